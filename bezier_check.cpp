@@ -0,0 +1,151 @@
+// verification de BezierFeedback : evalue des carreaux connus sur le gpu et compare les sommets relus
+// avec de casteljau sur le cpu. renvoie 0 si les resultats sont identiques a la tolerance pres, 1 sinon.
+// utilisable sans carte graphique, avec mesa / llvmpipe : LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./bezier_check
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "App.h"
+#include "Geometry.h"
+#include "BezierFeedback.h"
+#include "GL/TPAttributes.h"
+
+
+//! de casteljau sur le cpu, meme schema que bezier_feedback.gkfx : position et normale du carreau bilineaire final.
+void casteljau( const int n, const gk::Point *control, const float u, const float v, gk::Point& position, gk::Normal& normal )
+{
+    double p[gk::BezierFeedback::MAX_CONTROL][gk::BezierFeedback::MAX_CONTROL][3];
+    for(int i= 0; i < n; i++)
+        for(int j= 0; j < n; j++)
+        {
+            p[i][j][0]= control[i*n + j].x;
+            p[i][j][1]= control[i*n + j].y;
+            p[i][j][2]= control[i*n + j].z;
+        }
+
+    for(int r= 1; r < n - 1; r++)
+        for(int i= 0; i < n - r; i++)
+            for(int j= 0; j < n - r; j++)
+                for(int k= 0; k < 3; k++)
+                    p[i][j][k]= (1.0 - u) * ((1.0 - v) * p[i][j][k] + v * p[i][j+1][k])
+                        + u * ((1.0 - v) * p[i+1][j][k] + v * p[i+1][j+1][k]);
+
+    double du[3], dv[3], q[3];
+    for(int k= 0; k < 3; k++)
+    {
+        const double a= (1.0 - v) * p[0][0][k] + v * p[0][1][k];
+        const double b= (1.0 - v) * p[1][0][k] + v * p[1][1][k];
+        q[k]= (1.0 - u) * a + u * b;
+        du[k]= b - a;
+        dv[k]= ((1.0 - u) * p[0][1][k] + u * p[1][1][k]) - ((1.0 - u) * p[0][0][k] + u * p[1][0][k]);
+    }
+
+    position= gk::Point(q[0], q[1], q[2]);
+    const double nx= du[1] * dv[2] - du[2] * dv[1];
+    const double ny= du[2] * dv[0] - du[0] * dv[2];
+    const double nz= du[0] * dv[1] - du[1] * dv[0];
+    const double length= std::sqrt(nx*nx + ny*ny + nz*nz);
+    if(length > 0.0)
+        normal= gk::Normal(nx / length, ny / length, nz / length);
+    else
+        normal= gk::Normal(0.f, 0.f, 1.f);
+}
+
+//! carreau de n x n points de controle, une bosse decalee de 'offset'.
+void patch( const int n, const float offset, std::vector<gk::Point>& control )
+{
+    for(int i= 0; i < n; i++)
+        for(int j= 0; j < n; j++)
+        {
+            const float x= (float) i / (float) (n -1);
+            const float y= (float) j / (float) (n -1);
+            control.push_back( gk::Point(offset + x * 4.f, y * 3.f, std::sin(x * 3.f + offset) * std::cos(y * 2.f) * 2.f) );
+        }
+}
+
+//! evalue les carreaux sur le gpu et compare avec le cpu. renvoie le nombre d'erreurs.
+int check( gk::BezierFeedback& feedback, const int resolution, const int n, const std::vector<gk::Point>& control )
+{
+    const int patch_count= (int) control.size() / (n * n);
+    const int count= feedback.refine(n, &control.front(), patch_count);
+    if(count != patch_count * resolution * resolution)
+    {
+        printf("refine(n= %d): %d vertices, expected %d\n", n, count, patch_count * resolution * resolution);
+        return 1;
+    }
+    if(feedback.writtenVertexCount() != count)
+    {
+        printf("refine(n= %d): transform feedback wrote %d vertices, expected %d\n", n, feedback.writtenVertexCount(), count);
+        return 1;
+    }
+
+    std::vector<gk::Point> positions;
+    std::vector<gk::Normal> normals;
+    if(feedback.read(positions, normals) != count)
+    {
+        printf("read(n= %d) failed\n", n);
+        return 1;
+    }
+
+    int errors= 0;
+    float position_error= 0.f;
+    float normal_error= 0.f;
+    for(int p= 0; p < patch_count; p++)
+        for(int i= 0; i < resolution; i++)
+            for(int j= 0; j < resolution; j++)
+            {
+                const float u= (float) i / (float) (resolution -1);
+                const float v= (float) j / (float) (resolution -1);
+                const int id= p * resolution * resolution + i * resolution + j;
+
+                gk::Point position;
+                gk::Normal normal;
+                casteljau(n, &control[p * n * n], u, v, position, normal);
+
+                const float d= gk::Distance(positions[id], position);
+                const float c= 1.f - gk::Dot(normals[id], normal);
+                position_error= std::max(position_error, d);
+                normal_error= std::max(normal_error, c);
+                if(d > 1e-4f || c > 1e-4f)
+                {
+                    if(errors < 8)
+                        printf("  patch %d (%g, %g): gpu (%g %g %g) cpu (%g %g %g)\n", p, u, v,
+                            positions[id].x, positions[id].y, positions[id].z, position.x, position.y, position.z);
+                    errors++;
+                }
+            }
+
+    printf("n= %d, %d patches, %d vertices: max position error %g, max normal error %g, %d errors\n",
+        n, patch_count, count, position_error, normal_error, errors);
+    return errors;
+}
+
+int main( int argc, char **argv )
+{
+    gk::App app(64, 64);
+    if(app.isClosed())
+        return 1;
+    gk::BufferState::init();
+
+    const int resolution= 17;
+    gk::BezierFeedback feedback;
+    if(feedback.init(resolution, 4) < 0)
+    {
+        printf("BezierFeedback::init( ) failed.\n");
+        return 1;
+    }
+
+    int errors= 0;
+    for(int n= 2; n <= gk::BezierFeedback::MAX_CONTROL; n++)
+    {
+        std::vector<gk::Point> control;
+        for(int p= 0; p < 3; p++)
+            patch(n, (float) p, control);
+        errors+= check(feedback, resolution, n, control);
+    }
+
+    printf("%s\n", (errors == 0) ? "ok" : "FAILED");
+    return (errors == 0) ? 0 : 1;
+}
@@ -5,6 +5,7 @@
 #include "GL/GLPlatform.h"
 
 #include "App.h"
+#include "AsyncIO.h"
 #include "ProfilerClock.h"
 
 namespace gk {
@@ -335,6 +336,9 @@ int App::run( )
         // traitement des evenements : clavier, souris, fenetre, etc.
         processEvents();
         
+        // publie les objets charges en arriere plan, cf. AsyncIO
+        AsyncIO::update();
+        
         // mise a jour de la scene
         ProfilerClock::Ticks frame= ProfilerClock::getDelay(start);
         ProfilerClock::Ticks delta= ProfilerClock::delay(frame, last_frame);
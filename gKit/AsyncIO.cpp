@@ -0,0 +1,311 @@
+#include <cstdio>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "SDLImagePlatform.h"
+
+#include "AsyncIO.h"
+#include "ImageIO.h"
+#include "MeshIO.h"
+#include "MeshMaterialIO.h"
+
+
+namespace gk {
+
+AsyncIO::AsyncIO( )
+    :
+    m_requests(),
+    m_threads(),
+    m_queue(),
+    m_loaded(),
+    m_lock(SDL_CreateMutex()),
+    m_work(SDL_CreateCond()),
+    m_done(SDL_CreateCond()),
+    m_mesh_lock(SDL_CreateMutex()),
+    m_pending(0),
+    m_threads_n(0),
+    m_stop(false)
+{
+    // construit les managers avant AsyncIO : ils sont detruits apres l'arret des threads de chargement
+    ImageIO::manager();
+    HDRImageIO::manager();
+    MeshIO::manager();
+    MeshMaterialIO::manager();
+
+    // les decodeurs sont deja paralleles (openmp), quelques threads suffisent pour recouvrir les lectures
+#ifdef _OPENMP
+    m_threads_n= std::min(4, std::max(2, omp_get_num_procs() / 2));
+#else
+    m_threads_n= 2;
+#endif
+}
+
+AsyncIO::~AsyncIO( )
+{
+    // termine les threads, les requetes en cours de chargement sont terminees
+    if(m_lock != NULL)
+    {
+        SDL_LockMutex(m_lock);
+        m_stop= true;
+        SDL_CondBroadcast(m_work);
+        SDL_UnlockMutex(m_lock);
+    }
+
+    for(unsigned int i= 0; i < m_threads.size(); i++)
+        SDL_WaitThread(m_threads[i], NULL);
+
+    // detruit les requetes et les objets qui n'ont pas ete references par leur manager.
+    // les managers sont construits avant AsyncIO et detruits apres, cf. AsyncIO().
+    for(requests_map_type::iterator i= m_requests.begin(); i != m_requests.end(); ++i)
+        delete i->second;
+
+    SDL_DestroyCond(m_done);
+    SDL_DestroyCond(m_work);
+    SDL_DestroyMutex(m_mesh_lock);
+    SDL_DestroyMutex(m_lock);
+}
+
+int AsyncIO::worker( void *data )
+{
+    AsyncIO *io= (AsyncIO *) data;
+
+    SDL_LockMutex(io->m_lock);
+    for(;;)
+    {
+        while(io->m_queue.empty() && io->m_stop == false)
+            SDL_CondWait(io->m_work, io->m_lock);
+        if(io->m_stop)
+            break;
+
+        AsyncRequest *request= io->m_queue.front();
+        io->m_queue.pop_front();
+
+        // charge l'objet sans bloquer les autres threads
+        SDL_UnlockMutex(io->m_lock);
+        const int code= request->load();
+        SDL_LockMutex(io->m_lock);
+
+        request->m_code= code;
+        io->m_loaded.push_back(request);
+        SDL_CondBroadcast(io->m_done);
+    }
+    SDL_UnlockMutex(io->m_lock);
+
+    return 0;
+}
+
+Mesh *AsyncIO::decode_mesh( const std::string& filename )
+{
+    AsyncIO& io= manager();
+
+    SDL_LockMutex(io.m_mesh_lock);
+    Mesh *mesh= MeshIO::decode(filename);
+    SDL_UnlockMutex(io.m_mesh_lock);
+    return mesh;
+}
+
+int AsyncIO::start( )
+{
+    if(m_threads.empty() == false)
+        return 0;
+    if(m_lock == NULL || m_work == NULL || m_done == NULL || m_mesh_lock == NULL)
+        return -1;
+
+#if SDL_IMAGE_MAJOR_VERSION > 1 || SDL_IMAGE_MINOR_VERSION > 2 || SDL_IMAGE_PATCHLEVEL >= 8
+    // charge les bibliotheques de decodage avant les threads, IMG_Load() les charge a la premiere utilisation
+    IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_TIF);
+#endif
+
+    for(int i= 0; i < m_threads_n; i++)
+    {
+        SDL_Thread *thread= SDL_CreateThread(worker, this);
+        if(thread == NULL)
+            break;
+        m_threads.push_back(thread);
+    }
+
+    if(m_threads.empty())
+    {
+        printf("AsyncIO::start( ): thread creation failed:\n%s\n", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+template< class Object >
+TAsyncRequest<Object> *AsyncIO::request( IOManager<Object>& manager, typename TAsyncRequest<Object>::decode_function decode,
+    const std::string& filename, const std::string& name, AsyncCreate<Object> *create )
+{
+    // requete deja creee, en cours ou terminee
+    TAsyncRequest<Object> *request= NULL;
+    const std::pair<const void *, IOName> key((const void *) &manager, IOName(filename, name));
+    requests_map_type::iterator found= m_requests.find(key);
+    if(found != m_requests.end())
+    {
+        request= static_cast<TAsyncRequest<Object> *>(found->second);
+        if(request->m_state != AsyncRequest::FAILED)
+        {
+            request->attach(create);
+            return request;
+        }
+
+        // echec du chargement ou de la creation des ressources openGL : recommencer.
+        // les ressources openGL deja creees restent valides, seule la nouvelle creation est executee.
+        if(request->m_published == false)
+            delete request->m_object;
+        request->m_state= AsyncRequest::PENDING;
+        request->m_object= NULL;
+        request->m_handle.reset();
+        request->m_published= false;
+        request->m_creates.clear();
+    }
+    else
+    {
+        request= new TAsyncRequest<Object>(manager, decode, filename, name);
+        m_requests.insert( std::make_pair(key, request) );
+    }
+
+    // objet deja charge par IO::read(), pas de chargement
+    Object *object= manager.findAndAcquire(filename, name);
+    if(object != NULL)
+    {
+        request->m_object= object;
+        request->m_handle.adopt(manager, object);
+        request->m_published= true;
+        request->m_state= AsyncRequest::READY;
+        request->attach(create);
+        return request;
+    }
+
+    request->attach(create);
+    if(start() < 0)
+    {
+        request->m_state= AsyncRequest::FAILED;
+        return request;
+    }
+
+    SDL_LockMutex(m_lock);
+    m_queue.push_back(request);
+    m_pending++;
+    SDL_CondSignal(m_work);
+    SDL_UnlockMutex(m_lock);
+
+    return request;
+}
+
+int AsyncIO::publish( )
+{
+    std::vector<AsyncRequest *> loaded;
+    SDL_LockMutex(m_lock);
+    loaded.swap(m_loaded);
+    SDL_UnlockMutex(m_lock);
+
+    for(unsigned int i= 0; i < loaded.size(); i++)
+    {
+        AsyncRequest *request= loaded[i];
+        if(request->publish() < 0)
+        {
+            printf("AsyncIO: '%s' failed.\n", request->filename().c_str());
+            request->m_state= AsyncRequest::FAILED;
+        }
+        else
+            request->m_state= AsyncRequest::READY;
+        m_pending--;
+    }
+
+    return m_pending;
+}
+
+void AsyncIO::wait_loaded( )
+{
+    SDL_LockMutex(m_lock);
+    while(m_loaded.empty())
+        SDL_CondWait(m_done, m_lock);
+    SDL_UnlockMutex(m_lock);
+}
+
+TAsyncRequest<Image> *AsyncIO::readImage( const std::string& filename, const std::string& name,
+    AsyncCreate<Image> *create )
+{
+    return manager().request<Image>(ImageIO::manager(), ImageIO::decode, filename, name, create);
+}
+
+TAsyncRequest<HDRImage> *AsyncIO::readHDRImage( const std::string& filename, const std::string& name,
+    AsyncCreate<HDRImage> *create )
+{
+    return manager().request<HDRImage>(HDRImageIO::manager(), HDRImageIO::decode, filename, name, create);
+}
+
+TAsyncRequest<Mesh> *AsyncIO::readMesh( const std::string& filename, const std::string& name,
+    AsyncCreate<Mesh> *create )
+{
+    return manager().request<Mesh>(MeshIO::manager(), decode_mesh, filename, name, create);
+}
+
+int AsyncIO::update( )
+{
+    AsyncIO& io= manager();
+    if(io.m_pending == 0)
+        return 0;
+    return io.publish();
+}
+
+int AsyncIO::wait( AsyncRequest *request )
+{
+    if(request == NULL)
+        return -1;
+
+    AsyncIO& io= manager();
+    while(request->state() == AsyncRequest::PENDING)
+    {
+        io.wait_loaded();
+        io.publish();
+    }
+
+    return request->ready() ? 0 : -1;
+}
+
+int AsyncIO::finish( )
+{
+    AsyncIO& io= manager();
+    while(io.m_pending > 0)
+    {
+        io.wait_loaded();
+        io.publish();
+    }
+
+    for(requests_map_type::iterator i= io.m_requests.begin(); i != io.m_requests.end(); ++i)
+        if(i->second->failed())
+            return -1;
+    return 0;
+}
+
+int AsyncIO::drop( AsyncRequest *request )
+{
+    if(request == NULL || request->state() == AsyncRequest::PENDING)
+        return -1;
+
+    AsyncIO& io= manager();
+    for(requests_map_type::iterator i= io.m_requests.begin(); i != io.m_requests.end(); ++i)
+        if(i->second == request)
+        {
+            io.m_requests.erase(i);
+            delete request;
+            return 0;
+        }
+
+    return -1;
+}
+
+void AsyncIO::setThreads( const int n )
+{
+    AsyncIO& io= manager();
+    if(io.m_threads.empty() && n > 0)
+        io.m_threads_n= n;
+}
+
+}       // namespace
@@ -0,0 +1,325 @@
+#ifndef _GK_ASYNC_IO_H
+#define _GK_ASYNC_IO_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+#include "SDLPlatform.h"
+
+#include "IOManager.h"
+#include "Image.h"
+#include "Mesh.h"
+
+
+namespace gk {
+
+//! creation des ressources openGL d'un objet charge par AsyncIO, executee par le thread openGL, cf. AsyncIO::update().
+template< class Object >
+class AsyncCreate
+{
+public:
+    AsyncCreate( ) {}
+    virtual ~AsyncCreate( ) {}
+
+    //! cree les ressources openGL associees a l'objet, createGLResource(), etc.
+    //! \return 0 en cas de succes, -1 en cas d'erreur.
+    virtual int create( Object *object )= 0;
+};
+
+
+//! requete de chargement asynchrone, cf. AsyncIO.
+
+//! une requete est creee par AsyncIO::readImage(), readHDRImage() ou readMesh(), elle appartient a AsyncIO
+//! et reste valide jusqu'a AsyncIO::drop() ou la fin de l'application. son etat n'est modifie que par le thread openGL, cf. AsyncIO::update().
+class AsyncRequest
+{
+    friend class AsyncIO;
+
+    // non copyable
+    AsyncRequest( const AsyncRequest& );
+    AsyncRequest& operator=( const AsyncRequest& );
+
+public:
+    //! etat de la requete.
+    enum State
+    {
+        PENDING= 0,     //!< en attente ou en cours de chargement.
+        READY,          //!< objet charge, reference par son manager, ressources openGL creees.
+        FAILED          //!< echec du chargement ou de la creation des ressources openGL.
+    };
+
+protected:
+    std::string m_filename;
+    std::string m_name;
+    State m_state;      //!< modifie par le thread openGL uniquement.
+    int m_code;         //!< resultat de load(), modifie par un thread de chargement.
+
+    //! charge l'objet, execute par un thread de chargement.
+    //! \return 0 en cas de succes, -1 en cas d'erreur.
+    virtual int load( )= 0;
+
+    //! reference l'objet charge dans son manager et cree ses ressources openGL, execute par le thread openGL.
+    //! \return 0 en cas de succes, -1 en cas d'erreur.
+    virtual int publish( )= 0;
+
+public:
+    AsyncRequest( const std::string& filename, const std::string& name )
+        :
+        m_filename(filename),
+        m_name(name),
+        m_state(PENDING),
+        m_code(0)
+    {}
+
+    virtual ~AsyncRequest( ) {}
+
+    //! renvoie l'etat de la requete.
+    State state( ) const
+    {
+        return m_state;
+    }
+
+    //! vrai si l'objet est charge et utilisable.
+    bool ready( ) const
+    {
+        return (m_state == READY);
+    }
+
+    //! vrai si le chargement a echoue.
+    bool failed( ) const
+    {
+        return (m_state == FAILED);
+    }
+
+    const std::string& filename( ) const
+    {
+        return m_filename;
+    }
+
+    const std::string& name( ) const
+    {
+        return m_name;
+    }
+};
+
+
+//! requete de chargement asynchrone d'un objet, cf. AsyncIO.
+template< class Object >
+class TAsyncRequest : public AsyncRequest
+{
+    friend class AsyncIO;
+
+public:
+    //! fonction de chargement, sans referencer l'objet dans le manager, cf. ImageIO::decode().
+    typedef Object *(*decode_function)( const std::string& filename );
+
+protected:
+    IOManager<Object>& m_manager;
+    decode_function m_decode;
+    std::vector<AsyncCreate<Object> *> m_creates;
+    Object *m_object;
+    IOHandle<Object> m_handle;  //!< reference sur l'objet publie, cf. AsyncIO::drop().
+    bool m_published;   //!< l'objet appartient au manager.
+
+    int load( )
+    {
+        m_object= m_decode(m_filename);
+        return (m_object != NULL) ? 0 : -1;
+    }
+
+    int publish( )
+    {
+        if(m_code < 0 || m_object == NULL)
+            return -1;
+
+        // l'objet a pu etre charge entre temps par IO::read(), insert() conserve l'objet deja reference.
+        // l'objet est reference par la requete, il ne peut pas etre detruit pour respecter le budget du manager.
+        m_object= m_manager.insertAndAcquire(m_object, m_filename, m_name);
+        m_handle.adopt(m_manager, m_object);
+        m_published= true;
+
+        int code= 0;
+        for(unsigned int i= 0; i < m_creates.size(); i++)
+            if(m_creates[i]->create(m_object) < 0)
+                code= -1;
+        return code;
+    }
+
+    //! ajoute une creation de ressources openGL, executee immediatement si l'objet est deja charge.
+    int attach( AsyncCreate<Object> *create )
+    {
+        if(create == NULL)
+            return 0;
+        for(unsigned int i= 0; i < m_creates.size(); i++)
+            if(m_creates[i] == create)
+                return 0;
+
+        m_creates.push_back(create);
+        if(m_state == READY && create->create(get()) < 0)
+        {
+            m_state= FAILED;
+            return -1;
+        }
+        return 0;
+    }
+
+    TAsyncRequest( IOManager<Object>& manager, decode_function decode,
+        const std::string& filename, const std::string& name )
+        :
+        AsyncRequest(filename, name),
+        m_manager(manager),
+        m_decode(decode),
+        m_creates(),
+        m_object(NULL),
+        m_handle(),
+        m_published(false)
+    {}
+
+public:
+    //! retire une creation de ressources openGL, a appeler avant de detruire 'create' si la requete le reference encore.
+    void detach( AsyncCreate<Object> *create )
+    {
+        for(unsigned int i= 0; i < m_creates.size(); i++)
+            if(m_creates[i] == create)
+            {
+                m_creates.erase(m_creates.begin() + i);
+                return;
+            }
+    }
+    
+    //! detruit l'objet charge s'il n'a pas ete reference par le manager.
+    ~TAsyncRequest( )
+    {
+        if(m_published == false)
+            delete m_object;
+    }
+
+    //! renvoie l'objet charge, ou NULL si la requete n'est pas terminee, cf. ready(), AsyncIO::wait().
+    //! l'objet est reference par la requete, cf. IOHandle, et reste valide jusqu'a AsyncIO::drop().
+    Object *get( ) const
+    {
+        return (m_state == READY) ? m_handle.get() : NULL;
+    }
+};
+
+
+//! chargement asynchrone des images et des maillages.
+
+//! les fichiers sont decodes par un groupe de threads, pendant que l'application continue son initialisation
+//! (compilation des shaders, autres chargements, etc.). les objets decodes sont references par leur manager
+//! (ImageIO, HDRImageIO, MeshIO) et leurs ressources openGL sont creees par le thread openGL, dans update(),
+//! appele a chaque image par App::run(), ou dans wait() et finish().
+//! les requetes sur un meme fichier sont regroupees : un objet deja reference par son manager n'est pas recharge,
+//! une requete en cours ou terminee est partagee, une requete en echec est relancee.
+//! l'objet d'une requete terminee est reference par la requete (cf. IOHandle) : il n'est pas detruit pour respecter
+//! le budget de son manager, cf. IOManager::setBudget(), tant que la requete n'est pas retiree par drop().
+//! les creations de ressources openGL (AsyncCreate) sont conservees par la requete : elles doivent rester valides
+//! jusqu'a la fin de la requete, ou etre retirees par TAsyncRequest::detach().
+//! les maillages completent leurs matieres apres les avoir referencees dans MeshMaterialIO : ils sont charges un par un,
+//! et MeshIO::read() ne doit pas charger les memes matieres pendant leur chargement.
+/*! exemple d'utilisation :
+\code
+    // dans App::init(), m_diffuse est un membre de l'application : gk::AsyncTexture2D<gk::Image> m_diffuse;
+    gk::TAsyncRequest<gk::Image> *image= gk::AsyncIO::readImage("diffuse.png", "", &m_diffuse);
+    gk::TAsyncRequest<gk::Mesh> *mesh= gk::AsyncIO::readMesh("scene.obj");
+
+    // compiler les shaders, etc. pendant le chargement
+
+    if(gk::AsyncIO::finish() < 0)
+        return -1;
+    m_texture= m_diffuse.texture();
+    m_mesh= mesh->get();
+\endcode
+*/
+class AsyncIO
+{
+    // non copyable
+    AsyncIO( const AsyncIO& );
+    AsyncIO& operator=( const AsyncIO& );
+
+    typedef std::map< std::pair<const void *, IOName>, AsyncRequest * > requests_map_type;
+    requests_map_type m_requests;       //!< toutes les requetes, par manager et par nom.
+
+    std::vector<SDL_Thread *> m_threads;
+    std::deque<AsyncRequest *> m_queue;         //!< requetes en attente de chargement.
+    std::vector<AsyncRequest *> m_loaded;       //!< requetes chargees, en attente de publication.
+    SDL_mutex *m_lock;
+    SDL_cond *m_work;           //!< signale une nouvelle requete ou la fin des threads.
+    SDL_cond *m_done;           //!< signale une requete chargee.
+    SDL_mutex *m_mesh_lock;     //!< serialise le chargement des maillages, cf. MeshMaterialIO.
+    int m_pending;              //!< nombre de requetes non publiees.
+    int m_threads_n;
+    bool m_stop;
+
+    // private default constructor, singleton
+    AsyncIO( );
+    ~AsyncIO( );
+
+    //! boucle d'un thread de chargement.
+    static int worker( void *data );
+
+    //! chargement d'un maillage, un seul a la fois.
+    static Mesh *decode_mesh( const std::string& filename );
+
+    //! cree les threads de chargement, si necessaire.
+    int start( );
+
+    //! publie les requetes chargees.
+    int publish( );
+
+    //! attend qu'une requete soit chargee.
+    void wait_loaded( );
+
+    //! cree une requete ou renvoie la requete existante sur le meme objet.
+    template< class Object >
+    TAsyncRequest<Object> *request( IOManager<Object>& manager, typename TAsyncRequest<Object>::decode_function decode,
+        const std::string& filename, const std::string& name, AsyncCreate<Object> *create );
+
+public:
+    //! charge une image couleur, cf. ImageIO::read().
+    //! \param create creation des ressources openGL, executee par le thread openGL, peut etre NULL.
+    static TAsyncRequest<Image> *readImage( const std::string& filename, const std::string& name= "",
+        AsyncCreate<Image> *create= NULL );
+
+    //! charge une image hdr, cf. HDRImageIO::read().
+    static TAsyncRequest<HDRImage> *readHDRImage( const std::string& filename, const std::string& name= "",
+        AsyncCreate<HDRImage> *create= NULL );
+
+    //! charge un maillage, cf. MeshIO::read().
+    static TAsyncRequest<Mesh> *readMesh( const std::string& filename, const std::string& name= "",
+        AsyncCreate<Mesh> *create= NULL );
+
+    //! publie les objets charges : reference les objets dans leur manager et cree leurs ressources openGL.
+    //! a appeler par le thread openGL, ne bloque pas.
+    //! \return le nombre de requetes en cours.
+    static int update( );
+
+    //! attend la fin d'une requete, a appeler par le thread openGL.
+    //! \return 0 si l'objet est charge, -1 en cas d'erreur.
+    static int wait( AsyncRequest *request );
+
+    //! attend la fin de toutes les requetes, a appeler par le thread openGL.
+    //! \return 0 si tous les objets sont charges, -1 si au moins une requete a echoue.
+    static int finish( );
+
+    //! retire une requete terminee : son objet n'est plus reference par la requete, et la requete est detruite.
+    //! a appeler par le thread openGL.
+    //! \return 0 en cas de succes, -1 si la requete est en cours.
+    static int drop( AsyncRequest *request );
+    
+    //! fixe le nombre de threads de chargement, avant la premiere requete.
+    static void setThreads( const int n );
+
+    static
+    AsyncIO& manager( )  // singleton
+    {
+        static AsyncIO manager;
+        return manager;
+    }
+};
+
+}       // namespace
+
+#endif
@@ -0,0 +1,159 @@
+
+#include <cstdio>
+#include <cstring>
+
+#include "BezierFeedback.h"
+#include "BufferManager.h"
+#include "QueryManager.h"
+#include "EffectIO.h"
+#include "EffectShaderManager.h"
+#include "GL/GLQuery.h"
+#include "GL/TPAttributes.h"
+#include "GL/TPFeedback.h"
+#include "GL/TPShaderProgram.h"
+
+
+namespace gk {
+
+int BezierFeedback::init( const int resolution, const int max_patches, const std::string& effect )
+{
+    if(resolution < 2 || max_patches < 1)
+        return -1;
+
+    Effect *fx= EffectIO::read(effect);
+    if(fx == NULL)
+        return -1;
+    m_program= EffectShaderManager(fx).createShaderProgram("bezier_feedback");
+    if(m_program == NULL)
+        return -1;
+
+    // les varyings enregistres doivent etre declares avant l'edition de liens
+    std::vector<std::string> varyings;
+    varyings.push_back("position");
+    varyings.push_back("normal");
+    if(m_program->setFeedbackVaryings(varyings, GL_SEPARATE_ATTRIBS) < 0
+    || m_program->createGLResource() < 0)
+        return -1;
+
+    // grille de parametres, u selon i, v selon j
+    std::vector<Point2> parameters;
+    parameters.reserve(resolution * resolution);
+    for(int i= 0; i < resolution; i++)
+        for(int j= 0; j < resolution; j++)
+            parameters.push_back( Point2((float) i / (float) (resolution -1), (float) j / (float) (resolution -1)) );
+
+    // triangles de la grille, orientes selon cross(du, dv)
+    std::vector<unsigned int> indices;
+    indices.reserve((resolution -1) * (resolution -1) * 6);
+    for(int i= 0; i < resolution -1; i++)
+        for(int j= 0; j < resolution -1; j++)
+        {
+            const unsigned int a= i * resolution + j;
+            const unsigned int b= a + 1;
+            const unsigned int c= a + resolution;
+            const unsigned int d= c + 1;
+
+            indices.push_back(a); indices.push_back(c); indices.push_back(b);
+            indices.push_back(b); indices.push_back(c); indices.push_back(d);
+        }
+
+    const unsigned int count= max_patches * resolution * resolution;
+    m_parameters= createAttributeBuffer(parameters.size(), parameters.size() * sizeof(Point2), &parameters.front());
+    m_indices= createIndexBuffer(indices.size(), indices.size() * sizeof(unsigned int), &indices.front());
+    m_positions= createAttributeBuffer(count, count * sizeof(float[3]), NULL, GL_DYNAMIC_COPY);
+    m_normals= createAttributeBuffer(count, count * sizeof(float[3]), NULL, GL_DYNAMIC_COPY);
+    m_query= createQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+    if(m_parameters == NULL || m_indices == NULL || m_positions == NULL || m_normals == NULL || m_query == NULL)
+        return -1;
+    if(m_parameters->createGLResource() < 0 || m_indices->createGLResource() < 0
+    || m_positions->createGLResource() < 0 || m_normals->createGLResource() < 0
+    || m_query->createGLResource() < 0)
+        return -1;
+
+    m_resolution= resolution;
+    m_max_patches= max_patches;
+    m_patch_count= 0;
+    return 0;
+}
+
+int BezierFeedback::refine( const int n, const Point *control, const int patch_count )
+{
+    if(m_program == NULL || control == NULL)
+        return -1;
+    if(n < 2 || n > MAX_CONTROL || patch_count < 0 || patch_count > m_max_patches)
+        return -1;
+
+    const ProgramFeedback position= m_program->feedback("position");
+    const ProgramFeedback normal= m_program->feedback("normal");
+    const ProgramUniform points= m_program->uniform("control");
+
+    setShaderProgram(m_program);
+    setVertexBuffer(m_program->attribute("parameter"), m_parameters, 2, GL_FLOAT);
+    setFeedbackBuffer(position, m_positions);
+    setFeedbackBuffer(normal, m_normals);
+    setUniform(m_program->uniform("n"), n);
+
+    // pas de rasterisation, uniquement l'evaluation des sommets
+    glEnable(GL_RASTERIZER_DISCARD);
+    m_query->begin();
+    glBeginTransformFeedback(GL_POINTS);
+
+    // les draws successifs dans le meme begin / end ajoutent les sommets a la suite dans les buffers
+    const int vertex_count= patchVertexCount();
+    for(int p= 0; p < patch_count; p++)
+    {
+        setUniformArray(points, &control[p * n * n].x, n * n, 3);
+        DrawArrays(GL_POINTS, 0, vertex_count);
+    }
+
+    glEndTransformFeedback();
+    m_query->end();
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    resetFeedbackBuffer(position);
+    resetFeedbackBuffer(normal);
+    resetVertexBuffer(m_program->attribute("parameter"));
+
+    m_patch_count= patch_count;
+    return patch_count * vertex_count;
+}
+
+int BezierFeedback::writtenVertexCount( )
+{
+    if(m_query == NULL)
+        return -1;
+    // GL_POINTS : 1 primitive == 1 sommet
+    return m_query->result();
+}
+
+int BezierFeedback::read( std::vector<Point>& positions, std::vector<Normal>& normals )
+{
+    positions.clear();
+    normals.clear();
+    if(m_positions == NULL || m_normals == NULL)
+        return -1;
+
+    const int count= m_patch_count * patchVertexCount();
+    if(count == 0)
+        return 0;
+
+    const float *p= (const float *) m_positions->map(0, count * sizeof(float[3]), GL_MAP_READ_BIT);
+    if(p == NULL)
+        return -1;
+    positions.reserve(count);
+    for(int i= 0; i < count; i++)
+        positions.push_back( Point(p[3*i], p[3*i +1], p[3*i +2]) );
+    m_positions->unmap();
+
+    const float *nn= (const float *) m_normals->map(0, count * sizeof(float[3]), GL_MAP_READ_BIT);
+    if(nn == NULL)
+        return -1;
+    normals.reserve(count);
+    for(int i= 0; i < count; i++)
+        normals.push_back( Normal(nn[3*i], nn[3*i +1], nn[3*i +2]) );
+    m_normals->unmap();
+
+    return count;
+}
+
+}       // namespace
@@ -0,0 +1,115 @@
+#ifndef _GK_BEZIER_FEEDBACK_H
+#define _GK_BEZIER_FEEDBACK_H
+
+#include <string>
+#include <vector>
+
+#include "Geometry.h"
+#include "GL/GLPlatform.h"
+#include "GL/TPBuffer.h"
+
+
+namespace gk {
+
+class GLShaderProgram;
+class GLQuery;
+
+//! evaluation de carreaux de bezier sur le gpu : de casteljau dans un vertex shader, les sommets sont recuperes par transform feedback.
+
+//! chaque carreau de n x n points de controle est evalue sur une grille reguliere de resolution x resolution parametres (u, v),
+//! les positions et les normales des sommets sont ecrites dans 2 buffers, carreau apres carreau, sans passer par le cpu.
+//! les buffers s'utilisent directement comme attributs "position" et "normal" d'un shader, avec indexBuffer() :
+//! les sommets du carreau p commencent a p * patchVertexCount().
+//! cf. bezier_feedback.gkfx, utilise opengl 3 (glsl 130).
+class BezierFeedback
+{
+    GLShaderProgram *m_program;
+    GLAttributeBuffer *m_parameters;    //!< grille de parametres (u, v) partagee par tous les carreaux.
+    GLIndexBuffer *m_indices;           //!< triangles de la grille d'un carreau.
+    GLAttributeBuffer *m_positions;     //!< positions des sommets evalues, vec3.
+    GLAttributeBuffer *m_normals;       //!< normales des sommets evalues, vec3.
+    GLQuery *m_query;                   //!< nombre de sommets ecrits par le dernier refine().
+
+    int m_resolution;
+    int m_max_patches;
+    int m_patch_count;
+
+    // non copyable
+    BezierFeedback( const BezierFeedback& );
+    BezierFeedback& operator=( const BezierFeedback& );
+
+public:
+    //! nombre maximum de points de controle sur chaque cote d'un carreau, cf. MAX_CONTROL dans bezier_feedback.gkfx.
+    enum { MAX_CONTROL= 8 };
+
+    //! constructeur par defaut, cf. init().
+    BezierFeedback( )
+        :
+        m_program(NULL),
+        m_parameters(NULL),
+        m_indices(NULL),
+        m_positions(NULL),
+        m_normals(NULL),
+        m_query(NULL),
+        m_resolution(0),
+        m_max_patches(0),
+        m_patch_count(0)
+    {}
+
+    //! destructeur. les ressources openGL sont detruites par les managers.
+    ~BezierFeedback( ) {}
+
+    //! charge le shader et cree les buffers pour max_patches carreaux evalues sur une grille de resolution x resolution sommets.
+    //! a appeler apres la creation du contexte openGL et BufferState::init(), cf. bezier_check.cpp.
+    int init( const int resolution, const int max_patches, const std::string& effect= "bezier_feedback.gkfx" );
+
+    //! evalue patch_count carreaux de n x n points de controle, control[p*n*n + i*n + j], i selon u, j selon v.
+    //! \return le nombre de sommets ecrits dans positionBuffer() et normalBuffer(), ou -1 en cas d'erreur.
+    int refine( const int n, const Point *control, const int patch_count );
+
+    //! renvoie le nombre de sommets ecrits par le dernier refine(), attend la fin du transform feedback.
+    int writtenVertexCount( );
+
+    //! relit les sommets evalues par le dernier refine(), pour les verifications.
+    int read( std::vector<Point>& positions, std::vector<Normal>& normals );
+
+    //! renvoie le buffer des positions evaluees, vec3.
+    GLAttributeBuffer *positionBuffer( )
+    {
+        return m_positions;
+    }
+
+    //! renvoie le buffer des normales evaluees, vec3.
+    GLAttributeBuffer *normalBuffer( )
+    {
+        return m_normals;
+    }
+
+    //! renvoie le buffer d'indices (unsigned int) des triangles d'un carreau.
+    GLIndexBuffer *indexBuffer( )
+    {
+        return m_indices;
+    }
+
+    //! renvoie le nombre de sommets d'un carreau.
+    int patchVertexCount( ) const
+    {
+        return m_resolution * m_resolution;
+    }
+
+    //! renvoie le nombre d'indices d'un carreau.
+    int patchIndexCount( ) const
+    {
+        return (m_resolution - 1) * (m_resolution - 1) * 6;
+    }
+
+    //! renvoie le nombre de carreaux evalues par le dernier refine().
+    int patchCount( ) const
+    {
+        return m_patch_count;
+    }
+};
+
+}       // namespace
+
+#endif
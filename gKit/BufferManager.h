@@ -5,6 +5,7 @@
 #include "GLManager.h"
 #include "GL/GLPlatform.h"
 #include "GL/TPBuffer.h"
+#include "GL/TPStreamBuffer.h"
 
 
 namespace gk {
@@ -25,6 +26,22 @@ GLIndexBuffer *createIndexBuffer( const unsigned int count, const unsigned int s
         new GLIndexBuffer(count, size, data, usage) );
 }
 
+//! gestion 'auto' des ressources openGL : pour les buffers modifies a chaque image, cf. GLStreamBuffer.
+inline
+GLStreamBuffer *createStreamBuffer( const unsigned int frame_length )
+{
+    return GLManager<GLStreamBuffer>::manager().insert(
+        new GLStreamBuffer(frame_length) );
+}
+
+//! gestion 'auto' des ressources openGL : pour les pixel buffers, relecture asynchrone des resultats d'un rendu.
+inline
+GLPixelBuffer *createPixelBuffer( const unsigned int length, const GLenum usage= GL_STREAM_READ )
+{
+    return GLManager<GLPixelBuffer>::manager().insert(
+        new GLPixelBuffer(length, usage) );
+}
+
 }
 
 #endif
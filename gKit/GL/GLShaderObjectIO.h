@@ -22,9 +22,10 @@ class GLVertexShaderIO : public IOManager<GLVertexShader>
     ~GLVertexShaderIO( )
     {
         // detruire les ressources GL, ~IOManager() detruit les objets.
-        for(names_map_type::iterator 
-            i= m_names_map.begin(); i != m_names_map.end(); ++i)
-            i->second->releaseGLResource();
+        std::vector<GLVertexShader *> objects;
+        getObjects(objects);
+        for(unsigned int i= 0; i < objects.size(); i++)
+            objects[i]->releaseGLResource();
     }
     
 public:
@@ -68,9 +69,10 @@ class GLFragmentShaderIO : public IOManager<GLFragmentShader>
     ~GLFragmentShaderIO( )
     {
         // detruire les ressources GL, ~IOManager() detruit les objets.
-        for(names_map_type::iterator 
-            i= m_names_map.begin(); i != m_names_map.end(); ++i)
-            i->second->releaseGLResource();
+        std::vector<GLFragmentShader *> objects;
+        getObjects(objects);
+        for(unsigned int i= 0; i < objects.size(); i++)
+            objects[i]->releaseGLResource();
     }
     
 public:
@@ -115,9 +117,10 @@ class GLGeometryShaderIO : public IOManager<GLGeometryShader>
     ~GLGeometryShaderIO( )
     {
         // detruire les ressources GL, ~IOManager() detruit les objets.
-        for(names_map_type::iterator 
-            i= m_names_map.begin(); i != m_names_map.end(); ++i)
-            i->second->releaseGLResource();
+        std::vector<GLGeometryShader *> objects;
+        getObjects(objects);
+        for(unsigned int i= 0; i < objects.size(); i++)
+            objects[i]->releaseGLResource();
     }
     
 public:
@@ -162,9 +165,10 @@ class GLControlShaderIO : public IOManager<GLControlShader>
     ~GLControlShaderIO( )
     {
         // detruire les ressources GL, ~IOManager() detruit les objets.
-        for(names_map_type::iterator 
-            i= m_names_map.begin(); i != m_names_map.end(); ++i)
-            i->second->releaseGLResource();
+        std::vector<GLControlShader *> objects;
+        getObjects(objects);
+        for(unsigned int i= 0; i < objects.size(); i++)
+            objects[i]->releaseGLResource();
     }
     
 public:
@@ -209,9 +213,10 @@ class GLEvaluationShaderIO : public IOManager<GLEvaluationShader>
     ~GLEvaluationShaderIO( )
     {
         // detruire les ressources GL, ~IOManager() detruit les objets.
-        for(names_map_type::iterator 
-            i= m_names_map.begin(); i != m_names_map.end(); ++i)
-            i->second->releaseGLResource();
+        std::vector<GLEvaluationShader *> objects;
+        getObjects(objects);
+        for(unsigned int i= 0; i < objects.size(); i++)
+            objects[i]->releaseGLResource();
     }
     
 public:
@@ -54,6 +54,10 @@ int BufferState::init( )
     Attributes[INDIRECT]= ActiveAttributes[INDIRECT];
 #endif
     
+    active= PIXEL_PACK;
+    ActiveAttributes[PIXEL_PACK]= BufferState(GL_PIXEL_PACK_BUFFER, active);
+    Attributes[PIXEL_PACK]= ActiveAttributes[PIXEL_PACK];
+    
     return 0;
 }
 
@@ -198,6 +202,16 @@ BufferState& BufferState::resetIndexBuffer( )
     return *this;
 }
 
+BufferState& BufferState::resetPixelBuffer( )
+{
+    assert(m_target == GL_PIXEL_PACK_BUFFER);
+    
+    // glReadPixels() ecrit de nouveau en memoire centrale
+    glBindBuffer(m_target, 0);
+    m_buffer= NULL;
+    return *this;
+}
+
 
 BufferState& BufferState::reset( )
 {
@@ -39,6 +39,8 @@ enum
     
     INDIRECT,
     
+    PIXEL_PACK,
+    
     BUFFER_STATE_LAST
 };
 
@@ -150,6 +152,7 @@ public:
     
     BufferState& resetVertexBuffer( );
     BufferState& resetIndexBuffer( );
+    BufferState& resetPixelBuffer( );
 
     BufferState& reset( );
     
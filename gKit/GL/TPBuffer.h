@@ -309,6 +309,50 @@ public:
     }
 };
 
+//! representation d'un pixel buffer : destination de glReadPixels(), les donnees sont relues plus tard sans attendre le gpu.
+class GLPixelBuffer : public GLBuffer
+{
+public:
+    GLPixelBuffer( const unsigned int length, const GLenum usage= GL_STREAM_READ )
+        :
+        GLBuffer(PIXEL_PACK, length, length, NULL, usage )
+    {
+        // ne reste pas attache, glReadPixels() doit continuer a ecrire en memoire centrale.
+        ActiveAttributes[PIXEL_PACK].resetPixelBuffer();
+    }
+    
+    ~GLPixelBuffer( ) {}
+    
+    //! utilise le buffer comme destination de glReadPixels(), le parametre 'pixels' de glReadPixels() est un offset dans le buffer.
+    int bindAsPixelPack( )
+    {
+        if(m_name == 0)
+            return -1;
+        
+        ActiveAttributes[PIXEL_PACK].setBuffer(this);
+        return 0;
+    }
+    
+    //! glReadPixels() ecrit de nouveau en memoire centrale.
+    static
+    void unbindPixelPack( )
+    {
+        ActiveAttributes[PIXEL_PACK].resetPixelBuffer();
+    }
+    
+    void *map( const unsigned long int offset, const unsigned long int length, const GLbitfield access= GL_MAP_READ_BIT )
+    {
+        return GLBuffer::map(PIXEL_PACK, offset, length, access );
+    }
+    
+    int unmap( )
+    {
+        const int code= GLBuffer::unmap(PIXEL_PACK);
+        ActiveAttributes[PIXEL_PACK].resetPixelBuffer();
+        return code;
+    }
+};
+
 }
 
 #endif
@@ -159,4 +159,21 @@ int setUniform( const ProgramUniform& uniform, const float *m, const GLboolean t
     return -1;
 }
 
+int setUniformArray( const ProgramUniform& uniform, const float *v, const int count, const int size )
+{
+    if(uniform.isValid() == false)
+        return -1;
+    
+    ActiveShaderProgram.setShaderProgram(uniform.program());
+    switch(size)
+    {
+        case 1: glUniform1fv(uniform.location(), count, v); break;
+        case 2: glUniform2fv(uniform.location(), count, v); break;
+        case 3: glUniform3fv(uniform.location(), count, v); break;
+        case 4: glUniform4fv(uniform.location(), count, v); break;
+        default: return -1;
+    }
+    return 0;
+}
+
 }
@@ -125,6 +125,9 @@ int setUniform( const ProgramUniform& uniform, const float x, const float y, con
 //! modifier la valeur d'un uniform, mat4.
 int setUniform( const ProgramUniform& uniform, const float *m, const GLboolean transpose= GL_TRUE );
 
+//! modifier la valeur d'un tableau d'uniforms, float[count], vec2[count], vec3[count] ou vec4[count], selon size.
+int setUniformArray( const ProgramUniform& uniform, const float *v, const int count, const int size );
+
 }
 
 #endif
@@ -281,6 +281,19 @@ ProgramFeedback GLShaderProgram::feedback( const char *name ) const
 }
 
 
+int GLShaderProgram::setFeedbackVaryings( const std::vector<std::string>& varyings, const GLenum mode )
+{
+    if(mode != GL_SEPARATE_ATTRIBS && mode != GL_INTERLEAVED_ATTRIBS)
+        return -1;
+    
+    m_feedback_varyings= varyings;
+    m_feedback_mode= mode;
+    // re-linke le shader program, s'il est deja construit
+    if(m_is_linked)
+        return link();
+    return 0;
+}
+
 //! (re-)linke le shader program.
 int GLShaderProgram::link( )
 {
@@ -291,6 +304,15 @@ int GLShaderProgram::link( )
     m_attributes.clear();
     m_feedbacks.clear();
     
+    // declare les varyings du transform feedback, avant le link
+    if(m_feedback_varyings.empty() == false)
+    {
+        std::vector<const GLchar *> varyings;
+        for(unsigned int i= 0; i < m_feedback_varyings.size(); i++)
+            varyings.push_back(m_feedback_varyings[i].c_str());
+        glTransformFeedbackVaryings(m_name, (GLsizei) varyings.size(), &varyings.front(), m_feedback_mode);
+    }
+    
     GLint code;
     glLinkProgram(m_name);
     glGetProgramiv(m_name, GL_LINK_STATUS, &code);
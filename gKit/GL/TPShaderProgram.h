@@ -53,6 +53,8 @@ protected:
     std::vector<parameter> m_feedbacks;
     std::vector<parameter> m_attributes;
     std::vector<parameter> m_samplers;
+    std::vector<std::string> m_feedback_varyings;
+    GLenum m_feedback_mode;
 
     GLuint m_name;
     int m_attribute_count;
@@ -74,6 +76,8 @@ public:
         :
         m_shaders(),
         m_feedbacks(),
+        m_feedback_varyings(),
+        m_feedback_mode(GL_SEPARATE_ATTRIBS),
         m_name(0),
         m_is_linked(false),
         m_is_validated(false)
@@ -87,6 +91,10 @@ public:
     //! ajoute un shader object au shader program.
     int attachShader( GLShaderObject *shader );
 
+    //! declare les varyings enregistres par le transform feedback, a appeler avant createGLResource() ou link().
+    //! \param mode GL_SEPARATE_ATTRIBS, un buffer par varying, ou GL_INTERLEAVED_ATTRIBS, un seul buffer.
+    int setFeedbackVaryings( const std::vector<std::string>& varyings, const GLenum mode= GL_SEPARATE_ATTRIBS );
+    
     //! \todo definir attribute, varyings et samplers avant la compilation
     //! (re-)linke le shader program.
     int link( );
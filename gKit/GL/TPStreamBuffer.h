@@ -0,0 +1,214 @@
+#ifndef _TP_STREAM_BUFFER_H
+#define _TP_STREAM_BUFFER_H
+
+#include <cstdio>
+#include <cstring>
+
+#include "GL/GLPlatform.h"
+#include "GL/TPAttributes.h"
+#include "GL/TPBuffer.h"
+
+
+namespace gk {
+
+//! buffer d'attributs modifie a chaque image, sans attendre que le gpu termine les draws precedents.
+//! le buffer est decoupe en FRAMES regions, une par image : le cpu ecrit dans la region de l'image courante pendant que 
+//! le gpu utilise celles des images precedentes. une barriere (fence) est posee a la fin de chaque image, et l'application 
+//! n'attend que lorsqu'elle revient sur une region que le gpu n'a pas fini de lire (3 images de retard).
+//!
+//! utilise un mapping persistant et coherent (GL_ARB_buffer_storage) lorsqu'il est disponible, 
+//! sinon chaque allocation est mappee sans synchronisation (GL_MAP_UNSYNCHRONIZED_BIT), la barriere garantit que la region est libre.
+//!
+//! utilisation :
+//! \code
+//! stream->beginFrame();
+//! unsigned long int offset;
+//! float *p= (float *) stream->map(n * sizeof(float) * 3, offset);
+//! ... ecrire les sommets ...
+//! stream->unmap();
+//! setVertexBuffer(program->attribute("position"), stream, 3, GL_FLOAT, 0, offset);
+//! ... draw ...
+//! stream->endFrame();
+//! \endcode
+class GLStreamBuffer : public GLAttributeBuffer
+{
+public:
+    enum
+    {
+        FRAMES= 3       //!< nombre de regions / d'images en vol.
+    };
+    
+protected:
+    GLsync m_fences[FRAMES];
+    unsigned int m_frame_length;        //!< taille d'une region, en octets.
+    unsigned int m_frame;               //!< region de l'image courante.
+    unsigned int m_offset;              //!< premier octet libre de la region courante.
+    unsigned int m_stalls;              //!< nombre d'attentes du gpu.
+    
+    unsigned char *m_persistent;        //!< mapping persistant, ou NULL.
+    bool m_mapped;
+    
+public:
+    //! constructeur. 
+    //! \param frame_length taille maximale des donnees ecrites par image, en octets. le buffer alloue FRAMES * frame_length octets.
+    GLStreamBuffer( const unsigned int frame_length )
+        :
+        GLAttributeBuffer(0, 0, NULL, GL_STREAM_DRAW),
+        m_frame_length((frame_length + 255) & ~255u),
+        m_frame(0),
+        m_offset(0),
+        m_stalls(0),
+        m_persistent(NULL),
+        m_mapped(false)
+    {
+        for(int i= 0; i < FRAMES; i++)
+            m_fences[i]= 0;
+        
+        m_length= FRAMES * m_frame_length;
+        ActiveAttributes[ATTRIBUTE].setBuffer(this);
+        
+    #ifdef GL_MAP_PERSISTENT_BIT
+        if(GLEW_ARB_buffer_storage)
+        {
+            const GLbitfield flags= GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(ActiveAttributes[ATTRIBUTE].target(), m_length, NULL, flags);
+            m_persistent= (unsigned char *) glMapBufferRange(ActiveAttributes[ATTRIBUTE].target(), 0, m_length, flags);
+            if(m_persistent != NULL)
+                return;
+            
+            // pas de mapping persistant, re-cree un buffer classique.
+            // le binding actif reference deja this, setBuffer() ne re-associerait pas le nouveau nom.
+            glDeleteBuffers(1, &m_name);
+            glGenBuffers(1, &m_name);
+            glBindBuffer(ActiveAttributes[ATTRIBUTE].target(), m_name);
+        }
+    #endif
+        glBufferData(ActiveAttributes[ATTRIBUTE].target(), m_length, NULL, GL_STREAM_DRAW);
+    }
+    
+    //! destructeur.
+    ~GLStreamBuffer( )
+    {
+        for(int i= 0; i < FRAMES; i++)
+            if(m_fences[i] != 0)
+                glDeleteSync(m_fences[i]);
+        // glDeleteBuffers() termine le mapping persistant
+    }
+    
+    //! commence une image : attend, si necessaire, que le gpu ait fini d'utiliser la region de l'image.
+    int beginFrame( )
+    {
+        m_offset= 0;
+        GLsync& fence= m_fences[m_frame];
+        if(fence == 0)
+            return 0;
+        
+        GLenum status= glClientWaitSync(fence, 0, 0);
+        if(status == GL_TIMEOUT_EXPIRED)
+        {
+            m_stalls++;
+            // GL_SYNC_FLUSH_COMMANDS_BIT : la barriere doit etre envoyee au gpu pour etre signalee
+            do
+                status= glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            while(status == GL_TIMEOUT_EXPIRED);
+        }
+        
+        glDeleteSync(fence);
+        fence= 0;
+        return (status == GL_WAIT_FAILED) ? -1 : 0;
+    }
+    
+    //! termine l'image : pose la barriere qui protege la region apres les draws, et passe a la region suivante.
+    int endFrame( )
+    {
+        if(m_mapped)
+            unmap();
+        
+        if(m_fences[m_frame] != 0)
+            glDeleteSync(m_fences[m_frame]);
+        m_fences[m_frame]= glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_frame= (m_frame + 1) % FRAMES;
+        m_offset= 0;
+        return 0;
+    }
+    
+    //! alloue 'length' octets dans la region de l'image courante et renvoie un pointeur pour les ecrire, 
+    //! ou NULL si la region est pleine. 
+    //! \param offset position des donnees dans le buffer, a utiliser comme offset des attributs, cf. setVertexBuffer().
+    //! \param alignment alignement de l'allocation, puissance de 2.
+    //! les donnees doivent etre ecrites avant unmap() et avant le draw qui les utilise.
+    void *map( const unsigned int length, unsigned long int& offset, const unsigned int alignment= 16 )
+    {
+        if(m_name == 0)
+            return NULL;
+        if(m_mapped)
+            unmap();
+        
+        const unsigned int begin= (m_offset + alignment - 1) & ~(alignment - 1);
+        if(begin + length > m_frame_length)
+        {
+            printf("GLStreamBuffer::map( ): frame overflow, %u bytes, %u available.\n", length, m_frame_length - begin);
+            return NULL;
+        }
+        
+        m_offset= begin + length;
+        offset= m_frame * m_frame_length + begin;
+        if(m_persistent != NULL)
+            return m_persistent + offset;
+        
+        // la barriere de beginFrame() garantit que le gpu n'utilise plus la region
+        m_mapped= true;
+        return GLBuffer::map(ATTRIBUTE, offset, length, 
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    }
+    
+    //! termine l'ecriture des donnees allouees par map().
+    int unmap( )
+    {
+        if(m_mapped == false)
+            return 0;
+        
+        m_mapped= false;
+        return GLBuffer::unmap(ATTRIBUTE);
+    }
+    
+    //! copie 'length' octets dans la region de l'image courante, renvoie -1 si la region est pleine.
+    //! \param offset position des donnees dans le buffer, a utiliser comme offset des attributs, cf. setVertexBuffer().
+    int push( const void *data, const unsigned int length, unsigned long int& offset, const unsigned int alignment= 16 )
+    {
+        void *p= map(length, offset, alignment);
+        if(p == NULL)
+            return -1;
+        
+        memcpy(p, data, length);
+        return unmap();
+    }
+    
+    //! renvoie la taille d'une region, en octets.
+    unsigned int frameLength( ) const
+    {
+        return m_frame_length;
+    }
+    
+    //! renvoie le nombre d'octets encore disponibles dans la region de l'image courante.
+    unsigned int available( ) const
+    {
+        return m_frame_length - m_offset;
+    }
+    
+    //! renvoie vrai si le buffer utilise un mapping persistant.
+    bool isPersistent( ) const
+    {
+        return (m_persistent != NULL);
+    }
+    
+    //! renvoie le nombre de fois ou beginFrame() a du attendre le gpu.
+    unsigned int stalls( ) const
+    {
+        return m_stalls;
+    }
+};
+
+}
+
+#endif
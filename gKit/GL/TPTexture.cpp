@@ -96,9 +96,12 @@ GLTexture2D::GLTexture2D( const int unit, const HDRImage *image, const GLenum fo
     m_data_type= data_type;
     
     ActiveTextureUnits[unit].setTexture( ProgramSampler(unit), this );
+    // les lignes de l'image sont alignees et completees, cf. TImage::stride()
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image->stride());
     glTexImage2D(m_target, 0, 
         m_format, m_width, m_height, 0,
         data_format, data_type, image->data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     
     // definir les parametres de filtrages de base
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -126,9 +129,80 @@ GLTexture2D::GLTexture2D( const int unit, const Image *image, const GLenum forma
     m_data_type= data_type;
     
     ActiveTextureUnits[unit].setTexture( ProgramSampler(unit), this );
+    // les lignes de l'image sont alignees et completees, cf. TImage::stride()
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image->stride());
     glTexImage2D(m_target, 0, 
         m_format, m_width, m_height, 0,
         data_format, data_type, image->data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    
+    // definir les parametres de filtrages de base
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    
+    glGenerateMipmap(m_target);
+    assert(glGetError() == GL_NO_ERROR);
+}
+
+
+GLTexture2D::GLTexture2D( const int unit, const HalfImage *image, const GLenum format, 
+    const GLenum data_format, const GLenum data_type )
+    :
+    GLTexture(GL_TEXTURE_2D)
+{
+    if(image == NULL)
+        return;
+    
+    m_width= image->width();
+    m_height= image->height();
+    m_depth= 1;
+    m_format= format;
+    m_data_format= data_format;
+    m_data_type= data_type;
+    
+    ActiveTextureUnits[unit].setTexture( ProgramSampler(unit), this );
+    // les lignes de l'image sont alignees et completees, cf. TImage::stride()
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image->stride());
+    glTexImage2D(m_target, 0, 
+        m_format, m_width, m_height, 0,
+        data_format, data_type, image->data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    
+    // definir les parametres de filtrages de base
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    
+    glGenerateMipmap(m_target);
+    assert(glGetError() == GL_NO_ERROR);
+}
+
+
+GLTexture2D::GLTexture2D( const int unit, const RGB9E5Image *image, const GLenum format, 
+    const GLenum data_format, const GLenum data_type )
+    :
+    GLTexture(GL_TEXTURE_2D)
+{
+    if(image == NULL)
+        return;
+    
+    m_width= image->width();
+    m_height= image->height();
+    m_depth= 1;
+    m_format= format;
+    m_data_format= data_format;
+    m_data_type= data_type;
+    
+    ActiveTextureUnits[unit].setTexture( ProgramSampler(unit), this );
+    // les lignes de l'image sont alignees et completees, cf. TImage::stride()
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image->stride());
+    glTexImage2D(m_target, 0, 
+        m_format, m_width, m_height, 0,
+        data_format, data_type, image->data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     
     // definir les parametres de filtrages de base
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -216,10 +290,14 @@ GLTexture2DArray::GLTexture2DArray( const int unit, const HDRImageArray *images,
         data_format, data_type, NULL);
 
     for(int i= 0; i < m_depth; i++)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, (*images)[i]->stride());
         glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 
             0, 0, i,  
             m_width, m_height, 1, 
             data_format, data_type, (*images)[i]->data());
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     
     glGenerateMipmap(m_target);
 }
@@ -247,10 +325,14 @@ GLTexture2DArray::GLTexture2DArray( const int unit, const ImageArray *images, co
         data_format, data_type, NULL);
 
     for(int i= 0; i < m_depth; i++)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, (*images)[i]->stride());
         glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 
             0, 0, i,  
             m_width, m_height, 1, 
             data_format, data_type, (*images)[i]->data());
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     
     glGenerateMipmap(m_target);
 }
@@ -299,9 +381,13 @@ GLTextureCube::GLTextureCube( const int unit, const HDRImageCube *faces, const G
 
     ActiveTextureUnits[unit].setTexture( ProgramSampler(unit), this );
     for(int face= 0; face < 6; face++)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, (*faces)[face]->stride());
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 
             0, m_format, m_width, m_height, 0,
             data_format, data_type, (*faces)[face]->data());
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     
     glGenerateMipmap(m_target);
 }
@@ -325,9 +411,13 @@ GLTextureCube::GLTextureCube( const int unit, const ImageCube *faces, const GLen
     
     ActiveTextureUnits[unit].setTexture( ProgramSampler(unit), this );
     for(int face= 0; face < 6; face++)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, (*faces)[face]->stride());
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 
             0, m_format, m_width, m_height, 0,
             data_format, data_type, (*faces)[face]->data());
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     
     glGenerateMipmap(m_target);
 }
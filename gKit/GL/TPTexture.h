@@ -138,6 +138,14 @@ public:
     
     GLTexture2D( const int unit, const Image *image, const GLenum format= GL_RGBA, 
         const GLenum data_format= GL_RGBA, const GLenum data_type=GL_UNSIGNED_BYTE );
+    
+    //! texture hdr compacte, 8 octets par pixel.
+    GLTexture2D( const int unit, const HalfImage *image, const GLenum format= GL_RGBA16F, 
+        const GLenum data_format= GL_RGBA, const GLenum data_type= GL_HALF_FLOAT );
+    
+    //! texture hdr compacte, 4 octets par pixel.
+    GLTexture2D( const int unit, const RGB9E5Image *image, const GLenum format= GL_RGB9_E5, 
+        const GLenum data_format= GL_RGB, const GLenum data_type= GL_UNSIGNED_INT_5_9_9_9_REV );
 };
 
 class GLDepthTexture : public GLTexture2D
@@ -0,0 +1,162 @@
+#ifndef _GK_HALF_H
+#define _GK_HALF_H
+
+#include <cstring>
+
+#include "SIMD.h"
+
+
+namespace gk {
+
+//! conversion float 32 bits vers half float 16 bits, arrondi au plus proche, conserve les denormaux, les infinis et les nan.
+inline
+unsigned short FloatToHalf( const float value )
+{
+    unsigned int f;
+    memcpy(&f, &value, sizeof(f));
+    
+    const unsigned int sign= f & 0x80000000u;
+    f^= sign;
+    
+    unsigned int h;
+    if(f >= 0x47800000u)
+        // trop grand, infini ou nan
+        h= (f > 0x7f800000u) ? 0x7e00u : 0x7c00u;
+    else if(f < 0x38800000u)
+    {
+        // denormal ou zero : l'addition de 0.5 fait l'arrondi
+        float v;
+        memcpy(&v, &f, sizeof(v));
+        v+= 0.5f;
+        memcpy(&h, &v, sizeof(h));
+        h-= 0x3f000000u;
+    }
+    else
+    {
+        // normal : change le biais de l'exposant et arrondi la mantisse au plus proche pair
+        const unsigned int odd= (f >> 13) & 1u;
+        f+= 0xc8000fffu + odd;
+        h= f >> 13;
+    }
+    
+    return (unsigned short) (h | (sign >> 16));
+}
+
+//! conversion half float 16 bits vers float 32 bits.
+inline
+float HalfToFloat( const unsigned short value )
+{
+    const unsigned int exponent_mask= 0x7c00u << 13;
+    
+    unsigned int f= (value & 0x7fffu) << 13;
+    const unsigned int exponent= f & exponent_mask;
+    f+= (127 - 15) << 23;
+    
+    float v;
+    if(exponent == exponent_mask)
+    {
+        // infini ou nan
+        f+= (128 - 16) << 23;
+        memcpy(&v, &f, sizeof(v));
+    }
+    else if(exponent == 0)
+    {
+        // denormal ou zero : renormalise
+        f+= 1u << 23;
+        memcpy(&v, &f, sizeof(v));
+        v-= 6.103515625e-05f;     // 2^-14
+    }
+    else
+        memcpy(&v, &f, sizeof(v));
+    
+    if(value & 0x8000u)
+        v= -v;
+    return v;
+}
+
+#ifdef GK_SSE
+//! conversion de 4 floats en half floats, sse2, meme resultat que FloatToHalf( ).
+//! renvoie les half floats etendus (avec leur signe) sur 32 bits, cf. _mm_packs_epi32( ).
+inline
+__m128i FloatToHalf4( const __m128 value )
+{
+    const __m128i sign= _mm_and_si128(_mm_castps_si128(value), _mm_set1_epi32(0x80000000));
+    const __m128i f= _mm_xor_si128(_mm_castps_si128(value), sign);
+    const __m128 absf= _mm_castsi128_ps(f);
+
+    // trop grand, infini ou nan
+    const __m128i nan= _mm_castps_si128(_mm_cmpunord_ps(absf, absf));
+    const __m128i inf_nan= _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(nan, _mm_set1_epi32(0x0200)));
+    const __m128i regular= _mm_cmpgt_epi32(_mm_set1_epi32(0x47800000), f);
+
+    // denormal ou zero : l'addition de 0.5 fait l'arrondi
+    const __m128i denormal= _mm_cmpgt_epi32(_mm_set1_epi32(0x38800000), f);
+    const __m128i h_denormal= _mm_sub_epi32(
+        _mm_castps_si128(_mm_add_ps(absf, _mm_set1_ps(0.5f))), _mm_set1_epi32(0x3f000000));
+
+    // normal : change le biais de l'exposant et arrondi la mantisse au plus proche pair
+    const __m128i odd= _mm_srli_epi32(_mm_slli_epi32(f, 18), 31);
+    const __m128i h_normal= _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(f, _mm_set1_epi32(0xc8000fff)), odd), 13);
+
+    const __m128i h= _mm_or_si128(_mm_and_si128(denormal, h_denormal), _mm_andnot_si128(denormal, h_normal));
+    const __m128i result= _mm_or_si128(_mm_and_si128(regular, h), _mm_andnot_si128(regular, inf_nan));
+    return _mm_or_si128(result, _mm_srai_epi32(sign, 16));
+}
+
+//! conversion de 4 half floats (16 bits de poids faible de chaque entier) en floats, sse2, meme resultat que HalfToFloat( ).
+inline
+__m128 HalfToFloat4( const __m128i value )
+{
+    const __m128i h= _mm_and_si128(value, _mm_set1_epi32(0x7fff));
+    const __m128i sign= _mm_slli_epi32(_mm_xor_si128(_mm_and_si128(value, _mm_set1_epi32(0xffff)), h), 16);
+
+    // exposant + mantisse decales, multiplies par 2^112 : change le biais de l'exposant et renormalise les denormaux
+    const __m128 scaled= _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(h, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+
+    // infini ou nan
+    const __m128i inf_nan= _mm_and_si128(_mm_cmpgt_epi32(h, _mm_set1_epi32(0x7bff)), _mm_set1_epi32(255 << 23));
+    return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, inf_nan)));
+}
+#endif
+
+//! conversion de n floats en half floats, utilise les instructions f16c lorsqu'elles sont disponibles, ou sse2.
+inline
+void FloatToHalf( const int n, const float *in, unsigned short *out )
+{
+    int i= 0;
+#if defined(GK_SSE) && defined(__F16C__)
+    for(; i + 8 <= n; i+= 8)
+        _mm_storeu_si128((__m128i *) (out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#elif defined(GK_SSE)
+    for(; i + 8 <= n; i+= 8)
+        _mm_storeu_si128((__m128i *) (out + i), 
+            _mm_packs_epi32(FloatToHalf4(_mm_loadu_ps(in + i)), FloatToHalf4(_mm_loadu_ps(in + i + 4))));
+#endif
+    for(; i < n; i++)
+        out[i]= FloatToHalf(in[i]);
+}
+
+//! conversion de n half floats en floats, utilise les instructions f16c lorsqu'elles sont disponibles, ou sse2.
+inline
+void HalfToFloat( const int n, const unsigned short *in, float *out )
+{
+    int i= 0;
+#if defined(GK_SSE) && defined(__F16C__)
+    for(; i + 8 <= n; i+= 8)
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (in + i))));
+#elif defined(GK_SSE)
+    const __m128i zero= _mm_setzero_si128();
+    for(; i + 8 <= n; i+= 8)
+    {
+        const __m128i h= _mm_loadu_si128((const __m128i *) (in + i));
+        _mm_storeu_ps(out + i, HalfToFloat4(_mm_unpacklo_epi16(h, zero)));
+        _mm_storeu_ps(out + i + 4, HalfToFloat4(_mm_unpackhi_epi16(h, zero)));
+    }
+#endif
+    for(; i < n; i++)
+        out[i]= HalfToFloat(in[i]);
+}
+
+}       // namespace
+
+#endif
@@ -4,6 +4,17 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <algorithm>
+
+#ifdef WIN32
+    #include <windows.h>
+#else
+    #include <sys/time.h>
+#endif
+
+#include "SDLPlatform.h"
+#include "IOResource.h"
 
 #ifdef VERBOSE_DEBUG
 #include <cstdio>
@@ -17,12 +28,20 @@ struct IOName
 {
     std::string m_filename;
     std::string m_name;
+    unsigned int m_hash;        //!< hash fnv-1a du nom du fichier et du nom.
     
     IOName( const std::string& filename, const std::string& name )
         :
         m_filename(filename),
-        m_name(name)
-    {}
+        m_name(name),
+        m_hash(2166136261u)
+    {
+        for(unsigned int i= 0; i < filename.size(); i++)
+            m_hash= (m_hash ^ (unsigned char) filename[i]) * 16777619u;
+        m_hash= (m_hash ^ 0u) * 16777619u;      // separateur
+        for(unsigned int i= 0; i < name.size(); i++)
+            m_hash= (m_hash ^ (unsigned char) name[i]) * 16777619u;
+    }
     
     ~IOName( ) {}
     
@@ -36,9 +55,17 @@ struct IOName
         return m_filename;
     }
     
+    unsigned int hash( ) const
+    {
+        return m_hash;
+    }
+    
     //! necessaire pour l'insertion dans une std::map.
+    //! compare d'abord les hash : les chaines ne sont comparees qu'en cas de collision, ou pour l'objet recherche.
     bool operator<( const IOName& b ) const
     {
+        if(m_hash != b.m_hash)
+            return (m_hash < b.m_hash);
         if(m_filename < b.m_filename)
             return true;
         else if(m_filename > b.m_filename)
@@ -47,7 +74,32 @@ struct IOName
     }
 };
 
+//! statistiques d'un IOManager, cf. IOManager::stats().
+struct IOStats
+{
+    size_t bytes;               //!< memoire utilisee par les objets references, cf. IOResource::memoryUsage().
+    size_t peak;                //!< maximum de bytes.
+    size_t budget;              //!< budget, 0 : pas de limite.
+    int objects;                //!< nombre d'objets references.
+    int hits;                   //!< nombre de find() reussis.
+    int misses;                 //!< nombre de find() echoues.
+    int evictions;              //!< nombre d'objets detruits pour respecter le budget.
+    size_t evicted_bytes;       //!< memoire liberee par les evictions.
+    
+    IOStats( )
+        :
+        bytes(0), peak(0), budget(0), objects(0),
+        hits(0), misses(0), evictions(0), evicted_bytes(0)
+    {}
+};
+
 //! manager pour les 'objets' importes a partir d'un fichier.
+
+//! les objets sont repartis en SHARDS groupes, selon le hash de leur nom (cf. IOName) ou de leur adresse,
+//! chaque groupe est protege par son propre verrou : find() et insert() peuvent etre utilises par plusieurs threads.
+//! la memoire utilisee par les objets est comptabilisee (cf. IOResource::memoryUsage()), si elle depasse le budget
+//! (cf. setBudget(), pas de limite par defaut), insert() detruit les objets les moins recemment utilises (find(), insert())
+//! qui ne sont pas references par un IOHandle, jusqu'a 90% du budget. avec un budget, conserver un IOHandle sur les objets utilises.
 template< class Object >
 class IOManager
 {
@@ -56,33 +108,258 @@ class IOManager
     IOManager& operator=( const IOManager& );
 
 protected:
+    enum { SHARDS= 16 };
+    enum { LOW_WATER= 90 };     //!< evict() detruit des objets jusqu'a LOW_WATER % du budget.
+    
+    //! utilisation interne. objet reference.
+    struct Entry
+    {
+        Object *object;
+        size_t size;                    //!< memoire utilisee par l'objet.
+        unsigned long long stamp;       //!< date de la derniere utilisation.
+        int refs;                       //!< nombre d'IOHandle sur l'objet.
+        
+        Entry( Object *_object, const size_t _size, const unsigned long long _stamp )
+            :
+            object(_object), size(_size), stamp(_stamp), refs(0)
+        {}
+    };
+    
+    typedef std::map<IOName, Entry> names_map_type;
+    // stockage duplique des IONames, faire mieux... pour un vrai projet.
+    typedef std::map<Object *, IOName> objects_map_type;
+    
+    //! groupe d'objets, par nom. l'horloge et les compteurs sont modifies sous le verrou du groupe, cf. find().
+    struct NamesShard
+    {
+        names_map_type map;
+        SDL_mutex *lock;
+        unsigned long long clock;       //!< date de la derniere utilisation d'un objet du groupe, cf. tick().
+        int hits;
+        int misses;
+    };
+    
+    //! groupe d'objets, par adresse.
+    struct ObjectsShard
+    {
+        objects_map_type map;
+        SDL_mutex *lock;
+    };
+    
+    //! utilisation interne. objet a detruire, cf. evict().
+    struct Candidate
+    {
+        unsigned long long stamp;
+        Object *object;
+        IOName name;
+        
+        Candidate( const unsigned long long _stamp, Object *_object, const IOName& _name )
+            :
+            stamp(_stamp), object(_object), name(_name)
+        {}
+        
+        bool operator<( const Candidate& b ) const
+        {
+            return (stamp < b.stamp);
+        }
+    };
+    
+    NamesShard m_names[SHARDS];
+    ObjectsShard m_objects[SHARDS];
+    
+    SDL_mutex *m_lock;          //!< protege m_stats, sauf hits et misses comptes par chaque groupe.
+    IOStats m_stats;
+    
+    static
+    unsigned int shard( const IOName& name )
+    {
+        return name.hash() % SHARDS;
+    }
+    
+    static
+    unsigned int shard( const Object *object )
+    {
+        // les objets sont alloues par new, ignorer les bits d'alignement
+        const unsigned long long p= (unsigned long long) (size_t) object;
+        return (unsigned int) ((p >> 4) ^ (p >> 12)) % SHARDS;
+    }
+    
+    //! renvoie l'horloge systeme, en micro secondes.
+    static
+    unsigned long long now( )
+    {
+    #ifdef WIN32
+        LARGE_INTEGER ticks;
+        LARGE_INTEGER frequency;
+        QueryPerformanceCounter(&ticks);
+        QueryPerformanceFrequency(&frequency);
+        return (unsigned long long) (ticks.QuadPart / frequency.QuadPart) * 1000000u
+            + (unsigned long long) (ticks.QuadPart % frequency.QuadPart) * 1000000u / frequency.QuadPart;
+    #else
+        struct timeval ticks;
+        gettimeofday(&ticks, NULL);
+        return (unsigned long long) ticks.tv_sec * 1000000u + ticks.tv_usec;
+    #endif
+    }
+    
+    //! renvoie une nouvelle date d'utilisation, a appeler sous le verrou du groupe.
+    //! les dates d'un groupe sont strictement croissantes, les dates de groupes differents sont comparables
+    //! a la micro seconde pres : sans compteur partage, les recherches ne sont pas serialisees.
+    static
+    unsigned long long tick( NamesShard& names )
+    {
+        names.clock= std::max(names.clock +1, now() << 4);
+        return names.clock;
+    }
+    
+    //! modifie le nombre d'IOHandle sur un objet, et sa date d'utilisation.
+    int reference( Object *object, const int delta )
+    {
+        if(object == NULL)
+            return -1;
+        
+        // retrouve le nom de l'objet, puis l'objet : les verrous ne sont jamais imbriques dans cet ordre, cf. insert().
+        ObjectsShard& objects= m_objects[shard(object)];
+        SDL_LockMutex(objects.lock);
+        typename objects_map_type::iterator found= objects.map.find(object);
+        if(found == objects.map.end())
+        {
+            SDL_UnlockMutex(objects.lock);
+            return -1;
+        }
+        const IOName key= found->second;
+        SDL_UnlockMutex(objects.lock);
+        
+        NamesShard& names= m_names[shard(key)];
+        SDL_LockMutex(names.lock);
+        typename names_map_type::iterator entry= names.map.find(key);
+        int code= -1;
+        if(entry != names.map.end() && entry->second.object == object)
+        {
+            entry->second.refs+= delta;
+            entry->second.stamp= tick(names);
+            code= 0;
+        }
+        SDL_UnlockMutex(names.lock);
+        return code;
+    }
+    
+    //! renvoie vrai si la memoire utilisee est revenue sous LOW_WATER % du budget, a appeler sous m_lock.
+    bool underLowWater( ) const
+    {
+        return (m_stats.bytes <= m_stats.budget / 100 * LOW_WATER);
+    }
+    
+    //! detruit les objets les moins recemment utilises, non references par un IOHandle, si le budget est depasse.
+    //! les objets sont detruits par lots, jusqu'a LOW_WATER % du budget : le parcours et le tri de tous les objets
+    //! sont amortis sur les insertions suivantes, au lieu d'etre refaits a chaque insertion au budget.
+    //! \param keep objet a conserver, cf. insert().
+    int evict( const Object *keep )
+    {
+        SDL_LockMutex(m_lock);
+        const bool over= (m_stats.budget > 0 && m_stats.bytes > m_stats.budget);
+        SDL_UnlockMutex(m_lock);
+        if(over == false)
+            return 0;
+        
+        // objets detruisibles, du moins recemment utilise au plus recent
+        std::vector<Candidate> candidates;
+        for(int i= 0; i < SHARDS; i++)
+        {
+            SDL_LockMutex(m_names[i].lock);
+            for(typename names_map_type::iterator 
+                k= m_names[i].map.begin(); k != m_names[i].map.end(); ++k)
+            {
+                if(k->second.refs == 0 && k->second.size > 0 && k->second.object != keep)
+                    candidates.push_back( Candidate(k->second.stamp, k->second.object, k->first) );
+            }
+            SDL_UnlockMutex(m_names[i].lock);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        
+        int count= 0;
+        for(unsigned int i= 0; i < candidates.size(); i++)
+        {
+            SDL_LockMutex(m_lock);
+            const bool done= underLowWater();
+            SDL_UnlockMutex(m_lock);
+            if(done)
+                break;
+            
+            // l'objet a pu etre utilise ou reference depuis le parcours
+            const Candidate& candidate= candidates[i];
+            NamesShard& names= m_names[shard(candidate.name)];
+            SDL_LockMutex(names.lock);
+            typename names_map_type::iterator found= names.map.find(candidate.name);
+            if(found == names.map.end() || found->second.object != candidate.object
+            || found->second.refs > 0 || found->second.stamp != candidate.stamp)
+            {
+                SDL_UnlockMutex(names.lock);
+                continue;
+            }
+            
+            const size_t size= found->second.size;
+            names.map.erase(found);
+            ObjectsShard& objects= m_objects[shard(candidate.object)];
+            SDL_LockMutex(objects.lock);
+            objects.map.erase(candidate.object);
+            SDL_UnlockMutex(objects.lock);
+            SDL_UnlockMutex(names.lock);
+            
+        #ifdef VERBOSE_DEBUG
+            printf("IOManager<%s> %p::evict( ): object %p '%s', filename '%s', %lu bytes\n", 
+                typeid(Object).name(), this, candidate.object, 
+                candidate.name.m_name.c_str(), candidate.name.m_filename.c_str(), (unsigned long) size);
+        #endif
+            delete candidate.object;
+            count++;
+            
+            SDL_LockMutex(m_lock);
+            m_stats.bytes-= size;
+            m_stats.objects--;
+            m_stats.evictions++;
+            m_stats.evicted_bytes+= size;
+            SDL_UnlockMutex(m_lock);
+        }
+        
+        return count;
+    }
+    
     //! constructeur.
     IOManager( )
         :
-        m_names_map(),
-        m_objects_map()
-    {}
+        m_lock(SDL_CreateMutex()),
+        m_stats()
+    {
+        for(int i= 0; i < SHARDS; i++)
+        {
+            m_names[i].lock= SDL_CreateMutex();
+            m_names[i].clock= 0;
+            m_names[i].hits= 0;
+            m_names[i].misses= 0;
+            m_objects[i].lock= SDL_CreateMutex();
+        }
+    }
     
-    //! destructeur.
+    //! destructeur. detruit tous les objets, meme s'ils sont references par un IOHandle.
     virtual ~IOManager( )
     {
-        for(typename names_map_type::iterator 
-            i= m_names_map.begin(); i != m_names_map.end(); ++i)
+        for(int i= 0; i < SHARDS; i++)
         {
-            delete i->second;
+            for(typename names_map_type::iterator 
+                k= m_names[i].map.begin(); k != m_names[i].map.end(); ++k)
+            {
+                delete k->second.object;
+            }
+            
+            SDL_DestroyMutex(m_names[i].lock);
+            SDL_DestroyMutex(m_objects[i].lock);
         }
+        SDL_DestroyMutex(m_lock);
     }
-
-    typedef std::map<IOName, Object *> names_map_type;
-    names_map_type m_names_map;
-
-    // stockage duplique des IONames, faire mieux... pour un vrai projet.
-    typedef std::map<Object *, IOName> objects_map_type;
-    objects_map_type m_objects_map;
     
-public:
-    //! reference un nouvel 'objet' par son nom et le nom du fichier d'import.
-    Object *insert( Object *object, const std::string& filename, const std::string& name= "" )
+    //! reference un objet, cf. insert(). 'refs' references sont ajoutees sur l'objet renvoye, sous le verrou de son nom.
+    Object *insert( Object *object, const std::string& filename, const std::string& name, const int refs )
     {
         if(object == NULL)
             return NULL;
@@ -93,48 +370,292 @@ public:
             object, name.c_str(), filename.c_str());
     #endif
         
-        m_names_map.insert( std::make_pair( IOName(filename, name), object ) );
-        m_objects_map.insert( std::make_pair( object, IOName(filename, name) ) );
+        const IOName key(filename, name);
+        const size_t size= IOResourceMemory(object);
+        NamesShard& names= m_names[shard(key)];
+        SDL_LockMutex(names.lock);
+        const unsigned long long stamp= tick(names);
+        std::pair<typename names_map_type::iterator, bool> inserted= names.map.insert( std::make_pair(key, Entry(object, size, stamp)) );
+        if(inserted.second == false)
+        {
+            Object *found= inserted.first->second.object;
+            inserted.first->second.stamp= stamp;
+            inserted.first->second.refs+= refs;
+            SDL_UnlockMutex(names.lock);
+            if(found != object)
+                delete object;
+            return found;
+        }
+        inserted.first->second.refs= refs;
+        
+        // reference l'adresse avant de rendre l'objet visible par son nom : toujours verrouiller les noms puis les adresses.
+        ObjectsShard& objects= m_objects[shard(object)];
+        SDL_LockMutex(objects.lock);
+        objects.map.insert( std::make_pair(object, key) );
+        SDL_UnlockMutex(objects.lock);
+        SDL_UnlockMutex(names.lock);
+        
+        SDL_LockMutex(m_lock);
+        m_stats.bytes+= size;
+        m_stats.peak= std::max(m_stats.peak, m_stats.bytes);
+        m_stats.objects++;
+        SDL_UnlockMutex(m_lock);
+        
+        // respecte le budget, sans detruire le nouvel objet
+        evict(object);
         return object;
     }
     
-    //! recherche un 'objet' deja importe.
-    Object *find( const std::string& filename, const std::string& name= "" )
+    //! recherche un objet, cf. find(). 'refs' references sont ajoutees sur l'objet trouve, sous le verrou de son nom.
+    Object *find( const std::string& filename, const std::string& name, const int refs )
     {
-        typename names_map_type::iterator found= m_names_map.find( IOName(filename, name) );
+        const IOName key(filename, name);
+        NamesShard& names= m_names[shard(key)];
+        SDL_LockMutex(names.lock);
+        typename names_map_type::iterator found= names.map.find(key);
+        Object *object= NULL;
+        if(found != names.map.end())
+        {
+            object= found->second.object;
+            found->second.stamp= tick(names);
+            found->second.refs+= refs;
+            names.hits++;
+        }
+        else
+            names.misses++;
+        SDL_UnlockMutex(names.lock);
+        
     #ifdef VERBOSE_DEBUG
         printf("IOManager<%s> %p::find( ): object '%s', filename '%s'... ", 
             typeid(Object).name(), this,
             name.c_str(), filename.c_str());
-        if(found != m_names_map.end())
-            printf("found object %p done.\n", found->second);
+        if(object != NULL)
+            printf("found object %p done.\n", object);
         else
             printf("failed.\n");
     #endif
-
-        if(found == m_names_map.end())
-            return NULL;
-        else
-            return found->second;
+        
+        return object;
+    }
+    
+    //! renvoie tous les objets references, cf. les destructeurs des managers de shaders.
+    void getObjects( std::vector<Object *>& objects )
+    {
+        objects.clear();
+        for(int i= 0; i < SHARDS; i++)
+        {
+            SDL_LockMutex(m_names[i].lock);
+            for(typename names_map_type::iterator 
+                k= m_names[i].map.begin(); k != m_names[i].map.end(); ++k)
+            {
+                objects.push_back(k->second.object);
+            }
+            SDL_UnlockMutex(m_names[i].lock);
+        }
+    }
+    
+public:
+    //! reference un nouvel 'objet' par son nom et le nom du fichier d'import.
+    //! si un objet est deja reference sous ce nom (charge en meme temps par un autre thread, par exemple),
+    //! le nouvel objet est detruit et l'objet deja reference est renvoye.
+    //! si le budget est depasse, les objets les moins recemment utilises sont detruits, cf. setBudget().
+    Object *insert( Object *object, const std::string& filename, const std::string& name= "" )
+    {
+        return insert(object, filename, name, 0);
+    }
+    
+    //! reference un nouvel 'objet', cf. insert(), et ajoute une reference sur l'objet renvoye, cf. acquire() et IOHandle::adopt().
+    //! l'objet ne peut pas etre detruit pour respecter le budget entre son insertion et sa reference.
+    Object *insertAndAcquire( Object *object, const std::string& filename, const std::string& name= "" )
+    {
+        return insert(object, filename, name, 1);
+    }
+    
+    //! recherche un 'objet' deja importe.
+    //! avec un budget, l'objet peut etre detruit par une insertion d'un autre thread, cf. findAndAcquire().
+    Object *find( const std::string& filename, const std::string& name= "" )
+    {
+        return find(filename, name, 0);
+    }
+    
+    //! recherche un 'objet' deja importe, et ajoute une reference sur l'objet trouve, cf. acquire() et IOHandle::adopt().
+    //! l'objet ne peut pas etre detruit pour respecter le budget entre sa recherche et sa reference.
+    Object *findAndAcquire( const std::string& filename, const std::string& name= "" )
+    {
+        return find(filename, name, 1);
     }
     
-    //! recherche le nom et le nom du fichier d'un 'objet' deja importe.
-    const IOName *find( Object *object )
+    //! recherche le nom et le nom du fichier d'un 'objet' deja importe, copies dans 'name' : l'objet peut etre detruit ensuite.
+    //! \return 0 en cas de succes, -1 si l'objet n'est pas reference par le manager.
+    int find( Object *object, IOName& name )
     {
-        typename objects_map_type::iterator found= m_objects_map.find( object );
+        ObjectsShard& objects= m_objects[shard(object)];
+        SDL_LockMutex(objects.lock);
+        typename objects_map_type::iterator found= objects.map.find(object);
+        const bool exists= (found != objects.map.end());
+        if(exists)
+            name= found->second;
+        SDL_UnlockMutex(objects.lock);
+        
     #ifdef VERBOSE_DEBUG
         printf("IOManager<%s> %p::find( ): object %p... ", typeid(Object).name(), this, object);
-        if(found != m_objects_map.end())
+        if(exists)
             printf("found object '%s', filename '%s' done.\n", 
-                found->second.m_name.c_str(), found->second.m_filename.c_str());
+                name.m_name.c_str(), name.m_filename.c_str());
         else
             printf("failed.\n");
     #endif
         
-        if(found == m_objects_map.end())
-            return NULL;
-        else
-            return &found->second;
+        return exists ? 0 : -1;
+    }
+    
+    //! ajoute une reference sur un objet : il ne sera pas detruit pour respecter le budget, cf. IOHandle.
+    //! \return 0 en cas de succes, -1 si l'objet n'est pas reference par le manager.
+    int acquire( Object *object )
+    {
+        return reference(object, 1);
+    }
+    
+    //! retire une reference sur un objet, cf. acquire().
+    int release( Object *object )
+    {
+        return reference(object, -1);
+    }
+    
+    //! fixe la memoire maximale utilisee par les objets, en octets, 0 : pas de limite.
+    //! detruit les objets les moins recemment utilises si le budget est depasse, jusqu'a 90% du budget.
+    //! \return le nombre d'objets detruits.
+    int setBudget( const size_t bytes )
+    {
+        SDL_LockMutex(m_lock);
+        m_stats.budget= bytes;
+        SDL_UnlockMutex(m_lock);
+        return evict(NULL);
+    }
+    
+    //! detruit les objets les moins recemment utilises, non references, si le budget est depasse, jusqu'a 90% du budget.
+    //! \return le nombre d'objets detruits.
+    int evict( )
+    {
+        return evict(NULL);
+    }
+    
+    //! renvoie les statistiques du manager : memoire utilisee, evictions, etc.
+    IOStats stats( )
+    {
+        SDL_LockMutex(m_lock);
+        IOStats stats= m_stats;
+        SDL_UnlockMutex(m_lock);
+        
+        for(int i= 0; i < SHARDS; i++)
+        {
+            SDL_LockMutex(m_names[i].lock);
+            stats.hits+= m_names[i].hits;
+            stats.misses+= m_names[i].misses;
+            SDL_UnlockMutex(m_names[i].lock);
+        }
+        return stats;
+    }
+};
+
+
+//! reference comptee sur un objet d'un IOManager : l'objet n'est pas detruit pour respecter le budget du manager
+//! tant qu'un IOHandle le reference. copiable.
+//! un objet renvoye par find() ou IO::read() peut etre detruit par un autre thread avant d'etre reference par un IOHandle :
+//! utiliser IOHandle(manager, filename, name), ou IO::readHandle() pour charger et referencer l'objet.
+/*! exemple d'utilisation :
+\code
+    gk::ImageIO::manager().setBudget(512 * 1024 * 1024);
+    gk::IOHandle<gk::Image> image= gk::ImageIO::readHandle("diffuse.png");
+    if(image.get() == NULL)
+        return -1;
+    printf("%dx%d\n", image->width(), image->height());
+\endcode
+*/
+template< class Object >
+class IOHandle
+{
+    IOManager<Object> *m_manager;
+    Object *m_object;
+    
+public:
+    IOHandle( )
+        :
+        m_manager(NULL),
+        m_object(NULL)
+    {}
+    
+    //! reference un objet du manager, get() renvoie NULL si l'objet n'est pas (ou plus) reference par le manager.
+    IOHandle( IOManager<Object>& manager, Object *object )
+        :
+        m_manager(&manager),
+        m_object(NULL)
+    {
+        if(object != NULL && manager.acquire(object) == 0)
+            m_object= object;
+    }
+    
+    //! recherche et reference un objet du manager, cf. IOManager::findAndAcquire().
+    IOHandle( IOManager<Object>& manager, const std::string& filename, const std::string& name= "" )
+        :
+        m_manager(&manager),
+        m_object(manager.findAndAcquire(filename, name))
+    {}
+    
+    IOHandle( const IOHandle& b )
+        :
+        m_manager(b.m_manager),
+        m_object(NULL)
+    {
+        if(b.m_object != NULL && m_manager->acquire(b.m_object) == 0)
+            m_object= b.m_object;
+    }
+    
+    IOHandle& operator=( const IOHandle& b )
+    {
+        Object *object= NULL;
+        if(b.m_object != NULL && b.m_manager->acquire(b.m_object) == 0)
+            object= b.m_object;
+        reset();
+        m_manager= b.m_manager;
+        m_object= object;
+        return *this;
+    }
+    
+    ~IOHandle( )
+    {
+        reset();
+    }
+    
+    //! retire la reference sur l'objet.
+    void reset( )
+    {
+        if(m_object != NULL)
+            m_manager->release(m_object);
+        m_object= NULL;
+    }
+    
+    //! prend en charge une reference deja ajoutee sur un objet, cf. IOManager::findAndAcquire() et insertAndAcquire().
+    void adopt( IOManager<Object>& manager, Object *object )
+    {
+        reset();
+        m_manager= &manager;
+        m_object= object;
+    }
+    
+    Object *get( ) const
+    {
+        return m_object;
+    }
+    
+    Object *operator->( ) const
+    {
+        return m_object;
+    }
+    
+    Object& operator*( ) const
+    {
+        return *m_object;
     }
 };
 
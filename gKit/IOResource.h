@@ -2,6 +2,8 @@
 #ifndef _IORESOURCE_H
 #define _IORESOURCE_H
 
+#include <cstddef>
+
 namespace gk {
 
 //! classe de base des resources importees depuis un fichier, referencees par l'application, proprietes du gk::IOManager.
@@ -14,8 +16,29 @@ class IOResource
 public:
     IOResource( ) {}
     virtual ~IOResource( ) {}
+    
+    //! renvoie la memoire utilisee par la ressource, en octets, cf. le budget des IOManager.
+    //! 0 par defaut : la ressource n'est pas comptabilisee, ni detruite pour respecter le budget.
+    virtual size_t memoryUsage( ) const
+    {
+        return 0;
+    }
 };
 
+//! utilisation interne. renvoie la memoire utilisee par une ressource, cf. IOManager.
+inline
+size_t IOResourceMemory( const IOResource *resource )
+{
+    return resource->memoryUsage();
+}
+
+//! utilisation interne. les objets qui ne derivent pas de IOResource (shaders, etc.) ne sont pas comptabilises.
+inline
+size_t IOResourceMemory( const void * )
+{
+    return 0;
+}
+
 } // namespace
 
 #endif
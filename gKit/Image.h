@@ -4,9 +4,12 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <memory>
 #include <string>
 
 #include "IOResource.h"
+#include "Half.h"
+#include "RGB9E5.h"
 
 namespace gk {
 
@@ -50,6 +53,87 @@ struct Pixel
     ~Pixel( ) {}
 };
 
+//! representation d'un pixel 'hdr' rgba compact, en half float, 8 octets, cf. GL_RGBA16F.
+struct HalfPixel
+{
+    //! composantes publiques, half float.
+    unsigned short r, g, b, a;
+
+    typedef unsigned short type;
+    enum { d= 4 };
+
+    static
+    bool isColorPixel( )
+    {
+        return false;
+    }
+
+    static
+    bool isHdrPixel( )
+    {
+        return true;
+    }
+
+    //! par defaut, pixel noir.
+    HalfPixel( )
+        :
+        r(0), g(0), b(0), a(0x3c00)
+    {
+        assert(sizeof(HalfPixel) == sizeof(unsigned short[4]));
+    }
+
+    //! cree un pixel half float rgba.
+    HalfPixel( const float _r, const float _g, const float _b, const float _a= 1.f )
+        :
+        r(FloatToHalf(_r)), g(FloatToHalf(_g)), b(FloatToHalf(_b)), a(FloatToHalf(_a))
+    {
+        assert(sizeof(HalfPixel) == sizeof(unsigned short[4]));
+    }
+
+    ~HalfPixel( ) {}
+};
+
+//! representation d'un pixel 'hdr' rgb compact, 3 mantisses de 9 bits et un exposant partage, 4 octets, cf. GL_RGB9_E5.
+//! meme encombrement qu'un pixel rgbe (.hdr), mais utilisable directement comme texture.
+struct RGB9E5Pixel
+{
+    //! valeur codee.
+    unsigned int value;
+
+    typedef unsigned int type;
+    enum { d= 1 };
+
+    static
+    bool isColorPixel( )
+    {
+        return false;
+    }
+
+    static
+    bool isHdrPixel( )
+    {
+        return true;
+    }
+
+    //! par defaut, pixel noir.
+    RGB9E5Pixel( )
+        :
+        value(0)
+    {
+        assert(sizeof(RGB9E5Pixel) == sizeof(unsigned int));
+    }
+
+    //! cree un pixel rgb9e5, les composantes sont limitees a [0 65408].
+    RGB9E5Pixel( const float r, const float g, const float b )
+        :
+        value(FloatToRGB9E5(r, g, b))
+    {
+        assert(sizeof(RGB9E5Pixel) == sizeof(unsigned int));
+    }
+
+    ~RGB9E5Pixel( ) {}
+};
+
 //! representation d'un pixel 'hdr' rgba.
 struct HDRPixel
 {
@@ -96,12 +180,134 @@ struct HDRPixel
         a((float) color.a / 255.f)
     {}
     
+    //! cree un pixel hdr rgba a partir d'un pixel half float.
+    HDRPixel( const HalfPixel& color )
+        :
+        r(HalfToFloat(color.r)),
+        g(HalfToFloat(color.g)),
+        b(HalfToFloat(color.b)),
+        a(HalfToFloat(color.a))
+    {}
+    
+    //! cree un pixel hdr rgba a partir d'un pixel rgb9e5, alpha= 1.
+    HDRPixel( const RGB9E5Pixel& color )
+        :
+        a(1.f)
+    {
+        RGB9E5ToFloat(color.value, r, g, b);
+    }
+    
+    //! renvoie le pixel en half float.
+    HalfPixel half( ) const
+    {
+        return HalfPixel(r, g, b, a);
+    }
+    
+    //! renvoie le pixel en rgb9e5, alpha est ignore.
+    RGB9E5Pixel rgb9e5( ) const
+    {
+        return RGB9E5Pixel(r, g, b);
+    }
+    
     ~HDRPixel( ) {}
 };
 
 
+//! vue sur une partie de ligne : size pixels contigus.
+template< class T >
+struct TSpan
+{
+    T *data;
+    int size;
+
+    TSpan( ) : data(NULL), size(0) {}
+    TSpan( T *_data, const int _size ) : data(_data), size(_size) {}
+
+    T& operator[] ( const int i ) const
+    {
+        assert(i >= 0 && i < size);
+        return data[i];
+    }
+
+    T *begin( ) const
+    {
+        return data;
+    }
+
+    T *end( ) const
+    {
+        return data + size;
+    }
+};
+
+//! vue sur une image, ou un rectangle d'une image : width x height pixels, les lignes sont separees par stride pixels.
+//! les boucles sur les pixels parcourent les lignes, cf. row(), sans tests ni multiplication par pixel.
+/*! exemple :
+\code
+    gk::HDRImageView view= image->view();
+    for(int y= 0; y < view.height; y++)
+    {
+        gk::HDRPixel *p= view.row(y);
+        for(int x= 0; x < view.width; x++)
+            p[x].r*= 2.f;
+    }
+\endcode
+*/
+template< class T >
+struct TImageView
+{
+    T *data;            //!< premier pixel.
+    int width;
+    int height;
+    int stride;         //!< nombre de pixels entre le debut de 2 lignes.
+
+    TImageView( ) : data(NULL), width(0), height(0), stride(0) {}
+    TImageView( T *_data, const int _width, const int _height, const int _stride )
+        :
+        data(_data), width(_width), height(_height), stride(_stride)
+    {}
+
+    //! renvoie le premier pixel d'une ligne.
+    T *row( const int y ) const
+    {
+        assert(y >= 0 && y < height);
+        return data + (size_t) y * stride;
+    }
+
+    //! renvoie une partie de ligne, n pixels a partir de x.
+    TSpan<T> span( const int y, const int x= 0, const int n= -1 ) const
+    {
+        assert(x >= 0 && x <= width);
+        return TSpan<T>(row(y) + x, (n < 0) ? width - x : n);
+    }
+
+    //! renvoie une vue sur un rectangle, les pixels ne sont pas copies.
+    TImageView sub( const int x, const int y, const int w, const int h ) const
+    {
+        assert(x >= 0 && y >= 0 && x + w <= width && y + h <= height);
+        return TImageView(data + (size_t) y * stride + x, w, h, stride);
+    }
+
+    //! vrai si x, y est dans la vue.
+    bool contains( const int x, const int y ) const
+    {
+        return (x >= 0 && x < width && y >= 0 && y < height);
+    }
+
+    //! vrai si les lignes sont contigues, sans remplissage.
+    bool isContiguous( ) const
+    {
+        return (stride == width || height <= 1);
+    }
+};
+
+
 //! utilisation interne. representation d'une image, parametree par le type de pixel, cf. gk::Pixel et gk::HDRPixel.
 //! utiliser gk::Image et gk::HDRImage.
+
+//! le premier pixel de chaque ligne est aligne sur ALIGNMENT octets, les lignes sont completees, cf. stride() : 
+//! les boucles sur les lignes, cf. row() et view(), et les traitements sse / avx n'ont pas a gerer de lignes mal alignees.
+//! les pixels d'une ligne sont contigus, mais pas les lignes : utiliser row() ou stride() plutot que data() + y * width().
 template< class T >
 class TImage : public IOResource
 {
@@ -109,25 +315,46 @@ class TImage : public IOResource
     TImage( const TImage& );
     TImage& operator=( const TImage& );
     
+    unsigned char *m_storage;
     T *m_data;
     int m_width;
     int m_height;
+    int m_stride;
 
 public:
+    //! alignement du debut des lignes, en octets, cf. taille d'une ligne de cache et des registres avx.
+    enum { ALIGNMENT= 64 };
+
     //! construction d'une image de dimension width x height.
     TImage( const int width, const int height ) 
         :
+        m_storage(NULL),
+        m_data(NULL),
         m_width(width), 
-        m_height(height)
+        m_height(height),
+        m_stride(0)
     {
-        m_data= new T[width * height];
-        assert(m_data != NULL);
+        assert(ALIGNMENT % sizeof(T) == 0);
+        const size_t pitch= ((size_t) width * sizeof(T) + ALIGNMENT -1) & ~((size_t) ALIGNMENT -1);
+        m_stride= (int) (pitch / sizeof(T));
+
+        const size_t size= pitch * height;
+        m_storage= new unsigned char[size + ALIGNMENT];
+        assert(m_storage != NULL);
+        m_data= (T *) (m_storage + (ALIGNMENT - ((size_t) m_storage & (ALIGNMENT -1))) % ALIGNMENT);
+        std::uninitialized_fill(m_data, m_data + (size_t) m_stride * height, T());
     }
 
     //! destructeur.
     ~TImage( )
     {
-        delete [] m_data;
+        delete [] m_storage;
+    }
+    
+    //! renvoie la memoire utilisee par l'image, lignes alignees comprises.
+    size_t memoryUsage( ) const
+    {
+        return sizeof(TImage) + (size_t) m_stride * m_height * sizeof(T) + ALIGNMENT;
     }
 
     bool isColorImage( ) const
@@ -140,13 +367,13 @@ public:
         return T::isHdrPixel();
     }    
     
-    //! renvoie les donnees brutes de l'image.
+    //! renvoie les donnees brutes de l'image, premier pixel de la premiere ligne, cf. stride().
     void *data( )
     {
         return m_data;
     }
 
-    //! renvoie les donnees brutes de l'image. 
+    //! renvoie les donnees brutes de l'image, premier pixel de la premiere ligne, cf. stride().
     const void *data( ) const
     {
         return m_data;
@@ -164,15 +391,51 @@ public:
         return m_height;
     }
 
+    //! renvoie le nombre de pixels entre le debut de 2 lignes, stride() >= width().
+    int stride( ) const
+    {
+        return m_stride;
+    }
+
+    //! renvoie le nombre d'octets entre le debut de 2 lignes, multiple de ALIGNMENT.
+    size_t pitch( ) const
+    {
+        return (size_t) m_stride * sizeof(T);
+    }
+
+    //! renvoie le premier pixel d'une ligne, aligne sur ALIGNMENT octets.
+    T *row( const int y )
+    {
+        assert(y >= 0 && y < m_height);
+        return m_data + (size_t) y * m_stride;
+    }
+
+    //! renvoie le premier pixel d'une ligne, aligne sur ALIGNMENT octets.
+    const T *row( const int y ) const
+    {
+        assert(y >= 0 && y < m_height);
+        return m_data + (size_t) y * m_stride;
+    }
+
+    //! renvoie une vue sur tous les pixels de l'image.
+    TImageView<T> view( )
+    {
+        return TImageView<T>(m_data, m_width, m_height, m_stride);
+    }
+
+    //! renvoie une vue sur tous les pixels de l'image.
+    TImageView<const T> view( ) const
+    {
+        return TImageView<const T>(m_data, m_width, m_height, m_stride);
+    }
+
     //! remplace la couleur d'un pixel.
     void setPixel( const int x, const int y, const T& color )
     {
         assert(x >= 0 && x < m_width);
         assert(y >= 0 && y < m_height);
         
-        //~ const unsigned int id= (m_height - 1 - y) * m_width + x;
-        const unsigned int id= y * m_width + x;
-        m_data[id]= color;
+        m_data[(size_t) y * m_stride + x]= color;
     }
 
     //! renvoie la couleur d'un pixel.
@@ -181,9 +444,7 @@ public:
         assert(x >= 0 && x < m_width);
         assert(y >= 0 && y < m_height);
         
-        //~ const unsigned int id= (m_height - 1 - y) * m_width + x;
-        const unsigned int id= y * m_width + x;
-        return m_data[id];
+        return m_data[(size_t) y * m_stride + x];
     }
 };
 
@@ -193,6 +454,18 @@ typedef TImage<HDRPixel> HDRImage;
 //! declaration d'une image 'classique', avec pixels rgba.
 typedef TImage<Pixel> Image;
 
+//! declaration d'une image hdr compacte, pixels rgba half float.
+typedef TImage<HalfPixel> HalfImage;
+
+//! declaration d'une image hdr compacte, pixels rgb9e5.
+typedef TImage<RGB9E5Pixel> RGB9E5Image;
+
+//! vues sur les pixels des images.
+typedef TImageView<HDRPixel> HDRImageView;
+typedef TImageView<const HDRPixel> ConstHDRImageView;
+typedef TImageView<Pixel> ImageView;
+typedef TImageView<const Pixel> ConstImageView;
+
 }       // namespace
 
 #endif
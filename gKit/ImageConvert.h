@@ -0,0 +1,75 @@
+#ifndef _GK_IMAGE_CONVERT_H
+#define _GK_IMAGE_CONVERT_H
+
+#include "Image.h"
+
+
+namespace gk {
+
+//! conversions entre images hdr float, half float et rgb9e5, les images doivent avoir les memes dimensions.
+//! les pixels sont convertis par paquets (sse, cf. Half.h et RGB9E5.h), les lignes en parallele (openmp), cf. TImage::row().
+//! \return 0 en cas de succes, -1 en cas d'erreur.
+
+//! convertit une image float en half float.
+inline
+int ImageConvert( const HDRImage *in, HalfImage *out )
+{
+    if(in == NULL || out == NULL || in->width() != out->width() || in->height() != out->height())
+        return -1;
+
+    const int width= in->width();
+    const int height= in->height();
+    #pragma omp parallel for schedule(static)
+    for(int y= 0; y < height; y++)
+        FloatToHalf(4 * width, (const float *) in->row(y), (unsigned short *) out->row(y));
+    return 0;
+}
+
+//! convertit une image float en rgb9e5, alpha est ignore.
+inline
+int ImageConvert( const HDRImage *in, RGB9E5Image *out )
+{
+    if(in == NULL || out == NULL || in->width() != out->width() || in->height() != out->height())
+        return -1;
+
+    const int width= in->width();
+    const int height= in->height();
+    #pragma omp parallel for schedule(static)
+    for(int y= 0; y < height; y++)
+        FloatToRGB9E5(width, (const float *) in->row(y), (unsigned int *) out->row(y));
+    return 0;
+}
+
+//! convertit une image half float en float.
+inline
+int ImageConvert( const HalfImage *in, HDRImage *out )
+{
+    if(in == NULL || out == NULL || in->width() != out->width() || in->height() != out->height())
+        return -1;
+
+    const int width= in->width();
+    const int height= in->height();
+    #pragma omp parallel for schedule(static)
+    for(int y= 0; y < height; y++)
+        HalfToFloat(4 * width, (const unsigned short *) in->row(y), (float *) out->row(y));
+    return 0;
+}
+
+//! convertit une image rgb9e5 en float, alpha= 1.
+inline
+int ImageConvert( const RGB9E5Image *in, HDRImage *out )
+{
+    if(in == NULL || out == NULL || in->width() != out->width() || in->height() != out->height())
+        return -1;
+
+    const int width= in->width();
+    const int height= in->height();
+    #pragma omp parallel for schedule(static)
+    for(int y= 0; y < height; y++)
+        RGB9E5ToFloat(width, (const unsigned int *) in->row(y), (float *) out->row(y));
+    return 0;
+}
+
+}       // namespace
+
+#endif
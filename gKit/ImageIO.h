@@ -14,11 +14,15 @@ extern "C" {
 }
 #endif
 
+#include "ImageRGBE.h"
 #include "Geometry.h"
 #include "IOResource.h"
 
 #include "IOManager.h"
 #include "Image.h"
+#include "ImageConvert.h"
+#include "ImageWriter.h"
+#include "IOFileSystem.h"
 
 namespace gk {
 
@@ -29,10 +33,13 @@ class ImageIO : public IOManager<Image>
     ImageIO( const ImageIO& );
     ImageIO& operator=( const ImageIO& );
     
+    ImageWriter m_writer;
+    
     // private default constructor, singleton
     ImageIO( )
         :
-        IOManager<Image>()
+        IOManager<Image>(),
+        m_writer()
     {}
         
 public:
@@ -55,6 +62,28 @@ public:
         if(image != NULL)
             return image;
         
+        // reference l'image avec le manager
+        return manager().insert(decode(filename), filename, name);
+    }
+    
+    //! charge le fichier 'filename' et renvoie l'image, referencee par un IOHandle, cf. IOManager::setBudget().
+    static
+    IOHandle<Image> readHandle( const std::string& filename, const std::string& name= "" )
+    {
+        Image *image= manager().findAndAcquire(filename, name);
+        if(image == NULL)
+            image= manager().insertAndAcquire(decode(filename), filename, name);
+        
+        IOHandle<Image> handle;
+        handle.adopt(manager(), image);
+        return handle;
+    }
+    
+    //! charge le fichier 'filename' sans referencer l'image dans le manager, cf. AsyncIO.
+    //! peut etre utilise par plusieurs threads, l'image appartient a l'appelant.
+    static
+    Image *decode( const std::string& filename )
+    {
     #ifdef VERBOSE
         printf("loading color image '%s'...\n", filename.c_str());
     #endif
@@ -75,7 +104,7 @@ public:
         // creer l'image
         const int height= surface->h;
         const int width= surface->w;
-        image= new Image(width, height);
+        Image *image= new Image(width, height);
         if(image == NULL)
             return NULL;
 
@@ -101,6 +130,7 @@ public:
             for(int y= height -1; y >= 0; y--, py++)
             {
                 p= (Uint8 *) surface->pixels + py * surface->pitch;
+                Pixel *row= image->row(y);
                 for(int x= 0; x < width; x++, p+= format.BytesPerPixel)
                 {
                     const Uint8 r= p[format.Rshift / 8];
@@ -108,7 +138,7 @@ public:
                     const Uint8 b= p[format.Bshift / 8];
                     const Uint8 a= p[format.Ashift / 8];
                     
-                    image->setPixel(x, y, Pixel(r, g, b, a));
+                    row[x]= Pixel(r, g, b, a);
                 }
             }
         }
@@ -117,59 +147,41 @@ public:
             for(int y= height -1; y >= 0; y--, py++)
             {
                 p= (Uint8 *) surface->pixels + py * surface->pitch;
+                Pixel *row= image->row(y);
                 for(int x= 0; x < width; x++, p+= format.BytesPerPixel)
                 {
                     const Uint8 r= p[format.Rshift / 8];
                     const Uint8 g= p[format.Gshift / 8];
                     const Uint8 b= p[format.Bshift / 8];
                     
-                    image->setPixel(x, y, Pixel(r, g, b));
+                    row[x]= Pixel(r, g, b);
                 }
             }
         }
     
         SDL_FreeSurface(surface);
-        
-        // reference l'image avec le manager
-        return manager().insert(image, filename, name);
+        return image;
     }
     
-    //! ecrit une image dans un fichier .bmp nomme 'filename'.
+    //! ecrit une image dans un fichier .png ou .bmp nomme 'filename', .bmp pour les autres extensions.
+    //! les lignes sont ecrites directement, de la derniere a la premiere (openGL utilise une origine en bas a gauche), cf. ImageWriter.
+    //! les buffers du writer sont reutilises d'une image a l'autre, ecrire les images depuis un seul thread.
     static
     int write( const Image *image, const std::string& filename )
     {
         if(image == NULL)
             return -1;
         
-        // flip de l'image : Y inverse entre GL et BMP
-        Pixel *flip= new Pixel[image->width() * image->height()];
-        Pixel *data= flip;
-        for(int y= image->height() -1; y >= 0; y--)
-        {
-            memcpy(data, (Pixel *) image->data() + y * image->width(), image->width() * sizeof(Pixel));
-            data+= image->width();
-        }
+        ImageWriter& writer= manager().m_writer;
+        const ImageWriter::Format format= IOFileSystem::isType(filename, ".png") ? ImageWriter::PNG : ImageWriter::BMP;
+        if(writer.open(filename, image->width(), image->height(), 4, format) < 0)
+            return -1;
         
-        SDL_Surface *bmp= SDL_CreateRGBSurfaceFrom((void *) flip, 
-            image->width(), image->height(), 
-            32, image->width() * 4, 
-    #if 0
-            0xFF000000,
-            0x00FF0000, 
-            0x0000FF00,
-            0x000000FF
-    #else
-            0x000000FF,
-            0x0000FF00,
-            0x00FF0000, 
-            0xFF000000
-    #endif
-        );        
+        for(int y= image->height() -1; y >= 0; y--)
+            if(writer.write((const unsigned char *) image->row(y), 1) < 0)
+                break;
         
-        int code= SDL_SaveBMP(bmp, filename.c_str());
-        SDL_FreeSurface(bmp);
-        delete [] flip;
-        return code;
+        return writer.close();
     }
     
     static
@@ -197,6 +209,18 @@ public:
     //! charge une image rgbe, .hdr
     static
     HDRImage *RGBEread( const std::string& filename, const std::string& name= "" )
+    {
+        HDRImage *image= RGBEdecode(filename);
+        if(image == NULL)
+            return NULL;
+        
+        // reference l'image avec le manager
+        return manager().insert(image, filename, name);
+    }
+    
+    //! charge une image rgbe, .hdr, sans la referencer dans le manager.
+    static
+    HDRImage *RGBEdecode( const std::string& filename )
     {
         FILE *in= fopen( filename.c_str(), "rb" );
         if(in == NULL)
@@ -215,32 +239,18 @@ public:
             return NULL;
         }
         
-        float *data= new float[width*height*3];
-        code= RGBE_ReadPixels_RLE(in, data, width, height);
-        if(code != RGBE_RETURN_SUCCESS)
+        // decode les pixels directement dans l'image, retournee : openGL utilise une origine en bas a gauche.
+        HDRImage *image= new HDRImage(width, height);
+        code= RGBEReadPixels(in, width, height, (float *) image->data(), true, image->stride());
+        fclose(in);
+        if(code < 0)
         {
-            fclose(in);
-            delete [] data;
+            delete image;
             printf("\n -- read error '%s'\n", filename.c_str());
             return NULL;
         }
         
-        fclose(in);
-        
-        // converti les donnees en pixels hdr, retourne l'image, openGL utilise une origine en bas a gauche.
-        HDRImage *image= new HDRImage(width, height);
-        if(image == NULL)
-            return NULL;
-        
-        float *p= data;
-        for(int y= height -1; y >= 0; y--)
-            for(int x= 0; x < width; x++, p+= 3)
-                image->setPixel(x, y, HDRPixel(p[0], p[1], p[2]));
-        
-        delete [] data;
-        
-        // reference l'image avec le manager
-        return manager().insert(image, filename, name);
+        return image;
     }
     
     static
@@ -286,26 +296,74 @@ public:
         
         if(ImageIO::isColorFile(filename))
         {
-            // charger...
-            Image *color= ImageIO::read(filename, name);
-            if(color == NULL)
+            // charger, l'image couleur n'est pas detruite pendant la conversion...
+            IOHandle<Image> color= ImageIO::readHandle(filename, name);
+            if(color.get() == NULL)
                 return NULL;
             
-            //... et convertir l'image
-            HDRImage *hdr= new HDRImage(color->width(), color->height());
-            
-            for(int y= 0; y < color->height(); y++)
-                for(int x= 0; x < color->width(); x++)
-                    hdr->setPixel(x, y, 
-                        color->getPixel(x, y));
+            //... et convertir l'image, reference l'image avec le manager
+            return manager().insert(convert(color.get()), filename, name);
+        }
+        
+        // format non supporte.
+        return NULL;
+    }
+    
+    //! charge le fichier 'filename' et renvoie l'image, referencee par un IOHandle, cf. IOManager::setBudget().
+    static
+    IOHandle<HDRImage> readHandle( const std::string& filename, const std::string& name= "" )
+    {
+        HDRImage *image= manager().findAndAcquire(filename, name);
+        if(image == NULL)
+            image= manager().insertAndAcquire(decode(filename), filename, name);
+        
+        IOHandle<HDRImage> handle;
+        handle.adopt(manager(), image);
+        return handle;
+    }
+    
+    //! charge le fichier 'filename' sans referencer l'image dans le manager, cf. AsyncIO.
+    //! peut etre utilise par plusieurs threads, l'image appartient a l'appelant.
+    static
+    HDRImage *decode( const std::string& filename )
+    {
+        if(is_rgbe_file(filename))
+            return RGBEdecode(filename);
+        
+        if(ImageIO::isColorFile(filename))
+        {
+            Image *color= ImageIO::decode(filename);
+            if(color == NULL)
+                return NULL;
             
-            // reference l'image avec le manager
-            return manager().insert(hdr, filename, name);
+            HDRImage *hdr= convert(color);
+            delete color;
+            return hdr;
         }
         
         // format non supporte.
         return NULL;
     }
+    
+    //! converti une image couleur en image hdr.
+    static
+    HDRImage *convert( const Image *color )
+    {
+        HDRImage *hdr= new HDRImage(color->width(), color->height());
+        
+        const int width= color->width();
+        const int height= color->height();
+        #pragma omp parallel for schedule(static)
+        for(int y= 0; y < height; y++)
+        {
+            const Pixel *src= color->row(y);
+            HDRPixel *dst= hdr->row(y);
+            for(int x= 0; x < width; x++)
+                dst[x]= HDRPixel(src[x]);
+        }
+        
+        return hdr;
+    }
 
     //! enregistre l'image avec le nom 'filename'.
     static
@@ -329,24 +387,11 @@ public:
             return -1;
         }
         
-        float *data= new float[image->width() * image->height() * 3];
-        float *p= data;
-        for(int y= image->height() -1; y > 0; y--)
-        {
-            for(int x= 0; x < image->width(); x++, p+= 3)
-            {
-                const HDRPixel& pixel= image->getPixel(x, y);
-                p[0]= pixel.r;
-                p[1]= pixel.g;
-                p[2]= pixel.b;
-            }
-        }
-        
-        code= RGBE_WritePixels_RLE(out, (const float *) data, image->width(), image->height());
+        // compresse les scanlines en parallele, directement a partir des pixels de l'image, retournee.
+        code= RGBEWritePixels(out, image->width(), image->height(), (const float *) image->data(), true, image->stride());
         fclose(out);
-        delete [] data;
         
-        if(code != RGBE_RETURN_SUCCESS)
+        if(code < 0)
         {
             printf("\n -- write error '%s'\n", filename.c_str());
             return -1;
@@ -363,6 +408,91 @@ public:
     }
 };
 
+
+//! chargement d'images hdr compactes, cf. HalfImageIO et RGB9E5ImageIO. 
+//! les images .hdr sont decodees directement dans le format compact, sans passer par une image float complete.
+template< class T >
+class PackedImageIO : public IOManager< TImage<T> >
+{
+    PackedImageIO( const PackedImageIO& );
+    PackedImageIO& operator=( const PackedImageIO& );
+
+    // private default constructor, singleton
+    PackedImageIO( )
+        :
+        IOManager< TImage<T> >()
+    {}
+
+public:
+    //! charge le fichier 'filename' et renvoie l'image correspondante.
+    static
+    TImage<T> *read( const std::string& filename, const std::string& name= "" )
+    {
+        // importer le fichier, si necessaire
+        TImage<T> *image= manager().find(filename, name);
+        if(image != NULL)
+            return image;
+
+        if(HDRImageIO::is_rgbe_file(filename))
+        {
+            FILE *in= fopen(filename.c_str(), "rb");
+            if(in == NULL)
+            {
+                printf("\n -- read error '%s'\n", filename.c_str());
+                return NULL;
+            }
+
+            rgbe_header_info info;
+            int width, height;
+            int code= RGBE_ReadHeader(in, &width, &height, &info);
+            if(code != RGBE_RETURN_SUCCESS)
+            {
+                fclose(in);
+                printf("\n -- read error '%s'\n", filename.c_str());
+                return NULL;
+            }
+
+            // decode les pixels directement dans l'image, retournee : openGL utilise une origine en bas a gauche.
+            image= new TImage<T>(width, height);
+            code= RGBEReadPixels(in, width, height, (typename T::type *) image->data(), true, image->stride());
+            fclose(in);
+            if(code < 0)
+            {
+                delete image;
+                printf("\n -- read error '%s'\n", filename.c_str());
+                return NULL;
+            }
+        }
+        else
+        {
+            // charger, l'image hdr n'est pas detruite pendant la conversion...
+            IOHandle<HDRImage> hdr= HDRImageIO::readHandle(filename, name);
+            if(hdr.get() == NULL)
+                return NULL;
+
+            //... et convertir l'image
+            image= new TImage<T>(hdr->width(), hdr->height());
+            ImageConvert(hdr.get(), image);
+        }
+
+        // reference l'image avec le manager
+        return manager().insert(image, filename, name);
+    }
+
+    static
+    PackedImageIO& manager( )  // singleton
+    {
+        static PackedImageIO manager;
+        return manager;
+    }
+};
+
+//! operations d'entree/sortie sur les images hdr half float.
+typedef PackedImageIO<HalfPixel> HalfImageIO;
+
+//! operations d'entree/sortie sur les images hdr rgb9e5.
+typedef PackedImageIO<RGB9E5Pixel> RGB9E5ImageIO;
+
 }       // namespace
 
 #endif
@@ -0,0 +1,682 @@
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "rgbe.h"
+}
+
+#include "ImageRGBE.h"
+#include "SIMD.h"
+#include "Half.h"
+#include "RGB9E5.h"
+
+
+namespace gk {
+
+namespace {
+
+//! renvoie 2^(e - 136), le facteur d'echelle d'un pixel rgbe d'exposant e, ou 0 si e == 0.
+//! 2^(e - 136) peut etre un denormal, il est construit comme le produit de 2 puissances de 2 normalisees,
+//! 2^((e >> 1) - 68) * 2^((e - (e >> 1)) - 68), le produit est exact.
+inline
+float rgbe_scale( const unsigned int e )
+{
+    if(e == 0)
+        return 0.f;
+
+    union { unsigned int i; float f; } a, b;
+    a.i= ((e >> 1) + 59) << 23;
+    b.i= ((e - (e >> 1)) + 59) << 23;
+    return a.f * b.f;
+}
+
+//! lit la fin du fichier dans un buffer.
+int read_all( FILE *in, std::vector<unsigned char>& buffer )
+{
+    buffer.clear();
+
+    // estime la taille, si possible
+    const long start= ftell(in);
+    if(start >= 0 && fseek(in, 0, SEEK_END) == 0)
+    {
+        const long end= ftell(in);
+        if(end > start)
+            buffer.reserve(end - start);
+        fseek(in, start, SEEK_SET);
+    }
+
+    unsigned char tmp[65536];
+    size_t n;
+    while((n= fread(tmp, 1, sizeof(tmp), in)) > 0)
+        buffer.insert(buffer.end(), tmp, tmp + n);
+
+    return ferror(in) ? -1 : 0;
+}
+
+//! pixels rgbe non compresses : separe les composantes.
+const unsigned char *decode_flat( const unsigned char *in, const unsigned char *end, const int width, unsigned char *planes )
+{
+    if(end - in < 4 * width)
+        return NULL;
+
+    for(int i= 0; i < width; i++, in+= 4)
+    {
+        planes[i]= in[0];
+        planes[i + width]= in[1];
+        planes[i + 2*width]= in[2];
+        planes[i + 3*width]= in[3];
+    }
+
+    return in;
+}
+
+//! vrai si la scanline commence par un entete rle.
+bool is_rle( const unsigned char *in, const unsigned char *end, const int width )
+{
+    if(width < 8 || width > 0x7fff)
+        return false;
+    if(end - in < 4)
+        return false;
+    return (in[0] == 2 && in[1] == 2 && (in[2] & 0x80) == 0);
+}
+
+//! parcours une scanline compressee sans la decompresser, cf. RGBEDecodeScanline().
+const unsigned char *skip_scanline( const unsigned char *in, const unsigned char *end, const int width, const bool flat )
+{
+    if(flat)
+        return (end - in < 4 * width) ? NULL : in + 4 * width;
+    if(is_rle(in, end, width) == false || (((int) in[2] << 8) | in[3]) != width)
+        return NULL;
+    in+= 4;
+
+    for(int c= 0; c < 4; c++)
+    {
+        int n= width;
+        while(n > 0)
+        {
+            if(end - in < 2)
+                return NULL;
+
+            int count= in[0];
+            if(count > 128)
+            {
+                count-= 128;
+                in+= 2;
+            }
+            else
+            {
+                if(count == 0 || count > end - in - 1)
+                    return NULL;
+                in+= count + 1;
+            }
+
+            if(count > n)
+                return NULL;
+            n-= count;
+        }
+    }
+
+    return in;
+}
+
+//! conversion float vers rgbe, identique a float2rgbe() de rgbe.cpp, frexp() est remplace par la lecture des bits de v.
+inline
+void float_to_rgbe( unsigned char rgbe[4], const float red, const float green, const float blue )
+{
+    float v= red;
+    if(green > v) v= green;
+    if(blue > v) v= blue;
+    if(v < 1e-32f)
+    {
+        rgbe[0]= rgbe[1]= rgbe[2]= rgbe[3]= 0;
+        return;
+    }
+
+    // v est normalise : v = m * 2^e, m dans [0.5 1)
+    union { float f; unsigned int i; } m;
+    m.f= v;
+    const int e= (int) ((m.i >> 23) & 0xff) - 126;
+    m.i= (m.i & 0x807fffffu) | (126u << 23);
+
+    const float scale= (float) ((double) m.f * 256.0 / v);
+    rgbe[0]= (unsigned char) (red * scale);
+    rgbe[1]= (unsigned char) (green * scale);
+    rgbe[2]= (unsigned char) (blue * scale);
+    rgbe[3]= (unsigned char) (e + 128);
+}
+
+//! compresse une composante d'une scanline, meme codage que RGBE_WriteBytes_RLE() de rgbe.cpp.
+void encode_bytes( const unsigned char *data, const int n, std::vector<unsigned char>& out )
+{
+    const int min_run= 4;
+    int cur= 0;
+    while(cur < n)
+    {
+        // cherche la prochaine sequence d'au moins min_run valeurs identiques
+        int begin= cur;
+        int run= 0;
+        int old_run= 0;
+        while(run < min_run && begin < n)
+        {
+            begin+= run;
+            old_run= run;
+            run= 1;
+            while(begin + run < n && run < 127 && data[begin] == data[begin + run])
+                run++;
+        }
+
+        // une sequence courte juste avant la sequence trouvee
+        if(old_run > 1 && old_run == begin - cur)
+        {
+            out.push_back((unsigned char) (128 + old_run));
+            out.push_back(data[cur]);
+            cur= begin;
+        }
+
+        // valeurs quelconques jusqu'a la sequence
+        while(cur < begin)
+        {
+            int count= begin - cur;
+            if(count > 128)
+                count= 128;
+            out.push_back((unsigned char) count);
+            out.insert(out.end(), data + cur, data + cur + count);
+            cur+= count;
+        }
+
+        if(run >= min_run)
+        {
+            out.push_back((unsigned char) (128 + run));
+            out.push_back(data[begin]);
+            cur+= run;
+        }
+    }
+}
+
+//! compresse une scanline de pixels float rgba.
+void encode_scanline( const float *rgba, const int width, std::vector<unsigned char>& planes, std::vector<unsigned char>& out )
+{
+    const bool rle= (width >= 8 && width <= 0x7fff);
+    if(rle == false)
+    {
+        // rle interdit, pixels non compresses
+        unsigned char rgbe[4];
+        for(int i= 0; i < width; i++, rgba+= 4)
+        {
+            float_to_rgbe(rgbe, rgba[0], rgba[1], rgba[2]);
+            out.insert(out.end(), rgbe, rgbe + 4);
+        }
+        return;
+    }
+
+    planes.resize(4 * width);
+    unsigned char rgbe[4];
+    for(int i= 0; i < width; i++, rgba+= 4)
+    {
+        float_to_rgbe(rgbe, rgba[0], rgba[1], rgba[2]);
+        planes[i]= rgbe[0];
+        planes[i + width]= rgbe[1];
+        planes[i + 2*width]= rgbe[2];
+        planes[i + 3*width]= rgbe[3];
+    }
+
+    out.push_back(2);
+    out.push_back(2);
+    out.push_back((unsigned char) (width >> 8));
+    out.push_back((unsigned char) (width & 0xff));
+    for(int c= 0; c < 4; c++)
+        encode_bytes(&planes[c * width], width, out);
+}
+
+#ifdef GK_SSE
+//! convertit 4 pixels, composantes et exposants en entiers 32 bits, et les ecrit en rgba.
+inline
+void convert4( const __m128i r, const __m128i g, const __m128i b, const __m128i e, float *rgba )
+{
+    // e == 0 : pixel noir. remplace e par 136 (echelle 1) avant de masquer le resultat, 
+    // 2^-136 est un denormal et les calculs sur les denormaux sont tres lents.
+    const __m128i black= _mm_cmpeq_epi32(e, _mm_setzero_si128());
+    const __m128i ee= _mm_or_si128(e, _mm_and_si128(black, _mm_set1_epi32(136)));
+    
+    const __m128i bias= _mm_set1_epi32(59);
+    const __m128i e1= _mm_srli_epi32(ee, 1);
+    const __m128i e2= _mm_sub_epi32(ee, e1);
+    const __m128 s1= _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e1, bias), 23));
+    const __m128 s2= _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e2, bias), 23));
+    const __m128 scale= _mm_andnot_ps(_mm_castsi128_ps(black), _mm_mul_ps(s1, s2));
+
+    __m128 x= _mm_mul_ps(_mm_cvtepi32_ps(r), scale);
+    __m128 y= _mm_mul_ps(_mm_cvtepi32_ps(g), scale);
+    __m128 z= _mm_mul_ps(_mm_cvtepi32_ps(b), scale);
+    __m128 w= _mm_set1_ps(1.f);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    _mm_storeu_ps(rgba, x);
+    _mm_storeu_ps(rgba + 4, y);
+    _mm_storeu_ps(rgba + 8, z);
+    _mm_storeu_ps(rgba + 12, w);
+}
+#endif
+
+}       // namespace
+
+
+const unsigned char *RGBEDecodeScanline( const unsigned char *in, const unsigned char *end, const int width, unsigned char *planes )
+{
+    if(in == NULL || width <= 0)
+        return NULL;
+    if(is_rle(in, end, width) == false)
+        return decode_flat(in, end, width, planes);
+
+    if((((int) in[2] << 8) | in[3]) != width)
+        return NULL;    // wrong scanline width
+    in+= 4;
+
+    // chaque composante est compressee separement : sequences de valeurs identiques ou de valeurs quelconques
+    for(int c= 0; c < 4; c++)
+    {
+        unsigned char *ptr= planes + c * width;
+        unsigned char *const ptr_end= ptr + width;
+        while(ptr < ptr_end)
+        {
+            if(end - in < 2)
+                return NULL;
+
+            int count= in[0];
+            if(count > 128)
+            {
+                // sequence de la meme valeur
+                count-= 128;
+                if(count > ptr_end - ptr)
+                    return NULL;
+                memset(ptr, in[1], count);
+                in+= 2;
+            }
+            else
+            {
+                // sequence de valeurs quelconques
+                if(count == 0 || count > ptr_end - ptr || count > end - in - 1)
+                    return NULL;
+                memcpy(ptr, in + 1, count);
+                in+= count + 1;
+            }
+
+            ptr+= count;
+        }
+    }
+
+    return in;
+}
+
+void RGBEConvertScanline( const unsigned char *planes, const int width, float *rgba )
+{
+    const unsigned char *r= planes;
+    const unsigned char *g= planes + width;
+    const unsigned char *b= planes + 2*width;
+    const unsigned char *e= planes + 3*width;
+
+    int i= 0;
+#ifdef GK_SSE
+    // paquets de 16 pixels
+    const __m128i zero= _mm_setzero_si128();
+    for(; i + 16 <= width; i+= 16)
+    {
+        const __m128i r8= _mm_loadu_si128((const __m128i *) (r + i));
+        const __m128i g8= _mm_loadu_si128((const __m128i *) (g + i));
+        const __m128i b8= _mm_loadu_si128((const __m128i *) (b + i));
+        const __m128i e8= _mm_loadu_si128((const __m128i *) (e + i));
+
+        const __m128i r16[2]= { _mm_unpacklo_epi8(r8, zero), _mm_unpackhi_epi8(r8, zero) };
+        const __m128i g16[2]= { _mm_unpacklo_epi8(g8, zero), _mm_unpackhi_epi8(g8, zero) };
+        const __m128i b16[2]= { _mm_unpacklo_epi8(b8, zero), _mm_unpackhi_epi8(b8, zero) };
+        const __m128i e16[2]= { _mm_unpacklo_epi8(e8, zero), _mm_unpackhi_epi8(e8, zero) };
+        for(int k= 0; k < 2; k++)
+        {
+            float *p= rgba + 4 * (i + 8*k);
+            convert4(_mm_unpacklo_epi16(r16[k], zero), _mm_unpacklo_epi16(g16[k], zero),
+                _mm_unpacklo_epi16(b16[k], zero), _mm_unpacklo_epi16(e16[k], zero), p);
+            convert4(_mm_unpackhi_epi16(r16[k], zero), _mm_unpackhi_epi16(g16[k], zero),
+                _mm_unpackhi_epi16(b16[k], zero), _mm_unpackhi_epi16(e16[k], zero), p + 16);
+        }
+    }
+#endif
+
+    for(; i < width; i++)
+    {
+        const float scale= rgbe_scale(e[i]);
+        float *p= rgba + 4*i;
+        p[0]= (float) r[i] * scale;
+        p[1]= (float) g[i] * scale;
+        p[2]= (float) b[i] * scale;
+        p[3]= 1.f;
+    }
+}
+
+namespace {
+
+//! ecrit les pixels en float rgba.
+struct StoreFloat
+{
+    float *rgba;
+    size_t stride;
+
+    StoreFloat( float *_rgba, const int _stride ) : rgba(_rgba), stride(_stride) {}
+
+    void operator() ( const unsigned char *planes, const int width, const size_t row, float * ) const
+    {
+        RGBEConvertScanline(planes, width, rgba + row * stride * 4);
+    }
+};
+
+//! ecrit les pixels en half float rgba.
+struct StoreHalf
+{
+    unsigned short *rgba;
+    size_t stride;
+
+    StoreHalf( unsigned short *_rgba, const int _stride ) : rgba(_rgba), stride(_stride) {}
+
+    void operator() ( const unsigned char *planes, const int width, const size_t row, float *scanline ) const
+    {
+        RGBEConvertScanline(planes, width, scanline);
+        FloatToHalf(4 * width, scanline, rgba + row * stride * 4);
+    }
+};
+
+//! ecrit les pixels en rgb9e5.
+struct StoreRGB9E5
+{
+    unsigned int *rgb9e5;
+    size_t stride;
+
+    StoreRGB9E5( unsigned int *_rgb9e5, const int _stride ) : rgb9e5(_rgb9e5), stride(_stride) {}
+
+    void operator() ( const unsigned char *planes, const int width, const size_t row, float *scanline ) const
+    {
+        RGBEConvertScanline(planes, width, scanline);
+        FloatToRGB9E5(width, scanline, rgb9e5 + row * stride);
+    }
+};
+
+//! decompresse les scanlines et les ecrit dans l'image, cf. RGBEReadPixels( ).
+template< class Store >
+int read_pixels( FILE *in, const int width, const int height, const bool flip_y, const Store& store )
+{
+    if(in == NULL || width <= 0 || height <= 0)
+        return -1;
+
+    std::vector<unsigned char> buffer;
+    if(read_all(in, buffer) < 0 || buffer.empty())
+        return -1;
+
+    const unsigned char *begin= &buffer.front();
+    const unsigned char *end= begin + buffer.size();
+
+    // si la premiere scanline n'est pas compressee, le reste du fichier ne l'est pas non plus.
+    const bool flat= (is_rle(begin, end, width) == false);
+
+    // etape 1 : position de chaque scanline dans le fichier, sans decompresser
+    std::vector<const unsigned char *> scanlines(height);
+    const unsigned char *ptr= begin;
+    for(int y= 0; y < height; y++)
+    {
+        scanlines[y]= ptr;
+        ptr= skip_scanline(ptr, end, width, flat);
+        if(ptr == NULL)
+        {
+            printf("RGBEReadPixels( ): bad scanline data.\n");
+            return -1;
+        }
+    }
+
+    // etape 2 : decompresse et convertit les scanlines en parallele
+    int errors= 0;
+    #pragma omp parallel
+    {
+        std::vector<unsigned char> planes(4 * width);
+        std::vector<float> scanline(4 * width);
+
+        #pragma omp for schedule(dynamic, 16) reduction(+: errors)
+        for(int y= 0; y < height; y++)
+        {
+            const unsigned char *next= flat ? decode_flat(scanlines[y], end, width, &planes.front())
+                : RGBEDecodeScanline(scanlines[y], end, width, &planes.front());
+            if(next == NULL)
+            {
+                errors++;
+                continue;
+            }
+
+            const int row= flip_y ? height - 1 - y : y;
+            store(&planes.front(), width, row, &scanline.front());
+        }
+    }
+
+    return (errors > 0) ? -1 : 0;
+}
+
+}       // namespace
+
+int RGBEReadPixels( FILE *in, const int width, const int height, float *rgba, const bool flip_y, const int stride )
+{
+    if(rgba == NULL || (stride != 0 && stride < width))
+        return -1;
+    return read_pixels(in, width, height, flip_y, StoreFloat(rgba, stride ? stride : width));
+}
+
+int RGBEReadPixels( FILE *in, const int width, const int height, unsigned short *rgba, const bool flip_y, const int stride )
+{
+    if(rgba == NULL || (stride != 0 && stride < width))
+        return -1;
+    return read_pixels(in, width, height, flip_y, StoreHalf(rgba, stride ? stride : width));
+}
+
+int RGBEReadPixels( FILE *in, const int width, const int height, unsigned int *rgb9e5, const bool flip_y, const int stride )
+{
+    if(rgb9e5 == NULL || (stride != 0 && stride < width))
+        return -1;
+    return read_pixels(in, width, height, flip_y, StoreRGB9E5(rgb9e5, stride ? stride : width));
+}
+
+int RGBEWritePixels( FILE *out, const int width, const int height, const float *rgba, const bool flip_y, const int stride )
+{
+    if(out == NULL || rgba == NULL || width <= 0 || height <= 0 || (stride != 0 && stride < width))
+        return -1;
+    const size_t pitch= 4 * (size_t) (stride ? stride : width);
+
+    // compresse des groupes de scanlines en parallele, chaque groupe dans son buffer, 
+    // puis ecrit les buffers dans l'ordre. la taille des groupes limite la memoire temporaire.
+    const int chunk= 32;
+    const int batch= 64;        // groupes compresses avant chaque ecriture
+    std::vector< std::vector<unsigned char> > buffers(batch);
+
+    for(int first= 0; first < height; first+= batch * chunk)
+    {
+        const int count= std::min(batch, (height - first + chunk -1) / chunk);
+
+        #pragma omp parallel
+        {
+            std::vector<unsigned char> planes;
+
+            #pragma omp for schedule(dynamic, 1)
+            for(int c= 0; c < count; c++)
+            {
+                std::vector<unsigned char>& buffer= buffers[c];
+                buffer.clear();
+
+                const int y0= first + c * chunk;
+                const int y1= std::min(height, y0 + chunk);
+                for(int y= y0; y < y1; y++)
+                {
+                    const int row= flip_y ? height - 1 - y : y;
+                    encode_scanline(rgba + row * pitch, width, planes, buffer);
+                }
+            }
+        }
+
+        for(int c= 0; c < count; c++)
+            if(buffers[c].empty() == false 
+            && fwrite(&buffers[c].front(), 1, buffers[c].size(), out) != buffers[c].size())
+            {
+                printf("RGBEWritePixels( ): write error.\n");
+                return -1;
+            }
+    }
+
+    return 0;
+}
+
+
+
+RGBEReader::RGBEReader( )
+    :
+    m_in(NULL),
+    m_buffer(),
+    m_scanlines(),
+    m_begin(0),
+    m_end(0),
+    m_width(0),
+    m_height(0),
+    m_row(0),
+    m_flat(false),
+    m_eof(false)
+{}
+
+RGBEReader::~RGBEReader( )
+{
+    close();
+}
+
+int RGBEReader::open( const std::string& filename )
+{
+    close();
+
+    m_in= fopen(filename.c_str(), "rb");
+    if(m_in == NULL)
+    {
+        printf("RGBEReader::open( ): read error '%s'\n", filename.c_str());
+        return -1;
+    }
+
+    rgbe_header_info info;
+    if(RGBE_ReadHeader(m_in, &m_width, &m_height, &info) != RGBE_RETURN_SUCCESS || m_width <= 0 || m_height <= 0)
+    {
+        printf("RGBEReader::open( ): read error '%s'\n", filename.c_str());
+        close();
+        return -1;
+    }
+
+    return 0;
+}
+
+void RGBEReader::close( )
+{
+    if(m_in != NULL)
+        fclose(m_in);
+    m_in= NULL;
+    m_buffer.clear();
+    m_scanlines.clear();
+    m_begin= 0;
+    m_end= 0;
+    m_width= 0;
+    m_height= 0;
+    m_row= 0;
+    m_flat= false;
+    m_eof= false;
+}
+
+int RGBEReader::refill( const size_t size )
+{
+    if(m_buffer.size() < size)
+        m_buffer.resize(size);
+
+    // deplace les donnees non lues au debut du buffer
+    if(m_begin > 0)
+    {
+        if(m_end > m_begin)
+            memmove(&m_buffer.front(), &m_buffer[m_begin], m_end - m_begin);
+        m_end-= m_begin;
+        m_begin= 0;
+    }
+
+    while(m_end < m_buffer.size() && m_eof == false)
+    {
+        const size_t n= fread(&m_buffer[m_end], 1, m_buffer.size() - m_end, m_in);
+        if(n == 0)
+            m_eof= true;
+        m_end+= n;
+    }
+
+    return ferror(m_in) ? -1 : 0;
+}
+
+int RGBEReader::read( float *rgba, const int n )
+{
+    if(m_in == NULL || rgba == NULL || n <= 0)
+        return -1;
+
+    const int count= std::min(n, m_height - m_row);
+    if(count <= 0)
+        return 0;
+
+    // une scanline compressee occupe au plus 8 octets par pixel (runs de longueur 1), plus l'entete rle
+    const size_t scanline_max= 8 * (size_t) m_width + 16;
+    if(m_end - m_begin < count * scanline_max && m_eof == false)
+        if(refill(count * scanline_max + 65536) < 0)
+            return -1;
+
+    const unsigned char *begin= &m_buffer.front() + m_begin;
+    const unsigned char *end= &m_buffer.front() + m_end;
+
+    // si la premiere scanline n'est pas compressee, le reste du fichier ne l'est pas non plus.
+    if(m_row == 0)
+        m_flat= (is_rle(begin, end, m_width) == false);
+
+    // etape 1 : position de chaque scanline du groupe dans le buffer
+    m_scanlines.resize(count);
+    const unsigned char *ptr= begin;
+    for(int y= 0; y < count; y++)
+    {
+        m_scanlines[y]= ptr;
+        ptr= skip_scanline(ptr, end, m_width, m_flat);
+        if(ptr == NULL)
+        {
+            printf("RGBEReader::read( ): bad scanline data.\n");
+            return -1;
+        }
+    }
+
+    // etape 2 : decompresse et convertit les scanlines en parallele
+    const int width= m_width;
+    const bool flat= m_flat;
+    int errors= 0;
+    #pragma omp parallel if(count > 1)
+    {
+        std::vector<unsigned char> planes(4 * width);
+
+        #pragma omp for schedule(dynamic, 4) reduction(+: errors)
+        for(int y= 0; y < count; y++)
+        {
+            const unsigned char *next= flat ? decode_flat(m_scanlines[y], end, width, &planes.front())
+                : RGBEDecodeScanline(m_scanlines[y], end, width, &planes.front());
+            if(next == NULL)
+            {
+                errors++;
+                continue;
+            }
+
+            RGBEConvertScanline(&planes.front(), width, rgba + (size_t) y * width * 4);
+        }
+    }
+
+    if(errors > 0)
+        return -1;
+
+    m_begin= ptr - &m_buffer.front();
+    m_row+= count;
+    return count;
+}
+
+}       // namespace
@@ -0,0 +1,123 @@
+#ifndef _GK_IMAGE_RGBE_H
+#define _GK_IMAGE_RGBE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace gk {
+
+//! decodage rapide des pixels d'une image rgbe (.hdr, format de Greg Ward), cf. rgbe.h pour la version de reference.
+
+//! les scanlines sont decompressees (rle) dans un buffer par composante, puis converties par paquets de 16 pixels (sse),
+//! sans ldexp : 2^(e - 136) est construit directement a partir des bits de l'exposant.
+//! les pixels sont ecrits directement dans le stockage de l'image, en rgba, avec alpha= 1, ou en half float, ou en rgb9e5.
+//! les scanlines sont reperees par une premiere passe rapide sur le fichier, puis decompressees en parallele (openmp),
+//! l'ecriture compresse des groupes de scanlines en parallele et les ecrit dans l'ordre.
+
+//! decompresse une scanline : width octets par composante, r, g, b puis e, dans planes[4*width].
+//! accepte les scanlines compressees (rle) et les pixels rgbe non compresses.
+//! \return la position apres la scanline dans le buffer in, ou NULL si les donnees sont incorrectes.
+const unsigned char *RGBEDecodeScanline( const unsigned char *in, const unsigned char *end, const int width, unsigned char *planes );
+
+//! convertit une scanline decompressee en width pixels float rgba.
+void RGBEConvertScanline( const unsigned char *planes, const int width, float *rgba );
+
+//! lit les pixels d'une image apres RGBE_ReadHeader(), et les ecrit en float rgba dans rgba[width*height*4].
+//! \param flip_y ecrit la premiere scanline du fichier sur la derniere ligne de l'image (openGL utilise une origine en bas a gauche).
+//! \param stride nombre de pixels entre le debut de 2 lignes de l'image, cf. TImage::stride(), 0 : width.
+//! \return 0 en cas de succes, -1 en cas d'erreur.
+int RGBEReadPixels( FILE *in, const int width, const int height, float *rgba, const bool flip_y= true, const int stride= 0 );
+
+//! lit les pixels d'une image apres RGBE_ReadHeader(), et les ecrit en half float rgba dans rgba[width*height*4], cf. HalfImage.
+int RGBEReadPixels( FILE *in, const int width, const int height, unsigned short *rgba, const bool flip_y= true, const int stride= 0 );
+
+//! lit les pixels d'une image apres RGBE_ReadHeader(), et les ecrit en rgb9e5 dans rgb9e5[width*height], cf. RGB9E5Image.
+int RGBEReadPixels( FILE *in, const int width, const int height, unsigned int *rgb9e5, const bool flip_y= true, const int stride= 0 );
+
+//! compresse et ecrit les pixels float rgba d'une image apres RGBE_WriteHeader(), produit les memes donnees que RGBE_WritePixels_RLE().
+//! \param flip_y ecrit la derniere ligne de l'image en premier.
+//! \param stride nombre de pixels entre le debut de 2 lignes de l'image, 0 : width.
+//! \return 0 en cas de succes, -1 en cas d'erreur.
+int RGBEWritePixels( FILE *out, const int width, const int height, const float *rgba, const bool flip_y= true, const int stride= 0 );
+
+
+//! lecture en flux d'une image rgbe : les scanlines sont lues par groupes, dans l'ordre du fichier (de haut en bas).
+//! la memoire utilisee ne depend que de la largeur de l'image et de la taille des groupes, pas de sa hauteur.
+//! les scanlines d'un groupe sont reperees dans le buffer de lecture, puis decompressees en parallele (openmp).
+/*! exemple d'utilisation :
+\code
+    gk::RGBEReader reader;
+    if(reader.open("render.hdr") < 0)
+        return -1;
+
+    std::vector<float> rows(4 * reader.width() * 64);
+    int n;
+    while((n= reader.read(&rows.front(), 64)) > 0)
+    {
+        // n lignes de pixels float rgba
+    }
+    reader.close();
+\endcode
+*/
+class RGBEReader
+{
+    FILE *m_in;
+    std::vector<unsigned char> m_buffer;
+    std::vector<const unsigned char *> m_scanlines;
+    size_t m_begin;
+    size_t m_end;
+    int m_width;
+    int m_height;
+    int m_row;
+    bool m_flat;
+    bool m_eof;
+
+    // non copyable
+    RGBEReader( const RGBEReader& );
+    RGBEReader& operator=( const RGBEReader& );
+
+    //! complete le buffer de lecture, jusqu'a size octets, si possible.
+    int refill( const size_t size );
+
+public:
+    //! constructeur par defaut, cf. open().
+    RGBEReader( );
+
+    //! destructeur, ferme le fichier.
+    ~RGBEReader( );
+
+    //! ouvre un fichier et lit son entete.
+    //! \return 0 en cas de succes, -1 en cas d'erreur.
+    int open( const std::string& filename );
+
+    //! ferme le fichier.
+    void close( );
+
+    //! renvoie la largeur de l'image.
+    int width( ) const
+    {
+        return m_width;
+    }
+
+    //! renvoie la hauteur de l'image.
+    int height( ) const
+    {
+        return m_height;
+    }
+
+    //! renvoie le nombre de scanlines deja lues.
+    int row( ) const
+    {
+        return m_row;
+    }
+
+    //! lit au plus n scanlines et les ecrit en float rgba dans rgba[n*width*4], la premiere scanline du fichier est le haut de l'image.
+    //! \return le nombre de scanlines lues, 0 a la fin de l'image, ou -1 en cas d'erreur.
+    int read( float *rgba, const int n );
+};
+
+}       // namespace
+
+#endif
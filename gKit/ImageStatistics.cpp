@@ -0,0 +1,263 @@
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "ImageStatistics.h"
+#include "SIMD.h"
+
+
+namespace gk {
+
+namespace {
+
+//! constante de la moyenne logarithmique, evite log(0).
+const float log_delta= 1e-4f;
+
+//! statistiques partielles d'un thread.
+struct Partial
+{
+    float ymin;
+    float ymax;
+    double sum;
+    double log_sum;
+    std::vector<unsigned int> bins;
+
+    Partial( )
+        :
+        ymin(HUGE_VAL), ymax(-HUGE_VAL), sum(0.0), log_sum(0.0),
+        bins(ImageStatistics::BINS, 0)
+    {}
+};
+
+//! renvoie la classe de l'histogramme logarithmique d'une luminance : exposant et premiers bits de la mantisse.
+inline
+int log_bin( const float y )
+{
+    union { float f; unsigned int i; } v;
+    v.f= y;
+    if(!(y > 0.f))
+        return 0;
+
+    const int bin= (int) (v.i >> (23 - ImageStatistics::OCTAVE_BITS)) - ((127 + ImageStatistics::MIN_EXPONENT) << ImageStatistics::OCTAVE_BITS);
+    if(bin < 0)
+        return 0;
+    if(bin >= ImageStatistics::BINS)
+        return ImageStatistics::BINS -1;
+    return bin;
+}
+
+//! accumule les statistiques de n pixels rgba.
+void accumulate( const float *rgba, const int n, const float wr, const float wg, const float wb, Partial& stats )
+{
+    int i= 0;
+#ifdef GK_SSE
+    __m128 vmin= _mm_set1_ps(HUGE_VAL);
+    __m128 vmax= _mm_set1_ps(-HUGE_VAL);
+    __m128 vsum= _mm_setzero_ps();
+    __m128 vlog= _mm_setzero_ps();
+    const __m128 r_weight= _mm_set1_ps(wr);
+    const __m128 g_weight= _mm_set1_ps(wg);
+    const __m128 b_weight= _mm_set1_ps(wb);
+    const __m128 delta= _mm_set1_ps(log_delta);
+    // bornes de l'histogramme, les classes se calculent sans tests
+    const __m128 low= _mm_set1_ps(ldexpf(1.f, ImageStatistics::MIN_EXPONENT));
+    const __m128 high= _mm_castsi128_ps(_mm_set1_epi32(((127 + ImageStatistics::MAX_EXPONENT) << 23) -1));
+    const __m128i bin_offset= _mm_set1_epi32((127 + ImageStatistics::MIN_EXPONENT) << ImageStatistics::OCTAVE_BITS);
+
+    for(; i + 4 <= n; i+= 4)
+    {
+        __m128 r= _mm_loadu_ps(rgba + 4*i);
+        __m128 g= _mm_loadu_ps(rgba + 4*i + 4);
+        __m128 b= _mm_loadu_ps(rgba + 4*i + 8);
+        __m128 a= _mm_loadu_ps(rgba + 4*i + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        const __m128 y= _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r_weight), _mm_mul_ps(g, g_weight)), _mm_mul_ps(b, b_weight));
+        vmin= _mm_min_ps(vmin, y);
+        vmax= _mm_max_ps(vmax, y);
+        vsum= _mm_add_ps(vsum, y);
+        vlog= _mm_add_ps(vlog, log2_4(_mm_add_ps(_mm_max_ps(y, _mm_setzero_ps()), delta)));
+
+        const __m128 clamped= _mm_min_ps(_mm_max_ps(y, low), high);
+        const __m128i bins= _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(clamped), 23 - ImageStatistics::OCTAVE_BITS), bin_offset);
+
+        int k[4];
+        _mm_storeu_si128((__m128i *) k, bins);
+        stats.bins[k[0]]++;
+        stats.bins[k[1]]++;
+        stats.bins[k[2]]++;
+        stats.bins[k[3]]++;
+    }
+
+    float tmp[4];
+    _mm_storeu_ps(tmp, vmin);
+    stats.ymin= std::min(stats.ymin, std::min(std::min(tmp[0], tmp[1]), std::min(tmp[2], tmp[3])));
+    _mm_storeu_ps(tmp, vmax);
+    stats.ymax= std::max(stats.ymax, std::max(std::max(tmp[0], tmp[1]), std::max(tmp[2], tmp[3])));
+    _mm_storeu_ps(tmp, vsum);
+    stats.sum+= (double) tmp[0] + tmp[1] + tmp[2] + tmp[3];
+    _mm_storeu_ps(tmp, vlog);
+    stats.log_sum+= (double) tmp[0] + tmp[1] + tmp[2] + tmp[3];
+#endif
+
+    for(; i < n; i++)
+    {
+        const float *p= rgba + 4*i;
+        const float y= p[0] * wr + p[1] * wg + p[2] * wb;
+        stats.ymin= std::min(stats.ymin, y);
+        stats.ymax= std::max(stats.ymax, y);
+        stats.sum+= y;
+        stats.log_sum+= log2f(std::max(y, 0.f) + log_delta);
+        stats.bins[log_bin(y)]++;
+    }
+}
+
+}       // namespace
+
+
+int ImageStatistics::compute( const HDRImage *image, const float wr, const float wg, const float wb )
+{
+    if(image == NULL)
+        return -1;
+    return compute((const float *) image->data(), image->width(), image->height(), image->stride(), wr, wg, wb);
+}
+
+int ImageStatistics::compute( const float *rgba, const int n, const float wr, const float wg, const float wb )
+{
+    return compute(rgba, n, 1, n, wr, wg, wb);
+}
+
+int ImageStatistics::compute( const float *rgba, const int width, const int height, const int stride,
+    const float wr, const float wg, const float wb )
+{
+    ymin= 0.f;
+    ymax= 0.f;
+    mean= 0.f;
+    log_average= 0.f;
+    count= 0;
+    std::fill(m_bins.begin(), m_bins.end(), 0u);
+    if(rgba == NULL || width <= 0 || height <= 0 || stride < width)
+        return -1;
+
+    // paquets de pixels, dans chaque ligne : les sommes partielles restent precises en float.
+    const int block= 4096;
+    const int row_blocks= (width + block -1) / block;
+    const int blocks= row_blocks * height;
+    const int n= width * height;
+
+    Partial total;
+    #pragma omp parallel
+    {
+        Partial stats;
+
+        #pragma omp for schedule(static)
+        for(int k= 0; k < blocks; k++)
+        {
+            const int y= k / row_blocks;
+            const int first= (k % row_blocks) * block;
+            accumulate(rgba + 4 * ((size_t) y * stride + first), std::min(block, width - first), wr, wg, wb, stats);
+        }
+
+        #pragma omp critical
+        {
+            total.ymin= std::min(total.ymin, stats.ymin);
+            total.ymax= std::max(total.ymax, stats.ymax);
+            total.sum+= stats.sum;
+            total.log_sum+= stats.log_sum;
+            for(int i= 0; i < BINS; i++)
+                total.bins[i]+= stats.bins[i];
+        }
+    }
+
+    ymin= total.ymin;
+    ymax= total.ymax;
+    mean= (float) (total.sum / n);
+    log_average= exp2f((float) (total.log_sum / n));
+    count= n;
+    m_bins.swap(total.bins);
+    return 0;
+}
+
+void ImageStatistics::binRange( const int bin, float& a, float& b )
+{
+    const int octave= bin >> OCTAVE_BITS;
+    const int sub= bin & ((1 << OCTAVE_BITS) -1);
+    const float scale= ldexpf(1.f, MIN_EXPONENT + octave - OCTAVE_BITS);
+    a= scale * (float) ((1 << OCTAVE_BITS) + sub);
+    b= scale * (float) ((1 << OCTAVE_BITS) + sub + 1);
+}
+
+int ImageStatistics::histogram( const int n, const float hmin, const float hmax, std::vector<float>& bins ) const
+{
+    bins.assign(std::max(n, 0), 0.f);
+    if(n <= 0 || count == 0)
+        return -1;
+
+    const float scale= (hmax > hmin) ? (float) n / (hmax - hmin) : 0.f;
+    for(int i= 0; i < BINS; i++)
+    {
+        if(m_bins[i] == 0)
+            continue;
+
+        // intervalle des luminances de la classe, la premiere et la derniere classe contiennent aussi les valeurs hors limites
+        float a, b;
+        binRange(i, a, b);
+        if(i == 0)
+            a= std::min(a, ymin);
+        if(i == BINS -1)
+            b= std::max(b, ymax);
+        a= std::max(a, ymin);
+        b= std::min(b, ymax);
+
+        // repartit les pixels de la classe sur les classes regulieres, en supposant une distribution uniforme
+        const float c= (float) m_bins[i];
+        const float x0= std::min(std::max((a - hmin) * scale, 0.f), (float) n);
+        const float x1= std::min(std::max((b - hmin) * scale, 0.f), (float) n);
+        if(x1 - x0 < 1e-6f)
+        {
+            bins[std::min((int) x0, n -1)]+= c;
+            continue;
+        }
+
+        const float weight= c / (x1 - x0);
+        for(int k= (int) x0; k < n && (float) k < x1; k++)
+        {
+            const float overlap= std::min(x1, (float) (k +1)) - std::max(x0, (float) k);
+            if(overlap > 0.f)
+                bins[k]+= overlap * weight;
+        }
+    }
+
+    return 0;
+}
+
+float ImageStatistics::percentile( const float p ) const
+{
+    if(count == 0)
+        return 0.f;
+
+    const double target= (double) std::min(std::max(p, 0.f), 1.f) * count;
+    double sum= 0.0;
+    for(int i= 0; i < BINS; i++)
+    {
+        if(m_bins[i] == 0)
+            continue;
+
+        if(sum + m_bins[i] >= target)
+        {
+            float a, b;
+            binRange(i, a, b);
+            a= std::max(a, ymin);
+            b= std::min(b, ymax);
+            if(b < a)
+                return a;
+            return a + (b - a) * (float) ((target - sum) / m_bins[i]);
+        }
+        sum+= m_bins[i];
+    }
+
+    return ymax;
+}
+
+}       // namespace
@@ -0,0 +1,76 @@
+#ifndef _GK_IMAGE_STATISTICS_H
+#define _GK_IMAGE_STATISTICS_H
+
+#include <vector>
+
+#include "Image.h"
+
+
+namespace gk {
+
+//! statistiques de luminance d'une image hdr : min, max, moyenne, moyenne logarithmique et histogramme.
+
+//! un seul parcours de l'image, par paquets de 4 pixels (sse), reparti sur plusieurs threads (openmp).
+//! l'histogramme est construit directement sur les bits des luminances : 256 classes par puissance de 2,
+//! entre 2^-32 et 2^32, chaque thread remplit son histogramme, les histogrammes sont additionnes a la fin.
+//! les histogrammes lineaires (cf. histogram()) et les centiles (cf. percentile()) sont deduits de cet histogramme.
+class ImageStatistics
+{
+public:
+    //! classes de l'histogramme : 2^OCTAVE_BITS classes par puissance de 2, exposants dans [MIN_EXPONENT MAX_EXPONENT).
+    enum
+    {
+        OCTAVE_BITS= 8,
+        MIN_EXPONENT= -32,
+        MAX_EXPONENT= 32,
+        BINS= (MAX_EXPONENT - MIN_EXPONENT) << OCTAVE_BITS
+    };
+
+    float ymin;         //!< luminance minimum.
+    float ymax;         //!< luminance maximum.
+    float mean;         //!< luminance moyenne.
+    float log_average;  //!< moyenne logarithmique, exp(moyenne(log(delta + y))), cf. Reinhard 2002.
+    int count;          //!< nombre de pixels.
+
+    //! constructeur par defaut, statistiques vides.
+    ImageStatistics( )
+        :
+        ymin(0.f), ymax(0.f), mean(0.f), log_average(0.f), count(0),
+        m_bins(BINS, 0)
+    {}
+
+    ~ImageStatistics( ) {}
+
+    //! calcule les statistiques des pixels de l'image, luminance y = wr * r + wg * g + wb * b.
+    int compute( const HDRImage *image, const float wr= 1.f / 3.f, const float wg= 1.f / 3.f, const float wb= 1.f / 3.f );
+
+    //! calcule les statistiques de n pixels rgba.
+    int compute( const float *rgba, const int n, const float wr= 1.f / 3.f, const float wg= 1.f / 3.f, const float wb= 1.f / 3.f );
+
+    //! calcule les statistiques de width x height pixels rgba, les lignes sont separees par stride pixels, cf. TImage::stride().
+    int compute( const float *rgba, const int width, const int height, const int stride,
+        const float wr= 1.f / 3.f, const float wg= 1.f / 3.f, const float wb= 1.f / 3.f );
+
+    //! construit un histogramme de n classes regulieres entre hmin et hmax, renvoie le nombre de pixels de chaque classe.
+    //! les luminances en dehors de [hmin hmax] sont comptees dans la premiere ou la derniere classe.
+    int histogram( const int n, const float hmin, const float hmax, std::vector<float>& bins ) const;
+
+    //! renvoie la luminance telle qu'une fraction p des pixels est plus sombre, p dans [0 1].
+    float percentile( const float p ) const;
+
+    //! renvoie le nombre de pixels de chaque classe de l'histogramme logarithmique.
+    const std::vector<unsigned int>& logHistogram( ) const
+    {
+        return m_bins;
+    }
+
+    //! renvoie l'intervalle de luminance couvert par une classe de l'histogramme logarithmique.
+    static void binRange( const int bin, float& a, float& b );
+
+protected:
+    std::vector<unsigned int> m_bins;
+};
+
+}       // namespace
+
+#endif
@@ -0,0 +1,429 @@
+#include <cstring>
+#include <algorithm>
+
+#include <zlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "ImageWriter.h"
+#include "IOFileSystem.h"
+
+
+namespace gk {
+
+namespace {
+
+//! taille minimum des blocs de lignes compresses en parallele.
+const size_t block_size= 1 << 18;
+
+//! taille de la fenetre de deflate, les blocs sont initialises avec les window_size octets precedents.
+const size_t window_size= 1 << 15;
+
+//! ecrit un entier 32 bits, big endian (png).
+inline
+void store_be32( unsigned char *p, const unsigned int v )
+{
+    p[0]= (unsigned char) (v >> 24);
+    p[1]= (unsigned char) (v >> 16);
+    p[2]= (unsigned char) (v >> 8);
+    p[3]= (unsigned char) v;
+}
+
+//! ecrit un entier 16 ou 32 bits, little endian (bmp).
+inline
+void store_le16( unsigned char *p, const unsigned int v )
+{
+    p[0]= (unsigned char) v;
+    p[1]= (unsigned char) (v >> 8);
+}
+
+inline
+void store_le32( unsigned char *p, const unsigned int v )
+{
+    p[0]= (unsigned char) v;
+    p[1]= (unsigned char) (v >> 8);
+    p[2]= (unsigned char) (v >> 16);
+    p[3]= (unsigned char) (v >> 24);
+}
+
+}       // namespace
+
+
+ImageWriter::ImageWriter( )
+    :
+    m_file(NULL),
+    m_streams(),
+    m_blocks(),
+    m_pending(),
+    m_previous(),
+    m_window(),
+    m_row(),
+    m_adler(0),
+    m_width(0),
+    m_height(0),
+    m_channels(0),
+    m_rows(0),
+    m_block_rows(0),
+    m_pending_rows(0),
+    m_png(false),
+    m_started(false)
+{}
+
+ImageWriter::~ImageWriter( )
+{
+    if(m_file != NULL)
+        close();
+
+    for(unsigned int i= 0; i < m_streams.size(); i++)
+    {
+        z_stream *stream= (z_stream *) m_streams[i];
+        deflateEnd(stream);
+        delete stream;
+    }
+}
+
+int ImageWriter::open( const std::string& filename, const int width, const int height, const int channels, const Format format )
+{
+    if(m_file != NULL)
+        close();
+    if(width <= 0 || height <= 0 || (channels != 3 && channels != 4))
+        return -1;
+
+    bool png= (format == PNG);
+    if(format == AUTO)
+    {
+        png= IOFileSystem::isType(filename, ".png");
+        if(png == false && IOFileSystem::isType(filename, ".bmp") == false)
+        {
+            printf("ImageWriter::open( ): unsupported format '%s'\n", filename.c_str());
+            return -1;
+        }
+    }
+
+    m_file= fopen(filename.c_str(), "wb");
+    if(m_file == NULL)
+    {
+        printf("ImageWriter::open( ): write error '%s'\n", filename.c_str());
+        return -1;
+    }
+
+    m_width= width;
+    m_height= height;
+    m_channels= channels;
+    m_rows= 0;
+    m_png= png;
+
+    if(m_png == false)
+    {
+        // entete bmp, lignes alignees sur 4 octets, hauteur negative : lignes stockees de haut en bas.
+        // rgba : entete v4, masques BI_BITFIELDS dans l'ordre des composantes des pixels, les lignes sont ecrites telles quelles.
+        const unsigned int info_size= (channels == 4) ? 108 : 40;
+        const unsigned int offset= 14 + info_size;
+        const unsigned int pitch= ((unsigned int) width * channels + 3) & ~3u;
+        const unsigned int size= pitch * (unsigned int) height;
+        unsigned char header[14 + 108];
+        memset(header, 0, sizeof(header));
+        header[0]= 'B';
+        header[1]= 'M';
+        store_le32(header + 2, offset + size);
+        store_le32(header + 10, offset);
+        store_le32(header + 14, info_size);
+        store_le32(header + 18, (unsigned int) width);
+        store_le32(header + 22, (unsigned int) -height);
+        store_le16(header + 26, 1);
+        store_le16(header + 28, 8 * channels);
+        store_le32(header + 34, size);
+        store_le32(header + 38, 2835);  // 72 dpi
+        store_le32(header + 42, 2835);
+        if(channels == 4)
+        {
+            store_le32(header + 30, 3); // BI_BITFIELDS
+            store_le32(header + 54, 0x000000ffu);
+            store_le32(header + 58, 0x0000ff00u);
+            store_le32(header + 62, 0x00ff0000u);
+            store_le32(header + 66, 0xff000000u);
+            store_le32(header + 70, 0x73524742u);      // 'sRGB'
+        }
+
+        m_row.assign(pitch, 0);
+        if(fwrite(header, 1, offset, m_file) != offset)
+        {
+            printf("ImageWriter::open( ): write error '%s'\n", filename.c_str());
+            fclose(m_file);
+            m_file= NULL;
+            return -1;
+        }
+        return 0;
+    }
+
+    // signature et entete png : 8 bits par composante, rgb ou rgba, sans entrelacement
+    static const unsigned char signature[8]= { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+    unsigned char ihdr[13];
+    store_be32(ihdr, (unsigned int) width);
+    store_be32(ihdr + 4, (unsigned int) height);
+    ihdr[8]= 8;
+    ihdr[9]= (channels == 4) ? 6 : 2;
+    ihdr[10]= 0;
+    ihdr[11]= 0;
+    ihdr[12]= 0;
+    if(fwrite(signature, 1, sizeof(signature), m_file) != sizeof(signature)
+    || write_chunk("IHDR", ihdr, sizeof(ihdr)) < 0)
+    {
+        printf("ImageWriter::open( ): write error '%s'\n", filename.c_str());
+        fclose(m_file);
+        m_file= NULL;
+        return -1;
+    }
+
+    // un flux par bloc compresse en parallele, conserves d'une image a l'autre
+    if(m_streams.empty())
+    {
+    #ifdef _OPENMP
+        const int count= std::max(1, 2 * omp_get_max_threads());
+    #else
+        const int count= 1;
+    #endif
+        for(int i= 0; i < count; i++)
+        {
+            z_stream *stream= new z_stream;
+            memset(stream, 0, sizeof(z_stream));
+            // flux deflate brut, l'entete et la somme de controle zlib sont ecrits separement
+            if(deflateInit2(stream, Z_BEST_SPEED, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                delete stream;
+                break;
+            }
+            m_streams.push_back(stream);
+        }
+
+        if(m_streams.empty())
+        {
+            fclose(m_file);
+            m_file= NULL;
+            return -1;
+        }
+        m_blocks.resize(m_streams.size());
+    }
+
+    const size_t pitch= (size_t) width * channels;
+    m_block_rows= (int) std::max((size_t) 1, block_size / (pitch + 1));
+    m_pending.resize((pitch + 1) * m_block_rows * m_streams.size());
+    m_pending_rows= 0;
+    m_previous.assign(pitch, 0);
+    m_window.clear();
+    m_adler= adler32(0L, NULL, 0);
+    m_started= false;
+    return 0;
+}
+
+int ImageWriter::write_chunk( const char type[4], const unsigned char *data, const unsigned int size )
+{
+    unsigned char header[8];
+    store_be32(header, size);
+    memcpy(header + 4, type, 4);
+
+    unsigned long crc= crc32(0L, (const Bytef *) type, 4);
+    if(size > 0)
+        crc= crc32(crc, data, size);
+    unsigned char footer[4];
+    store_be32(footer, (unsigned int) crc);
+
+    if(fwrite(header, 1, 8, m_file) != 8
+    || (size > 0 && fwrite(data, 1, size, m_file) != size)
+    || fwrite(footer, 1, 4, m_file) != 4)
+    {
+        printf("ImageWriter( ): write error.\n");
+        return -1;
+    }
+    return 0;
+}
+
+int ImageWriter::compress_png( const bool last )
+{
+    const size_t row_size= (size_t) m_width * m_channels + 1;
+    const size_t size= (size_t) m_pending_rows * row_size;
+    const size_t block= (size_t) m_block_rows * row_size;
+    const int count= std::max(1, (int) ((size + block -1) / block));
+    const unsigned char *pending= m_pending.empty() ? NULL : &m_pending.front();
+
+    // compresse les blocs en parallele, chaque bloc est initialise avec les 32Ko precedents, 
+    // le dernier bloc de l'image termine le flux, les autres sont alignes sur un octet (Z_SYNC_FLUSH).
+    std::vector<unsigned long> adlers(count);
+    int errors= 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+: errors)
+    for(int c= 0; c < count; c++)
+    {
+        const size_t begin= c * block;
+        const size_t end= std::min(size, begin + block);
+        z_stream *stream= (z_stream *) m_streams[c];
+        std::vector<unsigned char>& out= m_blocks[c];
+
+        if(deflateReset(stream) != Z_OK)
+        {
+            errors++;
+            continue;
+        }
+
+        if(c > 0)
+        {
+            const size_t first= (begin > window_size) ? begin - window_size : 0;
+            deflateSetDictionary(stream, pending + first, (unsigned int) (begin - first));
+        }
+        else if(m_window.empty() == false)
+            deflateSetDictionary(stream, &m_window.front(), (unsigned int) m_window.size());
+
+        out.resize(deflateBound(stream, end - begin) + 64);
+        stream->next_in= const_cast<unsigned char *>(pending + begin);
+        stream->avail_in= (unsigned int) (end - begin);
+        stream->next_out= &out.front();
+        stream->avail_out= (unsigned int) out.size();
+
+        const bool finish= last && (c == count -1);
+        const int status= deflate(stream, finish ? Z_FINISH : Z_SYNC_FLUSH);
+        if((finish && status != Z_STREAM_END) || (!finish && status != Z_OK) || stream->avail_in != 0)
+        {
+            errors++;
+            continue;
+        }
+
+        out.resize(out.size() - stream->avail_out);
+        adlers[c]= adler32(adler32(0L, NULL, 0), pending + begin, (unsigned int) (end - begin));
+    }
+
+    if(errors > 0)
+        return -1;
+
+    // ecrit les blocs dans l'ordre, un bloc IDAT par bloc compresse
+    for(int c= 0; c < count; c++)
+    {
+        const size_t begin= c * block;
+        const size_t end= std::min(size, begin + block);
+        m_adler= adler32_combine(m_adler, adlers[c], (long) (end - begin));
+
+        std::vector<unsigned char>& out= m_blocks[c];
+        if(m_started == false)
+        {
+            // entete zlib : deflate, fenetre de 32Ko, niveau rapide
+            static const unsigned char zlib_header[2]= { 0x78, 0x01 };
+            out.insert(out.begin(), zlib_header, zlib_header + 2);
+            m_started= true;
+        }
+        if(last && c == count -1)
+        {
+            unsigned char trailer[4];
+            store_be32(trailer, (unsigned int) m_adler);
+            out.insert(out.end(), trailer, trailer + 4);
+        }
+
+        if(out.empty() == false && write_chunk("IDAT", &out.front(), (unsigned int) out.size()) < 0)
+            return -1;
+    }
+
+    // conserve la fin des lignes compressees, dictionnaire du prochain groupe de blocs
+    if(size >= window_size)
+        m_window.assign(pending + size - window_size, pending + size);
+    else if(size > 0)
+    {
+        m_window.insert(m_window.end(), pending, pending + size);
+        if(m_window.size() > window_size)
+            m_window.erase(m_window.begin(), m_window.end() - window_size);
+    }
+
+    m_pending_rows= 0;
+    return 0;
+}
+
+int ImageWriter::write_png( const unsigned char *pixels )
+{
+    // filtre 'up' : difference avec la ligne precedente, la premiere ligne est comparee a une ligne noire
+    const size_t pitch= (size_t) m_width * m_channels;
+    unsigned char *row= &m_pending[(size_t) m_pending_rows * (pitch + 1)];
+    row[0]= 2;
+    for(size_t i= 0; i < pitch; i++)
+        row[i + 1]= (unsigned char) (pixels[i] - m_previous[i]);
+    memcpy(&m_previous.front(), pixels, pitch);
+    m_pending_rows++;
+
+    // compresse les lignes en attente des qu'il y a un bloc par flux, la derniere ligne est compressee par close()
+    if(m_pending_rows == m_block_rows * (int) m_streams.size() && m_rows + 1 < m_height)
+        return compress_png(false);
+    return 0;
+}
+
+int ImageWriter::write_bmp( const unsigned char *pixels )
+{
+    if(m_channels == 4)
+    {
+        // rgba, cf. masques de l'entete : pas de conversion, les lignes sont deja alignees sur 4 octets
+        if(fwrite(pixels, 1, m_row.size(), m_file) != m_row.size())
+        {
+            printf("ImageWriter( ): write error.\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    // bgr
+    unsigned char *row= &m_row.front();
+    for(int i= 0; i < m_width; i++, pixels+= 3, row+= 3)
+    {
+        row[0]= pixels[2];
+        row[1]= pixels[1];
+        row[2]= pixels[0];
+    }
+
+    if(fwrite(&m_row.front(), 1, m_row.size(), m_file) != m_row.size())
+    {
+        printf("ImageWriter( ): write error.\n");
+        return -1;
+    }
+    return 0;
+}
+
+int ImageWriter::write( const unsigned char *pixels, const int n )
+{
+    if(m_file == NULL || pixels == NULL || n < 0 || m_rows + n > m_height)
+        return -1;
+
+    const size_t pitch= (size_t) m_width * m_channels;
+    for(int y= 0; y < n; y++, pixels+= pitch)
+    {
+        const int code= m_png ? write_png(pixels) : write_bmp(pixels);
+        if(code < 0)
+            return -1;
+        m_rows++;
+    }
+
+    return 0;
+}
+
+int ImageWriter::close( )
+{
+    if(m_file == NULL)
+        return -1;
+
+    int code= 0;
+    if(m_rows != m_height)
+    {
+        printf("ImageWriter::close( ): incomplete image, %d/%d rows.\n", m_rows, m_height);
+        code= -1;
+    }
+
+    if(m_png && code == 0)
+    {
+        if(compress_png(true) < 0 || write_chunk("IEND", NULL, 0) < 0)
+            code= -1;
+    }
+
+    if(fclose(m_file) != 0)
+        code= -1;
+    m_file= NULL;
+
+    // les buffers sont conserves pour l'image suivante
+    m_pending_rows= 0;
+    m_rows= 0;
+    return code;
+}
+
+}       // namespace
@@ -0,0 +1,98 @@
+#ifndef _GK_IMAGE_WRITER_H
+#define _GK_IMAGE_WRITER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace gk {
+
+//! ecriture en flux d'une image 8 bits .bmp ou .png, ligne par ligne, de haut en bas, sans sdl.
+
+//! la memoire utilisee ne depend que de la largeur de l'image : les lignes sont ecrites des qu'elles sont fournies,
+//! en .bmp, les lignes sont stockees de haut en bas (hauteur negative dans l'entete), les pixels rgba sont ecrits tels quels
+//! (masques BI_BITFIELDS), les pixels rgb sont convertis en bgr.
+//! en .png, les lignes sont filtrees (filtre 'up') puis compressees par blocs de lignes en parallele (openmp), niveau rapide
+//! (Z_BEST_SPEED) : chaque bloc est un flux deflate termine par Z_SYNC_FLUSH, initialise avec les 32Ko precedents,
+//! les blocs sont concatenes dans l'ordre et forment un seul flux zlib, cf. pigz.
+//! les buffers sont conserves entre 2 images : un meme writer peut ecrire une sequence d'images sans reallouer.
+/*! exemple d'utilisation :
+\code
+    gk::ImageWriter writer;
+    if(writer.open("output.png", width, height) < 0)
+        return -1;
+    for(int y= 0; y < height; y+= n)
+        writer.write(rgb, n);           // n lignes de width pixels rgb
+    writer.close();
+\endcode
+*/
+class ImageWriter
+{
+public:
+    //! format du fichier.
+    enum Format
+    {
+        AUTO= 0,        //!< choisi par l'extension du fichier.
+        BMP,
+        PNG
+    };
+
+private:
+    FILE *m_file;
+    std::vector<void *> m_streams;              //!< un flux zlib par bloc compresse en parallele.
+    std::vector< std::vector<unsigned char> > m_blocks;    //!< donnees compressees de chaque bloc.
+    std::vector<unsigned char> m_pending;       //!< lignes filtrees en attente de compression.
+    std::vector<unsigned char> m_previous;      //!< ligne precedente, filtre 'up'.
+    std::vector<unsigned char> m_window;        //!< 32Ko precedant les lignes en attente, dictionnaire du premier bloc.
+    std::vector<unsigned char> m_row;           //!< ligne convertie, bmp.
+    unsigned long m_adler;                      //!< somme de controle des donnees compressees.
+    int m_width;
+    int m_height;
+    int m_channels;
+    int m_rows;
+    int m_block_rows;                           //!< nombre de lignes par bloc.
+    int m_pending_rows;
+    bool m_png;
+    bool m_started;                             //!< l'entete zlib a ete ecrit.
+
+    // non copyable
+    ImageWriter( const ImageWriter& );
+    ImageWriter& operator=( const ImageWriter& );
+
+    int write_bmp( const unsigned char *pixels );
+    int write_png( const unsigned char *pixels );
+    int write_chunk( const char type[4], const unsigned char *data, const unsigned int size );
+    int compress_png( const bool last );
+
+public:
+    //! constructeur par defaut, cf. open().
+    ImageWriter( );
+
+    //! destructeur, ferme le fichier.
+    ~ImageWriter( );
+
+    //! cree le fichier et ecrit son entete.
+    //! \param channels 3 pour des pixels rgb, 4 pour des pixels rgba.
+    //! \param format AUTO : choisi par l'extension du fichier, .png ou .bmp.
+    //! \return 0 en cas de succes, -1 en cas d'erreur.
+    int open( const std::string& filename, const int width, const int height, const int channels= 3, const Format format= AUTO );
+
+    //! ecrit n lignes de width pixels, pixels[n*width*channels].
+    //! \return 0 en cas de succes, -1 en cas d'erreur.
+    int write( const unsigned char *pixels, const int n );
+
+    //! termine l'ecriture du fichier et le ferme.
+    //! \return 0 en cas de succes, -1 en cas d'erreur ou si toutes les lignes n'ont pas ete ecrites.
+    int close( );
+
+    //! renvoie le nombre de lignes deja ecrites.
+    int rows( ) const
+    {
+        return m_rows;
+    }
+};
+
+}       // namespace
+
+#endif
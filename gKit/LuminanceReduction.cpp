@@ -0,0 +1,258 @@
+
+#include <cstdio>
+#include <cmath>
+
+#include "LuminanceReduction.h"
+#include "EffectIO.h"
+#include "EffectShaderManager.h"
+#include "TextureManager.h"
+#include "FramebufferManager.h"
+#include "SamplerManager.h"
+#include "BufferManager.h"
+#include "GL/TPAttributes.h"
+#include "GL/TPBuffer.h"
+#include "GL/TPFramebuffer.h"
+#include "GL/TPSampler.h"
+#include "GL/TPShaderProgram.h"
+#include "GL/TPTextureUnits.h"
+
+
+namespace gk {
+
+LuminanceReduction::LuminanceReduction( )
+    :
+    m_reduce(NULL),
+    m_histogram(NULL),
+    m_sampler(NULL),
+    m_levels(),
+    m_framebuffers(),
+    m_bins(NULL),
+    m_bins_framebuffer(NULL),
+    m_frame(0),
+    m_pending(0),
+    m_width(0),
+    m_height(0),
+    m_bins_n(0),
+    m_step(1)
+{
+    for(int i= 0; i < FRAMES; i++)
+    {
+        m_readback[i]= NULL;
+        m_fences[i]= 0;
+        m_ranges[i][0]= 0.f;
+        m_ranges[i][1]= 1.f;
+    }
+
+    setWeights(1.f / 3.f, 1.f / 3.f, 1.f / 3.f);
+}
+
+LuminanceReduction::~LuminanceReduction( )
+{
+    // les textures, framebuffers et buffers sont detruits par les managers.
+    for(int i= 0; i < FRAMES; i++)
+        if(m_fences[i] != 0)
+            glDeleteSync(m_fences[i]);
+}
+
+void LuminanceReduction::setWeights( const float wr, const float wg, const float wb )
+{
+    m_weights[0]= wr;
+    m_weights[1]= wg;
+    m_weights[2]= wb;
+}
+
+int LuminanceReduction::init( const int width, const int height, const int bins, const int step, const std::string& effect )
+{
+    if(width <= 0 || height <= 0 || bins <= 0 || step <= 0)
+        return -1;
+
+    Effect *fx= EffectIO::read(effect);
+    if(fx == NULL)
+        return -1;
+    EffectShaderManager shaders(fx);
+    m_reduce= shaders.createShaderProgram("luminance_reduce");
+    if(m_reduce == NULL || m_reduce->createGLResource() < 0)
+        return -1;
+    m_histogram= shaders.createShaderProgram("luminance_histogram");
+    if(m_histogram == NULL || m_histogram->createGLResource() < 0)
+        return -1;
+
+    m_sampler= createNearestSampler();
+    if(m_sampler == NULL || m_sampler->createGLResource() < 0)
+        return -1;
+
+    // niveaux de la reduction, jusqu'a 1x1
+    m_levels.clear();
+    m_framebuffers.clear();
+    int w= width;
+    int h= height;
+    do
+    {
+        w= (w + 3) / 4;
+        h= (h + 3) / 4;
+
+        GLTexture2D *level= createTexture2D(UNIT0, w, h, GL_RGBA32F, GL_RGBA, GL_FLOAT);
+        GLFramebuffer *framebuffer= createFramebuffer();
+        if(level == NULL || level->createGLResource() < 0 || framebuffer == NULL || framebuffer->createGLResource() < 0)
+            return -1;
+        if(framebuffer->attachTexture(COLOR0, level) < 0 || framebuffer->setDrawbuffer(DRAW0, COLOR0) < 0)
+            return -1;
+
+        m_levels.push_back(level);
+        m_framebuffers.push_back(framebuffer);
+    }
+    while(w > 1 || h > 1);
+
+    // histogramme
+    m_bins= createTexture2D(UNIT0, bins, 1, GL_R32F, GL_RED, GL_FLOAT);
+    m_bins_framebuffer= createFramebuffer();
+    if(m_bins == NULL || m_bins->createGLResource() < 0 || m_bins_framebuffer == NULL || m_bins_framebuffer->createGLResource() < 0)
+        return -1;
+    if(m_bins_framebuffer->attachTexture(COLOR0, m_bins) < 0 || m_bins_framebuffer->setDrawbuffer(DRAW0, COLOR0) < 0)
+        return -1;
+    resetFramebuffer();
+
+    // copies des resultats : min, max, sommes + histogramme
+    for(int i= 0; i < FRAMES; i++)
+    {
+        m_readback[i]= createPixelBuffer((4 + bins) * sizeof(float));
+        if(m_readback[i] == NULL || m_readback[i]->createGLResource() < 0)
+            return -1;
+    }
+
+    m_width= width;
+    m_height= height;
+    m_bins_n= bins;
+    m_step= step;
+    m_frame= 0;
+    m_pending= 0;
+    return 0;
+}
+
+int LuminanceReduction::reduce( GLTexture2D *image, const float hmin, const float hmax )
+{
+    if(m_reduce == NULL || m_histogram == NULL || image == NULL)
+        return -1;
+    if(image->width() != m_width || image->height() != m_height)
+        return -1;
+    if(m_pending == FRAMES)
+        return -1;      // le gpu n'a pas encore termine les reductions precedentes
+
+    // conserve l'etat de l'application
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLfloat clear_color[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+    const GLboolean blend= glIsEnabled(GL_BLEND);
+    const GLboolean depth= glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    // reductions 4x4 successives : somme log2(delta + y), somme y, min y, max y
+    setShaderProgram(m_reduce);
+    setUniform(m_reduce->uniform("weights"), m_weights[0], m_weights[1], m_weights[2]);
+    GLTexture2D *source= image;
+    for(int i= 0; i < (int) m_levels.size(); i++)
+    {
+        setFramebuffer(m_framebuffers[i]);
+        glViewport(0, 0, m_levels[i]->width(), m_levels[i]->height());
+
+        setUniform(m_reduce->uniform("source_size"), source->width(), source->height());
+        setUniform(m_reduce->uniform("first"), (i == 0) ? 1 : 0);
+        setTextureUnit(m_reduce->sampler("source"), source, m_sampler);
+        DrawArrays(GL_TRIANGLES, 0, 3);
+
+        source= m_levels[i];
+    }
+    resetTextureUnit(m_reduce->sampler("source"));
+
+    // histogramme : un point par pixel, additionne dans la classe de sa luminance
+    const float range_min= hmin;
+    const float range_max= (hmax > hmin) ? hmax : hmin + 1e-6f;
+    setShaderProgram(m_histogram);
+    setFramebuffer(m_bins_framebuffer);
+    glViewport(0, 0, m_bins_n, 1);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    setUniform(m_histogram->uniform("size"), m_width, m_height);
+    setUniform(m_histogram->uniform("step"), m_step);
+    setUniform(m_histogram->uniform("weights"), m_weights[0], m_weights[1], m_weights[2]);
+    setUniform(m_histogram->uniform("hmin"), range_min);
+    setUniform(m_histogram->uniform("hmax"), range_max);
+    setUniform(m_histogram->uniform("bins"), m_bins_n);
+    setTextureUnit(m_histogram->sampler("image"), image, m_sampler);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    DrawArrays(GL_POINTS, 0, (m_width * m_height + m_step -1) / m_step);
+    glDisable(GL_BLEND);
+
+    resetTextureUnit(m_histogram->sampler("image"));
+    resetShaderProgram();
+    resetFramebuffer();
+
+    // copie les resultats dans un pixel buffer, relu plus tard
+    GLPixelBuffer *readback= m_readback[m_frame];
+    readback->bindAsPixelPack();
+    setReadFramebuffer(m_framebuffers.back());
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, (GLvoid *) 0);
+    setReadFramebuffer(m_bins_framebuffer);
+    glReadPixels(0, 0, m_bins_n, 1, GL_RED, GL_FLOAT, (GLvoid *) (4 * sizeof(float)));
+    resetReadFramebuffer();
+    GLPixelBuffer::unbindPixelPack();
+
+    m_fences[m_frame]= glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_ranges[m_frame][0]= range_min;
+    m_ranges[m_frame][1]= range_max;
+    m_frame= (m_frame + 1) % FRAMES;
+    m_pending++;
+
+    // restaure l'etat de l'application
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+    if(blend)
+        glEnable(GL_BLEND);
+    if(depth)
+        glEnable(GL_DEPTH_TEST);
+    return 0;
+}
+
+bool LuminanceReduction::result( LuminanceStatistics& stats )
+{
+    if(m_pending == 0)
+        return false;
+
+    // la plus ancienne reduction est-elle terminee ?
+    const int id= (m_frame - m_pending + FRAMES) % FRAMES;
+    const GLenum status= glClientWaitSync(m_fences[id], 0, 0);
+    if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+
+    glDeleteSync(m_fences[id]);
+    m_fences[id]= 0;
+    m_pending--;
+
+    const float *data= (const float *) m_readback[id]->map(0, (4 + m_bins_n) * sizeof(float), GL_MAP_READ_BIT);
+    if(data == NULL)
+    {
+        m_readback[id]->unmap();
+        return false;
+    }
+
+    const float n= (float) m_width * (float) m_height;
+    stats.log_average= exp2f(data[0] / n);
+    stats.mean= data[1] / n;
+    stats.ymin= data[2];
+    stats.ymax= data[3];
+    stats.hmin= m_ranges[id][0];
+    stats.hmax= m_ranges[id][1];
+    stats.bins.resize(m_bins_n);
+    for(int i= 0; i < m_bins_n; i++)
+        stats.bins[i]= data[4 + i] * (float) m_step;
+
+    m_readback[id]->unmap();
+    return true;
+}
+
+}       // namespace
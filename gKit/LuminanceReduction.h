@@ -0,0 +1,120 @@
+#ifndef _GK_LUMINANCE_REDUCTION_H
+#define _GK_LUMINANCE_REDUCTION_H
+
+#include <string>
+#include <vector>
+
+#include "GL/GLPlatform.h"
+
+
+namespace gk {
+
+class GLShaderProgram;
+class GLTexture2D;
+class GLFramebuffer;
+class GLSampler;
+class GLPixelBuffer;
+
+//! resultat d'une reduction, cf. LuminanceReduction.
+struct LuminanceStatistics
+{
+    float ymin;                 //!< luminance minimum.
+    float ymax;                 //!< luminance maximum.
+    float mean;                 //!< luminance moyenne.
+    float log_average;          //!< moyenne logarithmique, exp(moyenne(log(delta + y))).
+    float hmin;                 //!< intervalle couvert par l'histogramme.
+    float hmax;
+    std::vector<float> bins;    //!< nombre de pixels de chaque classe de l'histogramme, entre hmin et hmax.
+
+    LuminanceStatistics( )
+        :
+        ymin(0.f), ymax(0.f), mean(0.f), log_average(0.f), hmin(0.f), hmax(1.f), bins()
+    {}
+};
+
+//! statistiques de luminance d'une texture hdr calculees sur le gpu, pour ajuster l'exposition a chaque image, sans attendre le gpu.
+
+//! min, max, moyenne et moyenne logarithmique sont obtenus par une suite de reductions 4x4 dans des textures float,
+//! l'histogramme est accumule par blending additif : un point par pixel, place sur la classe de sa luminance.
+//! les resultats sont copies dans un pixel buffer, et relus quelques images plus tard, cf. result(),
+//! lorsque le gpu a termine, sans bloquer l'application.
+//! cf. luminance_reduction.gkfx, utilise opengl 3 (glsl 130).
+/*! exemple d'utilisation :
+\code
+    gk::LuminanceReduction reduction;
+    reduction.init(image->width(), image->height());
+
+    // a chaque image
+    reduction.reduce(texture, hmin, hmax);
+    gk::LuminanceStatistics stats;
+    if(reduction.result(stats))
+        saturation= stats.ymax;         // resultat d'une image precedente
+\endcode
+*/
+class LuminanceReduction
+{
+public:
+    //! nombre de copies des resultats en attente de relecture.
+    enum { FRAMES= 3 };
+
+private:
+    GLShaderProgram *m_reduce;
+    GLShaderProgram *m_histogram;
+    GLSampler *m_sampler;
+
+    std::vector<GLTexture2D *> m_levels;        //!< niveaux de la reduction, rgba32f, 4x plus petits a chaque niveau, jusqu'a 1x1.
+    std::vector<GLFramebuffer *> m_framebuffers;
+    GLTexture2D *m_bins;                        //!< histogramme, bins x 1, r32f.
+    GLFramebuffer *m_bins_framebuffer;
+
+    GLPixelBuffer *m_readback[FRAMES];
+    GLsync m_fences[FRAMES];
+    float m_ranges[FRAMES][2];
+    int m_frame;                //!< prochaine copie a remplir.
+    int m_pending;              //!< nombre de copies en attente.
+
+    int m_width;
+    int m_height;
+    int m_bins_n;
+    int m_step;
+    float m_weights[3];
+
+    // non copyable
+    LuminanceReduction( const LuminanceReduction& );
+    LuminanceReduction& operator=( const LuminanceReduction& );
+
+public:
+    //! constructeur par defaut, cf. init().
+    LuminanceReduction( );
+
+    //! destructeur.
+    ~LuminanceReduction( );
+
+    //! charge les shaders et cree les textures intermediaires pour des images width x height.
+    //! \param bins nombre de classes de l'histogramme,
+    //! \param step l'histogramme n'utilise qu'un pixel sur step, pour les grandes images.
+    int init( const int width, const int height, const int bins= 256, const int step= 1,
+        const std::string& effect= "luminance_reduction.gkfx" );
+
+    //! definit le calcul de la luminance, y = wr * r + wg * g + wb * b, moyenne des composantes par defaut.
+    void setWeights( const float wr, const float wg, const float wb );
+
+    //! lance le calcul des statistiques de la texture, et de l'histogramme entre hmin et hmax.
+    //! les resultats sont disponibles plus tard, cf. result().
+    //! \return -1 si FRAMES reductions sont deja en attente, ou en cas d'erreur.
+    int reduce( GLTexture2D *image, const float hmin, const float hmax );
+
+    //! renvoie vrai et les statistiques de la plus ancienne reduction terminee par le gpu, sans attendre.
+    //! renvoie faux si aucune reduction n'est terminee.
+    bool result( LuminanceStatistics& stats );
+
+    //! renvoie le nombre de reductions en attente.
+    int pending( ) const
+    {
+        return m_pending;
+    }
+};
+
+}       // namespace
+
+#endif
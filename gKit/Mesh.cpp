@@ -1,5 +1,12 @@
+#include <algorithm>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "Mesh.h"
+#include "SpatialGrid.h"
 
 namespace gk {
 
@@ -7,105 +14,414 @@ namespace gk {
 int Mesh::buildAdjacency( )
 {
     /*         
-        la tete de la liste d'adjacence du sommet d'indice a est m_position_adjacency[a]
-        toutes les listes sont concatenees dans une liste 'globale' m_adjacency
-        
-        la premiere face incidente au sommet a est m_adjacency[ m_position_adjacency[a] ]
-        les autres faces incidentes se trouvent dans les elements suivants de m_adjacency,
-        la fin de la liste est marquee par un numero de face = -1
+        toutes les listes sont concatenees dans une liste 'globale' m_adjacency,
+        les triangles incidents au sommet d'indice a sont m_adjacency[ m_position_adjacency[a] .. m_position_adjacency[a+1] ] (exclu)
+        et sont tries par indice croissant.
         
         exemple de parcours pour le sommet d'indice a:
-        for(int i= m_position_adjacency[a];
-            m_adjacency[i] != -1;
-            i++;
+        for(int i= m_position_adjacency[a]; i < m_position_adjacency[a +1]; i++)
         {
             le triangle d'indice m_adjacency[i] est adjacent / incident au sommet a
         }
+        
+        cf. adjacentTriangleCount() et adjacentTriangle().
      */
     
     const int triangles_n= triangleCount();
     const int positions_n= positionCount();
     
-    // initialise la liste d'adjacence des sommets
-    m_position_adjacency.clear();
-    m_position_adjacency.resize(positions_n, 0);
+    // les triangles sont repartis en blocs contigus, un bloc par thread : chaque thread compte les triangles
+    // de son bloc pour chaque sommet, les compteurs deviennent la position de chaque bloc dans les listes,
+    // et chaque thread insere ses triangles sans synchronisation, dans l'ordre croissant : les listes sont triees.
+    int blocks_n= 1;
+#ifdef _OPENMP
+    blocks_n= std::max(1, std::min(omp_get_max_threads(), triangles_n / 4096));
+#endif
+    std::vector<int> counts((size_t) blocks_n * positions_n, 0);
     
-    // passe 1 : compte le nombre de faces partageant chaque sommet
+    // passe 1 : compte le nombre de faces de chaque bloc partageant chaque sommet
+    #pragma omp parallel for schedule(static, 1)
+    for(int b= 0; b < blocks_n; b++)
     {
-        for(int i= 0; i < triangles_n; i++)
+        int *count= &counts[(size_t) b * positions_n];
+        const int end= (int) ((long long) (b +1) * triangles_n / blocks_n);
+        for(int i= 3 * (int) ((long long) b * triangles_n / blocks_n); i < 3*end; i++)
+            count[m_indices[i]]++;
+    }
+    
+    // passe 2 : position de chaque bloc dans la liste de chaque sommet, et taille de la liste dans m_position_adjacency[a +1]
+    m_position_adjacency.assign(positions_n +1, 0);
+    #pragma omp parallel for schedule(static, 4096)
+    for(int a= 0; a < positions_n; a++)
+    {
+        int offset= 0;
+        for(int b= 0; b < blocks_n; b++)
         {
-            const int a= m_indices[3*i];
-            m_position_adjacency[a]++;
-            
-            const int b= m_indices[3*i +1];
-            m_position_adjacency[b]++;
-            
-            const int c= m_indices[3*i +2];
-            m_position_adjacency[c]++;
+            int& count= counts[(size_t) b * positions_n + a];
+            const int n= count;
+            count= offset;
+            offset+= n;
         }
+        m_position_adjacency[a +1]= offset;
     }
     
-    // passe 2 : distribue le premier element de la liste d'adjacence dans la liste globale
+    // prefix sum, premier element de la liste de chaque sommet
+    for(int i= 0; i < positions_n; i++)
+        m_position_adjacency[i +1]+= m_position_adjacency[i];
+    
+    // passe 3 : insere chaque triangle dans la liste de ses sommets, chaque bloc remplit sa partie des listes
+    m_adjacency.resize(3*triangles_n);
+    #pragma omp parallel for schedule(static, 1)
+    for(int b= 0; b < blocks_n; b++)
     {
-        int head= 0;
-        int next= 0;
+        int *slot= &counts[(size_t) b * positions_n];
+        const int end= (int) ((long long) (b +1) * triangles_n / blocks_n);
+        for(int i= 3 * (int) ((long long) b * triangles_n / blocks_n); i < 3*end; i++)
+        {
+            const int a= m_indices[i];
+            m_adjacency[m_position_adjacency[a] + slot[a]++]= i / 3;
+        }
+    }
+    
+    m_adjacency_dirty= false;
+    return 0;
+}
+
+namespace {
+
+//! melange les bits d'une valeur, cf. murmur3.
+unsigned int mix( unsigned int h )
+{
+    h^= h >> 16;
+    h*= 0x85ebca6bu;
+    h^= h >> 13;
+    h*= 0xc2b2ae35u;
+    h^= h >> 16;
+    return h;
+}
+
+//! hash des coordonnees d'un point.
+unsigned int hashPosition( const Point& p )
+{
+    // + 0 : -0 et 0 ont le meme hash
+    const float v[3]= { p.x + 0.f, p.y + 0.f, p.z + 0.f };
+    unsigned int bits[3];
+    memcpy(bits, v, sizeof(bits));
+    return mix(bits[0] ^ mix(bits[1] ^ mix(bits[2])));
+}
+
+//! renvoie vrai si 2 points sont confondus.
+bool samePosition( const Point& a, const Point& b )
+{
+    return (a.x == b.x && a.y == b.y && a.z == b.z);
+}
+
+//! hash d'une arete, indices des sommets a < b.
+unsigned int hashEdge( const int a, const int b )
+{
+    return mix((unsigned int) a * 0x9e3779b1u + (unsigned int) b);
+}
+
+//! renvoie la plus petite puissance de 2 >= n.
+unsigned int tableSize( const int n )
+{
+    unsigned int size= 1;
+    while(size < (unsigned int) n)
+        size= size << 1;
+    return size;
+}
+
+}       // namespace
+
+//! construit les paires de triangles adjacents par une arete.
+int Mesh::buildEdgeNeighbors( std::vector<int>& neighbors, std::vector<int>& positions_id ) const
+{
+    /*  
+        les aretes sont numerotees 3*triangle + k, l'arete k relie les sommets k et (k+1)%3 du triangle.
+        neighbors[e] est l'arete opposee a e dans le triangle voisin, ou -1 pour une arete de bord ou partagee par plus de 2 triangles.
+        positions_id[a] est le plus petit indice de sommet ayant la meme position que le sommet a, les sommets dupliques
+        pour porter des normales ou des coordonnees de textures differentes sont consideres comme un seul sommet.
+     */
+    
+    const int positions_n= positionCount();
+    const int triangles_n= triangleCount();
+    
+    // etape 1 : identifie les sommets ayant la meme position, table ouverte de 2n entrees.
+    positions_id.resize(positions_n);
+    {
+        const unsigned int mask= tableSize(2*positions_n) - 1;
+        std::vector<int> table(mask +1, -1);
         for(int i= 0; i < positions_n; i++)
         {
-            m_position_adjacency[i]++;      // reserve une place pour le marqeur de fin de liste
-            next= head + m_position_adjacency[i];
-            m_position_adjacency[i]= head;
+            const Point& p= m_positions[i];
+            unsigned int h= hashPosition(p) & mask;
+            while(table[h] != -1 && !samePosition(m_positions[table[h]], p))
+                h= (h +1) & mask;
             
-            head= next;
+            if(table[h] == -1)
+                table[h]= i;
+            positions_id[i]= table[h];
+        }
+    }
+    
+    // etape 2 : apparie les aretes, table ouverte de 2*3t entrees.
+    neighbors.assign(3*triangles_n, -1);
+    {
+        const unsigned int mask= tableSize(6*triangles_n) - 1;
+        std::vector<int> table(mask +1, -1);
+        for(int e= 0; e < 3*triangles_n; e++)
+        {
+            const int t= e / 3;
+            const int a= positions_id[m_indices[e]];
+            const int b= positions_id[m_indices[3*t + (e +1) % 3]];
+            if(a == b)
+                continue;       // arete degeneree
+            
+            const int lo= std::min(a, b);
+            const int hi= std::max(a, b);
+            unsigned int h= hashEdge(lo, hi) & mask;
+            for(;;)
+            {
+                const int f= table[h];
+                if(f == -1)
+                {
+                    // premiere occurrence de l'arete
+                    table[h]= e;
+                    break;
+                }
+                
+                const int fa= positions_id[m_indices[f]];
+                const int fb= positions_id[m_indices[3*(f / 3) + (f +1) % 3]];
+                if(std::min(fa, fb) == lo && std::max(fa, fb) == hi)
+                {
+                    if(neighbors[f] == -1)
+                    {
+                        neighbors[f]= e;
+                        neighbors[e]= f;
+                    }
+                    else if(neighbors[f] >= 0)
+                    {
+                        // arete non manifold, partagee par plus de 2 triangles
+                        neighbors[neighbors[f]]= -1;
+                        neighbors[f]= -2;
+                    }
+                    break;
+                }
+                
+                h= (h +1) & mask;
+            }
         }
         
-        // alloue la liste globale d'adjacence
-        m_adjacency.clear();
-        m_adjacency.resize(next);
+        for(int e= 0; e < 3*triangles_n; e++)
+            if(neighbors[e] < 0)
+                neighbors[e]= -1;
     }
     
-    // passe 3 : construit la liste d'adjacence
+    return 0;
+}
+
+//! regroupe les triangles connectes par des aretes 'lisses', remplit m_smooth_groups.
+int Mesh::buildSmoothGroups( const std::vector<int>& neighbors, const std::vector<unsigned char>& smooth )
+{
+    const int triangles_n= triangleCount();
+    m_smooth_groups.assign(triangles_n, -1);
+    
+    // parcours en largeur, pile explicite
+    std::vector<int> stack;
+    stack.reserve(triangles_n);
+    int groups= 0;
+    for(int i= 0; i < triangles_n; i++)
     {
-        std::vector<int> last;
-        last.resize(positions_n);
+        if(m_smooth_groups[i] != -1)
+            continue;
+        
+        m_smooth_groups[i]= groups;
+        stack.push_back(i);
+        while(!stack.empty())
         {
-            // construit la queue de liste
-            for(int i= 0; i < positions_n; i++)
+            const int t= stack.back();
+            stack.pop_back();
+            for(int k= 0; k < 3; k++)
             {
-                last[i]= m_position_adjacency[i];
-                m_adjacency[last[i]]= -1;
+                const int e= 3*t + k;
+                if(neighbors[e] < 0 || smooth[e] == 0)
+                    continue;
+                
+                const int next= neighbors[e] / 3;
+                if(m_smooth_groups[next] != -1)
+                    continue;
+                m_smooth_groups[next]= groups;
+                stack.push_back(next);
             }
         }
         
-        // insere chaque triangle dans la liste d'adjacence de ses sommets
+        groups++;
+    }
+    
+    return groups;
+}
+
+//! duplique les sommets partages par des triangles de smooth groups differents.
+int Mesh::splitSmoothGroups( )
+{
+    const int positions_n= positionCount();
+    const bool has_normals= (m_normals.size() == m_positions.size());
+    const bool has_texcoords= (m_texcoords.size() == m_positions.size());
+    
+    buildAdjacency();
+    const std::vector<int> indices= m_indices;
+    
+    // triangles incidents au sommet, tries par groupe : un sommet par groupe, le premier groupe conserve le sommet
+    std::vector< std::pair<int, int> > triangles;
+    
+    int count= 0;
+    for(int v= 0; v < positions_n; v++)
+    {
+        triangles.clear();
+        const int end= m_position_adjacency[v +1];
+        for(int i= m_position_adjacency[v]; i < end; i++)
+            triangles.push_back( std::make_pair(m_smooth_groups[m_adjacency[i]], m_adjacency[i]) );
+        std::sort(triangles.begin(), triangles.end());
+        
+        int vertex= v;
+        const int triangles_n= (int) triangles.size();
         for(int i= 0; i < triangles_n; i++)
         {
-            const int a= m_indices[3*i];
-            m_adjacency[last[a]++]= i;
-            m_adjacency[last[a]]= -1;       // termine la liste 
-            
-            const int b= m_indices[3*i +1];
-            m_adjacency[last[b]++]= i;
-            m_adjacency[last[b]]= -1;       // termine la liste 
+            if(i > 0 && triangles[i].first != triangles[i -1].first)
+            {
+                // duplique le sommet
+                vertex= (int) m_positions.size();
+                const Point p= m_positions[v];
+                m_positions.push_back(p);
+                if(has_normals)
+                {
+                    const Normal n= m_normals[v];
+                    m_normals.push_back(n);
+                }
+                if(has_texcoords)
+                {
+                    const Point2 uv= m_texcoords[v];
+                    m_texcoords.push_back(uv);
+                }
+                
+                const int buffers_n= (int) m_attributes_buffer.size();
+                for(int b= 0; b < buffers_n; b++)
+                {
+                    MeshBuffer *buffer= m_attributes_buffer[b];
+                    if(buffer->count != positions_n + count)
+                        continue;       // attributs non associes aux sommets
+                    for(int k= 0; k < buffer->size; k++)
+                        buffer->data.push_back(buffer->data[v * buffer->size + k]);
+                    buffer->count++;
+                }
+                
+                count++;
+            }
             
-            const int c= m_indices[3*i +2];
-            m_adjacency[last[c]++]= i;
-            m_adjacency[last[c]]= -1;       // termine la liste 
+            const int t= triangles[i].second;
+            for(int k= 0; k < 3; k++)
+                if(indices[3*t + k] == v)
+                    m_indices[3*t + k]= vertex;
         }
     }
     
-    return 0;
+    // les listes d'adjacence et les clusters ne sont plus valides
+    m_position_adjacency.clear();
+    m_adjacency.clear();
+    m_adjacency_dirty= true;
+    m_clusters.clear();
+    m_cluster_vertices.clear();
+    
+#ifdef VERBOSE
+    printf("  split %d vertices\n", count);
+#endif
+    
+    return count;
 }
 
 //! construit les smooth groups en fonction de l'angle entre les normales des triangles adjacents.
 int Mesh::buildNormalSmoothGroups( const float max_angle )
 {
-    return -1;
+    const int triangles_n= triangleCount();
+    if(triangles_n == 0)
+        return -1;
+    
+#ifdef VERBOSE
+    printf("building normal smooth groups...\n");
+#endif
+    
+    std::vector<int> neighbors;
+    std::vector<int> positions_id;
+    buildEdgeNeighbors(neighbors, positions_id);
+    
+    // normales geometriques des triangles
+    std::vector<Normal> normals(triangles_n);
+    #pragma omp parallel for
+    for(int i= 0; i < triangles_n; i++)
+        normals[i]= getTriangleNormal(i);
+    
+    // une arete est lisse si l'angle entre les normales des 2 triangles est inferieur a max_angle (en degres)
+    const float cos_max= cosf(Radians(max_angle));
+    std::vector<unsigned char> smooth(3*triangles_n);
+    #pragma omp parallel for
+    for(int e= 0; e < 3*triangles_n; e++)
+        smooth[e]= (neighbors[e] >= 0 && Dot(normals[e / 3], normals[neighbors[e] / 3]) >= cos_max);
+    
+    const int groups= buildSmoothGroups(neighbors, smooth);
+    splitSmoothGroups();
+    
+#ifdef VERBOSE
+    printf("  %d smooth groups\n", groups);
+#endif
+    
+    return groups;
 }
 
 //! construit les smooth groups en fonction de la distance entre les coordonnees de textures des triangles adjacents. 
 int Mesh::buildTexCoordSmoothGropus( const float max )
 {
-    return -1;    
+    const int triangles_n= triangleCount();
+    if(triangles_n == 0 || m_texcoords.size() != m_positions.size())
+        return -1;
+    
+#ifdef VERBOSE
+    printf("building texcoord smooth groups...\n");
+#endif
+    
+    std::vector<int> neighbors;
+    std::vector<int> positions_id;
+    buildEdgeNeighbors(neighbors, positions_id);
+    
+    // une arete est lisse si les coordonnees de textures de ses extremites sont les memes (a max pres) dans les 2 triangles
+    const float max2= max * max;
+    std::vector<unsigned char> smooth(3*triangles_n);
+    #pragma omp parallel for
+    for(int e= 0; e < 3*triangles_n; e++)
+    {
+        smooth[e]= 0;
+        const int f= neighbors[e];
+        if(f < 0)
+            continue;
+        
+        const int a= m_indices[e];
+        const int b= m_indices[3*(e / 3) + (e +1) % 3];
+        int fa= m_indices[f];
+        int fb= m_indices[3*(f / 3) + (f +1) % 3];
+        if(positions_id[fa] != positions_id[a])
+            std::swap(fa, fb);
+        
+        smooth[e]= ((m_texcoords[a] - m_texcoords[fa]).LengthSquared() <= max2 
+            && (m_texcoords[b] - m_texcoords[fb]).LengthSquared() <= max2);
+    }
+    
+    const int groups= buildSmoothGroups(neighbors, smooth);
+    splitSmoothGroups();
+    
+#ifdef VERBOSE
+    printf("  %d smooth groups\n", groups);
+#endif
+    
+    return groups;
 }
 
 //! construit les normales du maillage. 
@@ -115,47 +431,767 @@ int Mesh::buildNormals( )
     printf("building normals...\n");
 #endif
     
-    // initialise les normales des sommets
-    m_normals.clear();
-    m_normals.resize(m_positions.size());
+    // etape 1 : construit (ou re-utilise) les listes de triangles incidents aux sommets,
+    // si les indices et les positions n'ont pas ete modifies depuis buildAdjacency().
+    const int positions_n= positionCount();
+    if(adjacencyDirty())
+        buildAdjacency();
+    
+    m_normals.resize(positions_n);
     
-    // etape 1 : accumule les normales des triangles sur chaque sommet de chaque triangle
+    // etape 2 : chaque sommet accumule les normales des triangles incidents, ponderees par l'angle du triangle sur le sommet.
+    // chaque normale n'est ecrite que par un seul thread, pas de synchronisation.
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(int id= 0; id < positions_n; id++)
     {
-        const int n= triangleCount();
-        for(int i=0; i < n; i++)
+        Vector normal;
+        const int end= m_position_adjacency[id +1];
+        for(int i= m_position_adjacency[id]; i < end; i++)
         {
-            // accumule la normale geometrique du triangle sur les normales des 3 sommets
-            const int ai= m_indices[3*i];
-            const int bi= m_indices[3*i +1];
-            const int ci= m_indices[3*i +2];
+            const int triangle= m_adjacency[i];
+            const Point& a= position(m_indices[3*triangle]);
+            const Point& b= position(m_indices[3*triangle +1]);
+            const Point& c= position(m_indices[3*triangle +2]);
+            
+            // normale geometrique du triangle
+            const Vector n= Cross(Vector(a, b), Vector(a, c));
+            const float length= n.Length();
+            if(length == 0.f)
+                continue;       // triangle degenere
             
-            const Point& a= position(ai);
-            const Point& b= position(bi);
-            const Point& c= position(ci);
-            const Vector ab(a, b);
-            const Vector ac(a, c);
-            Normal normal= Normal( Cross(ab, ac) );
+            // aretes du triangle partant du sommet
+            Vector u, v;
+            if(m_indices[3*triangle] == id)
+            {
+                u= Vector(a, b); 
+                v= Vector(a, c);
+            }
+            else if(m_indices[3*triangle +1] == id)
+            {
+                u= Vector(b, c); 
+                v= Vector(b, a);
+            }
+            else
+            {
+                u= Vector(c, a); 
+                v= Vector(c, b);
+            }
+            
+            const float lu= u.Length();
+            const float lv= v.Length();
+            if(lu == 0.f || lv == 0.f)
+                continue;
+            
+            const float cos_angle= std::max(-1.f, std::min(1.f, Dot(u, v) / (lu * lv)));
+            normal+= n * (acosf(cos_angle) / length);
+        }
+        
+        // etape 3 : normalise la normale du sommet
+        const float length= normal.Length();
+        m_normals[id]= (length > 0.f) ? Normal(normal / length) : Normal();
+    }
+    
+    return 0;
+}
 
-            const float length= normal.Length();
-            const float area= .5f * length;
-            // normale ponderee par l'aire du triangle et normalisee
-            const float w= area / length;
-            // a verifier ... w= 0.5 !!
+//! soude les sommets proches.
+int Mesh::weldVertices( const float epsilon )
+{
+    const int positions_n= positionCount();
+    if(positions_n == 0)
+        return 0;
+    
+#ifdef VERBOSE
+    printf("welding vertices...\n");
+#endif
+    
+    const bool has_normals= (m_normals.size() == m_positions.size());
+    const bool has_texcoords= (m_texcoords.size() == m_positions.size());
+    const float epsilon2= epsilon * epsilon;
+    
+    // etape 1 : trouve le representant de chaque sommet, le plus petit indice compatible, deja representant.
+    std::vector<int> remap(positions_n);
+    {
+        SpatialGrid grid(m_positions, 2.f * epsilon);
+        std::vector<int> neighbors;
+        for(int i= 0; i < positions_n; i++)
+        {
+            remap[i]= i;
+            grid.radius(m_positions[i], epsilon, neighbors);
+            
+            const int n= (int) neighbors.size();
+            for(int k= 0; k < n; k++)
+            {
+                const int id= neighbors[k];
+                if(id >= remap[i] || remap[id] != id)
+                    continue;
+                if(has_normals && (m_normals[i] - m_normals[id]).LengthSquared() > epsilon2)
+                    continue;
+                if(has_texcoords && (m_texcoords[i] - m_texcoords[id]).LengthSquared() > epsilon2)
+                    continue;
+                
+                remap[i]= id;
+            }
+        }
+    }
+    
+    // etape 2 : renumerote les representants et compacte les attributs, en place : remap[i] <= i.
+    int count= 0;
+    {
+        std::vector<int> compact(positions_n);
+        for(int i= 0; i < positions_n; i++)
+        {
+            if(remap[i] != i)
+            {
+                compact[i]= compact[remap[i]];
+                continue;
+            }
+            
+            compact[i]= count;
+            m_positions[count]= m_positions[i];
+            if(has_normals)
+                m_normals[count]= m_normals[i];
+            if(has_texcoords)
+                m_texcoords[count]= m_texcoords[i];
+            
+            const int buffers_n= (int) m_attributes_buffer.size();
+            for(int b= 0; b < buffers_n; b++)
+            {
+                MeshBuffer *buffer= m_attributes_buffer[b];
+                if(buffer->count != positions_n)
+                    continue;       // attributs non associes aux sommets
+                for(int k= 0; k < buffer->size; k++)
+                    buffer->data[count * buffer->size + k]= buffer->data[i * buffer->size + k];
+            }
             
-            m_normals[ai]+= normal * w;
-            m_normals[bi]+= normal * w;
-            m_normals[ci]+= normal * w;
+            count++;
         }
+        
+        m_positions.resize(count);
+        if(has_normals)
+            m_normals.resize(count);
+        if(has_texcoords)
+            m_texcoords.resize(count);
+        
+        const int buffers_n= (int) m_attributes_buffer.size();
+        for(int b= 0; b < buffers_n; b++)
+        {
+            MeshBuffer *buffer= m_attributes_buffer[b];
+            if(buffer->count != positions_n)
+                continue;
+            buffer->count= count;
+            buffer->data.resize(count * buffer->size);
+        }
+        
+        const int indices_n= (int) m_indices.size();
+        #pragma omp parallel for
+        for(int i= 0; i < indices_n; i++)
+            m_indices[i]= compact[m_indices[i]];
     }
     
-    // etape 2 : normalise les normales des sommets
+    // etape 3 : supprime les triangles degeneres, et decale les submeshes.
     {
-        const int n= (int) m_normals.size();
+        const int triangles_n= triangleCount();
+        const bool has_groups= ((int) m_smooth_groups.size() == triangles_n);
+        
+        std::vector<int> kept(triangles_n +1);
+        int t= 0;
+        for(int i= 0; i < triangles_n; i++)
+        {
+            kept[i]= t;
+            const int a= m_indices[3*i];
+            const int b= m_indices[3*i +1];
+            const int c= m_indices[3*i +2];
+            if(a == b || b == c || a == c)
+                continue;
+            
+            m_indices[3*t]= a;
+            m_indices[3*t +1]= b;
+            m_indices[3*t +2]= c;
+            m_materials_id[t]= m_materials_id[i];
+            if(has_groups)
+                m_smooth_groups[t]= m_smooth_groups[i];
+            t++;
+        }
+        kept[triangles_n]= t;
+        
+        m_indices.resize(3*t);
+        m_materials_id.resize(t);
+        if(has_groups)
+            m_smooth_groups.resize(t);
+        
+        const int submeshes_n= (int) m_submeshes.size();
+        for(int i= 0; i < submeshes_n; i++)
+        {
+            m_submeshes[i].begin= kept[m_submeshes[i].begin];
+            m_submeshes[i].end= kept[m_submeshes[i].end];
+        }
+    }
+    
+    // les listes d'adjacence et les clusters ne sont plus valides
+    m_position_adjacency.clear();
+    m_adjacency.clear();
+    m_adjacency_dirty= true;
+    m_clusters.clear();
+    m_cluster_vertices.clear();
+    
+    m_bbox.clear();
+    for(int i= 0; i < count; i++)
+        m_bbox.Union(m_positions[i]);
+    
+#ifdef VERBOSE
+    printf("  positions %d -> %d\n", positions_n, count);
+#endif
+    
+    return positions_n - count;
+}
+
+//! renvoie le nombre moyen de sommets transformes par triangle, pour un cache fifo.
+float Mesh::getACMR( const int cache_size ) const
+{
+    const int triangles_n= triangleCount();
+    if(triangles_n == 0)
+        return 0.f;
+    
+    // simule un cache fifo : un sommet est present s'il a ete charge moins de cache_size chargements plus tot.
+    std::vector<int> loaded(positionCount(), -cache_size -1);
+    int time= 0;
+    for(int i= 0; i < 3*triangles_n; i++)
+    {
+        const int v= m_indices[i];
+        if(time - loaded[v] > cache_size)
+            loaded[v]= time++;
+    }
+    
+    return (float) time / (float) triangles_n;
+}
+
+namespace {
+
+//! etat de l'algorithme tipsify, partage par tous les submeshes.
+struct Tipsify
+{
+    const std::vector<int>& indices;
+    const std::vector<int>& offsets;    //!< adjacence sommets / triangles, cf. Mesh::buildAdjacency().
+    const std::vector<int>& adjacency;
+    const int cache_size;
+    
+    std::vector<int> live;              //!< nombre de triangles non emis incidents a chaque sommet.
+    std::vector<int> loaded;            //!< date de chargement des sommets dans le cache.
+    std::vector<unsigned char> emitted; //!< triangles emis, ou hors du submesh.
+    std::vector<int> dead_end;          //!< pile de sommets recemment utilises.
+    int time;
+    
+    Tipsify( const std::vector<int>& _indices, const std::vector<int>& _offsets, const std::vector<int>& _adjacency, const int _cache_size )
+        :
+        indices(_indices), offsets(_offsets), adjacency(_adjacency), cache_size(_cache_size),
+        live(_offsets.size() -1, 0), loaded(_offsets.size() -1, 0), emitted(_indices.size() / 3, 1), 
+        dead_end(), time(_cache_size +1)
+    {}
+    
+    //! choisit le prochain sommet a traiter, parmi les sommets des derniers triangles emis, ou -1 si tous les triangles sont emis.
+    int next( const std::vector<int>& candidates, int& cursor, const int end )
+    {
+        int best= -1;
+        int best_priority= -1;
+        const int n= (int) candidates.size();
         for(int i= 0; i < n; i++)
-            m_normals[i]= Normalize(m_normals[i]);
+        {
+            const int v= candidates[i];
+            if(live[v] == 0)
+                continue;
+            
+            // prefere les sommets qui seront toujours dans le cache apres avoir emis leurs triangles, et les plus anciens.
+            int priority= 0;
+            if(time - loaded[v] + 2 * live[v] <= cache_size)
+                priority= time - loaded[v];
+            if(priority > best_priority)
+            {
+                best_priority= priority;
+                best= v;
+            }
+        }
+        if(best != -1)
+            return best;
+        
+        // impasse : reprend un sommet recent
+        while(!dead_end.empty())
+        {
+            const int v= dead_end.back();
+            dead_end.pop_back();
+            if(live[v] > 0)
+                return v;
+        }
+        
+        // reprend le prochain sommet du submesh dans l'ordre
+        for(; cursor < end; cursor++)
+            if(live[indices[cursor]] > 0)
+                return indices[cursor];
+        
+        return -1;
+    }
+    
+    //! reordonne les triangles [begin .. end) et les ajoute a order. clusters recoit le premier triangle de chaque sequence continue.
+    void run( const int begin, const int end, std::vector<int>& order, std::vector<int>& clusters )
+    {
+        for(int t= begin; t < end; t++)
+        {
+            emitted[t]= 0;
+            for(int k= 0; k < 3; k++)
+                live[indices[3*t + k]]++;
+        }
+        
+        std::vector<int> candidates;
+        int cursor= 3*begin;
+        int v= (begin < end) ? indices[3*begin] : -1;
+        bool jump= true;
+        while(v != -1)
+        {
+            if(jump)
+                clusters.push_back((int) order.size());
+            
+            // emet les triangles incidents au sommet
+            candidates.clear();
+            for(int i= offsets[v]; i < offsets[v +1]; i++)
+            {
+                const int t= adjacency[i];
+                if(emitted[t])
+                    continue;
+                emitted[t]= 1;
+                order.push_back(t);
+                
+                for(int k= 0; k < 3; k++)
+                {
+                    const int u= indices[3*t + k];
+                    dead_end.push_back(u);
+                    candidates.push_back(u);
+                    live[u]--;
+                    if(time - loaded[u] > cache_size)
+                        loaded[u]= time++;
+                }
+            }
+            
+            const int next_v= next(candidates, cursor, 3*end);
+            // le prochain sommet n'est pas un sommet des triangles emis, debut d'une nouvelle sequence
+            jump= (std::find(candidates.begin(), candidates.end(), next_v) == candidates.end());
+            v= next_v;
+        }
+        
+        dead_end.clear();
+    }
+};
+
+}       // namespace
+
+//! reordonne les triangles pour exploiter le cache de sommets transformes.
+int Mesh::optimizeVertexCache( const int cache_size, const bool overdraw )
+{
+    const int triangles_n= triangleCount();
+    if(triangles_n == 0)
+        return -1;
+    
+#ifdef VERBOSE
+    printf("optimizing vertex cache...\n");
+    const float acmr= getACMR(cache_size);
+#endif
+    
+    if(adjacencyDirty())
+        buildAdjacency();
+    
+    // les triangles sont reordonnes a l'interieur de chaque submesh
+    std::vector<SubMesh> ranges= m_submeshes;
+    if(ranges.empty())
+        ranges.push_back( SubMesh(0, triangles_n, 0) );
+    
+    std::vector<int> order;
+    order.reserve(triangles_n);
+    Tipsify tipsify(m_indices, m_position_adjacency, m_adjacency, cache_size);
+    
+    const int ranges_n= (int) ranges.size();
+    for(int r= 0; r < ranges_n; r++)
+    {
+        const int begin= (int) order.size();
+        std::vector<int> clusters;
+        tipsify.run(ranges[r].begin, ranges[r].end, order, clusters);
+        if(!overdraw || clusters.size() < 2)
+            continue;
+        
+        // overdraw : dessine d'abord les sequences orientees vers l'exterieur du submesh, qui cachent les autres.
+        Point center;
+        float area= 0.f;
+        const int clusters_n= (int) clusters.size();
+        clusters.push_back((int) order.size());
+        std::vector<std::pair<float, int> > sort_keys(clusters_n);
+        std::vector<Point> centers(clusters_n);
+        std::vector<Vector> normals(clusters_n);
+        for(int c= 0; c < clusters_n; c++)
+        {
+            float cluster_area= 0.f;
+            for(int i= clusters[c]; i < clusters[c +1]; i++)
+            {
+                const int t= order[i];
+                const Point& a= position(m_indices[3*t]);
+                const Point& b= position(m_indices[3*t +1]);
+                const Point& cc= position(m_indices[3*t +2]);
+                const Vector n= Cross(Vector(a, b), Vector(a, cc));     // 2 * aire * normale
+                const float w= n.Length();
+                
+                centers[c]+= (a + b + cc) * (w / 3.f);
+                normals[c]+= n;
+                cluster_area+= w;
+            }
+            
+            center+= centers[c];
+            area+= cluster_area;
+            if(cluster_area > 0.f)
+                centers[c]= centers[c] / cluster_area;
+        }
+        if(area > 0.f)
+            center= center / area;
+        
+        for(int c= 0; c < clusters_n; c++)
+        {
+            const float length= normals[c].Length();
+            const float d= (length > 0.f) ? Dot(Vector(center, centers[c]), normals[c] / length) : 0.f;
+            sort_keys[c]= std::make_pair(-d, c);
+        }
+        std::stable_sort(sort_keys.begin(), sort_keys.end());
+        
+        std::vector<int> sorted;
+        sorted.reserve(order.size() - begin);
+        for(int c= 0; c < clusters_n; c++)
+        {
+            const int id= sort_keys[c].second;
+            sorted.insert(sorted.end(), order.begin() + clusters[id], order.begin() + clusters[id +1]);
+        }
+        std::copy(sorted.begin(), sorted.end(), order.begin() + begin);
+    }
+    
+    // triangles non couverts par les submeshes, conserves dans l'ordre
+    if((int) order.size() != triangles_n)
+    {
+        std::vector<unsigned char> used(triangles_n, 0);
+        for(int i= 0; i < (int) order.size(); i++)
+            used[order[i]]= 1;
+        for(int i= 0; i < triangles_n; i++)
+            if(used[i] == 0)
+                order.push_back(i);
+    }
+    
+    // permute les triangles et leurs attributs
+    {
+        const bool has_groups= ((int) m_smooth_groups.size() == triangles_n);
+        const std::vector<int> indices= m_indices;
+        const std::vector<int> materials= m_materials_id;
+        const std::vector<int> groups= m_smooth_groups;
+        #pragma omp parallel for
+        for(int i= 0; i < triangles_n; i++)
+        {
+            const int t= order[i];
+            m_indices[3*i]= indices[3*t];
+            m_indices[3*i +1]= indices[3*t +1];
+            m_indices[3*i +2]= indices[3*t +2];
+            m_materials_id[i]= materials[t];
+            if(has_groups)
+                m_smooth_groups[i]= groups[t];
+        }
     }
     
+    // les listes d'adjacence et les clusters ne sont plus valides
+    m_position_adjacency.clear();
+    m_adjacency.clear();
+    m_adjacency_dirty= true;
+    m_clusters.clear();
+    m_cluster_vertices.clear();
+    
+#ifdef VERBOSE
+    printf("  acmr %f -> %f\n", acmr, getACMR(cache_size));
+#endif
+    
+    return 0;
+}
+
+//! renumerote les sommets dans l'ordre de leur premiere utilisation.
+int Mesh::optimizeVertexFetch( )
+{
+    const int positions_n= positionCount();
+    const int indices_n= (int) m_indices.size();
+    
+    // etape 1 : ordre de premiere utilisation, les sommets inutilises sont places a la fin.
+    std::vector<int> remap(positions_n, -1);
+    int count= 0;
+    for(int i= 0; i < indices_n; i++)
+        if(remap[m_indices[i]] == -1)
+            remap[m_indices[i]]= count++;
+    for(int i= 0; i < positions_n; i++)
+        if(remap[i] == -1)
+            remap[i]= count++;
+    
+    // etape 2 : permute les attributs des sommets
+    const bool has_normals= (m_normals.size() == m_positions.size());
+    const bool has_texcoords= (m_texcoords.size() == m_positions.size());
+    {
+        const std::vector<Point> positions= m_positions;
+        #pragma omp parallel for
+        for(int i= 0; i < positions_n; i++)
+            m_positions[remap[i]]= positions[i];
+    }
+    if(has_normals)
+    {
+        const std::vector<Normal> normals= m_normals;
+        #pragma omp parallel for
+        for(int i= 0; i < positions_n; i++)
+            m_normals[remap[i]]= normals[i];
+    }
+    if(has_texcoords)
+    {
+        const std::vector<Point2> texcoords= m_texcoords;
+        #pragma omp parallel for
+        for(int i= 0; i < positions_n; i++)
+            m_texcoords[remap[i]]= texcoords[i];
+    }
+    
+    const int buffers_n= (int) m_attributes_buffer.size();
+    for(int b= 0; b < buffers_n; b++)
+    {
+        MeshBuffer *buffer= m_attributes_buffer[b];
+        if(buffer->count != positions_n)
+            continue;       // attributs non associes aux sommets
+        
+        const std::vector<float> data= buffer->data;
+        const int size= buffer->size;
+        for(int i= 0; i < positions_n; i++)
+            for(int k= 0; k < size; k++)
+                buffer->data[remap[i] * size + k]= data[i * size + k];
+    }
+    
+    // etape 3 : renumerote les indices
+    #pragma omp parallel for
+    for(int i= 0; i < indices_n; i++)
+        m_indices[i]= remap[m_indices[i]];
+    
+    // les listes d'adjacence et les clusters ne sont plus valides
+    m_position_adjacency.clear();
+    m_adjacency.clear();
+    m_adjacency_dirty= true;
+    m_clusters.clear();
+    m_cluster_vertices.clear();
+    
     return 0;
 }
 
+//! decoupe chaque submesh en clusters de triangles voisins.
+int Mesh::buildClusters( const int max_vertices, const int max_triangles )
+{
+    const int triangles_n= triangleCount();
+    m_clusters.clear();
+    m_cluster_vertices.clear();
+    if(triangles_n == 0 || max_vertices < 3 || max_triangles < 1)
+        return -1;
+    
+#ifdef VERBOSE
+    printf("building clusters...\n");
+#endif
+    
+    if(adjacencyDirty())
+        buildAdjacency();
+    
+    std::vector<SubMesh> ranges= m_submeshes;
+    if(ranges.empty())
+        ranges.push_back( SubMesh(0, triangles_n, 0) );
+    
+    // emitted[t] : triangle deja place dans un cluster, ou hors du submesh en cours
+    std::vector<unsigned char> emitted(triangles_n, 1);
+    // stamp[v] : dernier cluster utilisant le sommet v
+    std::vector<int> stamp(positionCount(), -1);
+    std::vector<int> order;
+    order.reserve(triangles_n);
+    std::vector<int> vertices;
+    
+    const int ranges_n= (int) ranges.size();
+    for(int r= 0; r < ranges_n; r++)
+    {
+        const int range_begin= std::max(0, ranges[r].begin);
+        const int range_end= std::min(triangles_n, ranges[r].end);
+        for(int i= range_begin; i < range_end; i++)
+            emitted[i]= 0;
+        
+        int cursor= range_begin;
+        for(;;)
+        {
+            // nouveau cluster, a partir du prochain triangle du submesh
+            while(cursor < range_end && emitted[cursor])
+                cursor++;
+            if(cursor == range_end)
+                break;
+            
+            const int id= (int) m_clusters.size();
+            MeshCluster cluster;
+            cluster.begin= (int) order.size();
+            cluster.submesh_id= m_submeshes.empty() ? -1 : r;
+            cluster.vertex_begin= (int) m_cluster_vertices.size();
+            vertices.clear();
+            
+            int next= cursor;
+            while(next != -1)
+            {
+                // ajoute le triangle au cluster
+                emitted[next]= 1;
+                order.push_back(next);
+                for(int k= 0; k < 3; k++)
+                {
+                    const int v= m_indices[3*next + k];
+                    if(stamp[v] != id)
+                    {
+                        stamp[v]= id;
+                        vertices.push_back(v);
+                    }
+                }
+                
+                if((int) order.size() - cluster.begin == max_triangles)
+                    break;
+                
+                // choisit le triangle voisin ajoutant le moins de sommets au cluster
+                next= -1;
+                int next_cost= 3;
+                const int vertices_n= (int) vertices.size();
+                for(int i= 0; i < vertices_n && next_cost > 0; i++)
+                {
+                    const int v= vertices[i];
+                    for(int j= m_position_adjacency[v]; j < m_position_adjacency[v +1]; j++)
+                    {
+                        const int t= m_adjacency[j];
+                        if(emitted[t])
+                            continue;
+                        
+                        int cost= 0;
+                        for(int k= 0; k < 3; k++)
+                            if(stamp[m_indices[3*t + k]] != id)
+                                cost++;
+                        
+                        if(vertices_n + cost > max_vertices)
+                            continue;
+                        if(cost < next_cost || (cost == next_cost && t < next))
+                        {
+                            next= t;
+                            next_cost= cost;
+                        }
+                    }
+                }
+            }
+            
+            cluster.end= (int) order.size();
+            cluster.vertex_count= (int) vertices.size();
+            m_cluster_vertices.insert(m_cluster_vertices.end(), vertices.begin(), vertices.end());
+            m_clusters.push_back(cluster);
+        }
+    }
+    
+    // triangles non couverts par les submeshes, conserves dans l'ordre
+    if((int) order.size() != triangles_n)
+    {
+        std::vector<unsigned char> used(triangles_n, 0);
+        for(int i= 0; i < (int) order.size(); i++)
+            used[order[i]]= 1;
+        for(int i= 0; i < triangles_n; i++)
+            if(used[i] == 0)
+                order.push_back(i);
+    }
+    
+    // permute les triangles et leurs attributs
+    {
+        const bool has_groups= ((int) m_smooth_groups.size() == triangles_n);
+        const std::vector<int> indices= m_indices;
+        const std::vector<int> materials= m_materials_id;
+        const std::vector<int> groups= m_smooth_groups;
+        #pragma omp parallel for
+        for(int i= 0; i < triangles_n; i++)
+        {
+            const int t= order[i];
+            m_indices[3*i]= indices[3*t];
+            m_indices[3*i +1]= indices[3*t +1];
+            m_indices[3*i +2]= indices[3*t +2];
+            m_materials_id[i]= materials[t];
+            if(has_groups)
+                m_smooth_groups[i]= groups[t];
+        }
+    }
+    m_position_adjacency.clear();
+    m_adjacency.clear();
+    m_adjacency_dirty= true;
+    
+    // sphere englobante et cone des normales de chaque cluster
+    const int clusters_n= (int) m_clusters.size();
+    #pragma omp parallel for schedule(dynamic, 16)
+    for(int c= 0; c < clusters_n; c++)
+    {
+        MeshCluster& cluster= m_clusters[c];
+        
+        BBox bbox;
+        for(int i= 0; i < cluster.vertex_count; i++)
+            bbox.Union(m_positions[m_cluster_vertices[cluster.vertex_begin + i]]);
+        cluster.center= (bbox.pMin + bbox.pMax) * .5f;
+        
+        float radius2= 0.f;
+        for(int i= 0; i < cluster.vertex_count; i++)
+            radius2= std::max(radius2, DistanceSquared(cluster.center, m_positions[m_cluster_vertices[cluster.vertex_begin + i]]));
+        cluster.radius= sqrtf(radius2);
+        
+        // axe du cone : moyenne des normales, ouverture : normale la plus eloignee de l'axe
+        Vector axis;
+        for(int t= cluster.begin; t < cluster.end; t++)
+        {
+            const Normal n= getTriangleNormal(t);
+            axis+= Vector(n.x, n.y, n.z);
+        }
+        
+        cluster.cone_cutoff= 1.f;
+        const float length= axis.Length();
+        if(length == 0.f)
+            continue;
+        cluster.cone_axis= axis / length;
+        
+        float min_dot= 1.f;
+        for(int t= cluster.begin; t < cluster.end; t++)
+        {
+            const Normal n= getTriangleNormal(t);
+            if(n.x != 0.f || n.y != 0.f || n.z != 0.f)     // ignore les triangles degeneres
+                min_dot= std::min(min_dot, Dot(cluster.cone_axis, Vector(n.x, n.y, n.z)));
+        }
+        
+        // cone trop ouvert (> ~85 degres), le test n'eliminerait rien
+        if(min_dot > .1f)
+            cluster.cone_cutoff= sqrtf(1.f - min_dot * min_dot);
+    }
+    
+#ifdef VERBOSE
+    printf("  %d clusters, %.1f triangles / cluster\n", clusters_n, (float) triangles_n / (float) clusters_n);
+#endif
+    
+    return clusters_n;
+}
+
+size_t Mesh::memoryUsage( ) const
+{
+    size_t size= sizeof(Mesh)
+        + m_positions.capacity() * sizeof(Point)
+        + m_normals.capacity() * sizeof(Normal)
+        + m_texcoords.capacity() * sizeof(Point2)
+        + m_indices.capacity() * sizeof(int)
+        + m_materials_id.capacity() * sizeof(int)
+        + m_smooth_groups.capacity() * sizeof(int)
+        + m_position_adjacency.capacity() * sizeof(int)
+        + m_adjacency.capacity() * sizeof(int)
+        + m_submeshes.capacity() * sizeof(SubMesh)
+        + m_clusters.capacity() * sizeof(MeshCluster)
+        + m_cluster_vertices.capacity() * sizeof(int)
+        + m_materials.capacity() * sizeof(MeshMaterial *);
+    
+    const int n= (int) m_attributes_buffer.size();
+    for(int i= 0; i < n; i++)
+        size+= sizeof(MeshBuffer) + m_attributes_buffer[i]->data.capacity() * sizeof(float);
+    
+    return size;
+}
+
 }
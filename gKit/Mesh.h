@@ -11,6 +11,7 @@
 #include "IOResource.h"
 #include "MeshMaterial.h"
 #include "Geometry.h"
+#include "Transform.h"
 #include "Triangle.h"
 #include "PNTriangle.h"
 #include "Name.h"
@@ -45,6 +46,60 @@ struct SubMesh
     ~SubMesh( ) {}
 };
 
+//! representation d'un groupe de triangles voisins (meshlet), au plus MAX_VERTICES sommets et MAX_TRIANGLES triangles d'un meme submesh.
+//! les triangles du cluster sont contigus dans le maillage, cf. Mesh::buildClusters().
+struct MeshCluster
+{
+    enum 
+    { 
+        MAX_VERTICES= 64, 
+        MAX_TRIANGLES= 124 
+    };
+    
+    int begin;          //!< premier triangle du cluster.
+    int end;            //!< dernier triangle du cluster, exclu.
+    int submesh_id;     //!< indice du submesh contenant le cluster.
+    int vertex_begin;   //!< premier sommet du cluster dans Mesh::clusterVertices().
+    int vertex_count;   //!< nombre de sommets du cluster.
+    
+    Point center;       //!< centre de la sphere englobante.
+    float radius;       //!< rayon de la sphere englobante.
+    
+    Vector cone_axis;   //!< direction moyenne des normales des triangles.
+    float cone_cutoff;  //!< sinus de l'angle d'ouverture du cone des normales, 1 si le cone ne permet pas d'eliminer le cluster.
+    
+    //! constructeur par defaut.
+    MeshCluster( )
+        :
+        begin(0), end(0), submesh_id(0), vertex_begin(0), vertex_count(0),
+        center(), radius(0.f), cone_axis(), cone_cutoff(1.f)
+    {}
+    
+    //! renvoie vrai si tous les triangles du cluster sont orientes a l'oppose de l'observateur, place en eye (meme repere que le maillage).
+    bool isBackfacing( const Point& eye ) const
+    {
+        const Vector d(eye, center);
+        return (Dot(d, cone_axis) >= cone_cutoff * d.Length() + radius);
+    }
+    
+    //! renvoie vrai si la sphere englobante du cluster est (au moins en partie) dans le frustum de la transformation mvp (repere local vers projectif).
+    bool isVisible( const Transform& mvp ) const
+    {
+        // plans du frustum : ligne 3 +/- ligne i de la matrice
+        const Matrix4x4& m= mvp.matrix();
+        for(int i= 0; i < 3; i++)
+            for(int s= -1; s <= 1; s+= 2)
+            {
+                const Vector n(m.m[3][0] + s * m.m[i][0], m.m[3][1] + s * m.m[i][1], m.m[3][2] + s * m.m[i][2]);
+                const float d= m.m[3][3] + s * m.m[i][3];
+                if(Dot(n, Vector(center)) + d < -radius * n.Length())
+                    return false;
+            }
+        
+        return true;
+    }
+};
+
 //! representation d'un ensemble d'attributs generiques des sommets du maillage. equivalent a un GLBuffer.
 struct MeshBuffer
 {
@@ -68,13 +123,24 @@ struct MeshBuffer
         count(0), size(_size)
     {}
     
+    //! reserve la place pour n attributs supplementaires.
+    void reserve( const int n )
+    {
+        data.reserve(data.size() + n * size);
+    }
+    
     //! insertion d'un attribut generique.
     void push( const float *attribute )
     {
         count++;
-        
-        for(int i= 0; i < size; i++)
-            data.push_back(attribute[i]);
+        data.insert(data.end(), attribute, attribute + size);
+    }
+    
+    //! insertion de n attributs generiques.
+    void push( const int n, const float *attributes )
+    {
+        count+= n;
+        data.insert(data.end(), attributes, attributes + n * size);
     }
     
     //! insertion d'un attribut point 2d.
@@ -136,6 +202,8 @@ struct MeshBuffer
 
 
 class MeshIO;
+class Mesh;
+int MeshLoadFromGK( const std::string& filename, Mesh *mesh );
 
 //! representation d'un maillage triangule.
 
@@ -145,6 +213,7 @@ class MeshIO;
 class Mesh : public IOResource
 {
     friend class MeshIO;
+    friend int MeshLoadFromGK( const std::string& filename, Mesh *mesh );
     
     std::vector<Point> m_positions;
     std::vector<Normal> m_normals;
@@ -155,10 +224,13 @@ class Mesh : public IOResource
 
     std::vector<int> m_smooth_groups;   //!< triangles.size()
 
-    std::vector<int> m_position_adjacency;        //!< positions.size(), premier element de la liste d'adjacence du sommet.
-    std::vector<int> m_adjacency;       //!< 2* positions.size() ? liste globale m_adjacency[m_position_adjacency[id]] .. -1
+    std::vector<int> m_position_adjacency;        //!< positions.size() +1, premier element de la liste d'adjacence du sommet.
+    std::vector<int> m_adjacency;       //!< 3* triangles.size(), liste globale m_adjacency[m_position_adjacency[id]] .. m_adjacency[m_position_adjacency[id +1]] (exclu)
+    bool m_adjacency_dirty;     //!< topologie (indices, sommets) modifiee depuis buildAdjacency(), deplacer les sommets ne change pas l'adjacence.
 
     std::vector<SubMesh> m_submeshes;
+    std::vector<MeshCluster> m_clusters;        //!< cf. buildClusters().
+    std::vector<int> m_cluster_vertices;        //!< sommets de chaque cluster, m_cluster_vertices[cluster.vertex_begin] ..
     
     std::vector<MeshMaterial *> m_materials;
     MeshMaterial m_default_material;
@@ -167,6 +239,23 @@ class Mesh : public IOResource
 
     BBox m_bbox;
 
+    //! construit les paires d'aretes partagees par 2 triangles, cf. buildNormalSmoothGroups().
+    int buildEdgeNeighbors( std::vector<int>& neighbors, std::vector<int>& positions_id ) const;
+    
+    //! construit les smooth groups, triangles connectes par des aretes lisses. renvoie le nombre de groupes.
+    int buildSmoothGroups( const std::vector<int>& neighbors, const std::vector<unsigned char>& smooth );
+    
+    //! duplique les sommets partages par plusieurs smooth groups. renvoie le nombre de sommets crees.
+    int splitSmoothGroups( );
+    
+    //! vrai si les listes d'adjacence doivent etre reconstruites, cf. buildAdjacency().
+    bool adjacencyDirty( ) const
+    {
+        return m_adjacency_dirty
+            || (int) m_position_adjacency.size() != positionCount() +1
+            || m_position_adjacency.back() != (int) m_indices.size();
+    }
+
     //! renvoie la position d'un sommet.
     Point& position( const int id )
     {
@@ -221,6 +310,7 @@ public:
     //! constructeur par defaut.
     Mesh( ) 
         :
+        m_adjacency_dirty(true),
         m_default_material("default")
     {}
     
@@ -232,6 +322,9 @@ public:
             delete m_attributes_buffer[i];
     }
     
+    //! renvoie la memoire utilisee par le maillage, les matieres appartiennent a MeshMaterialIO.
+    size_t memoryUsage( ) const;
+    
     //! ajoute un sommet.
     void pushPosition( const Point& point )
     {
@@ -242,12 +335,14 @@ public:
     //! ajoute un ensemble de sommets.
     void attachPositionBuffer( const std::vector<Point>& positions )
     {
+        m_adjacency_dirty= true;
         m_positions= positions;
     }
 
     //! ajoute un ensemble de sommets.
     void attachPositionBuffer( const int n, const Point *positions )
     {
+        m_adjacency_dirty= true;
         m_positions= std::vector<Point>(&positions[0], &positions[n]);
     }
 
@@ -258,6 +353,7 @@ public:
     }
     
     //! renvoie les positions des sommets du maillage. 
+    //! deplacer les sommets ne modifie pas les listes d'adjacence, cf. buildAdjacency() et buildNormals().
     //~ const std::vector<Point>& positions( )
     std::vector<Point>& positions( )
     {
@@ -365,6 +461,7 @@ public:
             return -1;
         
         const int n= (int) attributes.size();
+        buffer->reserve(n);
         for(int i= 0; i < n; i++)
             buffer->push(attributes[i]);
         return 0;
@@ -378,6 +475,7 @@ public:
         if(buffer == NULL)
             return -1;
         
+        buffer->reserve(n);
         for(int i= 0; i < n; i++)
             buffer->push(attributes[i]);
         return 0;
@@ -487,6 +585,7 @@ public:
     //! ajoute un triangle
     void pushTriangle( const int a, const int b, const int c, const int material_id, const int smooth_group= -1 )
     {
+        m_adjacency_dirty= true;
         m_indices.push_back(a);
         m_indices.push_back(b);
         m_indices.push_back(c);
@@ -518,10 +617,11 @@ public:
         return (int) m_indices.size();
     }
     
-    //! renvoie les indices du maillage.
+    //! renvoie les indices du maillage, les listes d'adjacence seront reconstruites, cf. buildAdjacency().
     //~ const std::vector<int>& indices( )
     std::vector<int>& indices( )
     {
+        m_adjacency_dirty= true;
         return m_indices;
     }
     
@@ -575,6 +675,30 @@ public:
         return m_submeshes;
     }
     
+    //! renvoie le nombre de clusters, cf. buildClusters().
+    int clusterCount( ) const
+    {
+        return (int) m_clusters.size();
+    }
+    
+    //! renvoie un cluster.
+    const MeshCluster& cluster( const int id ) const
+    {
+        return m_clusters[id];
+    }
+    
+    //! renvoie les clusters du maillage.
+    const std::vector<MeshCluster>& clusters( ) const
+    {
+        return m_clusters;
+    }
+    
+    //! renvoie les sommets des clusters, cf. MeshCluster::vertex_begin.
+    const std::vector<int>& clusterVertices( ) const
+    {
+        return m_cluster_vertices;
+    }
+    
     int pushDefaultMaterial( )
     {
         m_materials.push_back(&m_default_material);
@@ -771,15 +895,55 @@ public:
     //! construit la liste d'adjacence des sommets (liste de triangles).
     int buildAdjacency( );
     
+    //! renvoie le nombre de triangles incidents a un sommet, cf. buildAdjacency().
+    int adjacentTriangleCount( const int id ) const
+    {
+        return m_position_adjacency[id +1] - m_position_adjacency[id];
+    }
+    
+    //! renvoie l'indice du ieme triangle incident a un sommet, cf. buildAdjacency().
+    int adjacentTriangle( const int id, const int i ) const
+    {
+        return m_adjacency[m_position_adjacency[id] + i];
+    }
+    
     //! construit les smooth groups en fonction de l'angle entre les normales des triangles adjacents.
+    //! les triangles voisins appartiennent au meme groupe si l'angle (en degres) entre leurs normales est inferieur a max_angle.
+    //! les sommets partages par plusieurs groupes sont dupliques, buildNormals() calcule ensuite une normale par groupe.
+    //! renvoie le nombre de groupes, ou -1 en cas d'erreur.
     int buildNormalSmoothGroups( const float max_angle );
     
     //! construit les smooth groups en fonction de la distance entre les coordonnees de textures des triangles adjacents. 
+    //! les triangles voisins appartiennent au meme groupe si les coordonnees de textures de l'arete commune sont identiques, a max pres.
+    //! les sommets partages par plusieurs groupes sont dupliques.
+    //! renvoie le nombre de groupes, ou -1 en cas d'erreur.
     int buildTexCoordSmoothGropus( const float max );
     
-    //! construit les normales du maillage. 
+    //! construit les normales du maillage, moyenne des normales des triangles incidents ponderees par leur angle sur le sommet.
+    //! re-utilise les listes d'adjacence si elles sont a jour, cf. buildAdjacency().
     //! \todo utiliser les smooth groups s'ils sont presents.
     int buildNormals( );
+    
+    //! renvoie le nombre moyen de sommets transformes par triangle (ACMR) pour un cache fifo de cache_size sommets.
+    //! 0.5 pour un maillage regulier ideal, 3 dans le pire cas.
+    float getACMR( const int cache_size= 16 ) const;
+    
+    //! reordonne les triangles de chaque submesh pour exploiter le cache de sommets transformes, cf. tipsify.
+    //! si overdraw est vrai, les sequences de triangles orientees vers l'exterieur du submesh sont dessinees en premier.
+    //! affiche l'ACMR avant et apres optimisation, si VERBOSE est defini.
+    int optimizeVertexCache( const int cache_size= 16, const bool overdraw= true );
+    
+    //! renumerote les sommets dans l'ordre de leur premiere utilisation par les triangles, a utiliser apres optimizeVertexCache().
+    int optimizeVertexFetch( );
+    
+    //! decoupe chaque submesh en clusters de triangles voisins, au plus max_vertices sommets et max_triangles triangles par cluster.
+    //! les triangles sont reordonnes pour que chaque cluster soit une sequence contigue, les submeshes ne changent pas.
+    //! renvoie le nombre de clusters.
+    int buildClusters( const int max_vertices= MeshCluster::MAX_VERTICES, const int max_triangles= MeshCluster::MAX_TRIANGLES );
+    
+    //! soude les sommets a une distance <= epsilon, et dont les normales et coordonnees de textures sont identiques (a epsilon pres).
+    //! les triangles degeneres apres soudure sont supprimes. renvoie le nombre de sommets supprimes.
+    int weldVertices( const float epsilon );
 };
 
 } // namespace
@@ -0,0 +1,534 @@
+
+#include <algorithm>
+#include <cstring>
+
+#include "MeshCodec.h"
+
+
+namespace gk {
+
+namespace {
+
+//! ecrit un entier 32 bits, little endian.
+void writeInt( std::vector<unsigned char>& out, const unsigned int v )
+{
+    out.push_back(v & 0xff);
+    out.push_back((v >> 8) & 0xff);
+    out.push_back((v >> 16) & 0xff);
+    out.push_back((v >> 24) & 0xff);
+}
+
+//! lit un entier 32 bits, little endian.
+unsigned int readInt( const unsigned char *p )
+{
+    return (unsigned int) p[0] | ((unsigned int) p[1] << 8) | ((unsigned int) p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+//! ecrit un entier de taille variable, 7 bits par octet.
+void writeVarint( std::vector<unsigned char>& out, unsigned int v )
+{
+    while(v >= 128)
+    {
+        out.push_back((v & 127) | 128);
+        v= v >> 7;
+    }
+    out.push_back(v);
+}
+
+//! lit un entier de taille variable. renvoie -1 si les donnees sont tronquees.
+int readVarint( const unsigned char *& p, const unsigned char *end, unsigned int& v )
+{
+    v= 0;
+    for(int shift= 0; shift < 35; shift+= 7)
+    {
+        if(p == end)
+            return -1;
+        
+        const unsigned int b= *p++;
+        v|= (b & 127) << shift;
+        if((b & 128) == 0)
+            return 0;
+    }
+    
+    return -1;
+}
+
+//! entrelace les valeurs positives et negatives : 0, -1, 1, -2, 2, etc.
+unsigned int zigzag( const int v )
+{
+    return ((unsigned int) v << 1) ^ (unsigned int) (v >> 31);
+}
+
+int unzigzag( const unsigned int v )
+{
+    return (int) (v >> 1) ^ -(int) (v & 1);
+}
+
+unsigned char zigzag8( const unsigned char v )
+{
+    return (unsigned char) ((v << 1) ^ ((signed char) v >> 7));
+}
+
+unsigned char unzigzag8( const unsigned char v )
+{
+    return (unsigned char) ((v >> 1) ^ -(v & 1));
+}
+
+
+//! etat partage par le codeur et le decodeur d'indices : aretes et sommets recents, prochain sommet jamais utilise.
+struct IndexFifo
+{
+    enum
+    {
+        EDGE_MAX= 15,   //!< aretes referencables par un code, le code 15 indique un triangle sans arete partagee.
+        VERTEX_MAX= 14  //!< sommets referencables par un code, 0 : prochain sommet, 15 : delta explicite.
+    };
+    
+    int edges[16][2];
+    int vertices[16];
+    unsigned int edge_head;
+    unsigned int vertex_head;
+    int next;
+    int last;
+    
+    IndexFifo( )
+        :
+        edge_head(0), vertex_head(0), 
+        next(0), last(0)
+    {
+        for(int i= 0; i < 16; i++)
+        {
+            edges[i][0]= -1;
+            edges[i][1]= -1;
+            vertices[i]= -1;
+        }
+    }
+    
+    void pushEdge( const int a, const int b )
+    {
+        int *e= edges[edge_head & 15];
+        e[0]= a;
+        e[1]= b;
+        edge_head++;
+    }
+    
+    //! renvoie une arete, 0 pour la plus recente.
+    const int *edge( const int i ) const
+    {
+        return edges[(edge_head - 1 - i) & 15];
+    }
+    
+    int findEdge( const int a, const int b ) const
+    {
+        for(int i= 0; i < EDGE_MAX; i++)
+        {
+            const int *e= edge(i);
+            if(e[0] == a && e[1] == b)
+                return i;
+        }
+        return -1;
+    }
+    
+    void pushVertex( const int v )
+    {
+        vertices[vertex_head & 15]= v;
+        vertex_head++;
+    }
+    
+    //! renvoie un sommet, 0 pour le plus recent.
+    int vertex( const int i ) const
+    {
+        return vertices[(vertex_head - 1 - i) & 15];
+    }
+    
+    int findVertex( const int v ) const
+    {
+        for(int i= 0; i < VERTEX_MAX; i++)
+            if(vertex(i) == v)
+                return i;
+        return -1;
+    }
+};
+
+
+//! nombre de sommets par bloc, multiple de 16, ~8Ko par bloc.
+int vertexBlockSize( const int stride )
+{
+    return std::max(16, (8192 / stride) & ~15);
+}
+
+//! compresse un bloc de n sommets.
+void encodeVertexBlock( const unsigned char *vertices, const int n, const int stride, std::vector<unsigned char>& out )
+{
+    const int groups= (n + 15) / 16;
+    std::vector<unsigned char> plane(groups * 16, 0);
+    
+    for(int k= 0; k < stride; k++)
+    {
+        // transpose et code les differences
+        unsigned char previous= 0;
+        for(int i= 0; i < n; i++)
+        {
+            const unsigned char v= vertices[i * stride + k];
+            plane[i]= zigzag8(v - previous);
+            previous= v;
+        }
+        
+        // 2 bits par groupe : nombre de bits des valeurs du groupe, 0, 2, 4 ou 8
+        const unsigned int header= out.size();
+        out.resize(out.size() + (groups + 3) / 4, 0);
+        for(int g= 0; g < groups; g++)
+        {
+            const unsigned char *p= &plane[g * 16];
+            unsigned char bits= 0;
+            for(int i= 0; i < 16; i++)
+                bits|= p[i];
+            
+            int mode= 3;
+            if(bits == 0)
+                mode= 0;
+            else if(bits < 4)
+                mode= 1;
+            else if(bits < 16)
+                mode= 2;
+            out[header + g / 4]|= mode << ((g % 4) * 2);
+            
+            if(mode == 1)
+                for(int i= 0; i < 16; i+= 4)
+                    out.push_back(p[i] | (p[i +1] << 2) | (p[i +2] << 4) | (p[i +3] << 6));
+            else if(mode == 2)
+                for(int i= 0; i < 16; i+= 2)
+                    out.push_back(p[i] | (p[i +1] << 4));
+            else if(mode == 3)
+                out.insert(out.end(), p, p + 16);
+        }
+    }
+}
+
+//! decompresse un bloc de n sommets. renvoie -1 si les donnees sont tronquees.
+int decodeVertexBlock( const unsigned char *data, const unsigned char *end, unsigned char *vertices, const int n, const int stride )
+{
+    const int groups= (n + 15) / 16;
+    const int header_size= (groups + 3) / 4;
+    static const int group_size[4]= { 0, 4, 8, 16 };
+    
+    for(int k= 0; k < stride; k++)
+    {
+        if(end - data < header_size)
+            return -1;
+        const unsigned char *header= data;
+        data+= header_size;
+        
+        unsigned char previous= 0;
+        for(int g= 0; g < groups; g++)
+        {
+            const int mode= (header[g / 4] >> ((g % 4) * 2)) & 3;
+            if(end - data < group_size[mode])
+                return -1;
+            
+            unsigned char p[16];
+            if(mode == 0)
+                memset(p, 0, 16);
+            else if(mode == 1)
+                for(int i= 0; i < 4; i++)
+                {
+                    const unsigned char b= data[i];
+                    p[4*i]= b & 3;
+                    p[4*i +1]= (b >> 2) & 3;
+                    p[4*i +2]= (b >> 4) & 3;
+                    p[4*i +3]= b >> 6;
+                }
+            else if(mode == 2)
+                for(int i= 0; i < 8; i++)
+                {
+                    const unsigned char b= data[i];
+                    p[2*i]= b & 15;
+                    p[2*i +1]= b >> 4;
+                }
+            else
+                memcpy(p, data, 16);
+            data+= group_size[mode];
+            
+            const int count= std::min(16, n - g * 16);
+            unsigned char *v= vertices + g * 16 * stride + k;
+            for(int i= 0; i < count; i++, v+= stride)
+            {
+                previous+= unzigzag8(p[i]);
+                *v= previous;
+            }
+        }
+    }
+    
+    return 0;
+}
+
+}       // namespace
+
+
+int EncodeIndexBuffer( const int *indices, const int index_count, std::vector<unsigned char>& out )
+{
+    out.clear();
+    if(index_count % 3 != 0)
+        return -1;
+    
+    const int triangles= index_count / 3;
+    writeInt(out, triangles);
+    const unsigned int codes= out.size();
+    out.resize(out.size() + triangles);
+    
+    IndexFifo fifo;
+    for(int t= 0; t < triangles; t++)
+    {
+        const int *triangle= indices + 3*t;
+        
+        // recherche une arete partagee avec un triangle recent, orientee dans l'autre sens
+        int edge= -1;
+        int rotation= 0;
+        for(int r= 0; r < 3; r++)
+        {
+            const int e= fifo.findEdge(triangle[(r +1) % 3], triangle[r]);
+            if(e >= 0 && (edge < 0 || e < edge))
+            {
+                edge= e;
+                rotation= r;
+            }
+        }
+        
+        if(edge >= 0)
+        {
+            const int a= triangle[rotation];
+            const int b= triangle[(rotation +1) % 3];
+            const int c= triangle[(rotation +2) % 3];
+            
+            int code;
+            if(c == fifo.next)
+            {
+                code= 0;
+                fifo.next++;
+                fifo.pushVertex(c);
+            }
+            else
+            {
+                const int v= fifo.findVertex(c);
+                if(v >= 0)
+                    code= v + 1;
+                else
+                {
+                    code= 15;
+                    writeVarint(out, zigzag(c - fifo.last));
+                    fifo.last= c;
+                    fifo.pushVertex(c);
+                }
+            }
+            
+            out[codes + t]= (unsigned char) ((edge << 4) | code);
+            fifo.pushEdge(b, c);
+            fifo.pushEdge(c, a);
+        }
+        else
+        {
+            // pas d'arete partagee : 1 bit par sommet, prochain sommet ou delta explicite
+            int code= 0;
+            for(int i= 0; i < 3; i++)
+            {
+                const int v= triangle[i];
+                if(v == fifo.next)
+                {
+                    code|= 1 << i;
+                    fifo.next++;
+                }
+                else
+                {
+                    writeVarint(out, zigzag(v - fifo.last));
+                    fifo.last= v;
+                }
+                fifo.pushVertex(v);
+            }
+            
+            out[codes + t]= (unsigned char) (0xf0 | code);
+            fifo.pushEdge(triangle[0], triangle[1]);
+            fifo.pushEdge(triangle[1], triangle[2]);
+            fifo.pushEdge(triangle[2], triangle[0]);
+        }
+    }
+    
+    return 0;
+}
+
+int DecodeIndexBuffer( const unsigned char *data, const size_t size, std::vector<int>& indices )
+{
+    indices.clear();
+    if(size < 4)
+        return -1;
+    
+    const unsigned int triangles= readInt(data);
+    if(triangles > size - 4)
+        return -1;
+    
+    const unsigned char *codes= data + 4;
+    const unsigned char *p= codes + triangles;
+    const unsigned char *end= data + size;
+    
+    indices.resize(3 * triangles);
+    IndexFifo fifo;
+    for(unsigned int t= 0; t < triangles; t++)
+    {
+        int *triangle= &indices[3*t];
+        const int code= codes[t];
+        const int edge= code >> 4;
+        
+        if(edge != 15)
+        {
+            const int *e= fifo.edge(edge);
+            const int a= e[1];
+            const int b= e[0];
+            
+            int c;
+            const int v= code & 15;
+            if(v == 0)
+            {
+                c= fifo.next++;
+                fifo.pushVertex(c);
+            }
+            else if(v < 15)
+                c= fifo.vertex(v - 1);
+            else
+            {
+                unsigned int delta;
+                if(readVarint(p, end, delta) < 0)
+                    return -1;
+                c= fifo.last + unzigzag(delta);
+                fifo.last= c;
+                fifo.pushVertex(c);
+            }
+            
+            if(a < 0 || b < 0 || c < 0)
+                return -1;
+            
+            triangle[0]= a;
+            triangle[1]= b;
+            triangle[2]= c;
+            fifo.pushEdge(b, c);
+            fifo.pushEdge(c, a);
+        }
+        else
+        {
+            for(int i= 0; i < 3; i++)
+            {
+                int v;
+                if(code & (1 << i))
+                    v= fifo.next++;
+                else
+                {
+                    unsigned int delta;
+                    if(readVarint(p, end, delta) < 0)
+                        return -1;
+                    v= fifo.last + unzigzag(delta);
+                    fifo.last= v;
+                }
+                
+                if(v < 0)
+                    return -1;
+                triangle[i]= v;
+                fifo.pushVertex(v);
+            }
+            
+            fifo.pushEdge(triangle[0], triangle[1]);
+            fifo.pushEdge(triangle[1], triangle[2]);
+            fifo.pushEdge(triangle[2], triangle[0]);
+        }
+    }
+    
+    return 0;
+}
+
+
+int EncodeVertexBuffer( const void *vertices, const int count, const int stride, std::vector<unsigned char>& out )
+{
+    out.clear();
+    if(stride < 1 || stride > 256 || count < 0)
+        return -1;
+    
+    const int block_size= vertexBlockSize(stride);
+    const int blocks= (count + block_size - 1) / block_size;
+    
+    // compresse les blocs en parallele
+    std::vector<std::vector<unsigned char> > encoded(blocks);
+    #pragma omp parallel for schedule(dynamic, 16)
+    for(int b= 0; b < blocks; b++)
+    {
+        const int begin= b * block_size;
+        const int n= std::min(block_size, count - begin);
+        encodeVertexBlock((const unsigned char *) vertices + (size_t) begin * stride, n, stride, encoded[b]);
+    }
+    
+    // entete : nombre de sommets, taille, nombre de blocs et taille de chaque bloc
+    writeInt(out, count);
+    writeInt(out, stride);
+    writeInt(out, blocks);
+    size_t length= out.size() + 4 * blocks;
+    for(int b= 0; b < blocks; b++)
+    {
+        writeInt(out, encoded[b].size());
+        length+= encoded[b].size();
+    }
+    
+    out.reserve(length);
+    for(int b= 0; b < blocks; b++)
+        out.insert(out.end(), encoded[b].begin(), encoded[b].end());
+    
+    return 0;
+}
+
+int VertexBufferInfo( const unsigned char *data, const size_t size, int& count, int& stride )
+{
+    if(size < 12)
+        return -1;
+    
+    count= (int) readInt(data);
+    stride= (int) readInt(data + 4);
+    if(count < 0 || stride < 1 || stride > 256)
+        return -1;
+    return 0;
+}
+
+int DecodeVertexBuffer( const unsigned char *data, const size_t size, void *vertices, const int count, const int stride )
+{
+    int data_count, data_stride;
+    if(VertexBufferInfo(data, size, data_count, data_stride) < 0)
+        return -1;
+    if(data_count != count || data_stride != stride)
+        return -1;
+    
+    const int block_size= vertexBlockSize(stride);
+    const int blocks= (int) readInt(data + 8);
+    if(blocks != (count + block_size - 1) / block_size)
+        return -1;
+    if((size - 12) / 4 < (size_t) blocks)
+        return -1;
+    
+    // position de chaque bloc
+    std::vector<size_t> offsets(blocks + 1);
+    offsets[0]= 12 + 4 * (size_t) blocks;
+    for(int b= 0; b < blocks; b++)
+    {
+        offsets[b + 1]= offsets[b] + readInt(data + 12 + 4 * b);
+        if(offsets[b + 1] > size)
+            return -1;
+    }
+    
+    // decompresse les blocs en parallele
+    int errors= 0;
+    #pragma omp parallel for schedule(dynamic, 16) reduction(+: errors)
+    for(int b= 0; b < blocks; b++)
+    {
+        const int begin= b * block_size;
+        const int n= std::min(block_size, count - begin);
+        if(decodeVertexBlock(data + offsets[b], data + offsets[b + 1], (unsigned char *) vertices + (size_t) begin * stride, n, stride) < 0)
+            errors++;
+    }
+    
+    return (errors > 0) ? -1 : 0;
+}
+
+}       // namespace
@@ -0,0 +1,41 @@
+#ifndef _GK_MESH_CODEC_H
+#define _GK_MESH_CODEC_H
+
+#include <vector>
+#include <cstddef>
+
+
+namespace gk {
+
+//! compression des indices d'un maillage triangule.
+//! chaque triangle est code par un octet : l'arete partagee avec un triangle recent (fifo de 16 aretes) et le 3ieme sommet, 
+//! soit le prochain sommet jamais utilise, soit un sommet recent (fifo de 16 sommets), soit un delta explicite (varint).
+//! les triangles restent dans le meme ordre mais leurs sommets peuvent etre permutes circulairement (l'orientation est conservee).
+//! la compression est tres efficace apres Mesh::optimizeVertexCache() et Mesh::optimizeVertexFetch().
+//! taux obtenus : ~1.7 octets par triangle sur une grille reguliere optimisee, ~3 octets sur un maillage non optimise
+//! (3.2 sur les modeles de test), ~6 octets si les triangles sont dans un ordre aleatoire. l'octet de code est le minimum,
+//! les deltas explicites (varint) des sommets hors fifo font le reste.
+//! \return -1 si index_count n'est pas un multiple de 3, 0 sinon.
+int EncodeIndexBuffer( const int *indices, const int index_count, std::vector<unsigned char>& out );
+
+//! decompression des indices d'un maillage, cf. EncodeIndexBuffer().
+//! \return -1 si les donnees sont incoherentes ou tronquees, 0 sinon.
+int DecodeIndexBuffer( const unsigned char *data, const size_t size, std::vector<int>& indices );
+
+//! compression sans perte d'un ensemble de sommets de 'stride' octets.
+//! les sommets sont decoupes en blocs independants (compresses / decompresses en parallele). dans chaque bloc, 
+//! les octets de meme rang sont regroupes (transposition), codes par difference avec le sommet precedent, 
+//! puis ranges par groupes de 16 sur 0, 2, 4 ou 8 bits.
+//! \return -1 si stride n'est pas compris entre 1 et 256, 0 sinon.
+int EncodeVertexBuffer( const void *vertices, const int count, const int stride, std::vector<unsigned char>& out );
+
+//! renvoie le nombre de sommets et leur taille, sans decompresser le buffer. renvoie -1 si les donnees sont incoherentes.
+int VertexBufferInfo( const unsigned char *data, const size_t size, int& count, int& stride );
+
+//! decompression d'un ensemble de sommets, cf. EncodeVertexBuffer(). 'vertices' doit pouvoir stocker count * stride octets.
+//! \return -1 si les donnees sont incoherentes ou tronquees ou si count et stride ne correspondent pas, 0 sinon.
+int DecodeVertexBuffer( const unsigned char *data, const size_t size, void *vertices, const int count, const int stride );
+
+}       // namespace
+
+#endif
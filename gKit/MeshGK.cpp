@@ -0,0 +1,435 @@
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Geometry.h"
+#include "MeshMaterial.h"
+#include "MeshMaterialIO.h"
+#include "Mesh.h"
+#include "MeshGK.h"
+#include "MeshCodec.h"
+
+
+namespace gk {
+
+bool isMeshGK( const std::string& filename )
+{
+    const char *pos= strrchr(filename.c_str(), '.');
+    if(pos == NULL)
+        return false;
+    return (strcmp(pos, ".gkmesh") == 0);
+}
+
+namespace {
+
+const char magic[8]= { 'g', 'k', 'm', 'e', 's', 'h', '0', '1' };
+
+//! renvoie l'adresse du premier element, ou NULL si le tableau est vide.
+template < class T >
+T *data( std::vector<T>& v )
+{
+    return v.empty() ? NULL : &v.front();
+}
+
+template < class T >
+const T *data( const std::vector<T>& v )
+{
+    return v.empty() ? NULL : &v.front();
+}
+
+//! construction du fichier en memoire.
+struct Writer
+{
+    std::vector<unsigned char> data;
+    
+    void write( const void *p, const size_t size )
+    {
+        data.insert(data.end(), (const unsigned char *) p, (const unsigned char *) p + size);
+    }
+    
+    void writeInt( const int v )
+    {
+        write(&v, sizeof(v));
+    }
+    
+    void writeFloat( const float v )
+    {
+        write(&v, sizeof(v));
+    }
+    
+    void writeColor( const Color& color )
+    {
+        write(&color[0], 4 * sizeof(float));
+    }
+    
+    void writeString( const std::string& string )
+    {
+        writeInt((int) string.size());
+        write(string.data(), string.size());
+    }
+    
+    //! ecrit un bloc compresse, precede de sa taille.
+    void writeStream( const std::vector<unsigned char>& stream )
+    {
+        writeInt((int) stream.size());
+        if(stream.empty() == false)
+            write(&stream.front(), stream.size());
+    }
+    
+    //! compresse et ecrit un ensemble de sommets.
+    void writeVertices( const void *vertices, const int count, const int stride )
+    {
+        std::vector<unsigned char> stream;
+        EncodeVertexBuffer(vertices, count, stride, stream);
+        writeStream(stream);
+    }
+};
+
+//! lecture du fichier en memoire, 'error' est vrai si les donnees sont tronquees.
+struct Reader
+{
+    const unsigned char *p;
+    const unsigned char *end;
+    bool error;
+    
+    Reader( const unsigned char *begin, const size_t size )
+        :
+        p(begin), end(begin + size), error(false)
+    {}
+    
+    void read( void *v, const size_t size )
+    {
+        if(error || (size_t) (end - p) < size)
+        {
+            error= true;
+            memset(v, 0, size);
+            return;
+        }
+        
+        memcpy(v, p, size);
+        p+= size;
+    }
+    
+    int readInt( )
+    {
+        int v;
+        read(&v, sizeof(v));
+        return v;
+    }
+    
+    float readFloat( )
+    {
+        float v;
+        read(&v, sizeof(v));
+        return v;
+    }
+    
+    Color readColor( )
+    {
+        Color color;
+        read(&color[0], 4 * sizeof(float));
+        return color;
+    }
+    
+    std::string readString( )
+    {
+        const int size= readInt();
+        if(error || size < 0 || end - p < size)
+        {
+            error= true;
+            return std::string();
+        }
+        
+        std::string string((const char *) p, size);
+        p+= size;
+        return string;
+    }
+    
+    //! vrai si le reste du fichier peut contenir 'bytes' octets.
+    bool available( const double bytes ) const
+    {
+        return (bytes <= (double) (end - p));
+    }
+    
+    //! renvoie un bloc compresse, NULL si les donnees sont tronquees.
+    const unsigned char *readStream( size_t& size )
+    {
+        const int length= readInt();
+        if(error || length < 0 || end - p < length)
+        {
+            error= true;
+            size= 0;
+            return NULL;
+        }
+        
+        const unsigned char *stream= p;
+        size= length;
+        p+= length;
+        return stream;
+    }
+    
+    //! decompresse un ensemble de sommets.
+    int readVertices( void *vertices, const int count, const int stride )
+    {
+        size_t size;
+        const unsigned char *stream= readStream(size);
+        if(stream == NULL || DecodeVertexBuffer(stream, size, vertices, count, stride) < 0)
+        {
+            error= true;
+            return -1;
+        }
+        return 0;
+    }
+};
+
+}       // namespace
+
+
+int MeshWriteToGK( const Mesh *mesh, const std::string& filename )
+{
+    if(mesh == NULL)
+        return -1;
+    
+    const std::vector<Point>& positions= mesh->positions();
+    const std::vector<Normal>& normals= mesh->normals();
+    const std::vector<Point2>& texcoords= mesh->texCoords();
+    const std::vector<int>& indices= mesh->indices();
+    const std::vector<int>& materials_id= mesh->triangleMaterialsId();
+    const std::vector<int>& smooth_groups= mesh->smoothGroups();
+    const std::vector<SubMesh>& submeshes= mesh->subMeshes();
+    const std::vector<MeshMaterial *>& materials= mesh->materials();
+    
+    Writer out;
+    out.write(magic, sizeof(magic));
+    out.writeInt((int) positions.size());
+    out.writeInt((int) normals.size());
+    out.writeInt((int) texcoords.size());
+    out.writeInt(mesh->triangleCount());
+    out.writeInt((int) submeshes.size());
+    out.writeInt((int) materials.size());
+    out.writeInt(mesh->bufferCount());
+    
+    const BBox& bbox= mesh->getBBox();
+    out.write(&bbox.pMin.x, 3 * sizeof(float));
+    out.write(&bbox.pMax.x, 3 * sizeof(float));
+    
+    // attributs des sommets
+    out.writeVertices(data(positions), (int) positions.size(), sizeof(Point));
+    if(normals.empty() == false)
+        out.writeVertices(data(normals), (int) normals.size(), sizeof(Normal));
+    if(texcoords.empty() == false)
+        out.writeVertices(data(texcoords), (int) texcoords.size(), sizeof(Point2));
+    
+    // triangles
+    std::vector<unsigned char> stream;
+    if(EncodeIndexBuffer(data(indices), (int) indices.size(), stream) < 0)
+        return -1;
+    out.writeStream(stream);
+    out.writeVertices(data(materials_id), (int) materials_id.size(), sizeof(int));
+    out.writeVertices(data(smooth_groups), (int) smooth_groups.size(), sizeof(int));
+    
+    for(unsigned int i= 0; i < submeshes.size(); i++)
+    {
+        out.writeInt(submeshes[i].begin);
+        out.writeInt(submeshes[i].end);
+        out.writeInt(submeshes[i].material_id);
+    }
+    
+    for(unsigned int i= 0; i < materials.size(); i++)
+    {
+        const MeshMaterial *material= materials[i];
+        out.writeString(material->name);
+        out.writeString(material->diffuse_texture);
+        out.writeString(material->glossy_texture);
+        out.writeFloat(material->kd);
+        out.writeFloat(material->ks);
+        out.writeFloat(material->n);
+        out.writeFloat(material->ni);
+        out.writeColor(material->diffuse);
+        out.writeColor(material->specular);
+        out.writeColor(material->transmission);
+        out.writeColor(material->emission);
+    }
+    
+    // attributs generiques
+    for(int i= 0; i < mesh->bufferCount(); i++)
+    {
+        const MeshBuffer *buffer= mesh->buffer(i);
+        out.writeString(buffer->semantic.c_str());
+        out.writeInt(buffer->size);
+        out.writeInt(buffer->count);
+        out.writeVertices(data(buffer->data), buffer->count, buffer->size * sizeof(float));
+    }
+    
+    FILE *file= fopen(filename.c_str(), "wb");
+    if(file == NULL)
+    {
+        printf("MeshWriteToGK( ): '%s' failed.\n", filename.c_str());
+        return -1;
+    }
+    
+    const size_t written= fwrite(&out.data.front(), 1, out.data.size(), file);
+    fclose(file);
+    if(written != out.data.size())
+    {
+        printf("MeshWriteToGK( ): '%s' failed.\n", filename.c_str());
+        return -1;
+    }
+    
+    return 0;
+}
+
+int MeshLoadFromGK( const std::string& filename, Mesh *mesh )
+{
+    if(mesh == NULL)
+        return -1;
+    
+    FILE *file= fopen(filename.c_str(), "rb");
+    if(file == NULL)
+    {
+        printf("MeshLoadFromGK( ): '%s' failed.\n", filename.c_str());
+        return -1;
+    }
+    
+    // charge le fichier complet en une seule lecture
+    fseek(file, 0, SEEK_END);
+    const long int length= ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<unsigned char> content(length > 0 ? length : 0);
+    const size_t size= content.empty() ? 0 : fread(&content.front(), 1, content.size(), file);
+    fclose(file);
+    
+    Reader in(data(content), size);
+    char header[sizeof(magic)];
+    in.read(header, sizeof(header));
+    if(in.error || memcmp(header, magic, sizeof(magic)) != 0)
+    {
+        printf("MeshLoadFromGK( ): '%s' is not a gkmesh file.\n", filename.c_str());
+        return -1;
+    }
+    
+    const int position_count= in.readInt();
+    const int normal_count= in.readInt();
+    const int texcoord_count= in.readInt();
+    const int triangle_count= in.readInt();
+    const int submesh_count= in.readInt();
+    const int material_count= in.readInt();
+    const int buffer_count= in.readInt();
+    if(in.error || position_count < 0 || normal_count < 0 || texcoord_count < 0 
+    || triangle_count < 0 || submesh_count < 0 || material_count < 0 || buffer_count < 0)
+    {
+        printf("MeshLoadFromGK( ): '%s' is corrupted.\n", filename.c_str());
+        return -1;
+    }
+    
+    // verifie les tailles avant d'allouer : un sommet compresse occupe au moins 1/64 de sa taille, cf. EncodeVertexBuffer(),
+    // un triangle au moins 1 octet, cf. EncodeIndexBuffer().
+    if(!in.available((double) position_count * sizeof(Point) / 64 
+        + (double) normal_count * sizeof(Normal) / 64 
+        + (double) texcoord_count * sizeof(Point2) / 64 
+        + (double) triangle_count 
+        + (double) submesh_count * 3 * sizeof(int)))
+    {
+        printf("MeshLoadFromGK( ): '%s' is corrupted.\n", filename.c_str());
+        return -1;
+    }
+    
+    BBox& bbox= mesh->bbox();
+    in.read(&bbox.pMin.x, 3 * sizeof(float));
+    in.read(&bbox.pMax.x, 3 * sizeof(float));
+    
+    // attributs des sommets, decompresses directement dans le maillage
+    mesh->m_positions.resize(position_count);
+    in.readVertices(data(mesh->m_positions), position_count, sizeof(Point));
+    mesh->m_normals.resize(normal_count);
+    if(normal_count > 0)
+        in.readVertices(data(mesh->m_normals), normal_count, sizeof(Normal));
+    mesh->m_texcoords.resize(texcoord_count);
+    if(texcoord_count > 0)
+        in.readVertices(data(mesh->m_texcoords), texcoord_count, sizeof(Point2));
+    
+    // triangles
+    size_t stream_size;
+    const unsigned char *stream= in.readStream(stream_size);
+    if(stream == NULL || DecodeIndexBuffer(stream, stream_size, mesh->m_indices) < 0 
+    || (int) mesh->m_indices.size() != 3 * triangle_count)
+        in.error= true;
+    for(int i= 0; i < (int) mesh->m_indices.size() && in.error == false; i++)
+        if(mesh->m_indices[i] >= position_count)
+            in.error= true;     // DecodeIndexBuffer() ne renvoie pas d'indices negatifs
+    
+    mesh->m_materials_id.resize(triangle_count);
+    in.readVertices(data(mesh->m_materials_id), triangle_count, sizeof(int));
+    for(int i= 0; i < triangle_count && in.error == false; i++)
+        if(mesh->m_materials_id[i] < -1 || mesh->m_materials_id[i] >= material_count)
+            in.error= true;
+    mesh->m_smooth_groups.resize(triangle_count);
+    in.readVertices(data(mesh->m_smooth_groups), triangle_count, sizeof(int));
+    
+    // submeshes : intervalles de triangles
+    for(int i= 0; i < submesh_count && in.error == false; i++)
+    {
+        const int begin= in.readInt();
+        const int end= in.readInt();
+        const int material_id= in.readInt();
+        if(begin < 0 || begin > end || end > triangle_count || material_id < -1 || material_id >= material_count)
+            in.error= true;
+        else
+            mesh->pushSubMesh(begin, end, material_id);
+    }
+    
+    // matieres, referencees par le manager
+    std::vector<MeshMaterial *> materials;
+    for(int i= 0; i < material_count && in.error == false; i++)
+    {
+        const std::string name= in.readString();
+        MeshMaterial *material= new MeshMaterial(name);
+        material->diffuse_texture= in.readString();
+        material->glossy_texture= in.readString();
+        material->kd= in.readFloat();
+        material->ks= in.readFloat();
+        material->n= in.readFloat();
+        material->ni= in.readFloat();
+        material->diffuse= in.readColor();
+        material->specular= in.readColor();
+        material->transmission= in.readColor();
+        material->emission= in.readColor();
+        
+        // reutilise la matiere si le fichier a deja ete charge, insert() detruit alors la nouvelle matiere
+        material= MeshMaterialIO::manager().insert(material, filename, name);
+        materials.push_back(material);
+    }
+    mesh->setMaterials(materials);
+    
+    // attributs generiques
+    for(int i= 0; i < buffer_count && in.error == false; i++)
+    {
+        const std::string semantic= in.readString();
+        const int buffer_size= in.readInt();
+        const int count= in.readInt();
+        if(in.error || buffer_size < 1 || buffer_size > 4 || count < 0 
+        || !in.available((double) count * buffer_size * sizeof(float) / 64))
+        {
+            in.error= true;
+            break;
+        }
+        
+        MeshBuffer *buffer= new MeshBuffer(semantic, buffer_size);
+        mesh->m_attributes_buffer.push_back(buffer);
+        buffer->count= count;
+        buffer->data.resize(count * buffer_size);
+        in.readVertices(data(buffer->data), count, buffer_size * sizeof(float));
+    }
+    
+    if(in.error)
+    {
+        printf("MeshLoadFromGK( ): '%s' is corrupted.\n", filename.c_str());
+        return -1;
+    }
+    
+    return 0;
+}
+
+}       // namespace
@@ -0,0 +1,24 @@
+
+#ifndef _MESHGK_H
+#define _MESHGK_H
+
+#include <string>
+
+namespace gk {
+
+class Mesh;
+//! renvoie vrai si 'filename' se termine par '.gkmesh'.
+bool isMeshGK( const std::string& filename );
+
+//! charge un maillage enregistre par MeshWriteToGK().
+int MeshLoadFromGK( const std::string& filename, Mesh *mesh );
+
+//! enregistre un maillage au format .gkmesh : cache binaire compresse, plus petit que le .obj et beaucoup plus rapide a charger.
+//! positions, normales, coordonnees de texture, attributs generiques, identifiants de matieres et smooth groups sont compresses 
+//! sans perte par EncodeVertexBuffer(), les indices par EncodeIndexBuffer() (les sommets des triangles peuvent etre permutes circulairement).
+//! les matieres sont enregistrees completement et referencees par MeshMaterialIO lors du chargement.
+int MeshWriteToGK( const Mesh *mesh, const std::string& filename );
+
+}
+
+#endif
@@ -6,9 +6,7 @@
 
 #include "Mesh.h"
 #include "MeshOBJ.h"
-
-//~ #include "MeshGK.h"
-#define NO_MESHGK
+#include "MeshGK.h"
 
 namespace gk {
 
@@ -37,8 +35,30 @@ public:
         if(mesh != NULL)
             return mesh;
         
+        // reference le mesh avec le manager
+        return manager().insert(decode(filename), filename, name);
+    }
+    
+    //! importe l'objet 'name' du fichier 'filename' et renvoie le mesh, reference par un IOHandle, cf. IOManager::setBudget().
+    static
+    IOHandle<Mesh> readHandle( const std::string& filename, const std::string& name= "" )
+    {
+        Mesh *mesh= manager().findAndAcquire(filename, name);
+        if(mesh == NULL)
+            mesh= manager().insertAndAcquire(decode(filename), filename, name);
+        
+        IOHandle<Mesh> handle;
+        handle.adopt(manager(), mesh);
+        return handle;
+    }
+    
+    //! importe le fichier 'filename' sans referencer le mesh dans le manager, cf. AsyncIO.
+    //! les matieres sont referencees par MeshMaterialIO : un seul thread a la fois.
+    static
+    Mesh *decode( const std::string& filename )
+    {
         // importer le fichier
-        mesh= new Mesh;
+        Mesh *mesh= new Mesh;
         if(isMeshOBJ(filename) && MeshLoadFromOBJ(filename, mesh) < 0)
         {
             printf("'%s' failed.\n", filename.c_str());
@@ -55,8 +75,7 @@ public:
         }
     #endif
         
-        // reference le mesh avec le manager
-        return manager().insert(mesh, filename, name);
+        return mesh;
     }
 
 #ifndef NO_MESHGK
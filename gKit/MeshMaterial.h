@@ -41,6 +41,9 @@ struct MeshMaterial : public IOResource
         name(_name)
     {}
     
+    // les matieres ne sont pas comptabilisees, cf. IOResource::memoryUsage() : les maillages les utilisent sans IOHandle,
+    // elles ne doivent pas etre detruites pour respecter le budget de MeshMaterialIO.
+    
     //! destructeur.
     ~MeshMaterial( ) {}
 };
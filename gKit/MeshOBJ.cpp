@@ -430,7 +430,7 @@ int MaterialLoadFromMTL( const std::string& filename )
             {
                 // la matiere n'existe pas, la creer
                 material = new MeshMaterial( parser.getToken() );
-                MeshMaterialIO::manager().insert( material, filename, parser.getToken() );
+                material = MeshMaterialIO::manager().insert( material, filename, parser.getToken() );
             }
             
             continue;
@@ -534,7 +534,7 @@ int MeshLoadFromOBJ( const std::string& filename, Mesh *mesh )
     if ( default_material == NULL )
     {
         default_material = new MeshMaterial( "gk_default_material" );
-        MeshMaterialIO::manager().insert( default_material, "", default_material->name );
+        default_material = MeshMaterialIO::manager().insert( default_material, "", "gk_default_material" );
     }
     
     typedef std::map<std::string, int> smooth_map_type;
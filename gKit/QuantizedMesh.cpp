@@ -0,0 +1,360 @@
+
+#include <algorithm>
+#include <cmath>
+
+#include "QuantizedMesh.h"
+#include "BufferManager.h"
+#include "Half.h"
+#include "SIMD.h"
+
+
+namespace gk {
+
+namespace {
+
+//! renvoie le facteur d'echelle de quantification d'un axe de la boite englobante.
+float quantizeScale( const float extent )
+{
+    return (extent > 0.f) ? 65535.f / extent : 0.f;
+}
+
+//! quantifie une coordonnee sur [0 65535].
+unsigned short quantize( const float x, const float origin, const float scale )
+{
+    const float q= (x - origin) * scale + .5f;
+    if(q <= 0.f)
+        return 0;
+    if(q >= 65535.f)
+        return 65535;
+    return (unsigned short) q;
+}
+
+//! encode une normale, projection sur l'octaedre puis repliement de la moitie inferieure.
+void encodeOctahedral( const Normal& n, short& ex, short& ey )
+{
+    const float s= std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if(s == 0.f)
+    {
+        ex= 0;
+        ey= 0;
+        return;
+    }
+    
+    float x= n.x / s;
+    float y= n.y / s;
+    if(n.z < 0.f)
+    {
+        const float fx= (1.f - std::fabs(y)) * (x >= 0.f ? 1.f : -1.f);
+        const float fy= (1.f - std::fabs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x= fx;
+        y= fy;
+    }
+    
+    ex= (short) std::floor(std::min(1.f, std::max(-1.f, x)) * 32767.f + .5f);
+    ey= (short) std::floor(std::min(1.f, std::max(-1.f, y)) * 32767.f + .5f);
+}
+
+//! decode une normale.
+Normal decodeOctahedral( const short ex, const short ey )
+{
+    float x= std::max(-1.f, (float) ex / 32767.f);
+    float y= std::max(-1.f, (float) ey / 32767.f);
+    const float z= 1.f - std::fabs(x) - std::fabs(y);
+    const float t= std::max(-z, 0.f);
+    x+= (x >= 0.f) ? -t : t;
+    y+= (y >= 0.f) ? -t : t;
+    
+    const float length= std::sqrt(x*x + y*y + z*z);
+    return Normal(x / length, y / length, z / length);
+}
+
+#ifdef GK_SSE
+//! quantifie 4 coordonnees sur [0 65535].
+inline
+__m128i quantize4( const __m128 x, const float origin, const float scale )
+{
+    const __m128 q= _mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, _mm_set1_ps(origin)), _mm_set1_ps(scale)), _mm_set1_ps(.5f));
+    return _mm_cvttps_epi32(_mm_min_ps(_mm_set1_ps(65535.f), _mm_max_ps(_mm_setzero_ps(), q)));
+}
+
+//! convertit 4 entiers 32 bits sur [0 65535] en entiers 16 bits non signes, sans sse4.1 : decale, sature et restaure le signe.
+inline
+__m128i packu16( const __m128i a, const __m128i b )
+{
+    const __m128i bias= _mm_set1_epi32(32768);
+    return _mm_xor_si128(
+        _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias)), 
+        _mm_set1_epi16((short) 0x8000) );
+}
+#endif
+
+}       // namespace
+
+
+void QuantizePositions( const int n, const Point *positions, const BBox& bbox, unsigned short *out )
+{
+    const Vector extent(bbox.pMin, bbox.pMax);
+    const float scale[3]= { quantizeScale(extent.x), quantizeScale(extent.y), quantizeScale(extent.z) };
+    
+    int blocks= 0;
+#ifdef GK_SSE
+    blocks= n / 4;
+    #pragma omp parallel for if(blocks > 16384)
+    for(int b= 0; b < blocks; b++)
+    {
+        __m128 x, y, z;
+        load3x4(&positions[4*b].x, x, y, z);
+        
+        const __m128i qx= quantize4(x, bbox.pMin.x, scale[0]);
+        const __m128i qy= quantize4(y, bbox.pMin.y, scale[1]);
+        const __m128i qz= quantize4(z, bbox.pMin.z, scale[2]);
+        
+        // entrelace x y z 0
+        const __m128i xy= packu16(qx, qy);                              // x0 x1 x2 x3 y0 y1 y2 y3
+        const __m128i zw= packu16(qz, _mm_setzero_si128());             // z0 z1 z2 z3 0 0 0 0
+        const __m128i xy01= _mm_unpacklo_epi16(xy, _mm_srli_si128(xy, 8));     // x0 y0 x1 y1 x2 y2 x3 y3
+        const __m128i zw01= _mm_unpacklo_epi16(zw, _mm_srli_si128(zw, 8));     // z0 0 z1 0 z2 0 z3 0
+        _mm_storeu_si128((__m128i *) (out + 16*b), _mm_unpacklo_epi32(xy01, zw01));
+        _mm_storeu_si128((__m128i *) (out + 16*b + 8), _mm_unpackhi_epi32(xy01, zw01));
+    }
+#endif
+    
+    for(int i= blocks * 4; i < n; i++)
+    {
+        out[4*i]= quantize(positions[i].x, bbox.pMin.x, scale[0]);
+        out[4*i +1]= quantize(positions[i].y, bbox.pMin.y, scale[1]);
+        out[4*i +2]= quantize(positions[i].z, bbox.pMin.z, scale[2]);
+        out[4*i +3]= 0;
+    }
+}
+
+void DequantizePositions( const int n, const unsigned short *in, const BBox& bbox, Point *positions )
+{
+    const Vector extent(bbox.pMin, bbox.pMax);
+    const float scale[3]= { extent.x / 65535.f, extent.y / 65535.f, extent.z / 65535.f };
+    
+    int blocks= 0;
+#ifdef GK_SSE
+    blocks= n / 4;
+    #pragma omp parallel for if(blocks > 16384)
+    for(int b= 0; b < blocks; b++)
+    {
+        const __m128i zero= _mm_setzero_si128();
+        const __m128i a= _mm_loadu_si128((const __m128i *) (in + 16*b));        // x0 y0 z0 0 x1 y1 z1 0
+        const __m128i c= _mm_loadu_si128((const __m128i *) (in + 16*b + 8));    // x2 y2 z2 0 x3 y3 z3 0
+        
+        // separe les composantes
+        const __m128i ac_lo= _mm_unpacklo_epi16(a, c);          // x0 x2 y0 y2 z0 z2 0 0
+        const __m128i ac_hi= _mm_unpackhi_epi16(a, c);          // x1 x3 y1 y3 z1 z3 0 0
+        const __m128i xy= _mm_unpacklo_epi16(ac_lo, ac_hi);     // x0 x1 x2 x3 y0 y1 y2 y3
+        const __m128i zw= _mm_unpackhi_epi16(ac_lo, ac_hi);     // z0 z1 z2 z3 0 0 0 0
+        
+        const __m128 x= _mm_add_ps(_mm_set1_ps(bbox.pMin.x), 
+            _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(xy, zero)), _mm_set1_ps(scale[0])));
+        const __m128 y= _mm_add_ps(_mm_set1_ps(bbox.pMin.y), 
+            _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(xy, zero)), _mm_set1_ps(scale[1])));
+        const __m128 z= _mm_add_ps(_mm_set1_ps(bbox.pMin.z), 
+            _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zw, zero)), _mm_set1_ps(scale[2])));
+        store3x4(&positions[4*b].x, x, y, z);
+    }
+#endif
+    
+    for(int i= blocks * 4; i < n; i++)
+        positions[i]= Point(
+            bbox.pMin.x + (float) in[4*i] * scale[0], 
+            bbox.pMin.y + (float) in[4*i +1] * scale[1], 
+            bbox.pMin.z + (float) in[4*i +2] * scale[2]);
+}
+
+void EncodeOctahedral( const int n, const Normal *normals, short *out )
+{
+    int blocks= 0;
+#ifdef GK_SSE
+    blocks= n / 4;
+    #pragma omp parallel for if(blocks > 16384)
+    for(int b= 0; b < blocks; b++)
+    {
+        __m128 x, y, z;
+        load3x4(&normals[4*b].x, x, y, z);
+        
+        // projection sur l'octaedre |x| + |y| + |z| = 1
+        const __m128 s= _mm_add_ps(_mm_add_ps(abs4(x), abs4(y)), abs4(z));
+        const __m128 valid= _mm_cmpgt_ps(s, _mm_setzero_ps());
+        const __m128 inv= _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.f), s));
+        x= _mm_mul_ps(x, inv);
+        y= _mm_mul_ps(y, inv);
+        
+        // replie la moitie z < 0
+        const __m128 one= _mm_set1_ps(1.f);
+        const __m128 fx= _mm_mul_ps(_mm_sub_ps(one, abs4(y)), _mm_or_ps(one, sign4(x)));
+        const __m128 fy= _mm_mul_ps(_mm_sub_ps(one, abs4(x)), _mm_or_ps(one, sign4(y)));
+        const __m128 lower= _mm_and_ps(valid, _mm_cmplt_ps(z, _mm_setzero_ps()));
+        x= select4(lower, fx, x);
+        y= select4(lower, fy, y);
+        
+        const __m128 scale= _mm_set1_ps(32767.f);
+        const __m128i ex= _mm_cvtps_epi32(_mm_mul_ps(x, scale));
+        const __m128i ey= _mm_cvtps_epi32(_mm_mul_ps(y, scale));
+        
+        const __m128i exy= _mm_packs_epi32(ex, ey);     // x0 x1 x2 x3 y0 y1 y2 y3
+        _mm_storeu_si128((__m128i *) (out + 8*b), _mm_unpacklo_epi16(exy, _mm_srli_si128(exy, 8)));
+    }
+#endif
+    
+    for(int i= blocks * 4; i < n; i++)
+        encodeOctahedral(normals[i], out[2*i], out[2*i +1]);
+}
+
+void DecodeOctahedral( const int n, const short *in, Normal *normals )
+{
+    int blocks= 0;
+#ifdef GK_SSE
+    blocks= n / 4;
+    #pragma omp parallel for if(blocks > 16384)
+    for(int b= 0; b < blocks; b++)
+    {
+        // x dans les 16 bits de poids faible, y dans les 16 bits de poids fort, etend le signe
+        const __m128i e= _mm_loadu_si128((const __m128i *) (in + 8*b));
+        const __m128 scale= _mm_set1_ps(1.f / 32767.f);
+        const __m128 minus_one= _mm_set1_ps(-1.f);
+        __m128 x= _mm_max_ps(minus_one, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(e, 16), 16)), scale));
+        __m128 y= _mm_max_ps(minus_one, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(e, 16)), scale));
+        
+        const __m128 z= _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.f), abs4(x)), abs4(y));
+        const __m128 t= _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+        x= _mm_sub_ps(x, _mm_or_ps(t, sign4(x)));
+        y= _mm_sub_ps(y, _mm_or_ps(t, sign4(y)));
+        
+        const __m128 inv= _mm_div_ps(_mm_set1_ps(1.f), 
+            _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+        store3x4(&normals[4*b].x, _mm_mul_ps(x, inv), _mm_mul_ps(y, inv), _mm_mul_ps(z, inv));
+    }
+#endif
+    
+    for(int i= blocks * 4; i < n; i++)
+        normals[i]= decodeOctahedral(in[2*i], in[2*i +1]);
+}
+
+
+int QuantizedMesh::build( const Mesh& mesh )
+{
+    m_positions.clear();
+    m_normals.clear();
+    m_texcoords.clear();
+    m_buffers.clear();
+    m_bbox= BBox();
+    
+    const std::vector<Point>& positions= mesh.positions();
+    const int n= (int) positions.size();
+    if(n == 0)
+        return -1;
+    
+    // recalcule la boite englobante, attachPositionBuffer() ne la met pas a jour
+    for(int i= 0; i < n; i++)
+        m_bbox.Union(positions[i]);
+    
+    m_positions.resize(4 * n);
+    QuantizePositions(n, &positions.front(), m_bbox, &m_positions.front());
+    
+    const std::vector<Normal>& normals= mesh.normals();
+    if(normals.empty() == false)
+    {
+        m_normals.resize(2 * normals.size());
+        EncodeOctahedral((int) normals.size(), &normals.front(), &m_normals.front());
+    }
+    
+    const std::vector<Point2>& texcoords= mesh.texCoords();
+    if(texcoords.empty() == false)
+    {
+        m_texcoords.resize(2 * texcoords.size());
+        FloatToHalf(2 * (int) texcoords.size(), &texcoords.front().x, &m_texcoords.front());
+    }
+    
+    const int count= mesh.bufferCount();
+    m_buffers.resize(count);
+    for(int i= 0; i < count; i++)
+    {
+        const MeshBuffer *buffer= mesh.buffer(i);
+        QuantizedBuffer& quantized= m_buffers[i];
+        quantized.semantic= buffer->semantic;
+        quantized.count= buffer->count;
+        quantized.size= buffer->size;
+        quantized.data.resize(buffer->data.size());
+        if(buffer->data.empty() == false)
+            FloatToHalf((int) buffer->data.size(), &buffer->data.front(), &quantized.data.front());
+    }
+    
+    return 0;
+}
+
+int QuantizedMesh::decode( std::vector<Point>& positions, std::vector<Normal>& normals, std::vector<Point2>& texcoords ) const
+{
+    positions.resize(positionCount());
+    if(positions.empty() == false)
+        DequantizePositions((int) positions.size(), &m_positions.front(), m_bbox, &positions.front());
+    
+    normals.resize(normalCount());
+    if(normals.empty() == false)
+        DecodeOctahedral((int) normals.size(), &m_normals.front(), &normals.front());
+    
+    texcoords.resize(texcoordCount());
+    if(texcoords.empty() == false)
+        HalfToFloat((int) m_texcoords.size(), &m_texcoords.front(), &texcoords.front().x);
+    
+    return 0;
+}
+
+Transform QuantizedMesh::positionTransform( ) const
+{
+    // les attributs normalises sont lus sur [0 1] par les shaders
+    const Vector extent(m_bbox.pMin, m_bbox.pMax);
+    return Translate(Vector(m_bbox.pMin.x, m_bbox.pMin.y, m_bbox.pMin.z)) 
+        * Scale(extent.x > 0.f ? extent.x : 1.f, extent.y > 0.f ? extent.y : 1.f, extent.z > 0.f ? extent.z : 1.f);
+}
+
+unsigned int QuantizedMesh::size( ) const
+{
+    unsigned int length= m_positions.size() * sizeof(unsigned short) 
+        + m_normals.size() * sizeof(short) 
+        + m_texcoords.size() * sizeof(unsigned short);
+    for(unsigned int i= 0; i < m_buffers.size(); i++)
+        length+= m_buffers[i].data.size() * sizeof(unsigned short);
+    return length;
+}
+
+GLAttributeBuffer *QuantizedMesh::createPositionBuffer( const GLenum usage ) const
+{
+    if(m_positions.empty())
+        return NULL;
+    return createAttributeBuffer(positionCount(), m_positions.size() * sizeof(unsigned short), &m_positions.front(), usage);
+}
+
+GLAttributeBuffer *QuantizedMesh::createNormalBuffer( const GLenum usage ) const
+{
+    if(m_normals.empty())
+        return NULL;
+    return createAttributeBuffer(normalCount(), m_normals.size() * sizeof(short), &m_normals.front(), usage);
+}
+
+GLAttributeBuffer *QuantizedMesh::createTexCoordBuffer( const GLenum usage ) const
+{
+    if(m_texcoords.empty())
+        return NULL;
+    return createAttributeBuffer(texcoordCount(), m_texcoords.size() * sizeof(unsigned short), &m_texcoords.front(), usage);
+}
+
+GLAttributeBuffer *QuantizedMesh::createBuffer( const Name& semantic, const GLenum usage ) const
+{
+    for(unsigned int i= 0; i < m_buffers.size(); i++)
+        if(m_buffers[i].semantic == semantic)
+        {
+            if(m_buffers[i].data.empty())
+                return NULL;
+            return createAttributeBuffer(m_buffers[i].count, m_buffers[i].data.size() * sizeof(unsigned short), 
+                &m_buffers[i].data.front(), usage);
+        }
+    
+    return NULL;
+}
+
+}       // namespace
@@ -0,0 +1,183 @@
+#ifndef _GK_QUANTIZED_MESH_H
+#define _GK_QUANTIZED_MESH_H
+
+#include <vector>
+
+#include "Geometry.h"
+#include "Transform.h"
+#include "Mesh.h"
+#include "Name.h"
+#include "GL/GLPlatform.h"
+#include "GL/TPAttributes.h"
+#include "GL/TPBuffer.h"
+
+
+namespace gk {
+
+//! quantifie n positions sur 16 bits, relativement a une boite englobante. 
+//! 4 composantes par position : x, y, z, 0 (alignement des sommets sur 8 octets).
+void QuantizePositions( const int n, const Point *positions, const BBox& bbox, unsigned short *out );
+//! operation inverse de QuantizePositions().
+void DequantizePositions( const int n, const unsigned short *in, const BBox& bbox, Point *positions );
+
+//! encode n normales sur 2x16 bits, projection octaedrique.
+//! cf. "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al. 2014
+void EncodeOctahedral( const int n, const Normal *normals, short *out );
+//! operation inverse de EncodeOctahedral(), les normales decodees sont normalisees.
+void DecodeOctahedral( const int n, const short *in, Normal *normals );
+
+
+//! attributs generiques d'un maillage, stockes en half float.
+struct QuantizedBuffer
+{
+    Name semantic;      //!< nom de l'attribut
+    int count;          //!< nombre de vecteurs
+    int size;           //!< 1, 2, 3, 4, dimension des vecteurs
+    std::vector<unsigned short> data;   //!< count * size half floats
+    
+    QuantizedBuffer( )
+        :
+        semantic(), count(0), size(0), data()
+    {}
+    
+    //! description de l'attribut pour glVertexAttribPointer(), cf. BufferLayout.
+    BufferLayout layout( ) const
+    {
+        return BufferLayout(size, GL_HALF_FLOAT);
+    }
+};
+
+//! stockage compact des attributs d'un maillage : 16 octets par sommet au lieu de 32.
+//! - positions : 4x16 bits non signes, relatifs a la boite englobante du maillage (GL_UNSIGNED_SHORT normalise),
+//! - normales : 2x16 bits signes, projection octaedrique (GL_SHORT normalise),
+//! - coordonnees de texture et attributs generiques : half float (GL_HALF_FLOAT).
+//!
+//! les shaders utilisent positionTransform() comme matrice model (ou la composent avec) pour retrouver les positions,
+//! et decodent les normales :
+//! \code
+//! vec3 decode_normal( vec2 e )
+//! {
+//!     vec3 n= vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+//!     float t= max(-n.z, 0.0);
+//!     n.x+= (n.x >= 0.0) ? -t : t;
+//!     n.y+= (n.y >= 0.0) ? -t : t;
+//!     return normalize(n);
+//! }
+//! \endcode
+//! les indices et les sous-objets restent ceux du Mesh.
+class QuantizedMesh
+{
+    std::vector<unsigned short> m_positions;    //!< 4 * positionCount()
+    std::vector<short> m_normals;               //!< 2 * normalCount()
+    std::vector<unsigned short> m_texcoords;    //!< 2 * texcoordCount()
+    std::vector<QuantizedBuffer> m_buffers;
+    
+    BBox m_bbox;        //!< boite englobante utilisee pour quantifier les positions.
+    
+public:
+    QuantizedMesh( )
+        :
+        m_positions(), m_normals(), m_texcoords(), m_buffers(),
+        m_bbox()
+    {}
+    
+    //! construction a partir d'un maillage, cf. build().
+    QuantizedMesh( const Mesh& mesh )
+        :
+        m_positions(), m_normals(), m_texcoords(), m_buffers(),
+        m_bbox()
+    {
+        build(mesh);
+    }
+    
+    ~QuantizedMesh( ) {}
+    
+    //! (re-)construit les attributs quantifies d'un maillage. renvoie -1 si le maillage n'a pas de positions.
+    int build( const Mesh& mesh );
+    
+    //! decode les attributs, renvoie les positions, normales et coordonnees de texture approchees.
+    int decode( std::vector<Point>& positions, std::vector<Normal>& normals, std::vector<Point2>& texcoords ) const;
+    
+    //! renvoie la boite englobante utilisee pour quantifier les positions.
+    const BBox& bbox( ) const
+    {
+        return m_bbox;
+    }
+    
+    //! renvoie la transformation qui replace les positions quantifiees, normalisees sur [0 1], dans le repere du maillage.
+    Transform positionTransform( ) const;
+    
+    int positionCount( ) const
+    {
+        return (int) m_positions.size() / 4;
+    }
+    
+    int normalCount( ) const
+    {
+        return (int) m_normals.size() / 2;
+    }
+    
+    int texcoordCount( ) const
+    {
+        return (int) m_texcoords.size() / 2;
+    }
+    
+    const std::vector<unsigned short>& positions( ) const
+    {
+        return m_positions;
+    }
+    
+    const std::vector<short>& normals( ) const
+    {
+        return m_normals;
+    }
+    
+    const std::vector<unsigned short>& texcoords( ) const
+    {
+        return m_texcoords;
+    }
+    
+    int bufferCount( ) const
+    {
+        return (int) m_buffers.size();
+    }
+    
+    const QuantizedBuffer& buffer( const int id ) const
+    {
+        return m_buffers[id];
+    }
+    
+    //! renvoie la taille totale des attributs quantifies, en octets.
+    unsigned int size( ) const;
+    
+    //! description des positions pour glVertexAttribPointer(), cf. BufferLayout.
+    static BufferLayout positionLayout( )
+    {
+        return BufferLayout(3, GL_UNSIGNED_SHORT, 4 * sizeof(unsigned short), 0, 0, BufferLayout::NORMALIZE_BIT);
+    }
+    
+    //! description des normales pour glVertexAttribPointer(), cf. BufferLayout.
+    static BufferLayout normalLayout( )
+    {
+        return BufferLayout(2, GL_SHORT, 0, 0, 0, BufferLayout::NORMALIZE_BIT);
+    }
+    
+    //! description des coordonnees de texture pour glVertexAttribPointer(), cf. BufferLayout.
+    static BufferLayout texcoordLayout( )
+    {
+        return BufferLayout(2, GL_HALF_FLOAT);
+    }
+    
+    //! cree un buffer openGL contenant les positions quantifiees. renvoie NULL si le maillage n'a pas de positions.
+    GLAttributeBuffer *createPositionBuffer( const GLenum usage= GL_STATIC_DRAW ) const;
+    //! cree un buffer openGL contenant les normales encodees. renvoie NULL si le maillage n'a pas de normales.
+    GLAttributeBuffer *createNormalBuffer( const GLenum usage= GL_STATIC_DRAW ) const;
+    //! cree un buffer openGL contenant les coordonnees de texture. renvoie NULL si le maillage n'a pas de coordonnees de texture.
+    GLAttributeBuffer *createTexCoordBuffer( const GLenum usage= GL_STATIC_DRAW ) const;
+    //! cree un buffer openGL contenant un attribut generique. renvoie NULL si l'attribut n'existe pas.
+    GLAttributeBuffer *createBuffer( const Name& semantic, const GLenum usage= GL_STATIC_DRAW ) const;
+};
+
+}       // namespace
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef _GK_RGB9E5_H
+#define _GK_RGB9E5_H
+
+#include <cstring>
+
+#include "SIMD.h"
+
+
+namespace gk {
+
+//! conversion float rgb vers rgb9e5 (GL_RGB9_E5, GL_EXT_texture_shared_exponent) : 3 mantisses de 9 bits, exposant partage de 5 bits.
+//! les composantes negatives ou nan sont remplacees par 0, les composantes trop grandes par 65408.
+inline
+unsigned int FloatToRGB9E5( const float red, const float green, const float blue )
+{
+    const float max_value= 65408.f;     // (2^9 - 1) / 2^9 * 2^16
+    const float r= (red > 0.f) ? (red < max_value ? red : max_value) : 0.f;
+    const float g= (green > 0.f) ? (green < max_value ? green : max_value) : 0.f;
+    const float b= (blue > 0.f) ? (blue < max_value ? blue : max_value) : 0.f;
+
+    float v= r;
+    if(g > v) v= g;
+    if(b > v) v= b;
+
+    // exposant partage : floor(log2(v)), lu directement dans les bits de v, au moins -16
+    unsigned int bits;
+    memcpy(&bits, &v, sizeof(bits));
+    int e= (int) (bits >> 23) - 127;
+    if(e < -16)
+        e= -16;
+
+    // echelle des mantisses : 2^(8 - e)
+    unsigned int scale_bits= (unsigned int) (127 + 8 - e) << 23;
+    float scale;
+    memcpy(&scale, &scale_bits, sizeof(scale));
+    if((int) (v * scale + .5f) == 512)
+    {
+        scale*= .5f;
+        e++;
+    }
+
+    const unsigned int rm= (unsigned int) (r * scale + .5f);
+    const unsigned int gm= (unsigned int) (g * scale + .5f);
+    const unsigned int bm= (unsigned int) (b * scale + .5f);
+    return rm | (gm << 9) | (bm << 18) | ((unsigned int) (e + 16) << 27);
+}
+
+//! conversion rgb9e5 vers float rgb.
+inline
+void RGB9E5ToFloat( const unsigned int value, float& red, float& green, float& blue )
+{
+    // 2^(e - 15 - 9)
+    const unsigned int scale_bits= ((value >> 27) + 127 - 24) << 23;
+    float scale;
+    memcpy(&scale, &scale_bits, sizeof(scale));
+
+    red= (float) (value & 0x1ffu) * scale;
+    green= (float) ((value >> 9) & 0x1ffu) * scale;
+    blue= (float) ((value >> 18) & 0x1ffu) * scale;
+}
+
+//! conversion de n pixels float rgba en rgb9e5, par paquets de 4 pixels (sse). alpha est ignore.
+inline
+void FloatToRGB9E5( const int n, const float *rgba, unsigned int *out )
+{
+    int i= 0;
+#ifdef GK_SSE
+    const __m128 zero= _mm_setzero_ps();
+    const __m128 max_value= _mm_set1_ps(65408.f);
+    const __m128 half= _mm_set1_ps(.5f);
+    const __m128i min_exponent= _mm_set1_epi32(-16);
+    for(; i + 4 <= n; i+= 4)
+    {
+        __m128 r= _mm_loadu_ps(rgba + 4*i);
+        __m128 g= _mm_loadu_ps(rgba + 4*i + 4);
+        __m128 b= _mm_loadu_ps(rgba + 4*i + 8);
+        __m128 a= _mm_loadu_ps(rgba + 4*i + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        // _mm_max_ps(nan, 0) == 0
+        r= _mm_min_ps(_mm_max_ps(r, zero), max_value);
+        g= _mm_min_ps(_mm_max_ps(g, zero), max_value);
+        b= _mm_min_ps(_mm_max_ps(b, zero), max_value);
+        const __m128 v= _mm_max_ps(_mm_max_ps(r, g), b);
+
+        __m128i e= _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(v), 23), _mm_set1_epi32(127));
+        const __m128i low= _mm_cmplt_epi32(e, min_exponent);
+        e= _mm_or_si128(_mm_and_si128(low, min_exponent), _mm_andnot_si128(low, e));
+
+        __m128 scale= _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 8), e), 23));
+        const __m128i bump= _mm_cmpeq_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half)), _mm_set1_epi32(512));
+        scale= select4(_mm_castsi128_ps(bump), _mm_mul_ps(scale, half), scale);
+        e= _mm_sub_epi32(e, bump);
+
+        const __m128i rm= _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+        const __m128i gm= _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+        const __m128i bm= _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+        const __m128i packed= _mm_or_si128(_mm_or_si128(rm, _mm_slli_epi32(gm, 9)),
+            _mm_or_si128(_mm_slli_epi32(bm, 18), _mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(16)), 27)));
+        _mm_storeu_si128((__m128i *) (out + i), packed);
+    }
+#endif
+    for(; i < n; i++)
+        out[i]= FloatToRGB9E5(rgba[4*i], rgba[4*i +1], rgba[4*i +2]);
+}
+
+//! conversion de n pixels rgb9e5 en float rgba, par paquets de 4 pixels (sse), alpha= 1.
+inline
+void RGB9E5ToFloat( const int n, const unsigned int *in, float *rgba )
+{
+    int i= 0;
+#ifdef GK_SSE
+    const __m128i mask= _mm_set1_epi32(0x1ff);
+    for(; i + 4 <= n; i+= 4)
+    {
+        const __m128i v= _mm_loadu_si128((const __m128i *) (in + i));
+        const __m128 scale= _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_srli_epi32(v, 27), _mm_set1_epi32(127 - 24)), 23));
+
+        __m128 r= _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v, mask)), scale);
+        __m128 g= _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 9), mask)), scale);
+        __m128 b= _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 18), mask)), scale);
+        __m128 a= _mm_set1_ps(1.f);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        _mm_storeu_ps(rgba + 4*i, r);
+        _mm_storeu_ps(rgba + 4*i + 4, g);
+        _mm_storeu_ps(rgba + 4*i + 8, b);
+        _mm_storeu_ps(rgba + 4*i + 12, a);
+    }
+#endif
+    for(; i < n; i++)
+    {
+        RGB9E5ToFloat(in[i], rgba[4*i], rgba[4*i +1], rgba[4*i +2]);
+        rgba[4*i +3]= 1.f;
+    }
+}
+
+}       // namespace
+
+#endif
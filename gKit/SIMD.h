@@ -0,0 +1,114 @@
+#ifndef _GK_SIMD_H
+#define _GK_SIMD_H
+
+//! utilitaires sse partages par les traitements par paquets (transformations, quantification des attributs, etc.)
+//! GK_SSE est defini lorsque le compilateur genere du code sse, les versions scalaires sont utilisees sinon.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GK_SSE
+#include <emmintrin.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+#endif
+
+
+namespace gk {
+
+#ifdef GK_SSE
+//! charge 4 triplets (x, y, z) contigus et les separe : 3 lectures de 16 octets, sans depasser la fin des tableaux.
+inline 
+void load3x4( const float *p, __m128& x, __m128& y, __m128& z )
+{
+    const __m128 a= _mm_loadu_ps(p);           // x0 y0 z0 x1
+    const __m128 b= _mm_loadu_ps(p + 4);       // y1 z1 x2 y2
+    const __m128 c= _mm_loadu_ps(p + 8);       // z2 x3 y3 z3
+    
+    const __m128 xy= _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));    // x2 y2 z2 x3
+    const __m128 yz= _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));    // y0 z0 y1 z1
+    x= _mm_shuffle_ps(a, xy, _MM_SHUFFLE(3, 0, 3, 0));
+    y= _mm_shuffle_ps(yz, _mm_shuffle_ps(xy, c, _MM_SHUFFLE(2, 2, 1, 1)), _MM_SHUFFLE(2, 0, 2, 0));
+    z= _mm_shuffle_ps(yz, _mm_shuffle_ps(xy, c, _MM_SHUFFLE(3, 3, 2, 2)), _MM_SHUFFLE(2, 0, 3, 1));
+}
+
+//! operation inverse de load3x4().
+inline 
+void store3x4( float *p, const __m128 x, const __m128 y, const __m128 z )
+{
+    const __m128 xy01= _mm_unpacklo_ps(x, y);  // x0 y0 x1 y1
+    const __m128 xy23= _mm_unpackhi_ps(x, y);  // x2 y2 x3 y3
+    
+    const __m128 a= _mm_shuffle_ps(xy01, _mm_shuffle_ps(z, xy01, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+    const __m128 b= _mm_shuffle_ps(_mm_shuffle_ps(xy01, z, _MM_SHUFFLE(1, 1, 3, 3)), xy23, _MM_SHUFFLE(1, 0, 2, 0));
+    const __m128 c= _mm_shuffle_ps(_mm_shuffle_ps(z, xy23, _MM_SHUFFLE(2, 2, 2, 2)), 
+        _mm_shuffle_ps(xy23, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    
+    _mm_storeu_ps(p, a);
+    _mm_storeu_ps(p + 4, b);
+    _mm_storeu_ps(p + 8, c);
+}
+
+//! renvoie |x|.
+inline
+__m128 abs4( const __m128 x )
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+}
+
+//! renvoie le bit de signe de x.
+inline
+__m128 sign4( const __m128 x )
+{
+    return _mm_and_ps(_mm_set1_ps(-0.f), x);
+}
+
+//! renvoie mask ? a : b, mask est le resultat d'une comparaison.
+inline
+__m128 select4( const __m128 mask, const __m128 a, const __m128 b )
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+//! renvoie une approximation de log2(x), x > 0 et normalise, erreur absolue < 3e-6.
+//! x = 2^e * m, m dans [1 2) : log2(x) = e + log2(m), log2(m) est approche par un polynome de degre 6 en (m - 1).
+inline
+__m128 log2_4( const __m128 x )
+{
+    const __m128i bits= _mm_castps_si128(x);
+    const __m128 e= _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    const __m128 t= _mm_sub_ps(
+        _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000))), 
+        _mm_set1_ps(1.f));
+    
+    __m128 p= _mm_set1_ps(-0.025792329f);
+    p= _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.12147290f));
+    p= _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.27734159f));
+    p= _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.45715809f));
+    p= _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.71803358f));
+    p= _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(1.44253478f));
+    return _mm_add_ps(e, _mm_mul_ps(p, t));
+}
+
+//! renvoie une approximation de 2^x, x dans [-126 126], erreur relative < 2e-7.
+//! x = e + f, e entier, f dans [-0.5 0.5] : 2^x = 2^e * 2^f, 2^e est construit directement, 2^f est approche par un polynome de degre 6.
+inline
+__m128 exp2_4( const __m128 x )
+{
+    const __m128 xc= _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.f)), _mm_set1_ps(126.f));
+    const __m128i e= _mm_cvtps_epi32(xc);      // arrondi au plus proche
+    const __m128 f= _mm_sub_ps(xc, _mm_cvtepi32_ps(e));
+
+    __m128 p= _mm_set1_ps(1.535336188319500e-4f);
+    p= _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.339887440266574e-3f));
+    p= _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.618437357674640e-3f));
+    p= _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.550332471162809e-2f));
+    p= _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.402264791363012e-1f));
+    p= _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.931472028550421e-1f));
+    p= _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.f));
+    return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23)));
+}
+#endif
+
+}       // namespace
+
+#endif
@@ -0,0 +1,250 @@
+
+#include <algorithm>
+
+#include "SpatialGrid.h"
+
+
+namespace gk {
+
+int SpatialGrid::build( const std::vector<Point>& points, const float cell_size )
+{
+    const int n= (int) points.size();
+    m_points= points;
+    m_cell_points.clear();
+    m_cell_begin.clear();
+    m_bbox.clear();
+    m_mask= 0;
+    if(n == 0)
+        return 0;
+
+    for(int i= 0; i < n; i++)
+        m_bbox.Union(m_points[i]);
+
+    // taille des cellules
+    m_cell_size= cell_size;
+    if(m_cell_size <= 0.f)
+    {
+        // estimation grossiere : ~ n^(1/3) cellules sur le plus grand axe.
+        const Vector d(m_bbox.pMin, m_bbox.pMax);
+        const float extent= std::max(d.x, std::max(d.y, d.z));
+        m_cell_size= extent / std::max(1.f, cbrtf((float) n));
+        if(m_cell_size <= 0.f)
+            m_cell_size= 1.f;   // tous les points sont confondus
+    }
+    m_inv_cell_size= 1.f / m_cell_size;
+    m_origin= m_bbox.pMin;
+
+    // taille de la table : puissance de 2 >= 2n
+    unsigned int size= 1;
+    while(size < 2u * (unsigned int) n)
+        size= size << 1;
+    m_mask= size - 1;
+
+    // etape 1 : hash de la cellule de chaque point
+    std::vector<unsigned int> hashes(n);
+    #pragma omp parallel for
+    for(int i= 0; i < n; i++)
+    {
+        int x, y, z;
+        cell(m_points[i], x, y, z);
+        hashes[i]= hash(x, y, z);
+    }
+
+    // etape 2 : compte les points de chaque entree de la table
+    m_cell_begin.assign(size + 1, 0);
+    #pragma omp parallel for
+    for(int i= 0; i < n; i++)
+    {
+        #pragma omp atomic
+        m_cell_begin[hashes[i] + 1]++;
+    }
+
+    // etape 3 : prefix sum, premier element de chaque entree
+    for(unsigned int h= 0; h < size; h++)
+        m_cell_begin[h + 1]+= m_cell_begin[h];
+
+    // etape 4 : range les points, dans l'ordre : chaque entree est triee.
+    // sequentiel, une simple copie, sans atomic capture (openmp 3.1, non disponible avec certains compilateurs)
+    std::vector<int> next(m_cell_begin.begin(), m_cell_begin.end() - 1);
+    m_cell_points.resize(n);
+    for(int i= 0; i < n; i++)
+        m_cell_points[next[hashes[i]]++]= i;
+
+    return 0;
+}
+
+void SpatialGrid::gatherCell( const int x, const int y, const int z, const Point& p, const float radius2, std::vector<int>& result ) const
+{
+    const unsigned int h= hash(x, y, z);
+    const int end= m_cell_begin[h + 1];
+    for(int i= m_cell_begin[h]; i < end; i++)
+    {
+        const int id= m_cell_points[i];
+        const Point& q= m_points[id];
+
+        // plusieurs cellules peuvent partager la meme entree de la table
+        int qx, qy, qz;
+        cell(q, qx, qy, qz);
+        if(qx != x || qy != y || qz != z)
+            continue;
+
+        if(DistanceSquared(p, q) <= radius2)
+            result.push_back(id);
+    }
+}
+
+int SpatialGrid::radius( const Point& p, const float radius, std::vector<int>& result ) const
+{
+    result.clear();
+    if(m_points.empty() || radius < 0.f)
+        return 0;
+
+    // cellules couvertes par la sphere, limitees a la boite englobante des points
+    int x0, y0, z0, x1, y1, z1;
+    cell(Point(std::max(p.x - radius, m_bbox.pMin.x), std::max(p.y - radius, m_bbox.pMin.y), std::max(p.z - radius, m_bbox.pMin.z)), x0, y0, z0);
+    cell(Point(std::min(p.x + radius, m_bbox.pMax.x), std::min(p.y + radius, m_bbox.pMax.y), std::min(p.z + radius, m_bbox.pMax.z)), x1, y1, z1);
+
+    const float radius2= radius * radius;
+    for(int z= z0; z <= z1; z++)
+        for(int y= y0; y <= y1; y++)
+            for(int x= x0; x <= x1; x++)
+                gatherCell(x, y, z, p, radius2, result);
+
+    return (int) result.size();
+}
+
+void SpatialGrid::nearestCell( const int x, const int y, const int z, const Point& p, const int k,
+    std::vector<std::pair<float, int> >& heap ) const
+{
+    const unsigned int h= hash(x, y, z);
+    const int end= m_cell_begin[h + 1];
+    for(int i= m_cell_begin[h]; i < end; i++)
+    {
+        const int id= m_cell_points[i];
+        const Point& q= m_points[id];
+
+        int qx, qy, qz;
+        cell(q, qx, qy, qz);
+        if(qx != x || qy != y || qz != z)
+            continue;
+
+        const float d= DistanceSquared(p, q);
+        if((int) heap.size() < k)
+        {
+            heap.push_back( std::make_pair(d, id) );
+            std::push_heap(heap.begin(), heap.end());
+        }
+        else if(d < heap.front().first)
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back()= std::make_pair(d, id);
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+}
+
+int SpatialGrid::nearest( const Point& p, const int k, std::vector<int>& result, const float max_radius ) const
+{
+    result.clear();
+    if(m_points.empty() || k <= 0)
+        return 0;
+
+    // cellules occupees, la cellule de p est ramenee juste a cote de la grille : les points eloignes ne parcourent pas
+    // les anneaux vides. les anneaux autour de la cellule ramenee sont plus petits que les anneaux autour de p,
+    // l'arret de la recherche reste correct.
+    int x0, y0, z0, x1, y1, z1;
+    cell(m_bbox.pMin, x0, y0, z0);
+    cell(m_bbox.pMax, x1, y1, z1);
+
+    int cx, cy, cz;
+    cell(p, cx, cy, cz);
+    cx= std::max(x0 - 1, std::min(x1 + 1, cx));
+    cy= std::max(y0 - 1, std::min(y1 + 1, cy));
+    cz= std::max(z0 - 1, std::min(z1 + 1, cz));
+
+    // premier anneau qui touche la grille, dernier anneau necessaire pour couvrir tous les points
+    const int first= std::max(std::max(std::max(x0 - cx, cx - x1), std::max(y0 - cy, cy - y1)), std::max(std::max(z0 - cz, cz - z1), 0));
+    int rings= std::max(std::max(std::abs(cx - x0), std::abs(x1 - cx)),
+        std::max(std::max(std::abs(cy - y0), std::abs(y1 - cy)), std::max(std::abs(cz - z0), std::abs(z1 - cz))));
+    if(max_radius > 0.f)
+        rings= std::min(rings, (int) ceilf(std::min(max_radius * m_inv_cell_size, 1073741824.f)));
+
+    // parcours les cellules par anneaux concentriques autour de la cellule de p, limites aux cellules occupees
+    std::vector<std::pair<float, int> > heap;
+    heap.reserve(k);
+    for(int s= first; s <= rings; s++)
+    {
+        const int dx0= std::max(-s, x0 - cx);
+        const int dx1= std::min(s, x1 - cx);
+        for(int dz= std::max(-s, z0 - cz); dz <= std::min(s, z1 - cz); dz++)
+            for(int dy= std::max(-s, y0 - cy); dy <= std::min(s, y1 - cy); dy++)
+            {
+                if(dz == -s || dz == s || dy == -s || dy == s)
+                {
+                    // face de l'anneau : toute la ligne
+                    for(int dx= dx0; dx <= dx1; dx++)
+                        nearestCell(cx + dx, cy + dy, cz + dz, p, k, heap);
+                }
+                else
+                {
+                    // interieur de l'anneau : les 2 extremites de la ligne
+                    if(dx0 == -s)
+                        nearestCell(cx - s, cy + dy, cz + dz, p, k, heap);
+                    if(dx1 == s)
+                        nearestCell(cx + s, cy + dy, cz + dz, p, k, heap);
+                }
+            }
+
+        // tous les points a une distance < s * cell_size de p sont dans les anneaux 0 .. s.
+        const float covered= (float) s * m_cell_size;
+        if((int) heap.size() == k && heap.front().first <= covered * covered)
+            break;
+    }
+
+    std::sort_heap(heap.begin(), heap.end());
+    const float max_radius2= max_radius * max_radius;
+    for(int i= 0; i < (int) heap.size(); i++)
+    {
+        if(max_radius > 0.f && heap[i].first > max_radius2)
+            break;
+        result.push_back(heap[i].second);
+    }
+
+    return (int) result.size();
+}
+
+int SpatialGrid::nearest( const Point& p, const float max_radius ) const
+{
+    std::vector<int> result;
+    if(nearest(p, 1, result, max_radius) == 0)
+        return -1;
+    return result[0];
+}
+
+int SpatialGrid::weld( const float epsilon, std::vector<int>& remap ) const
+{
+    const int n= (int) m_points.size();
+    remap.resize(n);
+
+    // parcours sequentiel : le representant d'un point est le plus petit representant deja trouve a moins de epsilon.
+    int count= 0;
+    std::vector<int> neighbors;
+    for(int i= 0; i < n; i++)
+    {
+        remap[i]= i;
+        radius(m_points[i], epsilon, neighbors);
+        for(int j= 0; j < (int) neighbors.size(); j++)
+        {
+            const int id= neighbors[j];
+            if(id < remap[i] && remap[id] == id)
+                remap[i]= id;
+        }
+
+        if(remap[i] == i)
+            count++;
+    }
+
+    return count;
+}
+
+}       // namespace
@@ -0,0 +1,132 @@
+#ifndef _GK_SPATIAL_GRID_H
+#define _GK_SPATIAL_GRID_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "Geometry.h"
+
+
+namespace gk {
+
+//! grille reguliere 'hashee' sur un ensemble de points : recherche des voisins dans un rayon, des k plus proches voisins.
+
+//! les points sont ranges dans des cellules cubiques de cote 'cell_size', les coordonnees entieres de la cellule sont hashees
+//! dans une table de 2*n entrees, stockee en listes contigues (offsets + indices), sans allocation par cellule.
+//! la construction est parallele (openmp), les requetes sont const et peuvent etre utilisees par plusieurs threads.
+class SpatialGrid
+{
+    std::vector<Point> m_points;        //!< copie des points indexes.
+    std::vector<int> m_cell_begin;      //!< m_cell_begin[h] .. m_cell_begin[h+1] : points de l'entree h de la table.
+    std::vector<int> m_cell_points;     //!< indices des points, ranges par entree de la table.
+
+    BBox m_bbox;
+    Point m_origin;
+    float m_cell_size;
+    float m_inv_cell_size;
+    unsigned int m_mask;
+
+    // non copyable
+    SpatialGrid( const SpatialGrid& );
+    SpatialGrid& operator=( const SpatialGrid& );
+
+    //! renvoie une coordonnee entiere de cellule, limitee : les points tres eloignes de la grille ne debordent pas d'un int.
+    static int cellCoordinate( const float v )
+    {
+        return (int) std::max(-1073741824.f, std::min(1073741824.f, floorf(v)));
+    }
+
+    //! renvoie les coordonnees entieres de la cellule contenant p.
+    void cell( const Point& p, int& x, int& y, int& z ) const
+    {
+        x= cellCoordinate((p.x - m_origin.x) * m_inv_cell_size);
+        y= cellCoordinate((p.y - m_origin.y) * m_inv_cell_size);
+        z= cellCoordinate((p.z - m_origin.z) * m_inv_cell_size);
+    }
+
+    //! renvoie l'entree de la table associee a une cellule.
+    unsigned int hash( const int x, const int y, const int z ) const
+    {
+        return ((unsigned int) x * 73856093u ^ (unsigned int) y * 19349663u ^ (unsigned int) z * 83492791u) & m_mask;
+    }
+
+    //! parcours les points d'une cellule et ajoute ceux a distance < radius.
+    void gatherCell( const int x, const int y, const int z, const Point& p, const float radius2, std::vector<int>& result ) const;
+
+    //! parcours les points d'une cellule et met a jour les k plus proches voisins.
+    void nearestCell( const int x, const int y, const int z, const Point& p, const int k,
+        std::vector<std::pair<float, int> >& heap ) const;
+
+public:
+    //! constructeur par defaut, grille vide.
+    SpatialGrid( )
+        :
+        m_points(), m_cell_begin(), m_cell_points(),
+        m_bbox(), m_origin(),
+        m_cell_size(1.f), m_inv_cell_size(1.f),
+        m_mask(0)
+    {}
+
+    //! construit la grille sur un ensemble de points, cf. build().
+    SpatialGrid( const std::vector<Point>& points, const float cell_size )
+        :
+        m_points(), m_cell_begin(), m_cell_points(),
+        m_bbox(), m_origin(),
+        m_cell_size(1.f), m_inv_cell_size(1.f),
+        m_mask(0)
+    {
+        build(points, cell_size);
+    }
+
+    //! destructeur.
+    ~SpatialGrid( ) {}
+
+    //! (re-)construit la grille.
+    //! \param cell_size cote des cellules, choisir le rayon des requetes les plus frequentes.
+    //! si cell_size <= 0, utilise une taille estimee a partir de la boite englobante et du nombre de points.
+    int build( const std::vector<Point>& points, const float cell_size= 0.f );
+
+    //! renvoie le nombre de points indexes.
+    int pointCount( ) const
+    {
+        return (int) m_points.size();
+    }
+
+    //! renvoie un point indexe.
+    const Point& point( const int id ) const
+    {
+        return m_points[id];
+    }
+
+    //! renvoie le cote des cellules.
+    float cellSize( ) const
+    {
+        return m_cell_size;
+    }
+
+    //! renvoie la boite englobante des points.
+    const BBox& bbox( ) const
+    {
+        return m_bbox;
+    }
+
+    //! renvoie les indices des points a une distance <= radius de p (dans un ordre quelconque).
+    int radius( const Point& p, const float radius, std::vector<int>& result ) const;
+
+    //! renvoie les indices des k plus proches voisins de p, tries par distance croissante.
+    //! \param max_radius limite la recherche, les points plus loin ne sont pas renvoyes, ou <= 0 pour une recherche non limitee.
+    int nearest( const Point& p, const int k, std::vector<int>& result, const float max_radius= 0.f ) const;
+
+    //! renvoie l'indice du point le plus proche de p, ou -1 si la grille est vide (ou si aucun point n'est a moins de max_radius).
+    int nearest( const Point& p, const float max_radius= 0.f ) const;
+
+    //! renvoie pour chaque point l'indice de son representant : le plus petit indice des points a une distance <= epsilon.
+    //! les representants sont leur propre representant, remap[i] <= i.
+    //! \return le nombre de representants.
+    int weld( const float epsilon, std::vector<int>& remap ) const;
+};
+
+}       // namespace
+
+#endif
@@ -5,6 +5,7 @@
 #include "GLManager.h"
 #include "GL/GLPlatform.h"
 #include "GL/TPTexture.h"
+#include "AsyncIO.h"
 
 
 namespace gk {
@@ -36,6 +37,54 @@ GLTexture2D *createTexture2D( const int unit, const Image *image, const GLenum f
         new GLTexture2D(unit, image, format, data_format, data_type) );
 }
 
+//! gestion 'auto' des ressources openGL : pour les textures hdr compactes, half float.
+inline
+GLTexture2D *createTexture2D( const int unit, const HalfImage *image, const GLenum format= GL_RGBA16F, 
+    const GLenum data_format= GL_RGBA, const GLenum data_type= GL_HALF_FLOAT )
+{
+    return GLManager<GLTexture2D>::manager().insert(
+        new GLTexture2D(unit, image, format, data_format, data_type) );
+}
+
+//! gestion 'auto' des ressources openGL : pour les textures hdr compactes, rgb9e5.
+inline
+GLTexture2D *createTexture2D( const int unit, const RGB9E5Image *image, const GLenum format= GL_RGB9_E5, 
+    const GLenum data_format= GL_RGB, const GLenum data_type= GL_UNSIGNED_INT_5_9_9_9_REV )
+{
+    return GLManager<GLTexture2D>::manager().insert(
+        new GLTexture2D(unit, image, format, data_format, data_type) );
+}
+
+//! gestion 'auto' des ressources openGL : cree une texture couleur a la fin d'un chargement asynchrone, cf. AsyncIO.
+template< class ImageType >
+class AsyncTexture2D : public AsyncCreate<ImageType>
+{
+    int m_unit;
+    GLTexture2D *m_texture;
+    
+public:
+    AsyncTexture2D( const int unit )
+        :
+        AsyncCreate<ImageType>(),
+        m_unit(unit),
+        m_texture(NULL)
+    {}
+    
+    int create( ImageType *image )
+    {
+        m_texture= createTexture2D(m_unit, image);
+        if(m_texture == NULL)
+            return -1;
+        return m_texture->createGLResource();
+    }
+    
+    //! renvoie la texture, ou NULL si le chargement n'est pas termine.
+    GLTexture2D *texture( ) const
+    {
+        return m_texture;
+    }
+};
+
 //! gestion 'auto' des ressources openGL : pour les textures profondeur.
 inline
 GLDepthTexture *createDepthTexture( const int unit, const int w, const int h, const GLenum format= GL_DEPTH_COMPONENT,
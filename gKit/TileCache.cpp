@@ -0,0 +1,122 @@
+
+#include "TileCache.h"
+#include "TiledImage.h"
+#include "Half.h"
+#include "TextureManager.h"
+#include "GL/TPTexture.h"
+#include "GL/TPTextureUnits.h"
+
+
+namespace gk {
+
+TileCache::TileCache( )
+    :
+    m_image(NULL),
+    m_atlas(NULL),
+    m_slots(),
+    m_lru(),
+    m_index(),
+    m_upload(),
+    m_slots_x(0),
+    m_slots_y(0),
+    m_tile(0),
+    m_frame(0),
+    m_uploads(0),
+    m_max_uploads(0)
+{}
+
+int TileCache::init( const TiledImage *image, const int slots_x, const int slots_y, const int max_uploads )
+{
+    if(image == NULL || image->levels() == 0 || slots_x <= 0 || slots_y <= 0)
+        return -1;
+
+    m_image= image;
+    m_tile= image->tileSize();
+    m_slots_x= slots_x;
+    m_slots_y= slots_y;
+    m_max_uploads= max_uploads;
+
+    m_atlas= createTexture2D(UNIT0, slots_x * m_tile, slots_y * m_tile, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+    if(m_atlas == NULL || m_atlas->createGLResource() < 0)
+        return -1;
+
+    m_upload.resize(4 * m_tile * m_tile);
+    m_index.clear();
+    m_lru.clear();
+    m_slots.resize(slots_x * slots_y);
+    for(int i= 0; i < (int) m_slots.size(); i++)
+    {
+        m_slots[i].key= Key();
+        m_slots[i].frame= 0;
+        m_slots[i].lru= m_lru.insert(m_lru.end(), i);
+    }
+
+    m_frame= 1;
+    m_uploads= 0;
+    return 0;
+}
+
+void TileCache::beginFrame( )
+{
+    m_frame++;
+    m_uploads= 0;
+}
+
+int TileCache::find( const int level, const int x, const int y )
+{
+    if(m_atlas == NULL)
+        return -1;
+
+    const Key key(level, x, y);
+    std::map<Key, int>::iterator found= m_index.find(key);
+    if(found != m_index.end())
+    {
+        // deplace la tuile en tete de la liste lru
+        Slot& slot= m_slots[found->second];
+        m_lru.splice(m_lru.begin(), m_lru, slot.lru);
+        slot.frame= m_frame;
+        return found->second;
+    }
+
+    if(m_uploads >= m_max_uploads)
+        return -1;
+
+    const HDRPixel *pixels= m_image->tile(level, x, y);
+    if(pixels == NULL)
+        return -1;
+
+    // recycle l'emplacement le moins recemment utilise, s'il n'est pas utilise par l'image courante
+    const int id= m_lru.back();
+    Slot& slot= m_slots[id];
+    if(slot.frame == m_frame)
+        return -1;      // l'atlas est trop petit pour afficher toutes les tuiles
+
+    if(slot.key.level >= 0)
+        m_index.erase(slot.key);
+
+    // transfere la tuile en half float, les pixels sont lus dans le fichier projete en memoire par le systeme
+    FloatToHalf(4 * m_tile * m_tile, (const float *) pixels, &m_upload.front());
+    ActiveTextureUnits[UNIT0].setTexture(ProgramSampler(UNIT0), m_atlas);
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+        (id % m_slots_x) * m_tile, (id / m_slots_x) * m_tile, m_tile, m_tile,
+        GL_RGBA, GL_HALF_FLOAT, &m_upload.front());
+    m_uploads++;
+
+    slot.key= key;
+    slot.frame= m_frame;
+    m_lru.splice(m_lru.begin(), m_lru, slot.lru);
+    m_index.insert(std::make_pair(key, id));
+    return id;
+}
+
+void TileCache::slotRect( const int slot, float& s0, float& t0, float& s1, float& t1 ) const
+{
+    const float width= (float) (m_slots_x * m_tile);
+    const float height= (float) (m_slots_y * m_tile);
+    s0= (float) ((slot % m_slots_x) * m_tile) / width;
+    t0= (float) ((slot / m_slots_x) * m_tile) / height;
+    s1= s0 + (float) m_tile / width;
+    t1= t0 + (float) m_tile / height;
+}
+
+}       // namespace
@@ -0,0 +1,126 @@
+#ifndef _GK_TILE_CACHE_H
+#define _GK_TILE_CACHE_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+
+namespace gk {
+
+class TiledImage;
+class GLTexture2D;
+
+//! cache des tuiles d'une TiledImage dans une texture atlas, remplacement lru.
+
+//! l'atlas contient slots_x x slots_y emplacements de la taille d'une tuile, la memoire utilisee par le gpu
+//! ne depend pas de la taille de l'image. les tuiles sont transferees a la demande, cf. find(), au plus
+//! max_uploads par image, converties en half float, l'emplacement de la tuile la moins recemment utilisee est recycle.
+//! les tuiles utilisees pendant l'image courante ne sont jamais remplacees, cf. beginFrame().
+/*! exemple d'utilisation :
+\code
+    gk::TileCache cache;
+    cache.init(&image);
+
+    // a chaque image
+    cache.beginFrame();
+    int slot= cache.find(level, x, y);
+    if(slot >= 0)
+    {
+        float s0, t0, s1, t1;
+        cache.slotRect(slot, s0, t0, s1, t1);
+        // dessiner la tuile avec cache.atlas()
+    }
+\endcode
+*/
+class TileCache
+{
+    //! identifiant d'une tuile.
+    struct Key
+    {
+        int level;
+        int x;
+        int y;
+
+        Key( ) : level(-1), x(0), y(0) {}
+        Key( const int _level, const int _x, const int _y ) : level(_level), x(_x), y(_y) {}
+
+        bool operator<( const Key& b ) const
+        {
+            if(level != b.level)
+                return level < b.level;
+            if(y != b.y)
+                return y < b.y;
+            return x < b.x;
+        }
+    };
+
+    //! emplacement de l'atlas.
+    struct Slot
+    {
+        Key key;
+        unsigned int frame;             //!< derniere image ayant utilise la tuile.
+        std::list<int>::iterator lru;
+    };
+
+    const TiledImage *m_image;
+    GLTexture2D *m_atlas;
+    std::vector<Slot> m_slots;
+    std::list<int> m_lru;               //!< emplacements, du plus recemment utilise au plus ancien.
+    std::map<Key, int> m_index;         //!< emplacement de chaque tuile presente.
+    std::vector<unsigned short> m_upload;   //!< tuile convertie en half float avant son transfert.
+
+    int m_slots_x;
+    int m_slots_y;
+    int m_tile;
+    unsigned int m_frame;
+    int m_uploads;
+    int m_max_uploads;
+
+    // non copyable
+    TileCache( const TileCache& );
+    TileCache& operator=( const TileCache& );
+
+public:
+    //! constructeur par defaut, cf. init().
+    TileCache( );
+
+    //! destructeur.
+    ~TileCache( ) {}
+
+    //! cree l'atlas, slots_x x slots_y tuiles, en rgba16f.
+    //! \param max_uploads nombre maximum de tuiles transferees par image.
+    int init( const TiledImage *image, const int slots_x= 8, const int slots_y= 8, const int max_uploads= 8 );
+
+    //! commence une nouvelle image : les tuiles utilisees pendant l'image precedente peuvent etre remplacees.
+    void beginFrame( );
+
+    //! renvoie l'emplacement d'une tuile, la transfere si necessaire.
+    //! \return -1 si la tuile n'est pas presente et ne peut pas etre transferee pendant cette image.
+    int find( const int level, const int x, const int y );
+
+    //! renvoie vrai si la tuile est presente dans l'atlas.
+    bool resident( const int level, const int x, const int y ) const
+    {
+        return m_index.find(Key(level, x, y)) != m_index.end();
+    }
+
+    //! renvoie les coordonnees de texture d'un emplacement dans l'atlas.
+    void slotRect( const int slot, float& s0, float& t0, float& s1, float& t1 ) const;
+
+    //! renvoie la texture atlas.
+    GLTexture2D *atlas( ) const
+    {
+        return m_atlas;
+    }
+
+    //! renvoie le nombre de tuiles transferees pendant l'image courante.
+    int uploads( ) const
+    {
+        return m_uploads;
+    }
+};
+
+}       // namespace
+
+#endif
@@ -0,0 +1,480 @@
+
+#ifdef WIN32
+    #include <windows.h>
+#else
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "TiledImage.h"
+#include "ImageRGBE.h"
+
+
+namespace gk {
+
+namespace {
+
+//! entete du fichier, les tuiles commencent apres header_size octets.
+struct Header
+{
+    char magic[4];
+    int version;
+    int width;
+    int height;
+    int tile;
+    int levels;
+};
+
+const char magic[4]= { 'g', 'k', 't', 'i' };
+const int version= 1;
+const size_t header_size= 4096;
+
+//! fichier projete en memoire.
+struct Mapping
+{
+    void *map;
+    size_t size;
+    void *file;
+    void *mapping;
+
+    Mapping( ) : map(NULL), size(0), file(NULL), mapping(NULL) {}
+};
+
+//! projette un fichier en memoire, en lecture, ou en ecriture : le fichier est alors cree, avec size octets.
+int map_file( const std::string& filename, const bool write, const size_t size, Mapping& m )
+{
+#ifdef WIN32
+    HANDLE file= CreateFileA(filename.c_str(), write ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+        FILE_SHARE_READ, NULL, write ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+        return -1;
+
+    unsigned long long length= size;
+    if(write == false)
+    {
+        LARGE_INTEGER file_size;
+        if(GetFileSizeEx(file, &file_size) == 0)
+        {
+            CloseHandle(file);
+            return -1;
+        }
+        length= file_size.QuadPart;
+    }
+
+    HANDLE mapping= CreateFileMappingA(file, NULL, write ? PAGE_READWRITE : PAGE_READONLY,
+        (DWORD) (length >> 32), (DWORD) (length & 0xffffffffu), NULL);
+    if(mapping == NULL)
+    {
+        CloseHandle(file);
+        return -1;
+    }
+
+    void *map= MapViewOfFile(mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T) length);
+    if(map == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return -1;
+    }
+
+    m.map= map;
+    m.size= (size_t) length;
+    m.file= file;
+    m.mapping= mapping;
+    return 0;
+
+#else
+    const int fd= ::open(filename.c_str(), write ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+    if(fd < 0)
+        return -1;
+
+    size_t length= size;
+    if(write)
+    {
+        if(ftruncate(fd, (off_t) size) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct stat info;
+        if(fstat(fd, &info) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        length= (size_t) info.st_size;
+    }
+
+    void *map= mmap(NULL, length, write ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);        // la projection reste valide
+    if(map == MAP_FAILED)
+        return -1;
+
+    // les tuiles sont lues dans le desordre, pas de lecture anticipee
+    if(write == false)
+        madvise(map, length, MADV_RANDOM);
+
+    m.map= map;
+    m.size= length;
+    return 0;
+#endif
+}
+
+void unmap_file( Mapping& m )
+{
+    if(m.map == NULL)
+        return;
+
+#ifdef WIN32
+    UnmapViewOfFile(m.map);
+    CloseHandle((HANDLE) m.mapping);
+    CloseHandle((HANDLE) m.file);
+#else
+    munmap(m.map, m.size);
+#endif
+    m= Mapping();
+}
+
+//! dimension d'un niveau.
+int level_size( const int size, const int level )
+{
+    return std::max(1, (int) (((long long) size + (1ll << level) -1) >> level));
+}
+
+//! nombre de niveaux : le dernier niveau tient dans une seule tuile.
+int level_count( const int width, const int height, const int tile )
+{
+    int levels= 1;
+    while(levels < TiledImage::MAX_LEVELS
+    && (level_size(width, levels -1) > tile || level_size(height, levels -1) > tile))
+        levels++;
+    return levels;
+}
+
+//! description des tuiles d'un fichier.
+struct Layout
+{
+    int width;
+    int height;
+    int tile;
+    int levels;
+    size_t first[TiledImage::MAX_LEVELS +1];
+
+    Layout( const int w, const int h, const int t )
+        :
+        width(w), height(h), tile(t), levels(level_count(w, h, t))
+    {
+        first[0]= 0;
+        for(int l= 0; l < levels; l++)
+            first[l +1]= first[l] + (size_t) tilesX(l) * tilesY(l);
+    }
+
+    int tilesX( const int level ) const
+    {
+        return (level_size(width, level) + tile -1) / tile;
+    }
+
+    int tilesY( const int level ) const
+    {
+        return (level_size(height, level) + tile -1) / tile;
+    }
+
+    size_t tileBytes( ) const
+    {
+        return (size_t) tile * tile * sizeof(HDRPixel);
+    }
+
+    size_t fileSize( ) const
+    {
+        return header_size + first[levels] * tileBytes();
+    }
+
+    HDRPixel *data( void *map, const int level, const int x, const int y ) const
+    {
+        return (HDRPixel *) ((char *) map + header_size + (first[level] + (size_t) y * tilesX(level) + x) * tileBytes());
+    }
+
+    //! renvoie un pixel d'un niveau.
+    const HDRPixel& pixel( void *map, const int level, const int x, const int y ) const
+    {
+        return data(map, level, x / tile, y / tile)[(y % tile) * tile + (x % tile)];
+    }
+};
+
+//! copie une ligne de pixels du niveau 0 dans les tuiles, complete les tuiles du bord.
+void store_row( void *map, const Layout& layout, const int y, const HDRPixel *row )
+{
+    const int tiles= layout.tilesX(0);
+    const int ty= y / layout.tile;
+    const int offset= (y % layout.tile) * layout.tile;
+    for(int tx= 0; tx < tiles; tx++)
+    {
+        HDRPixel *dst= layout.data(map, 0, tx, ty) + offset;
+        const int x0= tx * layout.tile;
+        const int n= std::min(layout.tile, layout.width - x0);
+        std::copy(row + x0, row + x0 + n, dst);
+        for(int x= n; x < layout.tile; x++)
+            dst[x]= row[layout.width -1];
+    }
+}
+
+//! copie une ligne de pixels dans les tuiles, et complete les tuiles du haut en repetant la derniere ligne.
+void store_image_row( void *map, const Layout& layout, const int y, const HDRPixel *row )
+{
+    store_row(map, layout, y, row);
+    if(y != layout.height -1)
+        return;
+
+    const int rows= layout.tilesY(0) * layout.tile;
+    for(int k= layout.height; k < rows; k++)
+        store_row(map, layout, k, row);
+}
+
+//! construit les niveaux 1 et suivants, en moyennant 2x2 pixels du niveau precedent.
+void build_levels( void *map, const Layout& layout )
+{
+    for(int l= 1; l < layout.levels; l++)
+    {
+        const int w= level_size(layout.width, l);
+        const int h= level_size(layout.height, l);
+        const int pw= level_size(layout.width, l -1);
+        const int ph= level_size(layout.height, l -1);
+        const int tiles_x= layout.tilesX(l);
+        const int tiles= tiles_x * layout.tilesY(l);
+
+        #pragma omp parallel for schedule(dynamic)
+        for(int t= 0; t < tiles; t++)
+        {
+            const int tx= t % tiles_x;
+            const int ty= t / tiles_x;
+            HDRPixel *dst= layout.data(map, l, tx, ty);
+
+            for(int y= 0; y < layout.tile; y++)
+            {
+                // les tuiles du bord repetent les derniers pixels
+                const int py= std::min(ty * layout.tile + y, h -1);
+                const int y0= std::min(2*py, ph -1);
+                const int y1= std::min(2*py +1, ph -1);
+
+                for(int x= 0; x < layout.tile; x++)
+                {
+                    const int px= std::min(tx * layout.tile + x, w -1);
+                    const int x0= std::min(2*px, pw -1);
+                    const int x1= std::min(2*px +1, pw -1);
+
+                    const HDRPixel& a= layout.pixel(map, l -1, x0, y0);
+                    const HDRPixel& b= layout.pixel(map, l -1, x1, y0);
+                    const HDRPixel& c= layout.pixel(map, l -1, x0, y1);
+                    const HDRPixel& d= layout.pixel(map, l -1, x1, y1);
+                    dst[y * layout.tile + x]= HDRPixel(
+                        (a.r + b.r + c.r + d.r) * .25f,
+                        (a.g + b.g + c.g + d.g) * .25f,
+                        (a.b + b.b + c.b + d.b) * .25f,
+                        (a.a + b.a + c.a + d.a) * .25f);
+                }
+            }
+        }
+    }
+}
+
+//! ecrit l'entete, en dernier : un fichier incomplet n'est pas reconnu par TiledImage::open().
+void store_header( void *map, const Layout& layout )
+{
+    Header header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version= version;
+    header.width= layout.width;
+    header.height= layout.height;
+    header.tile= layout.tile;
+    header.levels= layout.levels;
+    memcpy(map, &header, sizeof(header));
+}
+
+}       // namespace
+
+
+TiledImage::TiledImage( )
+    :
+    m_map(NULL),
+    m_size(0),
+    m_file(NULL),
+    m_mapping(NULL),
+    m_width(0),
+    m_height(0),
+    m_tile(0),
+    m_levels(0)
+{}
+
+TiledImage::~TiledImage( )
+{
+    close();
+}
+
+int TiledImage::open( const std::string& filename )
+{
+    close();
+
+    Mapping m;
+    if(map_file(filename, false, 0, m) < 0)
+    {
+        printf("TiledImage::open( ): '%s' failed.\n", filename.c_str());
+        return -1;
+    }
+
+    Header header;
+    bool valid= (m.size >= header_size);
+    if(valid)
+    {
+        memcpy(&header, m.map, sizeof(header));
+        valid= (memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version
+            && header.width > 0 && header.height > 0 && header.tile > 0);
+    }
+    if(valid)
+    {
+        const Layout layout(header.width, header.height, header.tile);
+        valid= (header.levels == layout.levels && m.size >= layout.fileSize());
+        for(int l= 0; valid && l < layout.levels; l++)
+            m_first[l]= layout.first[l];
+    }
+    if(valid == false)
+    {
+        printf("TiledImage::open( ): '%s' is not a tiled image.\n", filename.c_str());
+        unmap_file(m);
+        return -1;
+    }
+
+    m_map= m.map;
+    m_size= m.size;
+    m_file= m.file;
+    m_mapping= m.mapping;
+    m_width= header.width;
+    m_height= header.height;
+    m_tile= header.tile;
+    m_levels= header.levels;
+    return 0;
+}
+
+void TiledImage::close( )
+{
+    Mapping m;
+    m.map= m_map;
+    m.size= m_size;
+    m.file= m_file;
+    m.mapping= m_mapping;
+    unmap_file(m);
+
+    m_map= NULL;
+    m_size= 0;
+    m_file= NULL;
+    m_mapping= NULL;
+    m_width= 0;
+    m_height= 0;
+    m_tile= 0;
+    m_levels= 0;
+}
+
+int TiledImage::width( const int level ) const
+{
+    return level_size(m_width, level);
+}
+
+int TiledImage::height( const int level ) const
+{
+    return level_size(m_height, level);
+}
+
+const HDRPixel *TiledImage::tile( const int level, const int x, const int y ) const
+{
+    if(m_map == NULL || level < 0 || level >= m_levels)
+        return NULL;
+    if(x < 0 || x >= tilesX(level) || y < 0 || y >= tilesY(level))
+        return NULL;
+
+    const size_t index= m_first[level] + (size_t) y * tilesX(level) + x;
+    return (const HDRPixel *) ((const char *) m_map + header_size + index * m_tile * m_tile * sizeof(HDRPixel));
+}
+
+int TiledImage::write( const HDRImage *image, const std::string& filename, const int tile )
+{
+    if(image == NULL || tile <= 0)
+        return -1;
+
+    const Layout layout(image->width(), image->height(), tile);
+    Mapping m;
+    if(map_file(filename, true, layout.fileSize(), m) < 0)
+    {
+        printf("TiledImage::write( ): '%s' failed.\n", filename.c_str());
+        return -1;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for(int y= 0; y < layout.height; y++)
+        store_image_row(m.map, layout, y, image->row(y));
+
+    build_levels(m.map, layout);
+    store_header(m.map, layout);
+    unmap_file(m);
+    return 0;
+}
+
+int TiledImage::convert( const std::string& rgbe, const std::string& filename, const int tile )
+{
+    if(tile <= 0)
+        return -1;
+
+    RGBEReader reader;
+    if(reader.open(rgbe) < 0)
+    {
+        printf("TiledImage::convert( ): read error '%s'\n", rgbe.c_str());
+        return -1;
+    }
+
+    const int width= reader.width();
+    const int height= reader.height();
+    const Layout layout(width, height, tile);
+    Mapping m;
+    if(map_file(filename, true, layout.fileSize(), m) < 0)
+    {
+        printf("TiledImage::convert( ): write error '%s'\n", filename.c_str());
+        return -1;
+    }
+
+    // les scanlines sont lues par groupes, directement dans les tuiles du fichier
+    // la premiere scanline du fichier est la derniere ligne de l'image (origine openGL en bas a gauche)
+    const int block= 64;
+    std::vector<HDRPixel> rows((size_t) width * block);
+    int n;
+    while((n= reader.read((float *) &rows.front(), block)) > 0)
+    {
+        const int first= reader.row() - n;
+        #pragma omp parallel for schedule(static)
+        for(int i= 0; i < n; i++)
+            store_image_row(m.map, layout, height -1 - (first + i), &rows[(size_t) i * width]);
+    }
+    reader.close();
+
+    if(n < 0)
+    {
+        unmap_file(m);
+        printf("TiledImage::convert( ): read error '%s'\n", rgbe.c_str());
+        return -1;
+    }
+
+    build_levels(m.map, layout);
+    store_header(m.map, layout);
+    unmap_file(m);
+    return 0;
+}
+
+}       // namespace
@@ -0,0 +1,109 @@
+#ifndef _GK_TILED_IMAGE_H
+#define _GK_TILED_IMAGE_H
+
+#include <cstddef>
+#include <string>
+
+#include "Image.h"
+
+
+namespace gk {
+
+//! image hdr decoupee en tuiles et pyramide de mipmaps, stockee dans un fichier projete en memoire (mmap).
+
+//! permet d'afficher des images trop grandes pour la memoire du gpu (ou de l'application) : seules les tuiles
+//! visibles, au niveau de detail necessaire, sont lues par le systeme et transferees au gpu, cf. TileCache.
+//! format du fichier .gkt : un entete de 4Ko, puis les tuiles de chaque niveau, de gauche a droite, de bas en haut.
+//! chaque tuile contient tile x tile pixels float rgba (HDRPixel), les tuiles du bord sont completees
+//! en repetant les derniers pixels de l'image. les lignes sont rangees de bas en haut, comme HDRImage (origine openGL).
+//! le niveau l+1 est construit en moyennant 2x2 pixels du niveau l, le dernier niveau tient dans une seule tuile.
+/*! exemple d'utilisation :
+\code
+    gk::TiledImage::convert("panorama.hdr", "panorama.gkt");
+
+    gk::TiledImage image;
+    if(image.open("panorama.gkt") < 0)
+        return -1;
+    const gk::HDRPixel *pixels= image.tile(image.levels() -1, 0, 0);
+\endcode
+*/
+class TiledImage
+{
+public:
+    //! nombre maximum de niveaux.
+    enum { MAX_LEVELS= 32 };
+
+private:
+    void *m_map;
+    size_t m_size;
+    void *m_file;               //!< descripteur du fichier, HANDLE sous windows.
+    void *m_mapping;            //!< HANDLE du 'file mapping' sous windows.
+
+    int m_width;
+    int m_height;
+    int m_tile;
+    int m_levels;
+    size_t m_first[MAX_LEVELS]; //!< indice de la premiere tuile de chaque niveau.
+
+    // non copyable
+    TiledImage( const TiledImage& );
+    TiledImage& operator=( const TiledImage& );
+
+public:
+    //! constructeur par defaut, cf. open().
+    TiledImage( );
+
+    //! destructeur, cf. close().
+    ~TiledImage( );
+
+    //! projette le fichier 'filename' en memoire, sans le lire.
+    int open( const std::string& filename );
+
+    //! ferme le fichier.
+    void close( );
+
+    //! renvoie la largeur d'un niveau de l'image.
+    int width( const int level= 0 ) const;
+
+    //! renvoie la hauteur d'un niveau de l'image.
+    int height( const int level= 0 ) const;
+
+    //! renvoie le nombre de niveaux.
+    int levels( ) const
+    {
+        return m_levels;
+    }
+
+    //! renvoie la dimension des tuiles.
+    int tileSize( ) const
+    {
+        return m_tile;
+    }
+
+    //! renvoie le nombre de tuiles d'un niveau, horizontalement.
+    int tilesX( const int level ) const
+    {
+        return (width(level) + m_tile -1) / m_tile;
+    }
+
+    //! renvoie le nombre de tuiles d'un niveau, verticalement.
+    int tilesY( const int level ) const
+    {
+        return (height(level) + m_tile -1) / m_tile;
+    }
+
+    //! renvoie les tileSize() x tileSize() pixels d'une tuile, ou NULL si la tuile n'existe pas.
+    //! les pixels sont lus par le systeme lors du premier acces.
+    const HDRPixel *tile( const int level, const int x, const int y ) const;
+
+    //! decoupe une image et ecrit le fichier 'filename'.
+    static int write( const HDRImage *image, const std::string& filename, const int tile= 256 );
+
+    //! convertit une image .hdr (rgbe) sans la charger completement : les scanlines sont decompressees par groupes, cf. RGBEReader,
+    //! puis copiees dans les tuiles du fichier 'filename'.
+    static int convert( const std::string& rgbe, const std::string& filename, const int tile= 256 );
+};
+
+}       // namespace
+
+#endif
@@ -0,0 +1,169 @@
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+#include "ToneMap.h"
+#include "SIMD.h"
+
+
+namespace gk {
+
+namespace {
+
+//! renvoie la valeur 8 bits d'une composante, comme la conversion d'openGL vers une texture rgba8.
+inline
+unsigned char unorm8( const float v )
+{
+    // !(v > 0) : v negatif ou nan
+    if(!(v > 0.f))
+        return 0;
+    if(v >= 1.f)
+        return 255;
+    return (unsigned char) (v * 255.f + .5f);
+}
+
+}       // namespace
+
+
+int ToneMap::setColors( const Image *colors )
+{
+    if(colors == NULL || colors->width() <= 0 || colors->height() <= 0)
+        return -1;
+
+    // le viewer lit la texture en t= 0.5, entre les 2 lignes du milieu si la hauteur est paire
+    const int width= colors->width();
+    const int r0= (colors->height() - 1) / 2;
+    const int r1= colors->height() / 2;
+    m_colors.resize(3 * width);
+    for(int x= 0; x < width; x++)
+    {
+        const Pixel& a= colors->getPixel(x, r0);
+        const Pixel& b= colors->getPixel(x, r1);
+        m_colors[3*x]= ((float) a.r + (float) b.r) / 510.f;
+        m_colors[3*x +1]= ((float) a.g + (float) b.g) / 510.f;
+        m_colors[3*x +2]= ((float) a.b + (float) b.b) / 510.f;
+    }
+
+    return 0;
+}
+
+void ToneMap::color( const float y, unsigned char *rgb ) const
+{
+    const int width= (int) m_colors.size() / 3;
+    const float x= y / saturation * (float) width - .5f;
+
+    float c[3]= { 0.f, 0.f, 0.f };
+    if(x > -1.f && x < (float) width)
+    {
+        // interpolation lineaire entre 2 texels, noir en dehors de la rampe
+        const int i= (int) floorf(x);
+        const float t= x - (float) i;
+        for(int k= 0; k < 3; k++)
+        {
+            const float a= (i >= 0) ? m_colors[3*i + k] : 0.f;
+            const float b= (i + 1 < width) ? m_colors[3*(i + 1) + k] : 0.f;
+            c[k]= a + (b - a) * t;
+        }
+    }
+
+    rgb[0]= unorm8(c[0]);
+    rgb[1]= unorm8(c[1]);
+    rgb[2]= unorm8(c[2]);
+}
+
+void ToneMap::apply( const float *rgba, const int n, unsigned char *rgb ) const
+{
+    if(heat)
+    {
+        for(int i= 0; i < n; i++)
+        {
+            const float *p= rgba + 4*i;
+            color(.3f * p[0] + .59f * p[1] + .11f * p[2], rgb + 3*i);
+        }
+        return;
+    }
+
+    // (color / y) * k1 * y^(1 / compression) = color * k1 * y^(1 / compression - 1)
+    const float k1= 1.f / powf(saturation, 1.f / compression);
+    const float e= 1.f / compression - 1.f;
+
+    int i= 0;
+#ifdef GK_SSE
+    const __m128 zero= _mm_setzero_ps();
+    const __m128 one= _mm_set1_ps(1.f);
+    const __m128 ymin= _mm_set1_ps(FLT_MIN);
+    const __m128 r_weight= _mm_set1_ps(.3f);
+    const __m128 g_weight= _mm_set1_ps(.59f);
+    const __m128 b_weight= _mm_set1_ps(.11f);
+    const __m128 k1_4= _mm_set1_ps(k1);
+    const __m128 e4= _mm_set1_ps(e);
+    const __m128 saturation4= _mm_set1_ps(saturation);
+    const __m128 scale= _mm_set1_ps(255.f);
+    const __m128 half= _mm_set1_ps(.5f);
+    for(; i + 4 <= n; i+= 4)
+    {
+        __m128 r= _mm_loadu_ps(rgba + 4*i);
+        __m128 g= _mm_loadu_ps(rgba + 4*i + 4);
+        __m128 b= _mm_loadu_ps(rgba + 4*i + 8);
+        __m128 a= _mm_loadu_ps(rgba + 4*i + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        const __m128 y= _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r_weight), _mm_mul_ps(g, g_weight)), _mm_mul_ps(b, b_weight));
+        // y <= 0 ou nan : pixel noir, log2_4() n'accepte que des valeurs normalisees
+        const __m128 valid= _mm_cmpgt_ps(y, ymin);
+        const __m128 s= _mm_and_ps(valid,
+            _mm_mul_ps(k1_4, exp2_4(_mm_mul_ps(log2_4(_mm_max_ps(y, ymin)), e4))));
+
+        // saturation : gris
+        const __m128 over= _mm_cmpgt_ps(y, saturation4);
+        r= select4(over, y, r);
+        g= select4(over, y, g);
+        b= select4(over, y, b);
+
+        // _mm_max_ps(nan, 0) == 0
+        r= _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_mul_ps(r, s), zero), one), scale), half);
+        g= _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_mul_ps(g, s), zero), one), scale), half);
+        b= _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_mul_ps(b, s), zero), one), scale), half);
+        a= zero;
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        // 4 pixels rgbx 8 bits, puis compacte en rgb
+        const __m128i p01= _mm_packs_epi32(_mm_cvttps_epi32(r), _mm_cvttps_epi32(g));
+        const __m128i p23= _mm_packs_epi32(_mm_cvttps_epi32(b), _mm_cvttps_epi32(a));
+        unsigned char tmp[16];
+        _mm_storeu_si128((__m128i *) tmp, _mm_packus_epi16(p01, p23));
+
+        unsigned char *out= rgb + 3*i;
+        memcpy(out, tmp, 3);
+        memcpy(out + 3, tmp + 4, 3);
+        memcpy(out + 6, tmp + 8, 3);
+        memcpy(out + 9, tmp + 12, 3);
+    }
+#endif
+
+    for(; i < n; i++)
+    {
+        const float *p= rgba + 4*i;
+        unsigned char *out= rgb + 3*i;
+
+        const float y= .3f * p[0] + .59f * p[1] + .11f * p[2];
+        if(!(y > FLT_MIN))
+        {
+            out[0]= out[1]= out[2]= 0;
+            continue;
+        }
+
+        const float s= k1 * powf(y, e);
+        if(y > saturation)
+        {
+            out[0]= out[1]= out[2]= unorm8(y * s);
+            continue;
+        }
+
+        out[0]= unorm8(p[0] * s);
+        out[1]= unorm8(p[1] * s);
+        out[2]= unorm8(p[2] * s);
+    }
+}
+
+}       // namespace
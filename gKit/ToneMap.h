@@ -0,0 +1,50 @@
+#ifndef _GK_TONE_MAP_H
+#define _GK_TONE_MAP_H
+
+#include <vector>
+
+#include "Image.h"
+
+
+namespace gk {
+
+//! tone mapping sur le cpu, memes courbes que hdr_tone.gkfx : compression (gamma), saturation, fausses couleurs.
+
+//! luminance y = 0.3 r + 0.59 g + 0.11 b, les pixels plus lumineux que saturation deviennent gris,
+//! couleur = (couleur / y) * k1 * y^(1 / compression), avec k1 = 1 / saturation^(1 / compression) : saturation == blanc.
+//! en mode fausses couleurs (heat), la couleur est lue dans une rampe, a la position y / saturation, interpolation lineaire,
+//! noir en dehors de la rampe, comme la texture du viewer (GL_CLAMP_TO_BORDER).
+//! les pixels sont traites par paquets de 4 (sse), pow() est evalue par exp2(log2()), cf. SIMD.h.
+class ToneMap
+{
+public:
+    float compression;  //!< exposant de compression, y^(1 / compression).
+    float saturation;   //!< luminance affichee en blanc.
+    bool heat;          //!< affiche les fausses couleurs, cf. setColors().
+
+    //! constructeur, valeurs par defaut du viewer.
+    ToneMap( const float _compression= 2.f, const float _saturation= 1.f )
+        :
+        compression(_compression), saturation(_saturation), heat(false),
+        m_colors()
+    {}
+
+    ~ToneMap( ) {}
+
+    //! definit la rampe de fausses couleurs, la ligne du milieu de l'image, cf. false_colors.png.
+    //! \return 0 en cas de succes, -1 en cas d'erreur.
+    int setColors( const Image *colors );
+
+    //! convertit n pixels float rgba en rgb 8 bits, dans rgb[n*3].
+    void apply( const float *rgba, const int n, unsigned char *rgb ) const;
+
+protected:
+    std::vector<float> m_colors;        //!< rampe de fausses couleurs, rgb normalises.
+
+    //! renvoie la fausse couleur d'une luminance.
+    void color( const float y, unsigned char *rgb ) const;
+};
+
+}       // namespace
+
+#endif
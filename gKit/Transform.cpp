@@ -12,8 +12,10 @@
 #include <algorithm>
 #include <iostream>
 #include <cstring>
+#include <cassert>
 
 #include "Transform.h"
+#include "SIMD.h"
 
 namespace gk {
 
@@ -114,6 +116,76 @@ Matrix4x4 Matrix4x4::getInverse() const
 }
 
 
+namespace {
+
+//! produit de 2 matrices affines, la derniere ligne est (0, 0, 0, 1).
+Matrix4x4 MulAffine( const Matrix4x4& a, const Matrix4x4& b )
+{
+    Matrix4x4 r;
+    for(int i= 0; i < 3; i++)
+    {
+        for(int j= 0; j < 3; j++)
+            r.m[i][j]= a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+        r.m[i][3]= a.m[i][0] * b.m[0][3] + a.m[i][1] * b.m[1][3] + a.m[i][2] * b.m[2][3] + a.m[i][3];
+    }
+    
+    return r;
+}
+
+//! produit de 2 translations.
+Matrix4x4 MulTranslation( const Matrix4x4& a, const Matrix4x4& b )
+{
+    Matrix4x4 r;
+    r.m[0][3]= a.m[0][3] + b.m[0][3];
+    r.m[1][3]= a.m[1][3] + b.m[1][3];
+    r.m[2][3]= a.m[2][3] + b.m[2][3];
+    return r;
+}
+
+//! inverse d'une transformation affine : A^-1, -A^-1.t, la partie 3x3 est inversee par les cofacteurs.
+Matrix4x4 InverseAffine( const Matrix4x4& a, const int type )
+{
+    Matrix4x4 r;
+    if(type == Transform::RIGID)
+    {
+        // partie 3x3 orthonormee, inverse == transposee
+        for(int i= 0; i < 3; i++)
+            for(int j= 0; j < 3; j++)
+                r.m[i][j]= a.m[j][i];
+    }
+    else if(type == Transform::AFFINE)
+    {
+        const float c00= a.m[1][1] * a.m[2][2] - a.m[1][2] * a.m[2][1];
+        const float c01= a.m[1][2] * a.m[2][0] - a.m[1][0] * a.m[2][2];
+        const float c02= a.m[1][0] * a.m[2][1] - a.m[1][1] * a.m[2][0];
+        const float det= a.m[0][0] * c00 + a.m[0][1] * c01 + a.m[0][2] * c02;
+        if(det == 0.f)
+        {
+            std::cerr << "Singular matrix in MatrixInvert";
+            return a.getInverse();
+        }
+        
+        const float inv= 1.f / det;
+        r.m[0][0]= c00 * inv;
+        r.m[0][1]= (a.m[0][2] * a.m[2][1] - a.m[0][1] * a.m[2][2]) * inv;
+        r.m[0][2]= (a.m[0][1] * a.m[1][2] - a.m[0][2] * a.m[1][1]) * inv;
+        r.m[1][0]= c01 * inv;
+        r.m[1][1]= (a.m[0][0] * a.m[2][2] - a.m[0][2] * a.m[2][0]) * inv;
+        r.m[1][2]= (a.m[0][2] * a.m[1][0] - a.m[0][0] * a.m[1][2]) * inv;
+        r.m[2][0]= c02 * inv;
+        r.m[2][1]= (a.m[0][1] * a.m[2][0] - a.m[0][0] * a.m[2][1]) * inv;
+        r.m[2][2]= (a.m[0][0] * a.m[1][1] - a.m[0][1] * a.m[1][0]) * inv;
+    }
+    // sinon translation, partie 3x3 identite
+    
+    for(int i= 0; i < 3; i++)
+        r.m[i][3]= -(r.m[i][0] * a.m[0][3] + r.m[i][1] * a.m[1][3] + r.m[i][2] * a.m[2][3]);
+    
+    return r;
+}
+
+}       // namespace
+
 // Transform Method Definitions
 std::ostream &operator<<( std::ostream &os, const Transform &t )
 {
@@ -137,7 +209,7 @@ Transform Translate( const Vector &delta )
         0, 0, 1, -delta.z,
         0, 0, 0,        1 );
     
-    return Transform( m, minv );
+    return Transform( m, minv, Transform::TRANSLATION );
 }
 
 //! renvoie la transformation associee au changement d'echelle (x, y, z).
@@ -155,7 +227,7 @@ Transform Scale( float x, float y, float z )
               0,       0, 1.f / z, 0,
               0,       0,       0, 1 );
     
-    return Transform( m, minv );
+    return Transform( m, minv, Transform::AFFINE );
 }
 
 //! renvoie la transformation associee au changement d'echelle (v, v, v).
@@ -173,7 +245,7 @@ Transform Scale( float v )
               0,       0, 1.f / v, 0,
               0,       0,       0, 1 );
     
-    return Transform( m, minv );
+    return Transform( m, minv, Transform::AFFINE );
 }
 
 
@@ -189,7 +261,7 @@ Transform RotateX( float angle )
         0, sin_t,  cos_t, 0,
         0,     0,      0, 1 );
 
-    return Transform( m, m.Transpose() );
+    return Transform( m, m.Transpose(), Transform::RIGID );
 }
 
 //! renvoie la transformation associee a une rotation autour de l'axe Y, angle est en degres.
@@ -204,7 +276,7 @@ Transform RotateY( float angle )
         -sin_t,   0, cos_t, 0,
              0,   0,     0, 1 );
     
-    return Transform( m, m.Transpose() );
+    return Transform( m, m.Transpose(), Transform::RIGID );
 }
 
 //! renvoie la transformation associee a une rotation autour de l'axe Z, angle est en degres.
@@ -219,7 +291,7 @@ Transform RotateZ( float angle )
             0,      0, 1, 0,
             0,      0, 0, 1 );
     
-    return Transform( m, m.Transpose() );
+    return Transform( m, m.Transpose(), Transform::RIGID );
 }
 
 //! renvoie la transformation associee a une rotation autour d'un vecteur, angle est en degres.
@@ -252,7 +324,7 @@ Transform Rotate( float angle, const Vector &axis )
     m[3][3] = 1;
     
     Matrix4x4 mat( m );
-    return Transform( mat, mat.Transpose() );
+    return Transform( mat, mat.Transpose(), Transform::RIGID );
 }
 
 //! renvoie la transformation camera (View).
@@ -307,7 +379,9 @@ Transform LookAt( const Point &pos, const Point &look, const Vector &up )
     m[3][3] = 1.f;
 
     Matrix4x4 camToWorld(m);
-    return Transform( camToWorld.getInverse(), camToWorld );
+    // right n'est pas normalise, la transformation n'est rigide que si up est orthogonal a dir
+    const int type= Transform::Classify(camToWorld);
+    return Transform( InverseAffine(camToWorld, type), camToWorld, type );
 }
 
 #if 0 // inline
@@ -328,12 +402,57 @@ BBox Transform::operator()( const BBox &b ) const
 }
 #endif
 
+int Transform::Classify( const Matrix4x4& mat )
+{
+    if(mat.m[3][0] != 0.f || mat.m[3][1] != 0.f || mat.m[3][2] != 0.f || mat.m[3][3] != 1.f)
+        return PROJECTIVE;
+    
+    // partie 3x3 : identite ? orthonormee ?
+    bool identity= true;
+    bool rigid= true;
+    for(int i= 0; i < 3; i++)
+        for(int j= 0; j < 3; j++)
+        {
+            if(mat.m[i][j] != (i == j ? 1.f : 0.f))
+                identity= false;
+            
+            const float dot= mat.m[0][i] * mat.m[0][j] + mat.m[1][i] * mat.m[1][j] + mat.m[2][i] * mat.m[2][j];
+            if(fabsf(dot - (i == j ? 1.f : 0.f)) > 1e-5f)
+                rigid= false;
+        }
+    
+    if(identity)
+        return (mat.m[0][3] == 0.f && mat.m[1][3] == 0.f && mat.m[2][3] == 0.f) ? IDENTITY : TRANSLATION;
+    return rigid ? RIGID : AFFINE;
+}
+
+Matrix4x4 Transform::Inverse( const Matrix4x4& mat, const int type )
+{
+    if(type == IDENTITY)
+        return Matrix4x4();
+    else if(type == PROJECTIVE)
+        return mat.getInverse();
+    else
+        return InverseAffine(mat, type);
+}
+
 Transform Transform::operator*( const Transform &t2 ) const
 {
-    Matrix4x4 m1 = Matrix4x4::Mul( m, t2.m );
-    Matrix4x4 m2 = Matrix4x4::Mul( t2.mInv, mInv );
+    if(t2.m_type == IDENTITY)
+        return *this;
+    if(m_type == IDENTITY)
+        return t2;
     
-    return Transform( m1, m2 );
+    const int type= std::max(m_type, t2.m_type);
+    if(type == TRANSLATION)
+    {
+        Matrix4x4 m1= MulTranslation( m, t2.m );
+        return Transform( m1, InverseAffine(m1, type), type );
+    }
+    
+    Matrix4x4 m1= (type == PROJECTIVE) ? Matrix4x4::Mul( m, t2.m ) : MulAffine( m, t2.m );
+    Matrix4x4 m2= (type == PROJECTIVE) ? Matrix4x4::Mul( t2.mInv, mInv ) : MulAffine( t2.mInv, mInv );
+    return Transform( m1, m2, type );
 }
 
 bool Transform::SwapsHandedness() const
@@ -424,4 +543,269 @@ Transform Viewport( float width, float height )
     return Transform(viewport);
 }
 
+// transformations de tableaux.
+// les noyaux travaillent sur 4 elements a la fois (sse), ou 8 (avx) pour les tableaux de coordonnees separees,
+// les elements restants sont transformes un par un.
+
+namespace {
+
+//! coefficients d'une transformation affine ou projective, lignes de la matrice.
+struct BatchMatrix
+{
+    float m[4][4];
+    bool projective;    //!< derniere ligne != (0, 0, 0, 1), division par w.
+    
+    BatchMatrix( const Matrix4x4& mat, const bool transpose, const bool linear )
+    {
+        for(int i= 0; i < 4; i++)
+            for(int j= 0; j < 4; j++)
+                m[i][j]= transpose ? mat.m[j][i] : mat.m[i][j];
+        
+        if(linear)
+        {
+            // normales : partie 3x3 uniquement
+            for(int i= 0; i < 3; i++)
+                m[i][3]= 0.f;
+            m[3][0]= 0.f; m[3][1]= 0.f; m[3][2]= 0.f; m[3][3]= 1.f;
+        }
+        
+        projective= (m[3][0] != 0.f || m[3][1] != 0.f || m[3][2] != 0.f || m[3][3] != 1.f);
+    }
+    
+    void apply( const float x, const float y, const float z, float& tx, float& ty, float& tz ) const
+    {
+        const float xt= m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+        const float yt= m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+        const float zt= m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+        if(projective)
+        {
+            const float wt= m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3];
+            assert( wt != 0.f );
+            const float inv= 1.f / wt;
+            tx= xt * inv; ty= yt * inv; tz= zt * inv;
+        }
+        else
+        {
+            tx= xt; ty= yt; tz= zt;
+        }
+    }
+    
+    unsigned char apply( const float x, const float y, const float z, HPoint& pt ) const
+    {
+        pt.x= m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+        pt.y= m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+        pt.z= m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+        pt.w= m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3];
+        
+        // meme convention que HPoint::isVisible()
+        unsigned char code= 0;
+        if(!(-pt.w < pt.x)) code|= 1;
+        if(!(pt.x < pt.w)) code|= 2;
+        if(!(-pt.w < pt.y)) code|= 4;
+        if(!(pt.y < pt.w)) code|= 8;
+        if(!(-pt.w < pt.z)) code|= 16;
+        if(!(pt.z < pt.w)) code|= 32;
+        return code;
+    }
+};
+
+#ifdef GK_SSE
+//! transforme 4 points (x, y, z) stockes dans des registres.
+inline
+void transform4( const BatchMatrix& mat, const __m128 x, const __m128 y, const __m128 z, 
+    __m128& tx, __m128& ty, __m128& tz, __m128& tw )
+{
+    #define GK_ROW4(r) _mm_add_ps( \
+        _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(mat.m[r][0])), _mm_mul_ps(y, _mm_set1_ps(mat.m[r][1]))), \
+        _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(mat.m[r][2])), _mm_set1_ps(mat.m[r][3])))
+    
+    tx= GK_ROW4(0);
+    ty= GK_ROW4(1);
+    tz= GK_ROW4(2);
+    tw= GK_ROW4(3);
+    #undef GK_ROW4
+}
+#endif
+
+//! transforme n triplets (x, y, z) contigus.
+void transformAoS( const BatchMatrix& mat, const int n, const float *p, float *pt )
+{
+    int blocks= 0;
+#ifdef GK_SSE
+    blocks= n / 4;
+    #pragma omp parallel for if(blocks > 16384)
+    for(int b= 0; b < blocks; b++)
+    {
+        __m128 x, y, z, tx, ty, tz, tw;
+        load3x4(p + 12*b, x, y, z);
+        transform4(mat, x, y, z, tx, ty, tz, tw);
+        if(mat.projective)
+        {
+            const __m128 inv= _mm_div_ps(_mm_set1_ps(1.f), tw);
+            tx= _mm_mul_ps(tx, inv);
+            ty= _mm_mul_ps(ty, inv);
+            tz= _mm_mul_ps(tz, inv);
+        }
+        store3x4(pt + 12*b, tx, ty, tz);
+    }
+#endif
+    
+    for(int i= blocks * 4; i < n; i++)
+        mat.apply(p[3*i], p[3*i +1], p[3*i +2], pt[3*i], pt[3*i +1], pt[3*i +2]);
+}
+
+//! transforme n points stockes en tableaux de coordonnees separees.
+void transformSoA( const BatchMatrix& mat, const int n, const float *x, const float *y, const float *z, 
+    float *tx, float *ty, float *tz )
+{
+    int first= 0;
+#if defined(GK_SSE) && defined(__AVX__)
+    {
+        const int blocks= n / 8;
+        #pragma omp parallel for if(blocks > 8192)
+        for(int b= 0; b < blocks; b++)
+        {
+            const int i= 8*b;
+            const __m256 px= _mm256_loadu_ps(x + i);
+            const __m256 py= _mm256_loadu_ps(y + i);
+            const __m256 pz= _mm256_loadu_ps(z + i);
+            
+            #define GK_ROW8(r) _mm256_add_ps( \
+                _mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(mat.m[r][0])), _mm256_mul_ps(py, _mm256_set1_ps(mat.m[r][1]))), \
+                _mm256_add_ps(_mm256_mul_ps(pz, _mm256_set1_ps(mat.m[r][2])), _mm256_set1_ps(mat.m[r][3])))
+            
+            __m256 rx= GK_ROW8(0);
+            __m256 ry= GK_ROW8(1);
+            __m256 rz= GK_ROW8(2);
+            if(mat.projective)
+            {
+                const __m256 inv= _mm256_div_ps(_mm256_set1_ps(1.f), GK_ROW8(3));
+                rx= _mm256_mul_ps(rx, inv);
+                ry= _mm256_mul_ps(ry, inv);
+                rz= _mm256_mul_ps(rz, inv);
+            }
+            #undef GK_ROW8
+            
+            _mm256_storeu_ps(tx + i, rx);
+            _mm256_storeu_ps(ty + i, ry);
+            _mm256_storeu_ps(tz + i, rz);
+        }
+        first= blocks * 8;
+    }
+#endif
+
+#ifdef GK_SSE
+    {
+        const int blocks= (n - first) / 4;
+        #pragma omp parallel for if(blocks > 16384)
+        for(int b= 0; b < blocks; b++)
+        {
+            const int i= first + 4*b;
+            __m128 rx, ry, rz, rw;
+            transform4(mat, _mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i), rx, ry, rz, rw);
+            if(mat.projective)
+            {
+                const __m128 inv= _mm_div_ps(_mm_set1_ps(1.f), rw);
+                rx= _mm_mul_ps(rx, inv);
+                ry= _mm_mul_ps(ry, inv);
+                rz= _mm_mul_ps(rz, inv);
+            }
+            
+            _mm_storeu_ps(tx + i, rx);
+            _mm_storeu_ps(ty + i, ry);
+            _mm_storeu_ps(tz + i, rz);
+        }
+        first+= blocks * 4;
+    }
+#endif
+    
+    for(int i= first; i < n; i++)
+        mat.apply(x[i], y[i], z[i], tx[i], ty[i], tz[i]);
+}
+
+}       // namespace
+
+void Transform::operator()( const int n, const Point *p, Point *pt ) const
+{
+    assert(sizeof(Point) == 3 * sizeof(float));
+    transformAoS(BatchMatrix(m, false, false), n, &p[0].x, &pt[0].x);
+}
+
+void Transform::operator()( const int n, const Normal *normals, Normal *nt ) const
+{
+    assert(sizeof(Normal) == 3 * sizeof(float));
+    transformAoS(BatchMatrix(inverseMatrix(), true, true), n, &normals[0].x, &nt[0].x);
+}
+
+int Transform::operator()( const int n, const Point *p, HPoint *pt, unsigned char *clip ) const
+{
+    assert(sizeof(Point) == 3 * sizeof(float));
+    assert(sizeof(HPoint) == 4 * sizeof(float));
+    const BatchMatrix mat(m, false, false);
+    const float *in= &p[0].x;
+    
+    int visible= 0;
+    int blocks= 0;
+#ifdef GK_SSE
+    blocks= n / 4;
+    #pragma omp parallel for if(blocks > 16384) reduction(+: visible)
+    for(int b= 0; b < blocks; b++)
+    {
+        __m128 x, y, z, w;
+        load3x4(in + 12*b, x, y, z);
+        transform4(mat, x, y, z, x, y, z, w);
+        
+        // codes de clipping, 1 bit par point et par plan, cf. HPoint::isVisible()
+        const __m128 nw= _mm_sub_ps(_mm_setzero_ps(), w);
+        const int planes[6]= {
+            _mm_movemask_ps(_mm_cmpnlt_ps(nw, x)), _mm_movemask_ps(_mm_cmpnlt_ps(x, w)),
+            _mm_movemask_ps(_mm_cmpnlt_ps(nw, y)), _mm_movemask_ps(_mm_cmpnlt_ps(y, w)),
+            _mm_movemask_ps(_mm_cmpnlt_ps(nw, z)), _mm_movemask_ps(_mm_cmpnlt_ps(z, w))
+        };
+        
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&pt[4*b].x, x);
+        _mm_storeu_ps(&pt[4*b +1].x, y);
+        _mm_storeu_ps(&pt[4*b +2].x, z);
+        _mm_storeu_ps(&pt[4*b +3].x, w);
+        
+        for(int k= 0; k < 4; k++)
+        {
+            unsigned char code= 0;
+            for(int i= 0; i < 6; i++)
+                code|= (unsigned char) (((planes[i] >> k) & 1) << i);
+            
+            if(clip != NULL)
+                clip[4*b + k]= code;
+            if(code == 0)
+                visible++;
+        }
+    }
+#endif
+    
+    for(int i= blocks * 4; i < n; i++)
+    {
+        const unsigned char code= mat.apply(in[3*i], in[3*i +1], in[3*i +2], pt[i]);
+        if(clip != NULL)
+            clip[i]= code;
+        if(code == 0)
+            visible++;
+    }
+    
+    return visible;
+}
+
+void Transform::transformPoints( const int n, const float *x, const float *y, const float *z, 
+    float *tx, float *ty, float *tz ) const
+{
+    transformSoA(BatchMatrix(m, false, false), n, x, y, z, tx, ty, tz);
+}
+
+void Transform::transformNormals( const int n, const float *x, const float *y, const float *z, 
+    float *tx, float *ty, float *tz ) const
+{
+    transformSoA(BatchMatrix(inverseMatrix(), true, true), n, x, y, z, tx, ty, tz);
+}
+
+
 } // namespace
@@ -263,33 +263,70 @@ struct Matrix4x4
 
 // Transform Declarations
 //! representation d'une transformation == un changement de repere, du repere '1' vers le repere '2'. 
+
+//! la transformation connait son type (identite, translation, rigide, affine, projective) ce qui permet d'utiliser
+//! des versions specialisees de la composition, de l'inversion et de l'application aux points.
+//! la matrice inverse est calculee par les constructeurs, en fonction du type : une transformation constante
+//! peut etre partagee entre plusieurs threads.
 class Transform
 {
 public:
+    //! types de transformations, du plus simple au plus general. la composition de 2 transformations est du type le plus general.
+    enum 
+    {
+        IDENTITY= 0,    //!< identite.
+        TRANSLATION,    //!< translation uniquement.
+        RIGID,          //!< rotation + translation, partie 3x3 orthonormee.
+        AFFINE,         //!< partie 3x3 quelconque + translation, derniere ligne (0, 0, 0, 1).
+        PROJECTIVE      //!< cas general.
+    };
+    
     // Transform Public Methods
     //! constructeur par defaut, transformation identite.
-    Transform( ) {}
+    Transform( ) 
+        :
+        m(), mInv(), m_type(IDENTITY)
+    {}
     
     //! construction a partir d'une matrice representee par un tableau 2d de reels.
     Transform( float mat[4][4] )
+        :
+        m(mat), mInv(), m_type(Classify(m))
     {
-        m= Matrix4x4(mat);
-        mInv = m.getInverse();
+        mInv= Inverse(m, m_type);
     }
     
     //! construction a partir d'une matrice.
     Transform( const Matrix4x4& mat )
+        :
+        m(mat), mInv(), m_type(Classify(m))
     {
-        m = mat;
-        mInv = m.getInverse();
+        mInv= Inverse(m, m_type);
     }
     
     //! construction a partir d'une matrice et de son inverse.
     Transform( const Matrix4x4& mat, const Matrix4x4& minv )
-    {
-        m = mat;
-        mInv = minv;
-    }
+        :
+        m(mat), mInv(minv), m_type(Classify(m))
+    {}
+    
+    //! construction a partir d'une matrice, de son inverse et de son type, cf. IDENTITY, etc.
+    Transform( const Matrix4x4& mat, const Matrix4x4& minv, const int type )
+        :
+        m(mat), mInv(minv), m_type(type)
+    {}
+    
+    //! construction a partir d'une matrice et de son type, l'inverse est calculee en fonction du type.
+    Transform( const Matrix4x4& mat, const int type )
+        :
+        m(mat), mInv(Inverse(mat, type)), m_type(type)
+    {}
+    
+    //! determine le type d'une matrice, cf. IDENTITY, etc.
+    static int Classify( const Matrix4x4& mat );
+    
+    //! calcule l'inverse d'une matrice, en fonction de son type, cf. IDENTITY, etc.
+    static Matrix4x4 Inverse( const Matrix4x4& mat, const int type );
     
     friend std::ostream &operator<<( std::ostream &, const Transform & );
     
@@ -305,6 +342,18 @@ public:
         *this= Transform();
     }
     
+    //! renvoie le type de la transformation, cf. IDENTITY, etc.
+    int type( ) const
+    {
+        return m_type;
+    }
+    
+    //! renvoie vrai si la derniere ligne de la matrice est (0, 0, 0, 1).
+    bool isAffine( ) const
+    {
+        return (m_type != PROJECTIVE);
+    }
+    
     //! renvoie la transformation sous forme de matrice openGL, utilisable directement avec glLoadTransposeMatrixf();
     const Matrix4x4& getGLTransposeMatrix( ) const
     {
@@ -326,13 +375,13 @@ public:
     //! renvoie la matrice de rotation rigide associee a la transformation directe = inverse transpose
     Matrix4x4 rotationMatrix( ) const
     {
-        return mInv.Transpose();
+        return inverseMatrix().Transpose();
     }
     
     //! renvoie la transformation inverse.
     Transform getInverse() const
     {
-        return Transform( mInv, m );
+        return Transform( inverseMatrix(), m, m_type );
     }
     
     //! \name transformations de points, vecteurs, normales, rayons, aabox. passage du repere '1' au repere '2'.
@@ -354,6 +403,26 @@ public:
     BBox operator()( const BBox &b ) const;
     // @}
 
+    //! \name transformations de tableaux de points, normales. passage du repere '1' au repere '2'.
+    //! les tableaux source et resultat peuvent etre identiques (transformation en place). 
+    // @{
+    //! transforme n points.
+    void operator()( const int n, const Point *p, Point *pt ) const;
+    //! transforme n normales, par l'inverse transpose.
+    void operator()( const int n, const Normal *normals, Normal *nt ) const;
+    //! transforme n points en points homogenes et calcule leur code de clipping, 0 si le point est visible, cf. HPoint::isVisible().
+    //! bits du code : 1 x < -w, 2 x > w, 4 y < -w, 8 y > w, 16 z < -w, 32 z > w. clip peut etre NULL.
+    //! renvoie le nombre de points visibles.
+    int operator()( const int n, const Point *p, HPoint *pt, unsigned char *clip ) const;
+
+    //! transforme n points stockes en tableaux de coordonnees separees (x, y, z).
+    void transformPoints( const int n, const float *x, const float *y, const float *z, 
+        float *tx, float *ty, float *tz ) const;
+    //! transforme n normales stockees en tableaux de coordonnees separees (x, y, z), par l'inverse transpose.
+    void transformNormals( const int n, const float *x, const float *y, const float *z, 
+        float *tx, float *ty, float *tz ) const;
+    // @}
+
     //! \name transformations inverses de points, vecteurs, normales, rayons, aabox. passage du repere '2' vers le repere '1'.
     // @{
     inline Point inverse( const Point &p ) const;
@@ -379,12 +448,12 @@ public:
 protected:
     // Transform Private Data
     //! les matrices directe et inverse de changement de repere.
-    Matrix4x4 m, mInv;
+    Matrix4x4 m;
+    Matrix4x4 mInv;
+    int m_type;                 //!< type de la transformation, cf. IDENTITY, etc.
 };
 
-/* \todo creer RigidTransform qui ne construit que la matrice directe R.T et le constructeur Transform( const RigidTransform& )= { R.T, -T.R-1 }
-    modifier RotateXYZ Scale et Translate pour construire une RigidTransform
-    ajouter X= Transform::inverse( const X& ) pour obtenir la transformation inverse au lieu de X= Transform::getInverse()(X)
+/* \todo ajouter X= Transform::inverse( const X& ) pour obtenir la transformation inverse au lieu de X= Transform::getInverse()(X)
 
     deplacer les operateurs de transformations operator( const X& ) (point, vecteur, normale, etc.) dans la classe Matrix4x4 
 */
@@ -415,8 +484,10 @@ Point Transform::operator()( const Point &p ) const
     const float xt = m.m[0][0] * x + m.m[0][1] * y + m.m[0][2] * z + m.m[0][3];
     const float yt = m.m[1][0] * x + m.m[1][1] * y + m.m[1][2] * z + m.m[1][3];
     const float zt = m.m[2][0] * x + m.m[2][1] * y + m.m[2][2] * z + m.m[2][3];
-    const float wt = m.m[3][0] * x + m.m[3][1] * y + m.m[3][2] * z + m.m[3][3];
+    if( m_type != PROJECTIVE )
+        return Point( xt, yt, zt );
     
+    const float wt = m.m[3][0] * x + m.m[3][1] * y + m.m[3][2] * z + m.m[3][3];
     assert( wt != 0 );
     if( wt == 1.f ) 
         return Point( xt, yt, zt );
@@ -435,6 +506,8 @@ void Transform::operator()( const Point &p, Point &pt ) const
     pt.x = m.m[0][0] * x + m.m[0][1] * y + m.m[0][2] * z + m.m[0][3];
     pt.y = m.m[1][0] * x + m.m[1][1] * y + m.m[1][2] * z + m.m[1][3];
     pt.z = m.m[2][0] * x + m.m[2][1] * y + m.m[2][2] * z + m.m[2][3];
+    if( m_type != PROJECTIVE )
+        return;
     
     const float wt = m.m[3][0] * x + m.m[3][1] * y + m.m[3][2] * z + m.m[3][3];
     assert( wt != 0 );
@@ -514,26 +587,28 @@ void Transform::operator()( const Vector &v, Vector &vt ) const
 inline 
 Normal Transform::operator()( const Normal &n ) const
 {
+    const Matrix4x4& inv= inverseMatrix();
     const float x = n.x;
     const float y = n.y;
     const float z = n.z;
     
     return Normal( 
-        mInv.m[0][0] * x + mInv.m[1][0] * y + mInv.m[2][0] * z,
-        mInv.m[0][1] * x + mInv.m[1][1] * y + mInv.m[2][1] * z,
-        mInv.m[0][2] * x + mInv.m[1][2] * y + mInv.m[2][2] * z);
+        inv.m[0][0] * x + inv.m[1][0] * y + inv.m[2][0] * z,
+        inv.m[0][1] * x + inv.m[1][1] * y + inv.m[2][1] * z,
+        inv.m[0][2] * x + inv.m[1][2] * y + inv.m[2][2] * z);
 }
 
 inline 
 void Transform::operator()( const Normal &n, Normal& nt ) const
 {
+    const Matrix4x4& inv= inverseMatrix();
     const float x = n.x;
     const float y = n.y;
     const float z = n.z;
     
-    nt.x = mInv.m[0][0] * x + mInv.m[1][0] * y + mInv.m[2][0] * z;
-    nt.y = mInv.m[0][1] * x + mInv.m[1][1] * y + mInv.m[2][1] * z;
-    nt.z = mInv.m[0][2] * x + mInv.m[1][2] * y + mInv.m[2][2] * z;
+    nt.x = inv.m[0][0] * x + inv.m[1][0] * y + inv.m[2][0] * z;
+    nt.y = inv.m[0][1] * x + inv.m[1][1] * y + inv.m[2][1] * z;
+    nt.z = inv.m[0][2] * x + inv.m[1][2] * y + inv.m[2][2] * z;
 }
 
 #if 1
@@ -573,15 +648,18 @@ void Transform::operator()( const Ray &ray, Ray &rt ) const
 inline 
 Point Transform::inverse( const Point &p ) const
 {
+    const Matrix4x4& inv= inverseMatrix();
     const float x = p.x;
     const float y = p.y;
     const float z = p.z;
     
-    const float xt = mInv.m[0][0] * x + mInv.m[0][1] * y + mInv.m[0][2] * z + mInv.m[0][3];
-    const float yt = mInv.m[1][0] * x + mInv.m[1][1] * y + mInv.m[1][2] * z + mInv.m[1][3];
-    const float zt = mInv.m[2][0] * x + mInv.m[2][1] * y + mInv.m[2][2] * z + mInv.m[2][3];
-    const float wt = mInv.m[3][0] * x + mInv.m[3][1] * y + mInv.m[3][2] * z + mInv.m[3][3];
+    const float xt = inv.m[0][0] * x + inv.m[0][1] * y + inv.m[0][2] * z + inv.m[0][3];
+    const float yt = inv.m[1][0] * x + inv.m[1][1] * y + inv.m[1][2] * z + inv.m[1][3];
+    const float zt = inv.m[2][0] * x + inv.m[2][1] * y + inv.m[2][2] * z + inv.m[2][3];
+    if( m_type != PROJECTIVE )
+        return Point( xt, yt, zt );
     
+    const float wt = inv.m[3][0] * x + inv.m[3][1] * y + inv.m[3][2] * z + inv.m[3][3];
     assert( wt != 0 );
     if( wt == 1.f ) 
         return Point( xt, yt, zt );
@@ -593,15 +671,18 @@ Point Transform::inverse( const Point &p ) const
 inline 
 void Transform::inverse( const Point &p, Point &pt ) const
 {
+    const Matrix4x4& inv= inverseMatrix();
     const float x = p.x;
     const float y = p.y;
     const float z = p.z;
     
-    pt.x = mInv.m[0][0] * x + mInv.m[0][1] * y + mInv.m[0][2] * z + mInv.m[0][3];
-    pt.y = mInv.m[1][0] * x + mInv.m[1][1] * y + mInv.m[1][2] * z + mInv.m[1][3];
-    pt.z = mInv.m[2][0] * x + mInv.m[2][1] * y + mInv.m[2][2] * z + mInv.m[2][3];
+    pt.x = inv.m[0][0] * x + inv.m[0][1] * y + inv.m[0][2] * z + inv.m[0][3];
+    pt.y = inv.m[1][0] * x + inv.m[1][1] * y + inv.m[1][2] * z + inv.m[1][3];
+    pt.z = inv.m[2][0] * x + inv.m[2][1] * y + inv.m[2][2] * z + inv.m[2][3];
+    if( m_type != PROJECTIVE )
+        return;
     
-    const float wt = mInv.m[3][0] * x + mInv.m[3][1] * y + mInv.m[3][2] * z + mInv.m[3][3];
+    const float wt = inv.m[3][0] * x + inv.m[3][1] * y + inv.m[3][2] * z + inv.m[3][3];
     assert( wt != 0 );
     if( wt != 1.f ) 
         pt /= wt;
@@ -610,39 +691,42 @@ void Transform::inverse( const Point &p, Point &pt ) const
 inline 
 void Transform::inverse( const Point &p, HPoint &pt ) const
 {
+    const Matrix4x4& inv= inverseMatrix();
     const float x = p.x;
     const float y = p.y;
     const float z = p.z;
     
-    pt.x = mInv.m[0][0] * x + mInv.m[0][1] * y + mInv.m[0][2] * z + mInv.m[0][3];
-    pt.y = mInv.m[1][0] * x + mInv.m[1][1] * y + mInv.m[1][2] * z + mInv.m[1][3];
-    pt.z = mInv.m[2][0] * x + mInv.m[2][1] * y + mInv.m[2][2] * z + mInv.m[2][3];
-    pt.w = mInv.m[3][0] * x + mInv.m[3][1] * y + mInv.m[3][2] * z + mInv.m[3][3];
+    pt.x = inv.m[0][0] * x + inv.m[0][1] * y + inv.m[0][2] * z + inv.m[0][3];
+    pt.y = inv.m[1][0] * x + inv.m[1][1] * y + inv.m[1][2] * z + inv.m[1][3];
+    pt.z = inv.m[2][0] * x + inv.m[2][1] * y + inv.m[2][2] * z + inv.m[2][3];
+    pt.w = inv.m[3][0] * x + inv.m[3][1] * y + inv.m[3][2] * z + inv.m[3][3];
 }
 
 inline 
 Vector Transform::inverse( const Vector &v ) const
 {
+    const Matrix4x4& inv= inverseMatrix();
     const float x = v.x;
     const float y = v.y;
     const float z = v.z;
     
     return Vector( 
-        mInv.m[0][0] * x + mInv.m[0][1] * y + mInv.m[0][2] * z,
-        mInv.m[1][0] * x + mInv.m[1][1] * y + mInv.m[1][2] * z,
-        mInv.m[2][0] * x + mInv.m[2][1] * y + mInv.m[2][2] * z);
+        inv.m[0][0] * x + inv.m[0][1] * y + inv.m[0][2] * z,
+        inv.m[1][0] * x + inv.m[1][1] * y + inv.m[1][2] * z,
+        inv.m[2][0] * x + inv.m[2][1] * y + inv.m[2][2] * z);
 }
 
 inline 
 void Transform::inverse( const Vector &v, Vector &vt ) const
 {
+    const Matrix4x4& inv= inverseMatrix();
     const float x = v.x;
     const float y = v.y;
     const float z = v.z;
     
-    vt.x = mInv.m[0][0] * x + mInv.m[0][1] * y + mInv.m[0][2] * z;
-    vt.y = mInv.m[1][0] * x + mInv.m[1][1] * y + mInv.m[1][2] * z;
-    vt.z = mInv.m[2][0] * x + mInv.m[2][1] * y + mInv.m[2][2] * z;
+    vt.x = inv.m[0][0] * x + inv.m[0][1] * y + inv.m[0][2] * z;
+    vt.y = inv.m[1][0] * x + inv.m[1][1] * y + inv.m[1][2] * z;
+    vt.z = inv.m[2][0] * x + inv.m[2][1] * y + inv.m[2][2] * z;
 }
 
 inline 
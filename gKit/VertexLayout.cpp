@@ -0,0 +1,177 @@
+
+#include <cstdio>
+#include <cstring>
+
+#include "VertexLayout.h"
+#include "BufferManager.h"
+#include "GL/TPShaderProgram.h"
+
+
+namespace gk {
+
+namespace {
+
+//! source d'un attribut : count elements de size floats.
+struct AttributeSource
+{
+    const float *data;
+    int size;
+    int count;
+    
+    AttributeSource( const float *_data, const int _size, const int _count )
+        :
+        data(_data), size(_size), count(_count)
+    {}
+};
+
+//! recherche un attribut standard ou un MeshBuffer. renvoie -1 s'il n'existe pas.
+int findSource( const Mesh& mesh, const Name& semantic, const float *& data, int& size, int& count )
+{
+    if(semantic == Name("position"))
+    {
+        data= mesh.positions().empty() ? NULL : &mesh.positions().front().x;
+        size= 3;
+        count= mesh.positionCount();
+        return 0;
+    }
+    if(semantic == Name("normal"))
+    {
+        data= mesh.normals().empty() ? NULL : &mesh.normals().front().x;
+        size= 3;
+        count= (int) mesh.normals().size();
+        return 0;
+    }
+    if(semantic == Name("texcoord"))
+    {
+        data= mesh.texCoords().empty() ? NULL : &mesh.texCoords().front().x;
+        size= 2;
+        count= (int) mesh.texCoords().size();
+        return 0;
+    }
+    
+    for(int i= 0; i < mesh.bufferCount(); i++)
+    {
+        const MeshBuffer *buffer= mesh.buffer(i);
+        if(buffer->semantic == semantic)
+        {
+            data= buffer->data.empty() ? NULL : &buffer->data.front();
+            size= buffer->size;
+            count= buffer->count;
+            return 0;
+        }
+    }
+    
+    return -1;
+}
+
+}       // namespace
+
+
+int VertexLayout::build( const Mesh& mesh, const std::vector<Name>& semantics )
+{
+    m_attributes.clear();
+    m_storage.clear();
+    m_offset= 0;
+    m_stride= 0;
+    m_count= mesh.positionCount();
+    
+    // compile la description des sommets
+    std::vector<AttributeSource> sources;
+    unsigned int offset= 0;
+    for(unsigned int i= 0; i < semantics.size(); i++)
+    {
+        const float *data= NULL;
+        int size= 0;
+        int count= 0;
+        if(findSource(mesh, semantics[i], data, size, count) < 0)
+        {
+            printf("VertexLayout::build( ): attribute '%s' not found.\n", semantics[i].c_str());
+            m_attributes.clear();
+            m_count= 0;
+            return -1;
+        }
+        if(count != m_count)
+        {
+            printf("VertexLayout::build( ): attribute '%s', %d elements, expected %d.\n", semantics[i].c_str(), count, m_count);
+            m_attributes.clear();
+            m_count= 0;
+            return -1;
+        }
+        
+        m_attributes.push_back( VertexAttribute(semantics[i], size, offset) );
+        sources.push_back( AttributeSource(data, size, count) );
+        offset+= size * sizeof(float);
+    }
+    
+    m_stride= (offset + 15) & ~15u;
+    if(m_count == 0 || m_stride == 0)
+        return 0;
+    
+    // alloue le buffer, aligne sur 16 octets, le remplissage est initialise a 0
+    m_storage.assign((size_t) m_count * m_stride + 15, 0);
+    m_offset= (16 - ((size_t) &m_storage.front() & 15)) & 15;
+    
+    // entrelace les attributs
+    unsigned char *vertices= &m_storage[m_offset];
+    const int attributes= (int) sources.size();
+    #pragma omp parallel for if(m_count > 65536)
+    for(int i= 0; i < m_count; i++)
+    {
+        unsigned char *vertex= vertices + (size_t) i * m_stride;
+        for(int k= 0; k < attributes; k++)
+            memcpy(vertex + m_attributes[k].offset, sources[k].data + (size_t) i * sources[k].size, sources[k].size * sizeof(float));
+    }
+    
+    return 0;
+}
+
+int VertexLayout::build( const Mesh& mesh )
+{
+    std::vector<Name> semantics;
+    semantics.push_back( Name("position") );
+    if(mesh.normals().empty() == false)
+        semantics.push_back( Name("normal") );
+    if(mesh.texCoords().empty() == false)
+        semantics.push_back( Name("texcoord") );
+    for(int i= 0; i < mesh.bufferCount(); i++)
+        if(mesh.buffer(i)->count > 0)
+            semantics.push_back( mesh.buffer(i)->semantic );
+    
+    return build(mesh, semantics);
+}
+
+const VertexAttribute *VertexLayout::findAttribute( const Name& semantic ) const
+{
+    for(unsigned int i= 0; i < m_attributes.size(); i++)
+        if(m_attributes[i].semantic == semantic)
+            return &m_attributes[i];
+    return NULL;
+}
+
+GLAttributeBuffer *VertexLayout::createBuffer( const GLenum usage ) const
+{
+    if(m_count == 0 || m_stride == 0)
+        return NULL;
+    return createAttributeBuffer(m_count, size(), data(), usage);
+}
+
+int VertexLayout::bind( const GLShaderProgram *program, GLAttributeBuffer *buffer ) const
+{
+    if(program == NULL || buffer == NULL)
+        return -1;
+    
+    int count= 0;
+    for(unsigned int i= 0; i < m_attributes.size(); i++)
+    {
+        const ProgramAttribute attribute= program->attribute(m_attributes[i].semantic.c_str());
+        if(attribute.location() < 0)
+            continue;
+        
+        setVertexBuffer(attribute, buffer, m_attributes[i].layout(m_stride));
+        count++;
+    }
+    
+    return count;
+}
+
+}       // namespace
@@ -0,0 +1,132 @@
+#ifndef _GK_VERTEX_LAYOUT_H
+#define _GK_VERTEX_LAYOUT_H
+
+#include <vector>
+
+#include "Mesh.h"
+#include "Name.h"
+#include "GL/GLPlatform.h"
+#include "GL/TPAttributes.h"
+#include "GL/TPBuffer.h"
+
+
+namespace gk {
+
+class GLShaderProgram;
+
+//! description d'un attribut dans un ensemble de sommets entrelaces, cf. VertexLayout.
+struct VertexAttribute
+{
+    Name semantic;              //!< nom de l'attribut, le meme que dans les shaders.
+    int size;                   //!< 1, 2, 3, 4, nombre de composantes float.
+    unsigned int offset;        //!< position de l'attribut dans le sommet, en octets.
+    
+    VertexAttribute( )
+        :
+        semantic(), size(0), offset(0)
+    {}
+    
+    VertexAttribute( const Name& _semantic, const int _size, const unsigned int _offset )
+        :
+        semantic(_semantic), size(_size), offset(_offset)
+    {}
+    
+    //! description de l'attribut pour glVertexAttribPointer(), cf. BufferLayout.
+    BufferLayout layout( const unsigned int stride ) const
+    {
+        return BufferLayout(size, GL_FLOAT, stride, offset);
+    }
+};
+
+//! construction d'un buffer unique de sommets entrelaces a partir des attributs d'un Mesh.
+//! les attributs sont selectionnes par leur nom : "position", "normal", "texcoord" designent les attributs standards du Mesh, 
+//! les autres noms les MeshBuffer correspondants. la taille d'un sommet est un multiple de 16 octets, et le debut du buffer est 
+//! aligne sur 16 octets.
+//! un seul GLAttributeBuffer est cree, et chaque attribut est associe a la variable de meme nom du shader, cf. bind().
+class VertexLayout
+{
+    std::vector<VertexAttribute> m_attributes;
+    std::vector<unsigned char> m_storage;
+    unsigned int m_offset;      //!< alignement du debut des sommets dans m_storage.
+    unsigned int m_stride;
+    int m_count;
+    
+    // non copyable
+    VertexLayout( const VertexLayout& );
+    VertexLayout& operator=( const VertexLayout& );
+    
+public:
+    VertexLayout( )
+        :
+        m_attributes(), m_storage(), 
+        m_offset(0), m_stride(0), m_count(0)
+    {}
+    
+    //! construction, cf. build().
+    VertexLayout( const Mesh& mesh, const std::vector<Name>& semantics )
+        :
+        m_attributes(), m_storage(), 
+        m_offset(0), m_stride(0), m_count(0)
+    {
+        build(mesh, semantics);
+    }
+    
+    ~VertexLayout( ) {}
+    
+    //! entrelace les attributs 'semantics' du maillage, dans l'ordre. 
+    //! renvoie -1 si un attribut n'existe pas ou si les attributs n'ont pas tous autant d'elements que de positions.
+    int build( const Mesh& mesh, const std::vector<Name>& semantics );
+    
+    //! entrelace tous les attributs non vides du maillage : positions, normales, coordonnees de texture, puis les MeshBuffer.
+    int build( const Mesh& mesh );
+    
+    //! renvoie le nombre de sommets.
+    int vertexCount( ) const
+    {
+        return m_count;
+    }
+    
+    //! renvoie la taille d'un sommet, en octets, multiple de 16.
+    unsigned int stride( ) const
+    {
+        return m_stride;
+    }
+    
+    //! renvoie le nombre d'attributs.
+    int attributeCount( ) const
+    {
+        return (int) m_attributes.size();
+    }
+    
+    //! renvoie la description d'un attribut.
+    const VertexAttribute& attribute( const int id ) const
+    {
+        return m_attributes[id];
+    }
+    
+    //! renvoie la description d'un attribut ou NULL s'il n'existe pas.
+    const VertexAttribute *findAttribute( const Name& semantic ) const;
+    
+    //! renvoie les sommets entrelaces, aligne sur 16 octets.
+    const void *data( ) const
+    {
+        return m_storage.empty() ? NULL : &m_storage[m_offset];
+    }
+    
+    //! renvoie la taille des sommets entrelaces, en octets.
+    unsigned int size( ) const
+    {
+        return m_count * m_stride;
+    }
+    
+    //! cree un buffer openGL contenant les sommets entrelaces. renvoie NULL si le buffer est vide.
+    GLAttributeBuffer *createBuffer( const GLenum usage= GL_STATIC_DRAW ) const;
+    
+    //! associe chaque attribut du buffer a la variable de meme nom du shader. 
+    //! les attributs non utilises par le shader sont ignores, renvoie le nombre d'attributs associes.
+    int bind( const GLShaderProgram *program, GLAttributeBuffer *buffer ) const;
+};
+
+}       // namespace
+
+#endif
@@ -1,4 +1,8 @@
+#include <map>
+#include <set>
+
 #include "halfedge.h"
+#include "SpatialGrid.h"
 
 int Halfedge::ID=0;
 
@@ -121,6 +125,138 @@ void Halfedge::computeNormals(Vertex ** t_Maillage, int nb_pas, vector<Face *> *
     }
 }
 
+int Halfedge::weldVertices( vector<Vertex *> * v_Vertex, vector<Halfedge *> * v_Halfedge, vector<Face *> * v_Face, float epsilon ) {
+    int n = v_Vertex->size();
+
+    //je cherche le representant de chaque sommet avec la grille
+    vector<gk::Point> v_P = vector<gk::Point>(n);
+    for ( int i=0; i<n; i++ ) {
+        v_P[i] = v_Vertex->at(i)->v;
+    }
+    gk::SpatialGrid grid( v_P, 2*epsilon );
+    vector<int> remap;
+    grid.weld( epsilon, remap );
+
+    map<Vertex *, Vertex *> m_V = map<Vertex *, Vertex *>();
+    for ( int i=0; i<n; i++ ) {
+        if ( remap[i] != i ) {
+            m_V[v_Vertex->at(i)] = v_Vertex->at(remap[i]);
+        }
+    }
+    if ( m_V.empty() ) {
+        return 0;
+    }
+
+    //les aretes pointent maintenant sur le representant
+    for ( int i=0; i<v_Halfedge->size(); i++ ) {
+        Halfedge * h = v_Halfedge->at(i);
+        map<Vertex *, Vertex *>::iterator found = m_V.find(h->v);
+        if ( found != m_V.end() ) {
+            h->v = found->second;
+        }
+    }
+
+    //les aretes dont les 2 sommets ont ete soudes sont nulles : je les retire de leur face
+    //les faces de moins de 3 aretes sont supprimees avec leurs aretes
+    set<Halfedge *> s_H = set<Halfedge *>();
+    int cpt_f=0;
+    for ( int i=0; i<v_Face->size(); i++ ) {
+        Face * f = v_Face->at(i);
+        vector<Halfedge *> v_H = f->getHalfedges();
+        vector<Halfedge *> v_K = vector<Halfedge *>();
+        for ( int j=0; j<v_H.size(); j++ ) {
+            Halfedge * p = v_H[(j + v_H.size() - 1) % v_H.size()];
+            if ( v_H[j]->v == p->v ) {
+                s_H.insert(v_H[j]);
+            }
+            else {
+                v_K.push_back(v_H[j]);
+            }
+        }
+
+        if ( v_K.size() < 3 ) {
+            s_H.insert(v_H.begin(), v_H.end());
+            delete f;
+            continue;
+        }
+        for ( int j=0; j<v_K.size(); j++ ) {
+            v_K[j]->he_n = v_K[(j+1) % v_K.size()];
+        }
+        f->he = v_K[0];
+        v_Face->at(cpt_f) = f;
+        cpt_f++;
+    }
+    v_Face->resize(cpt_f);
+
+    if ( !s_H.empty() ) {
+        int cpt_h=0;
+        for ( int i=0; i<v_Halfedge->size(); i++ ) {
+            Halfedge * h = v_Halfedge->at(i);
+            if ( h->he_e != NULL && s_H.count(h->he_e) ) {
+                h->he_e = NULL;
+            }
+        }
+        for ( int i=0; i<v_Halfedge->size(); i++ ) {
+            Halfedge * h = v_Halfedge->at(i);
+            if ( s_H.count(h) ) {
+                delete h;
+            }
+            else {
+                v_Halfedge->at(cpt_h) = h;
+                cpt_h++;
+            }
+        }
+        v_Halfedge->resize(cpt_h);
+    }
+
+    //je supprime les doublons
+    int cpt=0;
+    for ( int i=0; i<n; i++ ) {
+        Vertex * v = v_Vertex->at(i);
+        if ( remap[i] != i ) {
+            delete v;
+        }
+        else {
+            v_Vertex->at(cpt) = v;
+            cpt++;
+        }
+    }
+    v_Vertex->resize(cpt);
+
+    //chaque sommet pointe sur une arete restante
+    for ( int i=0; i<cpt; i++ ) {
+        v_Vertex->at(i)->he = NULL;
+    }
+    for ( int i=0; i<v_Halfedge->size(); i++ ) {
+        Halfedge * h = v_Halfedge->at(i);
+        if ( h->v->he == NULL ) {
+            h->v->he = h;
+        }
+    }
+
+    //les aretes sans paire peuvent maintenant en avoir une : a -> b est la paire de b -> a
+    map<pair<Vertex *, Vertex *>, Halfedge *> m_H = map<pair<Vertex *, Vertex *>, Halfedge *>();
+    for ( int i=0; i<v_Halfedge->size(); i++ ) {
+        Halfedge * h = v_Halfedge->at(i);
+        if ( h->he_e == NULL ) {
+            m_H[make_pair(h->getPrevious()->v, h->v)] = h;
+        }
+    }
+    for ( map<pair<Vertex *, Vertex *>, Halfedge *>::iterator it = m_H.begin(); it != m_H.end(); ++it ) {
+        Halfedge * h = it->second;
+        if ( h->he_e != NULL || it->first.first == it->first.second ) {
+            continue;
+        }
+        map<pair<Vertex *, Vertex *>, Halfedge *>::iterator found = m_H.find(make_pair(it->first.second, it->first.first));
+        if ( found != m_H.end() && found->second->he_e == NULL ) {
+            h->he_e = found->second;
+            found->second->he_e = h;
+        }
+    }
+
+    return n - cpt;
+}
+
 void evenHalfedge( Vertex * a, Vertex * b, Halfedge * he1, Halfedge * he2 ) {
     if ( a->he != he1 && b->he != he2 ) {
         if ( a->he->he_n->v == b ) {
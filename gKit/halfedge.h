@@ -55,6 +55,17 @@ class Halfedge {
 
         static void maillageToHalfedge(Vertex **, int, vector<Halfedge *> *, vector<Face *> *);
         static void computeNormals(Vertex **, int, vector<Face *> *);
+        //soude les sommets a une distance <= epsilon et relie les aretes paires qui en resultent
+        //les aretes nulles sont retirees de leur face, les faces de moins de 3 aretes sont supprimees
+        //retourne le nombre de sommets supprimes
+        static int weldVertices(vector<Vertex *> *, vector<Halfedge *> *, vector<Face *> *, float epsilon);
+        //simplifie le maillage par contraction d'aretes ( erreur quadrique ) jusqu'a nb_faces triangles
+        //les faces sont triangulees, les sommets de bord ne bougent pas et les bords sont conserves
+        //retourne le nombre de faces du maillage simplifie
+        static int simplify(vector<Vertex *> *, vector<Halfedge *> *, vector<Face *> *, int nb_faces);
+        //construit une chaine de niveaux de details, un maillage par nombre de faces cible ( du plus fin au plus grossier )
+        //le maillage d'origine n'est pas modifie
+        static void buildLOD(vector<Vertex *> *, vector<Halfedge *> *, vector<Face *> *, vector<int>, vector<struct LOD> *);
 
         static void importFromObj(string, vector<Vertex *> *, vector<Halfedge *> *, vector<Face *> *);
         static void exportToObj(string, Vertex **, int, vector<Face *> *);
@@ -62,5 +73,12 @@ class Halfedge {
         static string pointToObj(Vertex *);
         static string faceToObj(Face *);
 };
+
+//un niveau de detail : maillage halfedge complet, independant du maillage d'origine
+struct LOD {
+    vector<Vertex *> v_Vertex;
+    vector<Halfedge *> v_Halfedge;
+    vector<Face *> v_Face;
+};
 #endif
 
@@ -0,0 +1,410 @@
+#include <map>
+#include <queue>
+#include <algorithm>
+#include <cmath>
+
+#include "halfedge.h"
+
+namespace {
+
+//quadrique symetrique 4x4 : a b c d / b e f g / c f h i / d g i j
+struct Quadric {
+    double q[10];
+
+    Quadric() {
+        for ( int i=0; i<10; i++ ) {
+            q[i] = 0;
+        }
+    }
+
+    //quadrique du plan ax + by + cz + d = 0, ponderee par w
+    Quadric( double a, double b, double c, double d, double w ) {
+        q[0] = w*a*a; q[1] = w*a*b; q[2] = w*a*c; q[3] = w*a*d;
+        q[4] = w*b*b; q[5] = w*b*c; q[6] = w*b*d;
+        q[7] = w*c*c; q[8] = w*c*d;
+        q[9] = w*d*d;
+    }
+
+    Quadric & operator+=( const Quadric & o ) {
+        for ( int i=0; i<10; i++ ) {
+            q[i] += o.q[i];
+        }
+        return *this;
+    }
+
+    //erreur du point p
+    double error( const gk::Point & p ) const {
+        const double x=p.x, y=p.y, z=p.z;
+        return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+            + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+            + q[7]*z*z + 2*q[8]*z
+            + q[9];
+    }
+
+    //position minimisant l'erreur, retourne false si le systeme est mal conditionne
+    bool optimum( gk::Point & p ) const {
+        const double det = q[0]*(q[4]*q[7] - q[5]*q[5]) - q[1]*(q[1]*q[7] - q[5]*q[2]) + q[2]*(q[1]*q[5] - q[4]*q[2]);
+        if ( fabs(det) < 1e-12 ) {
+            return false;
+        }
+        const double inv = 1.0 / det;
+        p.x = (float) (-inv * ( q[3]*(q[4]*q[7] - q[5]*q[5]) - q[1]*(q[6]*q[7] - q[5]*q[8]) + q[2]*(q[6]*q[5] - q[4]*q[8]) ));
+        p.y = (float) (-inv * ( q[0]*(q[6]*q[7] - q[8]*q[5]) - q[3]*(q[1]*q[7] - q[5]*q[2]) + q[2]*(q[1]*q[8] - q[6]*q[2]) ));
+        p.z = (float) (-inv * ( q[0]*(q[4]*q[8] - q[5]*q[6]) - q[1]*(q[1]*q[8] - q[6]*q[2]) + q[3]*(q[1]*q[5] - q[4]*q[2]) ));
+        return true;
+    }
+};
+
+//contraction candidate, triee par cout croissant dans la file
+struct Collapse {
+    double cost;
+    int u, v; //u est supprime, v est conserve
+    int stamp_u, stamp_v; //versions des sommets au moment du calcul
+    gk::Point p;
+
+    bool operator<( const Collapse & c ) const {
+        return cost > c.cost;
+    }
+};
+
+//simplification sur un maillage indexe, extrait du maillage halfedge
+class Simplifier {
+    public:
+        vector<gk::Point> v_P;
+        vector<bool> v_Border;
+        vector<int> v_T; //3 sommets par triangle
+        vector<bool> v_Removed; //triangles supprimes
+        vector<vector<int> > v_VT; //triangles incidents a chaque sommet
+        vector<Quadric> v_Q;
+        vector<int> v_Stamp;
+        priority_queue<Collapse> queue;
+        int nb_triangles;
+
+        Simplifier( vector<Vertex *> * v_Vertex, vector<Face *> * v_Face ) {
+            map<Vertex *, int> m_V = map<Vertex *, int>();
+            for ( int i=0; i<v_Vertex->size(); i++ ) {
+                Vertex * v = v_Vertex->at(i);
+                m_V[v] = i;
+                v_P.push_back(v->v);
+                //les sommets de bord ne bougent pas
+                v_Border.push_back( v->he == NULL || v->isOnBorder() );
+            }
+
+            //les faces sont triangulees en eventail
+            for ( int i=0; i<v_Face->size(); i++ ) {
+                vector<Vertex *> v_V = v_Face->at(i)->getVertex();
+                for ( int k=1; k+1<v_V.size(); k++ ) {
+                    v_T.push_back( m_V[v_V.at(0)] );
+                    v_T.push_back( m_V[v_V.at(k)] );
+                    v_T.push_back( m_V[v_V.at(k+1)] );
+                }
+            }
+            nb_triangles = v_T.size() / 3;
+            v_Removed = vector<bool>(nb_triangles, false);
+
+            v_VT = vector<vector<int> >(v_P.size());
+            v_Q = vector<Quadric>(v_P.size());
+            v_Stamp = vector<int>(v_P.size(), 0);
+            for ( int t=0; t<nb_triangles; t++ ) {
+                const gk::Point & a = v_P[v_T[3*t]];
+                const gk::Point & b = v_P[v_T[3*t+1]];
+                const gk::Point & c = v_P[v_T[3*t+2]];
+                gk::Vector n = gk::Cross(b - a, c - a);
+                const float area = n.Length();
+                if ( area > 0 ) {
+                    n = n / area;
+                }
+                Quadric q( n.x, n.y, n.z, -gk::Dot(n, gk::Vector(a)), area * 0.5 );
+                for ( int k=0; k<3; k++ ) {
+                    v_VT[v_T[3*t+k]].push_back(t);
+                    v_Q[v_T[3*t+k]] += q;
+                }
+            }
+
+            //une contraction candidate par arete
+            for ( int t=0; t<nb_triangles; t++ ) {
+                for ( int k=0; k<3; k++ ) {
+                    int a = v_T[3*t+k];
+                    int b = v_T[3*t+(k+1)%3];
+                    if ( a < b ) {
+                        push(a, b);
+                    }
+                    else if ( !isEdge(b, a, t) ) {
+                        //arete de bord orientee b -> a, non vue depuis un autre triangle
+                        push(b, a);
+                    }
+                }
+            }
+        }
+
+        //retourne vrai si l'arete a b est dans un autre triangle que t
+        bool isEdge( int a, int b, int t ) {
+            for ( int i=0; i<v_VT[a].size(); i++ ) {
+                int s = v_VT[a][i];
+                if ( s != t && (v_T[3*s] == b || v_T[3*s+1] == b || v_T[3*s+2] == b) ) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        //calcule la contraction de l'arete a b et l'ajoute a la file
+        void push( int a, int b ) {
+            if ( v_Border[a] && v_Border[b] ) {
+                return;
+            }
+
+            Collapse c;
+            Quadric q = v_Q[a];
+            q += v_Q[b];
+            if ( v_Border[a] || v_Border[b] ) {
+                //le sommet de bord est conserve
+                c.v = v_Border[a] ? a : b;
+                c.u = v_Border[a] ? b : a;
+                c.p = v_P[c.v];
+            }
+            else {
+                c.u = a;
+                c.v = b;
+                if ( !q.optimum(c.p) ) {
+                    //choisit la meilleure position entre les extremites et le milieu
+                    gk::Point m = (v_P[a] + v_P[b]) * 0.5f;
+                    c.p = m;
+                    if ( q.error(v_P[a]) < q.error(c.p) ) c.p = v_P[a];
+                    if ( q.error(v_P[b]) < q.error(c.p) ) c.p = v_P[b];
+                }
+            }
+            c.cost = q.error(c.p);
+            c.stamp_u = v_Stamp[c.u];
+            c.stamp_v = v_Stamp[c.v];
+            queue.push(c);
+        }
+
+        //retourne les sommets voisins de a
+        void neighbours( int a, vector<int> & v_N ) {
+            v_N.clear();
+            for ( int i=0; i<v_VT[a].size(); i++ ) {
+                int t = v_VT[a][i];
+                for ( int k=0; k<3; k++ ) {
+                    int b = v_T[3*t+k];
+                    if ( b != a && find(v_N.begin(), v_N.end(), b) == v_N.end() ) {
+                        v_N.push_back(b);
+                    }
+                }
+            }
+        }
+
+        //condition de lien : les voisins communs de u et v sont exactement les sommets opposes a l'arete
+        //et aucun triangle ne se retourne apres la contraction
+        bool isValid( const Collapse & c ) {
+            vector<int> v_Nu, v_Nv;
+            neighbours(c.u, v_Nu);
+            neighbours(c.v, v_Nv);
+            if ( find(v_Nu.begin(), v_Nu.end(), c.v) == v_Nu.end() ) {
+                return false;
+            }
+
+            int common = 0;
+            for ( int i=0; i<v_Nu.size(); i++ ) {
+                if ( find(v_Nv.begin(), v_Nv.end(), v_Nu[i]) != v_Nv.end() ) {
+                    common++;
+                }
+            }
+            int opposite = 0;
+            for ( int i=0; i<v_VT[c.u].size(); i++ ) {
+                int t = v_VT[c.u][i];
+                if ( v_T[3*t] == c.v || v_T[3*t+1] == c.v || v_T[3*t+2] == c.v ) {
+                    opposite++;
+                }
+            }
+            if ( common != opposite ) {
+                return false;
+            }
+
+            //les triangles deplaces ne doivent pas se retourner
+            for ( int s=0; s<2; s++ ) {
+                int a = (s == 0) ? c.u : c.v;
+                for ( int i=0; i<v_VT[a].size(); i++ ) {
+                    int t = v_VT[a][i];
+                    int k = (v_T[3*t] == a) ? 0 : (v_T[3*t+1] == a) ? 1 : 2;
+                    int b = v_T[3*t+(k+1)%3];
+                    int d = v_T[3*t+(k+2)%3];
+                    if ( b == c.u || b == c.v || d == c.u || d == c.v ) {
+                        continue; //triangle supprime par la contraction
+                    }
+                    gk::Vector n0 = gk::Cross(v_P[b] - v_P[a], v_P[d] - v_P[a]);
+                    gk::Vector n1 = gk::Cross(v_P[b] - c.p, v_P[d] - c.p);
+                    if ( gk::Dot(n0, n1) <= 0 ) {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        //contracte les aretes jusqu'a nb_faces triangles
+        void run( int nb_faces ) {
+            while ( nb_triangles > nb_faces && !queue.empty() ) {
+                Collapse c = queue.top();
+                queue.pop();
+                if ( c.stamp_u != v_Stamp[c.u] || c.stamp_v != v_Stamp[c.v] ) {
+                    continue; //contraction perimee
+                }
+                if ( !isValid(c) ) {
+                    continue;
+                }
+
+                //supprime les triangles de l'arete, remplace u par v dans les autres
+                vector<int> v_Keep = vector<int>();
+                vector<int> v_Del = vector<int>();
+                for ( int i=0; i<v_VT[c.v].size(); i++ ) {
+                    int t = v_VT[c.v][i];
+                    if ( v_T[3*t] == c.u || v_T[3*t+1] == c.u || v_T[3*t+2] == c.u ) {
+                        v_Removed[t] = true;
+                        v_Del.push_back(t);
+                        nb_triangles--;
+                    }
+                    else {
+                        v_Keep.push_back(t);
+                    }
+                }
+                for ( int i=0; i<v_VT[c.u].size(); i++ ) {
+                    int t = v_VT[c.u][i];
+                    if ( v_Removed[t] ) {
+                        continue;
+                    }
+                    for ( int k=0; k<3; k++ ) {
+                        if ( v_T[3*t+k] == c.u ) {
+                            v_T[3*t+k] = c.v;
+                        }
+                    }
+                    v_Keep.push_back(t);
+                }
+                //les triangles supprimes disparaissent aussi des listes des sommets opposes
+                for ( int i=0; i<v_Del.size(); i++ ) {
+                    int t = v_Del[i];
+                    for ( int k=0; k<3; k++ ) {
+                        if ( v_T[3*t+k] == c.u || v_T[3*t+k] == c.v ) {
+                            continue;
+                        }
+                        vector<int> & v_L = v_VT[v_T[3*t+k]];
+                        int n = 0;
+                        for ( int j=0; j<v_L.size(); j++ ) {
+                            if ( !v_Removed[v_L[j]] ) {
+                                v_L[n++] = v_L[j];
+                            }
+                        }
+                        v_L.resize(n);
+                    }
+                }
+                v_VT[c.v] = v_Keep;
+                v_VT[c.u].clear();
+
+                v_P[c.v] = c.p;
+                v_Q[c.v] += v_Q[c.u];
+                v_Stamp[c.u]++;
+                v_Stamp[c.v]++;
+
+                //recalcule les contractions autour de v
+                vector<int> v_N;
+                neighbours(c.v, v_N);
+                for ( int i=0; i<v_N.size(); i++ ) {
+                    push( min(c.v, v_N[i]), max(c.v, v_N[i]) );
+                }
+            }
+        }
+
+        //construit un maillage halfedge a partir des triangles restants
+        void extract( vector<Vertex *> * v_Vertex, vector<Halfedge *> * v_Halfedge, vector<Face *> * v_Face ) {
+            vector<Vertex *> v_New = vector<Vertex *>(v_P.size(), (Vertex *) NULL);
+            map<pair<Vertex *, Vertex *>, Halfedge *> m_H = map<pair<Vertex *, Vertex *>, Halfedge *>();
+            for ( int t=0; t<v_Removed.size(); t++ ) {
+                if ( v_Removed[t] ) {
+                    continue;
+                }
+                Vertex * v_S[3];
+                for ( int k=0; k<3; k++ ) {
+                    int a = v_T[3*t+k];
+                    if ( v_New[a] == NULL ) {
+                        v_New[a] = new Vertex( v_P[a], NULL, 0 );
+                        v_Vertex->push_back( v_New[a] );
+                    }
+                    v_S[k] = v_New[a];
+                }
+
+                //meme construction que Face::fromObj
+                Face * f = new Face();
+                v_Face->push_back(f);
+                Halfedge * v_H[3];
+                for ( int k=0; k<3; k++ ) {
+                    v_H[k] = new Halfedge( v_S[k], NULL, NULL, f );
+                    v_Halfedge->push_back( v_H[k] );
+                }
+                f->he = v_H[0];
+                for ( int k=0; k<3; k++ ) {
+                    v_H[k]->he_n = v_H[(k+1)%3];
+                    m_H[make_pair(v_S[k], v_S[(k+1)%3])] = v_H[(k+1)%3];
+                }
+            }
+
+            //a -> b est la paire de b -> a
+            for ( map<pair<Vertex *, Vertex *>, Halfedge *>::iterator it = m_H.begin(); it != m_H.end(); ++it ) {
+                map<pair<Vertex *, Vertex *>, Halfedge *>::iterator found = m_H.find(make_pair(it->first.second, it->first.first));
+                if ( found != m_H.end() ) {
+                    it->second->he_e = found->second;
+                }
+            }
+
+            //normales des sommets, cf. computeNormals
+            for ( int i=0; i<v_Face->size(); i++ ) {
+                gk::Vector norm = v_Face->at(i)->computeNormal();
+                if ( norm.LengthSquared() == 0 ) {
+                    continue;
+                }
+                vector<Vertex *> v_V = v_Face->at(i)->getVertex();
+                for ( int j=0; j<v_V.size(); j++ ) {
+                    v_V.at(j)->n += gk::Normalize(norm);
+                }
+            }
+
+            //la somme des normales des faces n'est pas unitaire
+            for ( int a=0; a<v_New.size(); a++ ) {
+                if ( v_New[a] != NULL && v_New[a]->n.LengthSquared() > 0 ) {
+                    v_New[a]->n = gk::Normalize(v_New[a]->n);
+                }
+            }
+        }
+};
+
+}
+
+int Halfedge::simplify( vector<Vertex *> * v_Vertex, vector<Halfedge *> * v_Halfedge, vector<Face *> * v_Face, int nb_faces ) {
+    Simplifier s( v_Vertex, v_Face );
+    s.run( nb_faces );
+
+    //remplace le maillage
+    for ( int i=0; i<v_Vertex->size(); i++ ) delete v_Vertex->at(i);
+    for ( int i=0; i<v_Halfedge->size(); i++ ) delete v_Halfedge->at(i);
+    for ( int i=0; i<v_Face->size(); i++ ) delete v_Face->at(i);
+    v_Vertex->clear();
+    v_Halfedge->clear();
+    v_Face->clear();
+    s.extract( v_Vertex, v_Halfedge, v_Face );
+
+    return v_Face->size();
+}
+
+void Halfedge::buildLOD( vector<Vertex *> * v_Vertex, vector<Halfedge *> * v_Halfedge, vector<Face *> * v_Face, vector<int> v_Targets, vector<LOD> * v_LOD ) {
+    //les contractions sont enchainees : chaque niveau continue la simplification du precedent
+    sort( v_Targets.begin(), v_Targets.end() );
+    reverse( v_Targets.begin(), v_Targets.end() );
+
+    Simplifier s( v_Vertex, v_Face );
+    for ( int i=0; i<v_Targets.size(); i++ ) {
+        s.run( v_Targets.at(i) );
+        v_LOD->push_back( LOD() );
+        LOD & lod = v_LOD->back();
+        s.extract( &lod.v_Vertex, &lod.v_Halfedge, &lod.v_Face );
+    }
+}
@@ -0,0 +1,171 @@
+
+// tone mapping sans fenetre : convertit des images .hdr en .png ou .bmp, memes courbes que image_viewer / hdr_tone.gkfx.
+// les scanlines sont lues, converties et ecrites par groupes : la memoire utilisee ne depend pas de la hauteur des images.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "ImageIO.h"
+#include "ImageRGBE.h"
+#include "ImageWriter.h"
+#include "ImageStatistics.h"
+#include "IOFileSystem.h"
+#include "ToneMap.h"
+
+
+//! parametres de la conversion.
+struct Options
+{
+    float compression;
+    float saturation;           //!< <= 0 : luminance max de chaque image, comme image_viewer.
+    bool heat;
+    int block;                  //!< nombre de scanlines par groupe.
+    std::string format;         //!< extension des images produites.
+    std::string output;
+
+    Options( )
+        :
+        compression(2.f), saturation(0.f), heat(false), block(64), format(".png"), output()
+    {}
+};
+
+void usage( )
+{
+    printf("usage: hdr_tonemap [options] image.hdr [image.hdr ...]\n");
+    printf("  -c compression    exposant de compression (2)\n");
+    printf("  -s saturation     luminance affichee en blanc (luminance max de chaque image)\n");
+    printf("  -heat             fausses couleurs, cf. false_colors.png\n");
+    printf("  -bmp              produit des images .bmp (.png par defaut)\n");
+    printf("  -b rows           nombre de scanlines par groupe (64)\n");
+    printf("  -o file           nom de l'image produite, une seule image en entree\n");
+}
+
+//! premiere lecture de l'image : luminance max, comme le reglage initial du viewer.
+float max_luminance( const std::string& filename, const int block )
+{
+    gk::RGBEReader reader;
+    if(reader.open(filename) < 0)
+        return -1.f;
+
+    std::vector<float> rows(4 * (size_t) reader.width() * block);
+    float ymax= 0.f;
+    int n;
+    while((n= reader.read(&rows.front(), block)) > 0)
+    {
+        gk::ImageStatistics stats;
+        stats.compute(&rows.front(), n * reader.width());
+        ymax= std::max(ymax, stats.ymax);
+    }
+
+    return (n < 0) ? -1.f : ymax;
+}
+
+int tonemap( const std::string& filename, const std::string& output, const Options& options, gk::ToneMap& tone )
+{
+    tone.saturation= options.saturation;
+    if(tone.saturation <= 0.f)
+    {
+        tone.saturation= max_luminance(filename, options.block);
+        if(tone.saturation < 0.f)
+            return -1;
+        if(tone.saturation == 0.f)
+            tone.saturation= 1.f;   // image noire
+    }
+
+    gk::RGBEReader reader;
+    if(reader.open(filename) < 0)
+        return -1;
+
+    const int width= reader.width();
+    const int height= reader.height();
+    gk::ImageWriter writer;
+    if(writer.open(output, width, height, 3) < 0)
+        return -1;
+
+    std::vector<float> rows(4 * (size_t) width * options.block);
+    std::vector<unsigned char> pixels(3 * (size_t) width * options.block);
+    int n;
+    while((n= reader.read(&rows.front(), options.block)) > 0)
+    {
+        // les scanlines sont decompressees en parallele par le reader, puis converties en parallele
+        #pragma omp parallel for schedule(static)
+        for(int y= 0; y < n; y++)
+            tone.apply(&rows[4 * (size_t) y * width], width, &pixels[3 * (size_t) y * width]);
+
+        if(writer.write(&pixels.front(), n) < 0)
+            return -1;
+    }
+
+    if(n < 0)
+        return -1;
+    if(writer.close() < 0)
+        return -1;
+
+    printf("%s: %dx%d, compression %f, saturation %f -> %s\n",
+        filename.c_str(), width, height, tone.compression, tone.saturation, output.c_str());
+    return 0;
+}
+
+int main( int argc, char **argv )
+{
+    Options options;
+    std::vector<std::string> files;
+    for(int i= 1; i < argc; i++)
+    {
+        const bool value= (i + 1 < argc);
+        if(strcmp(argv[i], "-c") == 0 && value)
+            options.compression= (float) atof(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0 && value)
+            options.saturation= (float) atof(argv[++i]);
+        else if(strcmp(argv[i], "-b") == 0 && value)
+            options.block= atoi(argv[++i]);
+        else if(strcmp(argv[i], "-o") == 0 && value)
+            options.output= argv[++i];
+        else if(strcmp(argv[i], "-heat") == 0)
+            options.heat= true;
+        else if(strcmp(argv[i], "-bmp") == 0)
+            options.format= ".bmp";
+        else if(argv[i][0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    if(files.empty() || options.compression <= 0.f || options.block <= 0
+    || (options.output.empty() == false && files.size() > 1))
+    {
+        usage();
+        return 1;
+    }
+
+    gk::ToneMap tone(options.compression);
+    if(options.heat)
+    {
+        tone.heat= true;
+        if(tone.setColors(gk::ImageIO::read("false_colors.png")) < 0)
+        {
+            printf("false_colors.png: read error.\n");
+            return 1;
+        }
+    }
+
+    int code= 0;
+    for(unsigned int i= 0; i < files.size(); i++)
+    {
+        const std::string output= options.output.empty() ? gk::IOFileSystem::changeType(files[i], options.format) : options.output;
+        if(tonemap(files[i], output, options, tone) < 0)
+        {
+            printf("%s: failed.\n", files[i].c_str());
+            code= 1;
+        }
+    }
+
+    return code;
+}
@@ -9,6 +9,12 @@
 #include "EffectIO.h"
 #include "EffectShaderManager.h"
 #include "ImageIO.h"
+#include "AsyncIO.h"
+#include "ImageStatistics.h"
+#include "LuminanceReduction.h"
+#include "TiledImage.h"
+#include "TileCache.h"
+#include "IOFileSystem.h"
 #include "TextureManager.h"
 #include "SamplerManager.h"
 #include "GL/TPSampler.h"
@@ -21,6 +27,7 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <algorithm>
 
 #include "utils.h"
 
@@ -46,6 +53,7 @@ class ImageViewer : public gk::App
     std::string m_filename;
     gk::GLTexture2D *m_image;
     gk::GLTexture2D *m_colors;
+    gk::AsyncTexture2D<gk::Image> m_colors_create;      //!< creee par AsyncIO, doit rester valide apres init().
     gk::GLShaderProgram *m_program;
     gk::GLSampler *m_sampler;
 
@@ -68,6 +76,17 @@ class ImageViewer : public gk::App
     float m_bins_min;
     float m_bins_max;
 
+    gk::LuminanceReduction m_reduction;
+    bool m_auto_exposure;
+
+    gk::TiledImage m_tiles;
+    gk::TileCache m_cache;
+    gk::GLSampler *m_nearest;
+    bool m_tiled;
+    float m_view_x;
+    float m_view_y;
+    float m_zoom;
+
     public:
     ImageViewer( const int w, const int h, const std::string& filename )
         :
@@ -75,6 +94,7 @@ class ImageViewer : public gk::App
             m_filename(filename),
             m_image(NULL),
             m_colors(NULL),
+            m_colors_create(gk::UNIT0),
             m_program(NULL),
             m_sampler(NULL),
             m_compression(2.f),
@@ -88,7 +108,16 @@ class ImageViewer : public gk::App
             m_ymax(1.f),
             m_bins_n(256),
             m_bins_min(0.f),
-            m_bins_max(1.f)
+            m_bins_max(1.f),
+            m_reduction(),
+            m_auto_exposure(false),
+            m_tiles(),
+            m_cache(),
+            m_nearest(NULL),
+            m_tiled(false),
+            m_view_x(0.f),
+            m_view_y(0.f),
+            m_zoom(1.f)
     {
         m_ui.init(w, h);
     }
@@ -119,13 +148,25 @@ class ImageViewer : public gk::App
     {
         gk::TextureUnitState::init();
 
-        // charge la texture de fausses couleurs
-        gk::Image *colors= gk::ImageIO::read("false_colors.png");
-        if(colors == NULL)
-            return -1;
-        m_colors= gk::createTexture2D(gk::UNIT0, colors);
-        if(m_colors == NULL || m_colors->createGLResource() < 0)
-            return -1;
+        // charge la texture de fausses couleurs en arriere plan, pendant la compilation du shader
+        gk::TAsyncRequest<gk::Image> *colors_request= gk::AsyncIO::readImage("false_colors.png", "", &m_colors_create);
+
+        // charge l'image, ou les tuiles d'une trop grande image, cf. initTiles()
+        std::string tiles= m_filename;
+        if(isLargeImage(m_filename))
+        {
+            tiles= gk::IOFileSystem::changeType(m_filename, ".gkt");
+            if(gk::IOFileSystem::uptodate(m_filename, tiles) != 1)
+            {
+                printf("tiling '%s' to '%s'...\n", m_filename.c_str(), tiles.c_str());
+                if(gk::TiledImage::convert(m_filename, tiles) < 0)
+                    return -1;
+            }
+        }
+
+        gk::TAsyncRequest<gk::HDRImage> *hdr_request= NULL;
+        if(gk::IOFileSystem::isType(tiles, ".gkt") == false)
+            hdr_request= gk::AsyncIO::readHDRImage(m_filename);
 
         m_sampler= gk::createSampler();
         if(m_sampler == NULL || m_sampler->createGLResource() < 0)
@@ -138,17 +179,40 @@ class ImageViewer : public gk::App
         if(m_program == NULL || m_program->createGLResource() < 0)
             return -1;
 
-        // charge l'image
-        gk::HDRImage *hdr= gk::HDRImageIO::read(m_filename);
-        if(hdr == NULL)
-        {
-            printf(" -- '%s' failed.\n", m_filename.c_str());
+        if(gk::AsyncIO::wait(colors_request) < 0)
             return -1;
+        m_colors= m_colors_create.texture();
+
+        gk::ImageStatistics stats;
+        gk::HDRImage *hdr= NULL;
+        if(hdr_request == NULL)
+        {
+            if(initTiles(tiles, stats) < 0)
+            {
+                printf(" -- '%s' failed.\n", tiles.c_str());
+                return -1;
+            }
         }
+        else
+        {
+            gk::AsyncIO::wait(hdr_request);
+            hdr= hdr_request->get();
+            if(hdr == NULL)
+            {
+                printf(" -- '%s' failed.\n", m_filename.c_str());
+                return -1;
+            }
 
-        m_image= gk::createTexture2D(gk::UNIT0, hdr);
-        if(m_image == NULL || m_image->createGLResource() < 0)
-            return -1;
+            // texture compacte, rgb9e5 : 4 octets par pixel au lieu de 16
+            gk::RGB9E5Image packed(hdr->width(), hdr->height());
+            gk::ImageConvert(hdr, &packed);
+            m_image= gk::createTexture2D(gk::UNIT0, &packed);
+            if(m_image == NULL || m_image->createGLResource() < 0)
+                return -1;
+
+            // . statistiques de luminance et histogramme, en un seul parcours de l'image
+            stats.compute(hdr);
+        }
 
         // modifier le titre de la fenetre
         SDL_WM_SetCaption(m_filename.c_str(), "");
@@ -162,59 +226,200 @@ class ImageViewer : public gk::App
         m_saturation_fine= 0.f;
         m_mode= 0.f;
 
+        const float ymin= stats.ymin;
+        const float ymax= stats.ymax;
+        m_ymin= ymin;
+        m_ymax= ymax;
+
+        printf("min %f < %f < max %f, log average %f\n",
+                ymin, stats.mean, ymax, stats.log_average);
+
         m_bins_n= 256;
-        for(int i= 0; i< m_bins_n; i++)
-            m_bins[i]= 0.f;
-
-        // . trouver les extremess
-        float ymin= HUGE_VAL;
-        float ymax= -HUGE_VAL;
-        float sum= 0.f;
-        for(int y= 0; y < hdr->height(); y++)
-            for(int x= 0; x < hdr->width(); x++)
-            {
-                const gk::HDRPixel &pixel= hdr->getPixel(x, y);
-                const float l= (pixel.r + pixel.g + pixel.b) / 3.f;
+        std::vector<float> bins;
+        stats.histogram(m_bins_n, ymin, ymax, bins);
+        setHistogram(bins, stats.count);
 
-                if(l < ymin)
-                    ymin= l;
-                if(l > ymax)
-                    ymax= l;
+        // . statistiques calculees par le gpu, pour l'exposition automatique
+        if(hdr != NULL && m_reduction.init(hdr->width(), hdr->height(), m_bins_n) < 0)
+            printf("gpu luminance reduction failed.\n");
 
-                sum= sum + l;
-            }
+        // . reglage des plages des sliders
+        m_saturation= ymax;
+        m_saturation_max= ymax;
+        m_saturation_delta= ymax / 10.f;
+        m_saturation_fine= 0.f;
+        m_mode= 0.f;
+        return 0;
+    }
 
-        m_ymin= ymin;
-        m_ymax= ymax;
+    //! vrai pour les images .hdr trop grandes pour une texture, ou pour la memoire : elles sont affichees par tuiles.
+    bool isLargeImage( const std::string& filename )
+    {
+        if(gk::HDRImageIO::is_rgbe_file(filename) == false)
+            return false;
+
+        FILE *in= fopen(filename.c_str(), "rb");
+        if(in == NULL)
+            return false;
+
+        rgbe_header_info info;
+        int width= 0;
+        int height= 0;
+        const int code= RGBE_ReadHeader(in, &width, &height, &info);
+        fclose(in);
+        if(code != RGBE_RETURN_SUCCESS)
+            return false;
+
+        GLint max_size= 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        return (width > max_size || height > max_size
+            || (long long) width * height > 64ll * 1024 * 1024);
+    }
 
-        printf("min %f < %f < max %f\n",
-                ymin, sum / (hdr->width() * hdr->height()), ymax);
+    //! projette les tuiles en memoire, cree le cache de tuiles et calcule les statistiques sur le dernier niveau de l'image.
+    int initTiles( const std::string& filename, gk::ImageStatistics& stats )
+    {
+        if(m_tiles.open(filename) < 0)
+            return -1;
+        if(m_cache.init(&m_tiles) < 0)
+            return -1;
 
-        // . construit l'histogramme
-        const float bin_scale= (float) m_bins_n / (ymax - ymin);
-        for(int y= 0; y < hdr->height(); y++)
-            for(int x= 0; x < hdr->width(); x++)
-            {
-                const gk::HDRPixel &pixel= hdr->getPixel(x, y);
-                const float l= (pixel.r + pixel.g + pixel.b) / 3.f;
+        m_nearest= gk::createNearestSampler();
+        if(m_nearest == NULL || m_nearest->createGLResource() < 0)
+            return -1;
 
-                int k= (l - ymin) * bin_scale;
-                if(k < 0)
-                    k= 0;
-                if(k >= m_bins_n)
-                    k= m_bins_n -1;
+        // le dernier niveau tient dans une seule tuile
+        const int level= m_tiles.levels() -1;
+        const int width= m_tiles.width(level);
+        const int height= m_tiles.height(level);
+        const gk::HDRPixel *tile= m_tiles.tile(level, 0, 0);
+        std::vector<gk::HDRPixel> pixels;
+        pixels.reserve(width * height);
+        for(int y= 0; y < height; y++)
+            pixels.insert(pixels.end(), tile + y * m_tiles.tileSize(), tile + y * m_tiles.tileSize() + width);
+        stats.compute((const float *) &pixels[0], width * height);
+
+        // l'image complete est visible
+        m_tiled= true;
+        m_zoom= std::min((float) windowWidth() / (float) m_tiles.width(), (float) windowHeight() / (float) m_tiles.height());
+        m_view_x= 0.f;
+        m_view_y= 0.f;
+        return 0;
+    }
 
-                m_bins[k]+= 1.f;
-            }
+    //! deplacements et zoom, fleches et page up / page down.
+    void updateView( )
+    {
+        const float step= 10.f / m_zoom;
+        if(key(SDLK_LEFT))
+            m_view_x-= step;
+        if(key(SDLK_RIGHT))
+            m_view_x+= step;
+        if(key(SDLK_DOWN))
+            m_view_y-= step;
+        if(key(SDLK_UP))
+            m_view_y+= step;
+
+        float zoom= m_zoom;
+        if(key(SDLK_PAGEUP))
+        {
+            zoom= m_zoom * 2.f;
+            key(SDLK_PAGEUP)= 0;
+        }
+        if(key(SDLK_PAGEDOWN))
+        {
+            zoom= m_zoom / 2.f;
+            key(SDLK_PAGEDOWN)= 0;
+        }
+        if(key('n'))
+            zoom= 1.f;
+
+        // zoom autour du centre de la fenetre
+        const float cx= m_view_x + (float) windowWidth() / 2.f / m_zoom;
+        const float cy= m_view_y + (float) windowHeight() / 2.f / m_zoom;
+        m_zoom= zoom;
+        m_view_x= cx - (float) windowWidth() / 2.f / m_zoom;
+        m_view_y= cy - (float) windowHeight() / 2.f / m_zoom;
+    }
+
+    //! dessine les tuiles visibles d'un niveau de l'image, si elles sont presentes dans le cache, ou transferees pendant cette image.
+    void drawLevel( const int level )
+    {
+        const int tile= m_tiles.tileSize();
+        const float level_scale= (float) (1 << level);
+        const float scale= level_scale * m_zoom;        // taille d'un pixel du niveau dans la fenetre
+        const float x= m_view_x / level_scale;
+        const float y= m_view_y / level_scale;
+
+        const int x0= std::max(0, (int) floorf(x / tile));
+        const int y0= std::max(0, (int) floorf(y / tile));
+        const int x1= std::min(m_tiles.tilesX(level) -1, (int) floorf((x + (float) windowWidth() / scale) / tile));
+        const int y1= std::min(m_tiles.tilesY(level) -1, (int) floorf((y + (float) windowHeight() / scale) / tile));
+
+        glBegin(GL_QUADS);
+        for(int ty= y0; ty <= y1; ty++)
+        for(int tx= x0; tx <= x1; tx++)
+        {
+            const int slot= m_cache.find(level, tx, ty);
+            if(slot < 0)
+                continue;
+
+            // n'affiche pas les pixels ajoutes sur les bords de l'image
+            const int w= std::min(tile, m_tiles.width(level) - tx * tile);
+            const int h= std::min(tile, m_tiles.height(level) - ty * tile);
+            float s0, t0, s1, t1;
+            m_cache.slotRect(slot, s0, t0, s1, t1);
+            s1= s0 + (s1 - s0) * (float) w / (float) tile;
+            t1= t0 + (t1 - t0) * (float) h / (float) tile;
+
+            const float px= ((float) (tx * tile) - x) * scale;
+            const float py= ((float) (ty * tile) - y) * scale;
+            glTexCoord2f(s0, t1);
+            glVertex2f(px, py + h * scale);
+            glTexCoord2f(s0, t0);
+            glVertex2f(px, py);
+            glTexCoord2f(s1, t0);
+            glVertex2f(px + w * scale, py);
+            glTexCoord2f(s1, t1);
+            glVertex2f(px + w * scale, py + h * scale);
+        }
+        glEnd();
+    }
 
-        m_bins_min= hdr->width() * hdr->height();
+    //! dessine les tuiles : le dernier niveau couvre toute l'image, puis les tuiles du niveau adapte au zoom.
+    void drawTiles( )
+    {
+        // un pixel du niveau couvre au plus un pixel de la fenetre
+        int level= 0;
+        while(level +1 < m_tiles.levels() && (float) (1 << (level +1)) * m_zoom <= 1.f)
+            level++;
+
+        m_cache.beginFrame();
+        gk::setTextureUnit(m_program->sampler("image"), m_cache.atlas(), m_nearest);
+
+        const GLboolean depth= glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glColor3f(1.f, 0.f, 1.f);
+        drawLevel(m_tiles.levels() -1);
+        if(level != m_tiles.levels() -1)
+            drawLevel(level);
+        if(depth)
+            glEnable(GL_DEPTH_TEST);
+
+        gk::resetTextureUnit(m_program->sampler("image"));
+    }
+
+    //! normalise l'histogramme et regle sa dynamique.
+    void setHistogram( const std::vector<float>& bins, const int count )
+    {
+        m_bins_min= count;
         m_bins_max= 0;
         float bins_sum= 0.f;
-        const float bin_normalize= 1.f / (hdr->width() * hdr->height());
+        const float bin_normalize= 1.f / count;
         for(int i= 0; i < m_bins_n; i++)
         {
             //~ printf("%d: %d\n", i, (int) m_bins[i]);
-            m_bins[i]= m_bins[i] * bin_normalize;
+            m_bins[i]= bins[i] * bin_normalize;
 
             if(m_bins[i] < m_bins_min)
                 m_bins_min= m_bins[i];
@@ -226,14 +431,26 @@ class ImageViewer : public gk::App
 
         // . reglage de la dynamique de l'historgramme
         m_bins_max= bins_sum / m_bins_n;
+    }
 
-        // . reglage des plages des sliders
-        m_saturation= ymax;
-        m_saturation_max= ymax;
-        m_saturation_delta= ymax / 10.f;
-        m_saturation_fine= 0.f;
-        m_mode= 0.f;
-        return 0;
+    //! exposition automatique : statistiques calculees par le gpu, relues sans attendre.
+    void updateExposure( )
+    {
+        // histogramme sur l'intervalle de la derniere reduction
+        m_reduction.reduce(m_image, m_ymin, m_ymax);
+
+        gk::LuminanceStatistics stats;
+        while(m_reduction.result(stats))
+        {
+            m_ymin= stats.ymin;
+            m_ymax= stats.ymax;
+            setHistogram(stats.bins, m_image->width() * m_image->height());
+
+            // adaptation progressive de la saturation
+            m_saturation= m_saturation + (stats.ymax - m_saturation) * .1f;
+            m_saturation_fine= 0.f;
+            m_saturation_max= std::max(m_saturation_max, stats.ymax);
+        }
     }
 
     int draw( )
@@ -241,7 +458,9 @@ class ImageViewer : public gk::App
         if(key(SDLK_ESCAPE))
             Close();
 
-        if(key('n'))
+        if(m_tiled)
+            updateView();
+        else if(key('n'))
             resizeWindow(m_image->width(), m_image->height());
 
         if(key(SDLK_SPACE))
@@ -250,11 +469,14 @@ class ImageViewer : public gk::App
             key(SDLK_SPACE)= 0;
         }
 
+        if(m_auto_exposure && m_image != NULL)
+            updateExposure();
+
         const float x= 0.f;
         const float y= 0.f;
         const float z= -.5f;
-        const float w= m_image->width();
-        const float h= m_image->height();
+        const float w= m_tiled ? windowWidth() : m_image->width();
+        const float h= m_tiled ? windowHeight() : m_image->height();
 
         glMatrixMode(GL_PROJECTION);
         glLoadIdentity();
@@ -275,25 +497,31 @@ class ImageViewer : public gk::App
         else
             gk::setUniform(m_program->uniform("heat"), 0.f);
 
-        gk::setTextureUnit(m_program->sampler("image"), m_image, m_sampler);
         gk::setTextureUnit(m_program->sampler("colors"), m_colors, m_sampler);
 
-        glColor3f(1.f, 0.f, 1.f);
-        glBegin(GL_QUADS);
-        glTexCoord2f(0.f, 1.f);
-        glVertex3f(x, y+h, z);
+        if(m_tiled)
+            drawTiles();
+        else
+        {
+            gk::setTextureUnit(m_program->sampler("image"), m_image, m_sampler);
 
-        glTexCoord2f(0.f, 0.f);
-        glVertex3f(x, y, z);
+            glColor3f(1.f, 0.f, 1.f);
+            glBegin(GL_QUADS);
+            glTexCoord2f(0.f, 1.f);
+            glVertex3f(x, y+h, z);
 
-        glTexCoord2f(1.f, 0.f);
-        glVertex3f(x+w, y, z);
+            glTexCoord2f(0.f, 0.f);
+            glVertex3f(x, y, z);
 
-        glTexCoord2f(1.f, 1.f);
-        glVertex3f(x+w, y+h, z);
-        glEnd();
+            glTexCoord2f(1.f, 0.f);
+            glVertex3f(x+w, y, z);
 
-        gk::resetTextureUnit(m_program->sampler("image"));
+            glTexCoord2f(1.f, 1.f);
+            glVertex3f(x+w, y+h, z);
+            glEnd();
+
+            gk::resetTextureUnit(m_program->sampler("image"));
+        }
         gk::resetTextureUnit(m_program->sampler("colors"));
         gk::resetShaderProgram();
 
@@ -360,6 +588,7 @@ class ImageViewer : public gk::App
 
         m_ui.doHorizontalSlider(nv::Rect(), 0.f, m_saturation_delta, &m_saturation_fine);
         m_ui.doCheckButton(nv::Rect(), "histogram", &m_show_histogram);
+        m_ui.doCheckButton(nv::Rect(), "auto", &m_auto_exposure);
         m_ui.endGroup();
 
         m_ui.beginGroup(nv::GroupFlags_GrowRightFromTop);
@@ -390,12 +619,20 @@ class ImageViewer : public gk::App
     }
 };
 
+// dessine un pixel, s'il est dans l'image
+void plot( const gk::ImageView& view, int x, int y, const gk::Pixel& color ) {
+    if ( view.contains(x, y) ) {
+        view.row(y)[x] = color;
+    }
+}
+
 void drawCross( gk::Image * image, gk::Point p, gk::Pixel color ) {
-    image->setPixel( p[0]-1, p[1], color );
-    image->setPixel( p[0]+1, p[1], color );
-    image->setPixel( p[0], p[1], color );
-    image->setPixel( p[0], p[1]-1, color );
-    image->setPixel( p[0], p[1]+1, color );
+    const gk::ImageView view = image->view();
+    plot( view, p[0]-1, p[1], color );
+    plot( view, p[0]+1, p[1], color );
+    plot( view, p[0], p[1], color );
+    plot( view, p[0], p[1]-1, color );
+    plot( view, p[0], p[1]+1, color );
 }
 
 Vertex * P_DeCasteljau( float u, float v, Vertex ** t_Vertex, int n ) {
@@ -18,12 +18,20 @@
 
 using namespace std;
 
+// dessine un pixel, s'il est dans l'image
+void plot( const gk::ImageView& view, int x, int y, const gk::Pixel& color ) {
+    if ( view.contains(x, y) ) {
+        view.row(y)[x] = color;
+    }
+}
+
 void drawCross( gk::Image * image, gk::Point p, gk::Pixel color ) {
-    image->setPixel( p[0]-1, p[1], color );
-    image->setPixel( p[0]+1, p[1], color );
-    image->setPixel( p[0], p[1], color );
-    image->setPixel( p[0], p[1]-1, color );
-    image->setPixel( p[0], p[1]+1, color );
+    const gk::ImageView view = image->view();
+    plot( view, p[0]-1, p[1], color );
+    plot( view, p[0]+1, p[1], color );
+    plot( view, p[0], p[1], color );
+    plot( view, p[0], p[1]-1, color );
+    plot( view, p[0], p[1]+1, color );
 }
 
 gk::Point P_Aitkem( float t, int i, int r, gk::Point * t_Point, float * t_t, int n ) {
@@ -40,9 +48,10 @@ gk::Point P_Aitkem( float t, int i, int r, gk::Point * t_Point, float * t_t, int
 
 void aitkem( gk::Image * image, int i, int r, gk::Point * t_Point, float * t_t, int n ) {
     //pas à pas
+    const gk::ImageView view = image->view();
     for ( float j=t_t[0]; j<t_t[n-1]; j+=0.01 ) {
             gk::Point C = P_Aitkem( j, 0, r-1, t_Point, t_t, n );
-            image->setPixel( C[0], C[1], gk::Pixel(0,255,0) );
+            plot( view, C[0], C[1], gk::Pixel(0,255,0) );
     }
 }
 
@@ -172,7 +181,7 @@ int main( int argc, char ** argv )
 
             if(ph.isVisible()) {
                 gk::Point q = viewport(ph.project());
-                image->setPixel( q.x, q.y, gk::Pixel(255, 0, 0) );
+                plot( image->view(), q.x, q.y, gk::Pixel(255, 0, 0) );
             }
         }
     }
@@ -191,6 +200,12 @@ int main( int argc, char ** argv )
 /*        file.close();*/
 /*    }*/
 
+    // projette tous les sommets du maillage en une seule passe
+    gk::HPoint * t_HMaillage = (gk::HPoint *) malloc(sizeof(gk::HPoint)*nb_pas*nb_pas);
+    unsigned char * t_Clip = (unsigned char *) malloc(sizeof(unsigned char)*nb_pas*nb_pas);
+    mvp( nb_pas*nb_pas, t_Maillage, t_HMaillage, t_Clip );
+
+    const gk::ImageView view = image->view();
     for ( int i=0; i<nb_pas; i++ ) {
         if ( !file.fail() ) {
             file << "f";
@@ -204,14 +219,13 @@ int main( int argc, char ** argv )
 
 /*            cout << "x y z : " << p[0] << " " << p[1] << " " << p[2] << endl;*/
 
-            gk::HPoint ph;
-            mvp(p, ph);
+            const gk::HPoint& ph = t_HMaillage[i*nb_pas + j];
 
             //gk::Point q = ph.project();
-            if(ph.isVisible()) {
+            if(t_Clip[i*nb_pas + j] == 0) {
                 gk::Point q = viewport(ph.project());
 /*                printf("%f %f %f\n", q.x, q.y, q.z);*/
-                image->setPixel( q.x, q.y, gk::Pixel(255, 255, 255) );
+                plot( view, q.x, q.y, gk::Pixel(255, 255, 255) );
 /*                cout << "x y : " << p[0] << " " << p[1] << endl;*/
             }
 
@@ -227,6 +241,8 @@ int main( int argc, char ** argv )
         file.close();
     }
 
+    free(t_Clip);
+    free(t_HMaillage);
     free(t_Maillage);
     free(t_Point);
 
@@ -28,9 +28,9 @@ solution "LEAN"
 
 		configuration "linux"
 			includedirs { "glew-1.7.0/include" }
-			buildoptions { "-pipe", "`sdl-config --cflags`", "-march=native" }
+			buildoptions { "-pipe", "`sdl-config --cflags`", "-march=native", "-fopenmp" }
 			linkoptions { "-Wl,-rpath,glew-1.7.0/lib -Lglew-1.7.0/lib -lGLEW" } -- forcer la version locale de GLEW
-			linkoptions { "`sdl-config --libs`" }
+			linkoptions { "`sdl-config --libs`", "-fopenmp" }
 			links { "GL", "SDL_image", "SDL_ttf" }
 
 		configuration { "linux", "release" }
@@ -40,10 +40,13 @@ solution "LEAN"
 		configuration "windows"
 			includedirs { "./glew-1.7.0/include", "./SDL-1.2.14/include", "./SDL_image-1.2.10/include", "./SDL_ttf-2.0.10/include" } -- configurer les libs dans visual
 			libdirs { "./glew-1.7.0/lib", "./SDL-1.2.14/lib", "./SDL_image-1.2.10/lib", "./SDL_ttf-2.0.10/lib" } -- configurer les libs dans visual
+			includedirs { "./zlib-1.2.3/include" }  -- ImageWriter, png : zlib123-dll.zip, zlib1.dll
+			libdirs { "./zlib-1.2.3/lib" }
 			defines { "WIN32", "NVWIDGETS_EXPORTS", "_USE_MATH_DEFINES", "_CRT_SECURE_NO_WARNINGS" }
-			defines { "NOMINMAX" } -- allow std::min() and std::max() in vc++ :(((
+			defines { "NOMINMAX" } -- allow std::min() and std::max() in vc++ :(((
+			buildoptions { "/openmp" }
 			defines { "NVWIDGETS_EXPORTS" } -- for gKitStatic lib
-			links { "opengl32", "glu32", "glew32", "SDL", "SDLmain", "SDL_image", "SDL_ttf" }
+			links { "opengl32", "glu32", "glew32", "SDL", "SDLmain", "SDL_image", "SDL_ttf", "zdll" }
 			linkoptions { "/NODEFAULTLIB:msvcrt.lib" }
 
 		configuration "macosx"
@@ -54,7 +57,7 @@ solution "LEAN"
 			}
 			buildoptions {"-framework OpenGL -framework SDL -framework SDL_image -framework SDL_ttf -framework Cocoa -I$HOME/local/include"}
 			linkoptions {"-framework OpenGL -framework SDL -framework SDL_image -framework SDL_ttf -framework Cocoa -L$HOME/local/lib"}
-			links {"GLEW", "RGBE"}
+			links {"GLEW", "RGBE", "z"}  -- z : ImageWriter, png
 
 
 project "gKitStatic"
@@ -67,9 +70,13 @@ project "gKitShared"
  	kind "SharedLib"
  	files(all_files)
  	buildoptions {"-fPIC"}
+	configuration "linux"
+		links {"z"}  -- ImageWriter, png
 
 local all_main_files = {
-	"image_viewer"
+	"image_viewer",
+	"hdr_tonemap",
+	"bezier_check"
 }
 
 for i, name in ipairs(all_main_files) do
@@ -79,4 +86,6 @@ for i, name in ipairs(all_main_files) do
  		links {"gKitStatic"}
 --		links {"gKitShared"}
 		files {name..'.cpp'}
+		configuration "linux"
+			links {"z"}  -- ImageWriter, png
 end